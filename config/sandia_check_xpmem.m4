@@ -16,7 +16,7 @@ AC_DEFUN([SANDIA_CHECK_XPMEM], [
 
   XPMEM_CPPFLAGS=
   XPMEM_LDFLAGS=
-  XPMEM_LIBS="-lxpmem"
+  XPMEM_LIBS=
 
   saved_CPPFLAGS="$CPPFLAGS"
   saved_LDFLAGS="$LDFLAGS"
@@ -30,7 +30,7 @@ AC_DEFUN([SANDIA_CHECK_XPMEM], [
   AS_IF([test "$happy" = "yes"], 
     [AC_CHECK_HEADERS([xpmem.h], [], [happy=no])])
   AS_IF([test "$happy" = "yes"],
-    [AC_CHECK_LIB([xpmem], [xpmem_version], [], [happy=no])])
+    [AC_CHECK_LIB([xpmem], [xpmem_version], [XPMEM_LIBS="-lxpmem"], [happy=no])])
 
   CPPFLAGS="$saved_CPPFLAGS"
   LDFLAGS="$saved_LDFLAGS"
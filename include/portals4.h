@@ -78,6 +78,9 @@ typedef ptl_handle_any_t ptl_handle_ct_t; /*!< A counting type event handle */
 typedef ptl_handle_any_t ptl_handle_md_t; /*!< A memory descriptor handle */
 typedef ptl_handle_any_t ptl_handle_le_t; /*!< A list entry handle */
 typedef ptl_handle_any_t ptl_handle_me_t; /*!< A match list entry handle */
+typedef ptl_handle_any_t ptl_handle_prep_t; /*!< A prepared operation handle.
+                                             * Not part of the Portals
+                                             * Specs. */
 
 /*!
  * @union ptl_process_t
@@ -352,6 +355,7 @@ enum ni_types {
     NI_T_NMATCHING,
     NI_T_LOGICAL,
     NI_T_PHYSICAL,
+    NI_T_APP_PROGRESS,
     NI_T_OPTIONS_MASK
 };
 
@@ -373,6 +377,12 @@ enum ni_types {
  * PTL_NI_PHYSICAL are mutually exclusive */
 #define PTL_NI_PHYSICAL (1 << NI_T_PHYSICAL)
 
+/*! Request that the interface specified in \a iface be progressed by the
+ * application threads, when they call PtlEQGet(), PtlEQWait(), PtlEQPoll(),
+ * PtlCTWait(), PtlCTPoll() or a data movement function, instead of by a
+ * dedicated progress thread. Not part of the Portals Specs. */
+#define PTL_NI_APP_PROGRESS (1 << NI_T_APP_PROGRESS)
+
 #define PTL_NI_INIT_OPTIONS_MASK ((1 << NI_T_OPTIONS_MASK) - 1)
 
 /*! @typedef ptl_ni_fail_t
@@ -667,6 +677,36 @@ int PtlGetMap(ptl_handle_ni_t ni_handle,
               ptl_size_t      map_size,
               ptl_process_t  *mapping,
               ptl_size_t     *actual_map_size);
+/*!
+ * @fn PtlNIConnect(ptl_handle_ni_t      ni_handle,
+ *                  ptl_size_t           num_targets,
+ *                  const ptl_process_t *targets)
+ * @brief Establishes the connections to a set of peers ahead of time.
+ *      Not part of the Portals Specs.
+ * @details Starts the connection handshake with every target at once,
+ *      then waits until all of them are connected, so that the first
+ *      operation to each peer does not pay for connection setup. Targets
+ *      that are already connected, and the calling process itself, are
+ *      skipped. Setting the PTL_PRECONNECT environment variable to 1
+ *      starts the handshakes with the whole map when PtlSetMap() is
+ *      called, without waiting for them.
+ * @param[in] ni_handle     The network interface handle.
+ * @param[in] num_targets   The number of entries in \a targets.
+ * @param[in] targets       Ranks (logical interface) or NID/PID pairs
+ *                          (physical interface) to connect to. For a
+ *                          logical interface, NULL means every rank in the
+ *                          map and \a num_targets is ignored.
+ * @retval PTL_OK               Indicates success.
+ * @retval PTL_NO_INIT          Indicates that the portals API has not been
+ *                              successfully initialized.
+ * @retval PTL_ARG_INVALID      Indicates that an invalid argument was passed.
+ * @retval PTL_NO_SPACE         Indicates that there is insufficient memory.
+ * @retval PTL_FAIL             Indicates that a connection could not be
+ *                              established.
+ */
+int PtlNIConnect(ptl_handle_ni_t      ni_handle,
+                 ptl_size_t           num_targets,
+                 const ptl_process_t *targets);
 /*! @} */
 
 /************************
@@ -2568,6 +2608,132 @@ int PtlSwap(ptl_handle_md_t  get_md_handle,
  */
 int PtlAtomicSync(void);
 /*! @} */
+/*!
+ * @fn PtlPutPrepare(ptl_handle_md_t     md_handle,
+ *                   ptl_ack_req_t       ack_req,
+ *                   ptl_process_t       target_id,
+ *                   ptl_pt_index_t      pt_index,
+ *                   ptl_match_bits_t    match_bits,
+ *                   void               *user_ptr,
+ *                   ptl_handle_prep_t  *prep_handle)
+ * @brief Prepare a \p put operation that will be issued many times.
+ *      Not part of the Portals Specs.
+ * @details Validates the arguments that do not change from one \p put to
+ *      the next and builds the request once, so that PtlPreparedIssue()
+ *      only has to fill in the offsets, the length and the header data.
+ *      The memory descriptor cannot be released before the prepared
+ *      operation.
+ * @param[in] md_handle     The memory descriptor handle that describes the
+ *                          memory to be sent.
+ * @param[in] ack_req       Controls whether an acknowledgment event is
+ *                          requested, as for PtlPut().
+ * @param[in] target_id     A process identifier for the \e target process.
+ * @param[in] pt_index      The index in the \e target portal table.
+ * @param[in] match_bits    The match bits to use for message selection at
+ *                          the \e target process.
+ * @param[in] user_ptr      A user-specified value that is associated with
+ *                          each operation issued.
+ * @param[out] prep_handle  On successful return, this location will hold
+ *                          the handle of the prepared operation.
+ * @retval PTL_OK               Indicates success.
+ * @retval PTL_NO_INIT          Indicates that the portals API has not been
+ *                              successfully initialized.
+ * @retval PTL_ARG_INVALID      Indicates that an invalid argument was passed.
+ * @retval PTL_NO_SPACE         Indicates that there is insufficient memory.
+ * @see PtlPreparedIssue(), PtlPreparedRelease()
+ */
+int PtlPutPrepare(ptl_handle_md_t    md_handle,
+                  ptl_ack_req_t      ack_req,
+                  ptl_process_t      target_id,
+                  ptl_pt_index_t     pt_index,
+                  ptl_match_bits_t   match_bits,
+                  void              *user_ptr,
+                  ptl_handle_prep_t *prep_handle);
+
+/*!
+ * @fn PtlAtomicPrepare(ptl_handle_md_t     md_handle,
+ *                      ptl_ack_req_t       ack_req,
+ *                      ptl_process_t       target_id,
+ *                      ptl_pt_index_t      pt_index,
+ *                      ptl_match_bits_t    match_bits,
+ *                      void               *user_ptr,
+ *                      ptl_op_t            operation,
+ *                      ptl_datatype_t      datatype,
+ *                      ptl_handle_prep_t  *prep_handle)
+ * @brief Prepare an \p atomic operation that will be issued many times.
+ *      Not part of the Portals Specs.
+ * @details Same as PtlPutPrepare() for PtlAtomic().
+ * @param[in] md_handle     The memory descriptor handle that describes the
+ *                          memory to be sent.
+ * @param[in] ack_req       Controls whether an acknowledgment event is
+ *                          requested, as for PtlAtomic().
+ * @param[in] target_id     A process identifier for the \e target process.
+ * @param[in] pt_index      The index in the \e target portal table.
+ * @param[in] match_bits    The match bits to use for message selection at
+ *                          the \e target process.
+ * @param[in] user_ptr      A user-specified value that is associated with
+ *                          each operation issued.
+ * @param[in] operation     The operation to be performed using the
+ *                          initiator and target data.
+ * @param[in] datatype      The type of data being operated on.
+ * @param[out] prep_handle  On successful return, this location will hold
+ *                          the handle of the prepared operation.
+ * @retval PTL_OK               Indicates success.
+ * @retval PTL_NO_INIT          Indicates that the portals API has not been
+ *                              successfully initialized.
+ * @retval PTL_ARG_INVALID      Indicates that an invalid argument was passed.
+ * @retval PTL_NO_SPACE         Indicates that there is insufficient memory.
+ * @see PtlPreparedIssue(), PtlPreparedRelease()
+ */
+int PtlAtomicPrepare(ptl_handle_md_t    md_handle,
+                     ptl_ack_req_t      ack_req,
+                     ptl_process_t      target_id,
+                     ptl_pt_index_t     pt_index,
+                     ptl_match_bits_t   match_bits,
+                     void              *user_ptr,
+                     ptl_op_t           operation,
+                     ptl_datatype_t     datatype,
+                     ptl_handle_prep_t *prep_handle);
+
+/*!
+ * @fn PtlPreparedIssue(ptl_handle_prep_t  prep_handle,
+ *                      ptl_size_t         local_offset,
+ *                      ptl_size_t         length,
+ *                      ptl_size_t         remote_offset,
+ *                      ptl_hdr_data_t     hdr_data)
+ * @brief Issue a prepared operation. Not part of the Portals Specs.
+ * @details Behaves exactly as the PtlPut() or PtlAtomic() call the
+ *      operation was prepared for, with the given offsets, length and
+ *      header data.
+ * @param[in] prep_handle   The prepared operation handle.
+ * @param[in] local_offset  Offset from the start of the memory descriptor.
+ * @param[in] length        Length of the memory region to be sent.
+ * @param[in] remote_offset The offset into the target buffer.
+ * @param[in] hdr_data      64 bits of user data that can be included in the
+ *                          message header.
+ * @retval PTL_OK               Indicates success.
+ * @retval PTL_NO_INIT          Indicates that the portals API has not been
+ *                              successfully initialized.
+ * @retval PTL_ARG_INVALID      Indicates that an invalid argument was passed.
+ */
+int PtlPreparedIssue(ptl_handle_prep_t prep_handle,
+                     ptl_size_t        local_offset,
+                     ptl_size_t        length,
+                     ptl_size_t        remote_offset,
+                     ptl_hdr_data_t    hdr_data);
+
+/*!
+ * @fn PtlPreparedRelease(ptl_handle_prep_t prep_handle)
+ * @brief Release a prepared operation. Not part of the Portals Specs.
+ * @details Operations already issued are not affected.
+ * @param[in] prep_handle   The prepared operation handle.
+ * @retval PTL_OK               Indicates success.
+ * @retval PTL_NO_INIT          Indicates that the portals API has not been
+ *                              successfully initialized.
+ * @retval PTL_ARG_INVALID      Indicates that \a prep_handle is not a valid
+ *                              prepared operation handle.
+ */
+int PtlPreparedRelease(ptl_handle_prep_t prep_handle);
 /*! @} */
 
 /***************************
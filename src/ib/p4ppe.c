@@ -58,10 +58,11 @@ static int clients_compare(struct client *client1, struct client *client2)
 
 RB_GENERATE_STATIC(clients_root, client, entry, clients_compare);
 
+#if USE_XPMEM
 /* Given a memory segment, create a mapping for XPMEM, and return the
  * segid and the offset of the buffer. Return PTL_OK on success. */
-static int create_mapping_ppe(const void *addr_in, size_t length,
-                              struct xpmem_map *mapping)
+static int create_mapping_ppe(struct client *client, const void *addr_in,
+                              size_t length, struct xpmem_map *mapping)
 {
     void *addr;
 
@@ -86,34 +87,92 @@ static void delete_mapping_ppe(struct xpmem_map *mapping)
 {
     xpmem_remove(mapping->segid);
 }
+#else
+/* The segment was allocated with ppe_shm_alloc(). Send its memfd to
+ * the client, which maps it when the command completes. Return PTL_OK
+ * on success. */
+static int create_mapping_ppe(struct client *client, const void *addr_in,
+                              size_t length, struct xpmem_map *mapping)
+{
+    int ret;
+
+    assert(addr_in == mapping->source_addr && mapping->fd != -1);
+
+    ret = ppe_send_fd(client->s, mapping->fd);
+
+    /* The client has its own reference now. */
+    close(mapping->fd);
+    mapping->fd = -1;
+
+    return ret == PTL_OK ? PTL_OK : PTL_ARG_INVALID;
+}
 
-/* Create a unique ppebuf pool, to be used/shared by all clients. */
+/* The memory goes away with the object. */
+static void delete_mapping_ppe(struct xpmem_map *mapping)
+{
+}
+#endif
+
+/* Return a command ring in the comm pad. */
+static inline struct ppe_ring *get_ring(int index)
+{
+    return (void *)ppe.comm_pad + ppe.comm_pad->rings_offset +
+        index * sizeof(struct ppe_ring);
+}
+
+/* Create a unique ppebuf pool, to be used/shared by all clients, and
+ * the command rings. */
 static int setup_ppebufs(void)
 {
     size_t size;
     int ret;
     pool_t *pool;
     size_t slab_size;
+    size_t rings_offset;
 
     slab_size = ppe.ppebuf.num * sizeof(ppebuf_t);
 
+    rings_offset = sizeof(struct ppe_comm_pad) + slab_size;
+    rings_offset = ROUND_UP(rings_offset, 64);
+
     /* Round up to page size. */
-    size = sizeof(struct ppe_comm_pad) + slab_size;
+    size = rings_offset + ppe.num_rings * sizeof(struct ppe_ring);
     size = ROUND_UP(size, pagesize);
 
+#if USE_XPMEM
     if (posix_memalign((void **)&ppe.comm_pad, pagesize, size)) {
         WARN();
         return 1;
     }
+#else
+    /* The memfd is sent to each client that connects. */
+    ppe.comm_pad = ppe_shm_alloc(size, &ppe.comm_pad_mapping);
+    if (!ppe.comm_pad) {
+        WARN();
+        return 1;
+    }
+#endif
 
     ppe.ppebuf.slab = ppe.comm_pad->ppebuf_slab;
 
+    ppe.comm_pad->num_rings = ppe.num_rings;
+    ppe.comm_pad->rings_offset = rings_offset;
+    memset(get_ring(0), 0, ppe.num_rings * sizeof(struct ppe_ring));
+
+    ppe.ring_client = calloc(ppe.num_rings, sizeof(struct client *));
+    if (ppe.num_rings && !ppe.ring_client) {
+        WARN();
+        return 1;
+    }
+
+#if USE_XPMEM
     /* Make the whole thing shareable through XPMEM. */
-    ret = create_mapping_ppe(ppe.comm_pad, size, &ppe.comm_pad_mapping);
+    ret = create_mapping_ppe(NULL, ppe.comm_pad, size, &ppe.comm_pad_mapping);
     if (ret == -1) {
         WARN();
         return 1;
     }
+#endif
 
     /* Now we can create the buffer pool */
     pool = &ppe.comm_pad->ppebuf_pool;
@@ -143,10 +202,69 @@ static struct client *find_client(pid_t pid)
     return res;
 }
 
+/* Give a free command ring, processed by the client's progress thread,
+ * to a new client. Return its index, or -1 if none is left. */
+static int alloc_ring(struct client *client)
+{
+    struct ppe_ring *ring;
+    int i;
+
+    for (i = client->gbl.prog_thread; i < ppe.num_rings;
+         i += ppe.num_prog_threads) {
+        if (ppe.ring_client[i] == NULL) {
+            ring = get_ring(i);
+            ring->head = 0;
+            ring->tail = 0;
+
+            __sync_synchronize();
+            ppe.ring_client[i] = client;
+
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void release_ring(struct client *client)
+{
+    if (client->ring != -1 && ppe.ring_client[client->ring] == client) {
+        ppe.ring_client[client->ring] = NULL;
+        __sync_synchronize();
+    }
+
+    client->ring = -1;
+}
+
+/* Wait for every progress thread to go through its loop once. */
+static void wait_prog_threads(void)
+{
+    unsigned int passes[MAX_PROGRESS_THREADS];
+    struct prog_thread *pt;
+    int i;
+
+    for (i = 0; i < ppe.num_prog_threads; i++)
+        passes[i] = *(volatile unsigned int *)&ppe.prog_thread[i].passes;
+
+    for (i = 0; i < ppe.num_prog_threads; i++) {
+        pt = &ppe.prog_thread[i];
+
+        while (*(volatile int *)&pt->running &&
+               *(volatile unsigned int *)&pt->passes == passes[i])
+            SPINLOCK_BODY();
+    }
+}
+
 static void destroy_client(struct client *client)
 {
     RB_REMOVE(clients_root, &ppe.clients_tree, client);
 
+    release_ring(client);
+
+    /* A progress thread may still be processing its ring, or about
+     * to. */
+    wait_prog_threads();
+
 #ifndef HAVE_KITTEN
     ev_io_stop(evl.loop, &client->watcher);
 
@@ -156,8 +274,10 @@ static void destroy_client(struct client *client)
     /* If the client has crashed, then we should free all its
      * ressources. TODO */
 
+#if USE_XPMEM
     if (client->gbl.apid != -1)
         xpmem_release(client->gbl.apid);
+#endif
 
     free(client);
 }
@@ -176,6 +296,8 @@ static int process_client_msg(struct client *client,
     }
 
     client->pid = msg->req.pid;
+    client->ring = -1;
+#if USE_XPMEM
     client->gbl.apid =
         xpmem_get(msg->req.segid, XPMEM_RDWR, XPMEM_PERMIT_MODE, NULL);
 
@@ -183,7 +305,13 @@ static int process_client_msg(struct client *client,
         /* That is possible, but should not happen. */
         msg->rep.ret = PTL_FAIL;
         return -1;
-    } else if (index_init(&client->gbl) != PTL_OK) {
+    }
+#else
+    /* Its memory is accessed with process_vm_readv/writev. */
+    client->gbl.pid = client->pid;
+#endif
+
+    if (index_init(&client->gbl) != PTL_OK) {
         msg->rep.ret = PTL_FAIL;
         return -1;
     } else {
@@ -196,10 +324,13 @@ static int process_client_msg(struct client *client,
 
         RB_INSERT(clients_root, &ppe.clients_tree, client);
 
+        client->ring = alloc_ring(client);
+
         msg->rep.cookie = client;
         msg->rep.ppebufs_mapping = ppe.comm_pad_mapping;
         msg->rep.ppebufs_ppeaddr = ppe.comm_pad->ppebuf_slab;
         msg->rep.queue_index = client->gbl.prog_thread;
+        msg->rep.ring_index = client->ring;
         msg->rep.ret = PTL_OK;
     }
 
@@ -221,12 +352,37 @@ static void socket_process_client_msg(EV_P_ ev_io *w, int revents)
         return;
     }
 
+#if !USE_XPMEM
+    {
+        struct ucred cred;
+        socklen_t cred_len = sizeof(cred);
+
+        /* Don't trust the client with the PID its memory is accessed
+         * through. */
+        if (getsockopt(client->s, SOL_SOCKET, SO_PEERCRED, &cred,
+                       &cred_len) == -1) {
+            WARN();
+            destroy_client(client);
+            return;
+        }
+        msg.req.pid = cred.pid;
+    }
+#endif
+
     process_client_msg(client, &msg);
 
     if (send(client->s, &msg, sizeof(msg), 0) != sizeof(msg)) {
         /* The client just died. Whatever. */
         destroy_client(client);
+        return;
     }
+
+#if !USE_XPMEM
+    /* Followed by the comm pad. */
+    if (msg.rep.ret == PTL_OK &&
+        ppe_send_fd(client->s, ppe.comm_pad_mapping.fd) != PTL_OK)
+        destroy_client(client);
+#endif
 }
 
 /* Process an incomig connection request. */
@@ -241,6 +397,7 @@ static void socket_process_client_connection(EV_P_ ev_io *w, int revents)
         struct client *client = calloc(1, sizeof(struct client));
         if (client) {
             client->s = s;
+            client->ring = -1;
 
             /* Add a watcher on this client. */
             ev_io_init(&client->watcher, socket_process_client_msg, s,
@@ -297,13 +454,15 @@ int ppe_add_kitten_client(pid_t pid, uid_t uid, void *addr, void *ppe_addr,
                  "PPE_BASE_ADDR=0x%lx, " "PPE_COOKIE=0x%lx, "
                  "PPE_XPMEM_SOURCE_ADDR=0x%lx, " "PPE_XPMEM_OFFSET=0x%lx, "
                  "PPE_XPMEM_SIZE=0x%lx, " "PPE_XPMEM_SEGID=0x%lx, "
-                 "PPE_BUFS_ADDR=0x%lx, " "PPE_QUEUE_INDEX=%d, ",
+                 "PPE_BUFS_ADDR=0x%lx, " "PPE_QUEUE_INDEX=%d, "
+                 "PPE_RING_INDEX=%d, ",
                  (unsigned long)ppe_addr, (unsigned long)msg.rep.cookie,
                  (unsigned long)msg.rep.ppebufs_mapping.source_addr,
                  (unsigned long)msg.rep.ppebufs_mapping.offset,
                  (unsigned long)msg.rep.ppebufs_mapping.size,
                  (unsigned long)msg.rep.ppebufs_mapping.segid,
-                 (unsigned long)msg.rep.ppebufs_ppeaddr, msg.rep.queue_index);
+                 (unsigned long)msg.rep.ppebufs_ppeaddr, msg.rep.queue_index,
+                 msg.rep.ring_index);
 
     if ((status < 0) || (status >= str_size)) {
         WARN();
@@ -471,7 +630,13 @@ static void append_init_data_ppe_direct(data_t *data, mr_t *mr, void *addr,
     data->data_fmt = DATA_FMT_MEM_DMA;
 
     data->mem.num_mem_iovecs = 1;
+#if USE_XPMEM
     data->mem.mem_iovec[0].addr = addr_to_ppe(addr, mr);
+#else
+    /* Not mapped. The PPE copies from the client. */
+    data->mem.mem_iovec[0].pid = mr->obj.obj_ni->mem.pid;
+    data->mem.mem_iovec[0].addr = addr;
+#endif
     data->mem.mem_iovec[0].length = length;
 
     buf->length += sizeof(*data) + sizeof(struct mem_iovec);
@@ -481,14 +646,15 @@ static void append_init_data_ppe_direct(data_t *data, mr_t *mr, void *addr,
  * for both direct and indirect iovecs cases. That avoids a copy into
  * the message buffer. */
 static void append_init_data_ppe_iovec(data_t *data, md_t *md, int iov_start,
-                                       int num_iov, ptl_size_t length,
-                                       buf_t *buf)
+                                       int num_iov, ptl_size_t iov_offset,
+                                       ptl_size_t length, buf_t *buf)
 {
     data->data_fmt = DATA_FMT_MEM_INDIRECT;
     data->mem.num_mem_iovecs = num_iov;
+    data->mem.iovec_offset = iov_offset;
 
-    data->mem.mem_iovec[0].addr =
-        addr_to_ppe(&md->mem_iovecs[iov_start], md->ppe.mr_start);
+    /* The mem_iovecs are in the PPE already. */
+    data->mem.mem_iovec[0].addr = &md->mem_iovecs[iov_start];
     data->mem.mem_iovec[0].length = num_iov * sizeof(struct mem_iovec);
 
     buf->length += sizeof(*data) + sizeof(struct mem_iovec);
@@ -511,7 +677,6 @@ static int ppe_init_prepare_transfer(md_t *md, data_dir_t dir,
                                      buf_t *buf)
 {
     int err = PTL_OK;
-    req_hdr_t *hdr = (req_hdr_t *) buf->data;
     data_t *data = (data_t *)(buf->data + buf->length);
     int num_sge;
     ptl_size_t iov_start = 0;
@@ -521,8 +686,8 @@ static int ppe_init_prepare_transfer(md_t *md, data_dir_t dir,
         mr_t *mr;
         if (md->num_iov) {
             err =
-                append_immediate_data(md->start, md->mr_list, md->num_iov,
-                                      dir, offset, length, buf);
+                append_immediate_data(md->start, md->iov_end, md->mr_list,
+                                      md->num_iov, dir, offset, length, buf);
         } else {
             err =
                 mr_lookup_app(obj_to_ni(md), md->start + offset, length, &mr);
@@ -532,7 +697,7 @@ static int ppe_init_prepare_transfer(md_t *md, data_dir_t dir,
             }
 
             err =
-                append_immediate_data(md->start, &mr, md->num_iov, dir,
+                append_immediate_data(md->start, NULL, &mr, md->num_iov, dir,
                                       offset, length, buf);
 
             mr_put(mr);
@@ -543,18 +708,15 @@ static int ppe_init_prepare_transfer(md_t *md, data_dir_t dir,
         /* Find the index and offset of the first IOV as well as the
          * total number of IOVs to transfer. */
         num_sge =
-            iov_count_elem(iovecs, md->num_iov, offset, length, &iov_start,
-                           &iov_offset);
+            iov_count_elem(iovecs, md->iov_end, md->num_iov, offset, length,
+                           &iov_start, &iov_offset);
         if (num_sge < 0) {
             WARN();
             return PTL_FAIL;
         }
 
-        append_init_data_ppe_iovec(data, md, iov_start, num_sge, length, buf);
-
-        /* @todo this is completely bogus */
-        /* Adjust the header offset for iov start. */
-        hdr->roffset = cpu_to_le64(le64_to_cpu(hdr->roffset) - iov_offset);
+        append_init_data_ppe_iovec(data, md, iov_start, num_sge, iov_offset,
+                                   length, buf);
     } else {
         void *addr;
         mr_t *mr;
@@ -592,7 +754,7 @@ static int ppe_tgt_data_out(buf_t *buf, data_t *data)
         case DATA_FMT_MEM_INDIRECT:
             buf->transfer.mem.cur_rem_iovec = data->mem.mem_iovec[0].addr;
             buf->transfer.mem.num_rem_iovecs = data->mem.num_mem_iovecs;
-            buf->transfer.mem.cur_rem_off = 0;
+            buf->transfer.mem.cur_rem_off = data->mem.iovec_offset;
 
             next = STATE_TGT_RDMA;
             break;
@@ -624,6 +786,7 @@ static inline void buf_completed(ppebuf_t *buf)
     __sync_synchronize();
 }
 
+#if USE_XPMEM
 /* Attach to an XPMEM segment from a given client. */
 static int map_segment_ppe(struct client *client, const void *client_addr,
                            size_t len, void **ret)
@@ -667,6 +830,56 @@ static void unmap_segment_ppe(void *ptr_attach)
     }
 }
 
+/* Nothing to do, the segment is the client memory. */
+static inline int sync_segment_ppe(struct client *client, void *client_addr,
+                                   const void *ptr, size_t len)
+{
+    return 0;
+}
+#else
+/* Copy a segment from a given client. */
+static int map_segment_ppe(struct client *client, const void *client_addr,
+                           size_t len, void **ret)
+{
+    if (len == 0 || client_addr == NULL) {
+        /* Nothing to map, like the operand of a PTL_SWAP. It's still a
+         * valid call. */
+        *ret = NULL;
+        return 0;
+    }
+
+    *ret = malloc(len);
+    if (!*ret) {
+        WARN();
+        return 1;
+    }
+
+    if (cma_read(client->gbl.pid, *ret, client_addr, len) != PTL_OK) {
+        free(*ret);
+        *ret = NULL;
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Release the copy. */
+static void unmap_segment_ppe(void *ptr_attach)
+{
+    free(ptr_attach);
+}
+
+/* Write the copy back to the client. */
+static int sync_segment_ppe(struct client *client, void *client_addr,
+                            const void *ptr, size_t len)
+{
+    if (len == 0)
+        return 0;
+
+    return cma_write(client->gbl.pid, client_addr, ptr, len) != PTL_OK;
+}
+#endif
+
 static void do_OP_PtlInit(ppebuf_t *buf)
 {
     struct client *client = buf->cookie;
@@ -874,12 +1087,41 @@ static void do_OP_PtlGetMap(ppebuf_t *buf)
                        buf->msg.PtlGetMap.map_size, mapping,
                        &buf->msg.PtlGetMap.actual_map_size);
 
+        if (buf->msg.ret == PTL_OK &&
+            sync_segment_ppe(client, buf->msg.PtlGetMap.mapping, mapping,
+                             buf->msg.PtlGetMap.map_size *
+                             sizeof(ptl_process_t)))
+            buf->msg.ret = PTL_ARG_INVALID;
+
         unmap_segment_ppe(mapping);
     } else {
         buf->msg.ret = PTL_ARG_INVALID;
     }
 }
 
+static void do_OP_PtlNIConnect(ppebuf_t *buf)
+{
+    struct client *client = buf->cookie;
+    ptl_process_t *targets = NULL;
+    int ret = 0;
+
+    if (buf->msg.PtlNIConnect.targets)
+        ret =
+            map_segment_ppe(client, buf->msg.PtlNIConnect.targets,
+                            buf->msg.PtlNIConnect.num_targets *
+                            sizeof(ptl_process_t), (void **)&targets);
+    if (!ret) {
+        buf->msg.ret =
+            _PtlNIConnect(&client->gbl, buf->msg.PtlNIConnect.ni_handle,
+                          buf->msg.PtlNIConnect.num_targets, targets);
+
+        if (targets)
+            unmap_segment_ppe(targets);
+    } else {
+        buf->msg.ret = PTL_ARG_INVALID;
+    }
+}
+
 static void do_OP_PtlPTAlloc(ppebuf_t *buf)
 {
     struct client *client = buf->cookie;
@@ -1252,7 +1494,7 @@ static void do_OP_PtlEQAlloc(ppebuf_t *buf)
         assert(err == PTL_OK);
 
         err =
-            create_mapping_ppe(eq->eqe_list, eq->eqe_list_size,
+            create_mapping_ppe(client, eq->eqe_list, eq->eqe_list_size,
                                &eq->ppe.eqe_list);
         buf->msg.PtlEQAlloc.eqe_list = eq->ppe.eqe_list;
 
@@ -1304,7 +1546,7 @@ static void do_OP_PtlCTAlloc(ppebuf_t *buf)
         assert(err == PTL_OK);
 
         err =
-            create_mapping_ppe(&ct->info, sizeof(struct ct_info),
+            create_mapping_ppe(client, ct->info, sizeof(struct ct_info),
                                &ct->ppe.ct_mapping);
         buf->msg.PtlCTAlloc.ct_mapping = ct->ppe.ct_mapping;
 
@@ -1380,6 +1622,58 @@ static void do_OP_PtlAtomicSync(ppebuf_t *buf)
     buf->msg.ret = _PtlAtomicSync();
 }
 
+static void do_OP_PtlPutPrepare(ppebuf_t *buf)
+{
+    struct client *client = buf->cookie;
+
+    buf->msg.ret =
+        _PtlPutPrepare(&client->gbl, buf->msg.PtlPutPrepare.md_handle,
+                       buf->msg.PtlPutPrepare.ack_req,
+                       buf->msg.PtlPutPrepare.target_id,
+                       buf->msg.PtlPutPrepare.pt_index,
+                       buf->msg.PtlPutPrepare.match_bits,
+                       buf->msg.PtlPutPrepare.user_ptr,
+                       &buf->msg.PtlPutPrepare.prep_handle);
+}
+
+static void do_OP_PtlAtomicPrepare(ppebuf_t *buf)
+{
+    struct client *client = buf->cookie;
+
+    buf->msg.ret =
+        _PtlAtomicPrepare(&client->gbl, buf->msg.PtlAtomicPrepare.md_handle,
+                          buf->msg.PtlAtomicPrepare.ack_req,
+                          buf->msg.PtlAtomicPrepare.target_id,
+                          buf->msg.PtlAtomicPrepare.pt_index,
+                          buf->msg.PtlAtomicPrepare.match_bits,
+                          buf->msg.PtlAtomicPrepare.user_ptr,
+                          buf->msg.PtlAtomicPrepare.operation,
+                          buf->msg.PtlAtomicPrepare.datatype,
+                          &buf->msg.PtlAtomicPrepare.prep_handle);
+}
+
+static void do_OP_PtlPreparedIssue(ppebuf_t *buf)
+{
+    struct client *client = buf->cookie;
+
+    buf->msg.ret =
+        _PtlPreparedIssue(&client->gbl,
+                          buf->msg.PtlPreparedIssue.prep_handle,
+                          buf->msg.PtlPreparedIssue.local_offset,
+                          buf->msg.PtlPreparedIssue.length,
+                          buf->msg.PtlPreparedIssue.remote_offset,
+                          buf->msg.PtlPreparedIssue.hdr_data);
+}
+
+static void do_OP_PtlPreparedRelease(ppebuf_t *buf)
+{
+    struct client *client = buf->cookie;
+
+    buf->msg.ret =
+        _PtlPreparedRelease(&client->gbl,
+                            buf->msg.PtlPreparedRelease.prep_handle);
+}
+
 static void do_OP_PtlCTCancelTriggered(ppebuf_t *buf)
 {
     struct client *client = buf->cookie;
@@ -1419,7 +1713,8 @@ static struct {
     void (*func) (ppebuf_t *buf);
     const char *name;
 } ppe_ops[] = {
-    ADD_OP(PtlAtomic), ADD_OP(PtlAtomicSync), ADD_OP(PtlCTAlloc),
+    ADD_OP(PtlAtomic), ADD_OP(PtlAtomicPrepare), ADD_OP(PtlAtomicSync),
+        ADD_OP(PtlCTAlloc),
         ADD_OP(PtlCTCancelTriggered), ADD_OP(PtlCTFree), ADD_OP(PtlCTInc),
         ADD_OP(PtlCTSet), ADD_OP(PtlEQAlloc), ADD_OP(PtlEQFree),
         ADD_OP(PtlFetchAtomic), ADD_OP(PtlFini), ADD_OP(PtlGet),
@@ -1427,10 +1722,13 @@ static struct {
         ADD_OP(PtlGetUid), ADD_OP(PtlInit), ADD_OP(PtlLEAppend),
         ADD_OP(PtlLESearch), ADD_OP(PtlLEUnlink), ADD_OP(PtlMDBind),
         ADD_OP(PtlMDRelease), ADD_OP(PtlMEAppend), ADD_OP(PtlMESearch),
-        ADD_OP(PtlMEUnlink), ADD_OP(PtlNIFini), ADD_OP(PtlNIHandle),
+        ADD_OP(PtlMEUnlink), ADD_OP(PtlNIConnect), ADD_OP(PtlNIFini),
+        ADD_OP(PtlNIHandle),
         ADD_OP(PtlNIInit), ADD_OP(PtlNIStatus), ADD_OP(PtlPTAlloc),
         ADD_OP(PtlPTDisable), ADD_OP(PtlPTEnable), ADD_OP(PtlPTFree),
-        ADD_OP(PtlPut), ADD_OP(PtlSetMap), ADD_OP(PtlSwap),
+        ADD_OP(PtlPreparedIssue), ADD_OP(PtlPreparedRelease),
+        ADD_OP(PtlPut), ADD_OP(PtlPutPrepare), ADD_OP(PtlSetMap),
+        ADD_OP(PtlSwap),
         ADD_OP(PtlTriggeredAtomic), ADD_OP(PtlTriggeredCTInc),
         ADD_OP(PtlTriggeredCTSet), ADD_OP(PtlTriggeredFetchAtomic),
         ADD_OP(PtlTriggeredGet), ADD_OP(PtlTriggeredPut),
@@ -1440,14 +1738,175 @@ static struct {
 #endif
 ADD_OP(PtlStartBundle), ADD_OP(PtlEndBundle),};
 
+/* The client did not wait for the return code of an operation. If it
+ * failed, report it on the event queue and the counter of the MD the
+ * operation would have completed on. */
+static void async_failed(ppebuf_t *buf)
+{
+    struct client *client = buf->cookie;
+    ptl_handle_md_t md_handle;
+    ptl_event_kind_t type;
+    unsigned int ct_mask;
+    void *user_ptr;
+    md_t *md;
+
+    switch (buf->op) {
+        case OP_PtlPut:
+            md_handle = buf->msg.PtlPut.md_handle;
+            user_ptr = buf->msg.PtlPut.user_ptr;
+            type = PTL_EVENT_SEND;
+            ct_mask = PTL_MD_EVENT_CT_SEND | PTL_MD_EVENT_CT_ACK;
+            break;
+        case OP_PtlAtomic:
+            md_handle = buf->msg.PtlAtomic.md_handle;
+            user_ptr = buf->msg.PtlAtomic.user_ptr;
+            type = PTL_EVENT_SEND;
+            ct_mask = PTL_MD_EVENT_CT_SEND | PTL_MD_EVENT_CT_ACK;
+            break;
+        case OP_PtlGet:
+            md_handle = buf->msg.PtlGet.md_handle;
+            user_ptr = buf->msg.PtlGet.user_ptr;
+            type = PTL_EVENT_REPLY;
+            ct_mask = PTL_MD_EVENT_CT_REPLY;
+            break;
+        case OP_PtlFetchAtomic:
+            md_handle = buf->msg.PtlFetchAtomic.get_md_handle;
+            user_ptr = buf->msg.PtlFetchAtomic.user_ptr;
+            type = PTL_EVENT_REPLY;
+            ct_mask = PTL_MD_EVENT_CT_REPLY;
+            break;
+        default:
+            WARN();
+            return;
+    }
+
+    md = to_md(&client->gbl, md_handle);
+    if (!md) {
+        ptl_warn("%s failed with %d, on an invalid MD\n",
+                 ppe_ops[buf->op].name, buf->msg.ret);
+        return;
+    }
+
+    if (md->eq)
+        make_init_fail_event(md->eq, type, user_ptr, PTL_NI_UNDELIVERABLE);
+
+    if (md->ct && (md->options & ct_mask))
+        make_ct_merged_event(md->ct, 0, 1);
+
+    md_put(md);
+}
+
+/* Only one progress thread processes the commands of a client at a
+ * time. */
+static inline int client_trylock(struct client *client)
+{
+    return atomic_read(&client->busy) == 0 &&
+        atomic_swap(&client->busy, 1) == 0;
+}
+
+static inline void client_unlock(struct client *client)
+{
+    __sync_synchronize();
+    atomic_set(&client->busy, 0);
+}
+
+/* Process the commands queued on a client's ring, and give all their
+ * slots back at once. Return the number of commands processed. The
+ * client must be locked. The index of the ring is given, since the
+ * client may be losing it. */
+static int drain_ring(struct client *client, int index)
+{
+    struct ppe_ring *ring = get_ring(index);
+    unsigned int tail = ring->tail;
+    unsigned int head = ring->head;
+    unsigned int count = head - tail;
+    ppebuf_t *cmd;
+
+    if (count == 0)
+        return 0;
+
+    /* Don't read the slots before head. */
+    __sync_synchronize();
+
+    for (; tail != head; tail++) {
+        cmd = &ring->slot[tail & (PPE_RING_SIZE - 1)];
+
+        /* The ring tells who the client is. */
+        cmd->cookie = client;
+
+        ppe_ops[cmd->op].func(cmd);
+
+        if (cmd->msg.ret != PTL_OK)
+            async_failed(cmd);
+    }
+
+    __sync_synchronize();
+    ring->tail = tail;
+
+    return count;
+}
+
+/* An idle progress thread processes the commands waiting on the rings
+ * of the other threads. Return the number of commands processed. */
+static int steal_work(int first_ring)
+{
+    struct client *client;
+    struct ppe_ring *ring;
+    int count = 0;
+    int i;
+
+    for (i = 0; i < ppe.num_rings; i++) {
+        if (i % ppe.num_prog_threads == first_ring)
+            continue;
+
+        client = ppe.ring_client[i];
+        if (!client)
+            continue;
+
+        ring = get_ring(i);
+        if (ring->head != ring->tail && client_trylock(client)) {
+            count += drain_ring(client, i);
+            client_unlock(client);
+        }
+    }
+
+    return count;
+}
+
+/* Run a progress thread on a CPU of its own, if there are enough. */
+static void pin_thread(int index)
+{
+#ifdef CPU_SET
+    cpu_set_t set;
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (num_cpus <= 0)
+        return;
+
+    CPU_ZERO(&set);
+    CPU_SET(index % num_cpus, &set);
+
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        ptl_warn("Failed to pin progress thread %d.\n", index);
+#endif
+}
+
 /* Progress thread for the PPE. */
 static void *ppe_progress(void *arg)
 {
     struct prog_thread *pt = arg;
+    int first_ring = pt - ppe.prog_thread;
+
+    if (ppe.pin_threads)
+        pin_thread(first_ring);
+
+    pt->running = 1;
 
     while (!pt->stop) {
         ppebuf_t *ppebuf;
         buf_t *mem_buf;
+        int busy = 0;
+        int i;
 
 #if WITH_TRANSPORT_IB
         /* Infiniband. Walking the list of active NIs to find work. */
@@ -1465,14 +1924,48 @@ static void *ppe_progress(void *arg)
         }
 #endif
 
+        /* Get commands from the rings of our clients. */
+        for (i = first_ring; i < ppe.num_rings; i += ppe.num_prog_threads) {
+            struct client *client = ppe.ring_client[i];
+
+            if (client && client_trylock(client)) {
+                busy += drain_ring(client, i);
+                client_unlock(client);
+            }
+        }
+
         /* Get message from the message queue. */
         ppebuf = (ppebuf_t *)dequeue(NULL, pt->queue);
 
         if (ppebuf) {
+            struct client *client = ppebuf->cookie;
+            int ring;
+
+            /* Wait for a thread helping with the ring. */
+            while (!client_trylock(client))
+                SPINLOCK_BODY();
+
+            /* What the client put on its ring before comes first. */
+            ring = client->ring;
+            if (ring != -1)
+                drain_ring(client, ring);
+
             ppe_ops[ppebuf->op].func(ppebuf);
 
-            /* Return response to blocked client. */
-            buf_completed(ppebuf);
+            if (ppebuf->async) {
+                /* Nobody is waiting for that buffer. */
+                if (ppebuf->msg.ret != PTL_OK)
+                    async_failed(ppebuf);
+
+                ll_enqueue_obj(&ppe.comm_pad->ppebuf_pool.free_list, ppebuf);
+            } else {
+                /* Return response to blocked client. */
+                buf_completed(ppebuf);
+            }
+
+            client_unlock(client);
+
+            busy = 1;
         }
 
         /* Get message from our own queue. */
@@ -1514,12 +2007,22 @@ static void *ppe_progress(void *arg)
 
             /* From send_message_mem(). */
             buf_put(mem_buf);
+
+            busy = 1;
         }
 
-        /* TODO: don't spin if we got messages. */
-        SPINLOCK_BODY();
+        if (!busy && ppe.num_prog_threads > 1)
+            busy = steal_work(first_ring);
+
+        __sync_synchronize();
+        pt->passes++;
+
+        if (!busy)
+            SPINLOCK_BODY();
     }
 
+    pt->running = 0;
+
     return NULL;
 }
 
@@ -1592,7 +2095,11 @@ static int NIInit_ppe(gbl_t *gbl, ni_t *ni)
         ni->id.phys.pid = ni->iface->id.phys.pid;
 
     ni->mem.internal_queue = &pt->internal_queue;
+#if USE_XPMEM
     ni->mem.apid = gbl->apid;
+#else
+    ni->mem.pid = gbl->pid;
+#endif
 
 #if WITH_TRANSPORT_IB
     list_add_tail(&ni->rdma.ppe_ni_list, &pt->ni_list);
@@ -1661,6 +2168,13 @@ int ppe_run(int num_bufs, int num_threads, size_t stack_size)
     if (err)
         return 1;
 
+    ppe.num_rings = get_param(PTL_PPE_RINGS);
+    ppe.pin_threads = get_param(PTL_PPE_PIN_THREADS);
+
+    err = copy_engine_init();
+    if (err)
+        return 1;
+
     /* Init the index service */
     err = index_init(&ppe.gbl);
     if (err)
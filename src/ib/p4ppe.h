@@ -22,6 +22,13 @@ struct client {
     /* Keep the PID of the client. It's the key to the list. */
     pid_t pid;
 
+    /* Index of the client's command ring, or -1. */
+    int ring;
+
+    /* Set by the progress thread processing the client's commands. It
+     * is the client's own, or an idle one helping it. */
+    atomic_t busy;
+
 #ifdef HAVE_KITTEN
     /* On Kitten, the uid is trusted, set by the PCT */
     uid_t uid;
@@ -48,6 +55,11 @@ struct prog_thread {
     /* When to stop the progress thread. */
     int stop;
 
+    /* Whether it runs, and its number of passes through its loop. A
+     * client off the rings is unused once each thread did a pass. */
+    int running;
+    unsigned int passes;
+
     /* Linked list of active NIs. */
     struct list_head ni_list;
 
@@ -79,6 +91,15 @@ struct ppe {
         int num;                /* total number of ppebufs */
     } ppebuf;
 
+    /* Whether each progress thread runs on its own CPU. */
+    int pin_threads;
+
+    /* Owner of each command ring, or NULL if the ring is free. Ring i
+     * belongs to progress thread i % num_prog_threads, but an idle
+     * thread may process it too. */
+    int num_rings;
+    struct client **ring_client;
+
     /* Tree for physical NIs, indexed on PID. */
            RB_HEAD(phys_ni_root, ni) physni_tree;
 
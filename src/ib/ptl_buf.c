@@ -21,7 +21,7 @@ int buf_setup(void *arg)
 
     buf->num_mr = 0;
     buf->event_mask = 0;
-    buf->data = buf->internal_data;
+    buf->data = buf_data_area(buf);
     buf->rdma_desc_ok = 0;
     buf->ni_fail = PTL_NI_OK;
     buf->conn = NULL;
@@ -97,10 +97,10 @@ int buf_init(void *arg, void *parm)
     INIT_LIST_HEAD(&buf->list);
 
     buf->length = 0;
+    buf->data_size = BUF_DATA_SIZE;
     buf->type = BUF_FREE;
 
-    pthread_mutex_init(&buf->mutex, NULL);
-    pthread_cond_init(&buf->cond, NULL);
+    PTL_YIELDLOCK_INIT(&buf->lock);
 
 #if WITH_TRANSPORT_IB
     if (parm) {
@@ -133,8 +133,7 @@ void buf_fini(void *arg)
 #if WITH_TRANSPORT_IB
     PTL_FASTLOCK_DESTROY(&buf->rdma.rdma_list_lock);
 #endif
-    pthread_mutex_destroy(&buf->mutex);
-    pthread_cond_destroy(&buf->cond);
+    PTL_YIELDLOCK_DESTROY(&buf->lock);
 }
 
 /**
@@ -147,7 +146,7 @@ void buf_dump(buf_t *buf)
     struct req_hdr *hdr = (struct req_hdr *)buf->data;
 
     printf("buf: %p\n", buf);
-    printf("buf->size	= %d\n", BUF_DATA_SIZE);
+    printf("buf->size	= %u\n", buf->data_size);
     printf("buf->length	= %d\n", buf->length);
     printf("hdr->h1.version	= %d\n", hdr->h1.version);
     printf("hdr->h1.operation	= %d\n", hdr->h1.operation);
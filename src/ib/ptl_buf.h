@@ -122,16 +122,37 @@ struct xremote {
  * registered.
  */
 struct buf {
+    /* The first two cache lines hold what process_init() and
+     * process_tgt() touch for every message. Keep them together. */
+
         /** base object */
     obj_t obj;
 
-    pthread_mutex_t mutex;
+        /** serializes the state machines working on the buf */
+    PTL_YIELDLOCK_TYPE lock;
 
-        /** enables holding buf on lists */
-    struct list_head list;
+        /** type of buf */
+    buf_type_t type;
 
     unsigned int event_mask;
 
+        /** recv state */
+    int recv_state;
+
+        /** message length */
+    unsigned int length;
+
+        /** room for the message, set once when the buf is created */
+    unsigned int data_size;
+
+        /** message (usually internal_data) */
+    void *data;
+
+    conn_t *conn;
+
+    struct data *data_in;
+    struct data *data_out;
+
     ptl_size_t rlength;
     ptl_size_t roffset;
     ptl_size_t mlength;
@@ -139,10 +160,8 @@ struct buf {
     ptl_ni_fail_t ni_fail;      /* todo: may remove */
     ptl_list_t matching_list;   /* for ptl_list event field */
 
-    conn_t *conn;
-
-    struct data *data_in;
-    struct data *data_out;
+        /** number of mr's used in message */
+    int num_mr;
 
     /* Fields only valid during the lifetime of a buffer. */
     union {
@@ -221,28 +240,35 @@ struct buf {
         };
     };
 
-        /** recv state */
-    int recv_state;
+        /** enables holding buf on lists */
+    struct list_head list;
 
         /** remote destination for message */
     struct xremote dest;
 
-        /** message length */
-    unsigned int length;
-
-        /** message (usually internal_data) */
-    void *data;
+#if WITH_TRANSPORT_SHMEM || IS_PPE
+    /* When receiving a shared memory buffer (sbuf), a regular buffer (buf) is
+     * allocated to process the data through the receive state machine
+     * without destroying the sbuf that belongs to
+     * another process. Keep a pointer to that sbuf. */
+    struct buf *mem_buf;
+#endif
 
-        /** data to hold message */
-    uint8_t internal_data[BUF_DATA_SIZE];
+#if WITH_TRANSPORT_UDP
+    struct buf *udp_buf;
+#endif
 
-        /** type of buf */
-    buf_type_t type;
+#if IS_PPE
+    /* TODO: should move inside transfer union. */
+    /* When a memory transfer happens inside the PPE, keep the
+     * destination NI, so we can find which progress threads will
+     * process the buffer. */
+    ni_t *dest_ni;
+#endif
 
-    /* Target only. Must survive through buffer reuse. */
-    struct list_head unexpected_list;
-    int unexpected_busy;
-    pthread_cond_t cond;
+    /* Less used state follows. It stays in the buf_t rather than in
+     * separate allocations because UDP sends the whole buf_t and
+     * shared memory bufs are read by other processes. */
 
     /* Fields that survive between buffer reuse. */
     union {
@@ -289,6 +315,12 @@ struct buf {
 #endif
     };
 
+    /* Target only. Must survive through buffer reuse. Only used by
+     * messages on the overflow list; waiters sleep on the NI's
+     * unexpected_cond. */
+    struct list_head unexpected_list;
+    int unexpected_busy;
+
     /* Used during transfer. These fields are only valid while the
      * buffer is allocated. */
     struct {
@@ -332,6 +364,7 @@ struct buf {
 
             /* Local MD/ME/LE */
             ptl_iovec_t *iovecs;
+            const ptl_size_t *iov_end;  /* of the ME/LE iovecs, or NULL */
             ptl_size_t num_iovecs;
             ptl_size_t length_left;
             ptl_size_t offset;
@@ -364,6 +397,7 @@ struct buf {
 
             /* Local MD/ME/LE */
             ptl_iovec_t *iovecs;
+            const ptl_size_t *iov_end;  /* of the ME/LE iovecs, or NULL */
             ptl_size_t num_iovecs;
             ptl_size_t length_left;
             ptl_size_t offset;
@@ -406,32 +440,17 @@ struct buf {
             unsigned int iovec_split;
             //sequence number for this buf
             unsigned int seq_num;
+
+            /* Target of a rendezvous put, which pulls the data, and
+             * when the last chunk was asked for. */
+            unsigned int rndv;
+            uint64_t rndv_time;
         } udp;
 #endif
     } transfer;
 
-#if WITH_TRANSPORT_SHMEM || IS_PPE
-    /* When receiving a shared memory buffer (sbuf), a regular buffer (buf) is
-     * allocated to process the data through the receive state machine
-     * without destroying the sbuf that belongs to
-     * another process. Keep a pointer to that sbuf. */
-    struct buf *mem_buf;
-#endif
-
-#if WITH_TRANSPORT_UDP
-    struct buf *udp_buf;
-#endif
-
-#if IS_PPE
-    /* TODO: should move inside transfer union. */
-    /* When a memory transfer happens inside the PPE, keep the
-     * destination NI, so we can find which progress threads will
-     * process the buffer. */
-    ni_t *dest_ni;
-#endif
-
-        /** number of mr's used in message */
-    int num_mr;
+        /** data to hold message */
+    uint8_t internal_data[BUF_DATA_SIZE];
 
         /** mr's used in message */
     mr_t *mr_list[0];
@@ -465,6 +484,24 @@ static inline size_t real_buf_t_size(void)
     return sizeof(buf_t) + max_sge * sizeof(mr_t *);
 }
 
+/**
+ * Return where a buf holds its message.
+ *
+ * Bufs from the eager pools are larger than a buf_t, and keep the
+ * message after the mr_list instead of in internal_data.
+ *
+ * @param buf the buf
+ *
+ * @return address of the message
+ */
+static inline void *buf_data_area(buf_t *buf)
+{
+    if (buf->data_size > BUF_DATA_SIZE)
+        return (uint8_t *)buf + real_buf_t_size();
+
+    return buf->internal_data;
+}
+
 /**
  * Allocate a buf from the normal buf pool.
  *
@@ -586,6 +623,11 @@ static inline void set_buf_dest(buf_t *buf, conn_t *connect)
             //buf->dest.udp.dest_addr = &connect->sin;
             break;
 #endif
+
+#if !IS_PPE
+        case CONN_TYPE_SELF:
+            break;
+#endif
     }
 }
 
@@ -0,0 +1,190 @@
+/**
+ * @file ptl_cma.c
+ *
+ * Access to the memory of the PPE clients without XPMEM.
+ *
+ * The client memory is read and written with cross memory attach
+ * (process_vm_readv/writev), which only needs the client to let the
+ * PPE trace it. A copy between two clients, or an atomic operation,
+ * goes through a bounce buffer.
+ */
+
+#include "ptl_loc.h"
+
+#if IS_PPE && !USE_XPMEM
+
+#include <sys/uio.h>
+
+/* Size of the bounce buffer of each progress thread. */
+#define CMA_BOUNCE_SIZE		(64 * 1024)
+
+static __thread void *bounce;
+
+static void *get_bounce(void)
+{
+    if (unlikely(!bounce))
+        bounce = malloc(CMA_BOUNCE_SIZE);
+
+    return bounce;
+}
+
+/**
+ * @brief Copy between the PPE and a client.
+ *
+ * @param[in] pid the client
+ * @param[in] local the address in the PPE
+ * @param[in] remote the address in the client
+ * @param[in] length the number of bytes to copy
+ * @param[in] write whether to copy to the client
+ *
+ * @return status
+ */
+static int cma_rw(pid_t pid, void *local, void *remote, ptl_size_t length,
+                  int write)
+{
+    struct iovec liov;
+    struct iovec riov;
+    ssize_t ret;
+
+    while (length) {
+        liov.iov_base = local;
+        liov.iov_len = length;
+        riov.iov_base = remote;
+        riov.iov_len = length;
+
+        if (write)
+            ret = process_vm_writev(pid, &liov, 1, &riov, 1, 0);
+        else
+            ret = process_vm_readv(pid, &liov, 1, &riov, 1, 0);
+
+        /* A transfer can be partial. */
+        if (ret <= 0) {
+            WARN();
+            return PTL_FAIL;
+        }
+
+        local += ret;
+        remote += ret;
+        length -= ret;
+    }
+
+    return PTL_OK;
+}
+
+int cma_read(pid_t pid, void *dst, const void *addr, ptl_size_t length)
+{
+    return cma_rw(pid, dst, (void *)addr, length, 0);
+}
+
+int cma_write(pid_t pid, void *addr, const void *src, ptl_size_t length)
+{
+    return cma_rw(pid, (void *)src, addr, length, 1);
+}
+
+/**
+ * @brief Copy between two clients.
+ *
+ * @param[in] dst_pid the destination client
+ * @param[in] dst the destination address
+ * @param[in] src_pid the source client
+ * @param[in] src the source address
+ * @param[in] length the number of bytes to copy
+ *
+ * @return status
+ */
+int cma_copy(pid_t dst_pid, void *dst, pid_t src_pid, const void *src,
+             ptl_size_t length)
+{
+    void *buf = get_bounce();
+    ptl_size_t bytes;
+    int err;
+
+    if (!buf) {
+        WARN();
+        return PTL_NO_SPACE;
+    }
+
+    while (length) {
+        bytes = length;
+        if (bytes > CMA_BOUNCE_SIZE)
+            bytes = CMA_BOUNCE_SIZE;
+
+        err = cma_read(src_pid, buf, src, bytes);
+        if (err)
+            return err;
+
+        err = cma_write(dst_pid, dst, buf, bytes);
+        if (err)
+            return err;
+
+        dst += bytes;
+        src += bytes;
+        length -= bytes;
+    }
+
+    return PTL_OK;
+}
+
+static inline pid_t mr_pid(mr_t *mr)
+{
+    return mr->obj.obj_ni->mem.pid;
+}
+
+int copy_from_app(void *dst, void *addr, mr_t *mr, ptl_size_t length)
+{
+    assert(addr >= mr->addr && addr + length <= mr->addr + mr->length);
+
+    return cma_read(mr_pid(mr), dst, addr, length);
+}
+
+int copy_to_app(void *addr, mr_t *mr, const void *src, ptl_size_t length)
+{
+    assert(addr >= mr->addr && addr + length <= mr->addr + mr->length);
+
+    return cma_write(mr_pid(mr), addr, src, length);
+}
+
+/**
+ * @brief Apply an atomic operation to client memory.
+ *
+ * The operands are read in the bounce buffer, and written back. The
+ * buffer size is a multiple of any atomic type size.
+ *
+ * @return status
+ */
+int atomic_to_app(atom_op_t op, void *addr, mr_t *mr, void *src,
+                  ptl_size_t length)
+{
+    void *buf = get_bounce();
+    ptl_size_t bytes;
+    int err;
+
+    if (!buf) {
+        WARN();
+        return PTL_NO_SPACE;
+    }
+
+    while (length) {
+        bytes = length;
+        if (bytes > CMA_BOUNCE_SIZE)
+            bytes = CMA_BOUNCE_SIZE;
+
+        err = copy_from_app(buf, addr, mr, bytes);
+        if (err)
+            return err;
+
+        op(buf, src, bytes);
+
+        err = copy_to_app(addr, mr, buf, bytes);
+        if (err)
+            return err;
+
+        addr += bytes;
+        src += bytes;
+        length -= bytes;
+    }
+
+    return PTL_OK;
+}
+
+#endif
@@ -16,6 +16,11 @@
 
 #define max(a,b)	(((a) > (b)) ? (a) : (b))
 
+/* How long connect_peers() waits before restarting a handshake that
+ * went nowhere, and how many times. */
+#define CONNECT_RETRY_NSEC	(100 * 1000 * 1000)
+#define CONNECT_RETRIES		(50)
+
 /**
  * Initialize a new conn_t struct.
  *
@@ -32,6 +37,11 @@ int conn_init(void *arg, void *parm)
 
     conn->state = CONN_STATE_DISCONNECTED;
 
+#if !IS_PPE
+    INIT_LIST_HEAD(&conn->ack_merge.list);
+    conn->ack_merge.count = 0;
+#endif
+
 #if WITH_TRANSPORT_IB
     /* If IB is available, set it as the default transport. It may be
      * overriden later in PtlSetMap to use a local transport such as
@@ -102,34 +112,80 @@ void conn_fini(void *arg)
 #endif
 }
 
-static int compare_conn_id(const void *a, const void *b)
+/**
+ * Return the bucket of an NI connection table for an ID.
+ *
+ * @param[in] ni the NI
+ * @param[in] id the process ID
+ *
+ * @return the bucket index
+ */
+static inline unsigned int conn_hash_bucket(const ni_t *ni,
+                                            ptl_process_t id)
 {
-    const conn_t *c1 = a;
-    const conn_t *c2 = b;
+    uint32_t h = id.phys.nid * 0x9e3779b1U;
+
+    h ^= id.phys.pid + 0x7f4a7c15U + (h << 6) + (h >> 2);
 
-    return compare_id(&c1->id, &c2->id);
+    return h & ni->conns.hash_mask;
 }
 
 /**
- * Get connection info for a given process id.
+ * Search a bucket of an NI connection table.
+ *
+ * Entries are only ever added at the head of a bucket, after they
+ * have been fully initialized, and are not removed until the NI is
+ * destroyed, so it is safe to walk a bucket without the lock.
+ *
+ * @param[in] ni the NI
+ * @param[in] bucket the bucket to search
+ * @param[in] id the process ID to lookup
+ *
+ * @return the conn_t or NULL if not found
+ */
+static inline conn_t *conn_hash_find(ni_t *ni, unsigned int bucket,
+                                     ptl_process_t id)
+{
+    conn_t *conn;
+
+    conn = ((conn_t * volatile *)ni->conns.hash)[bucket];
+
+    while (conn) {
+        if (conn->id.phys.nid == id.phys.nid &&
+            conn->id.phys.pid == id.phys.pid)
+            return conn;
+        conn = conn->hash_next;
+    }
+
+    return NULL;
+}
+
+/**
+ * Get connection info for a given process id, over the regular
+ * transports.
  *
- * For logical NIs the connection is contained in the rank table.
- * For physical NIs the connection is held in a binary tree using
- * the ID as a sorting value.
+ * The connections of both logical and physical NIs are held in a
+ * hash table keyed on the physical ID. For logical NIs the rank is
+ * first translated through the map.
  *
- * For physical NIs if this is the first time we are sending a message
- * to this process create a new conn_t. For logical NIs the conn_t
- * structs are all allocated when the rank table is loaded.
+ * If this is the first time we are sending a message to this process
+ * create a new conn_t. For logical NIs, only the conn_t structs of the
+ * local ranks are created when the map is loaded, so that memory grows
+ * with the number of peers actually used rather than the job size.
+ *
+ * Unlike get_conn(), the NI itself is reached like any other peer.
+ * The transports use it to find the connection their own messages
+ * come in on.
  *
  * @param[in] ni the NI from which to get the connection
  * @param[in] id the process ID to lookup
  *
  * @return the conn_t and takes a reference on it
  */
-conn_t *get_conn(ni_t *ni, ptl_process_t id)
+conn_t *get_peer_conn(ni_t *ni, ptl_process_t id)
 {
     conn_t *conn;
-    void **ret;
+    unsigned int bucket;
 
     if (ni->options & PTL_NI_LOGICAL) {
         if (unlikely(id.rank >= ni->logical.map_size)) {
@@ -138,62 +194,283 @@ conn_t *get_conn(ni_t *ni, ptl_process_t id)
             return NULL;
         }
 
-        conn = ni->logical.rank_table[id.rank].connect;
+        id = rank_to_phys(ni, id.rank);
+    }
+
+    bucket = conn_hash_bucket(ni, id);
+
+    /* Fast path: lock free lookup. */
+    conn = conn_hash_find(ni, bucket, id);
+    if (likely(conn != NULL)) {
         conn_get(conn);
-    } else {
-        conn_t conn_search;
+        return conn;
+    }
 
-        PTL_FASTLOCK_LOCK(&ni->physical.lock);
+    PTL_FASTLOCK_LOCK(&ni->conns.lock);
 
-        /* lookup in binary tree */
-        conn_search.id = id;
-        ret = tfind(&conn_search, &ni->physical.tree, compare_conn_id);
-        if (ret) {
-            conn = *ret;
-            conn_get(conn);
-        } else {
-            /* Not found. Allocate and insert. */
-            if (conn_alloc(ni, &conn)) {
-                PTL_FASTLOCK_UNLOCK(&ni->physical.lock);
-                WARN();
-                return NULL;
-            }
+    /* Another thread may have inserted it in the meantime. */
+    conn = conn_hash_find(ni, bucket, id);
+    if (conn) {
+        conn_get(conn);
+    } else {
+        /* Not found. Allocate and insert. */
+        if (conn_alloc(ni, &conn)) {
+            PTL_FASTLOCK_UNLOCK(&ni->conns.lock);
+            WARN();
+            return NULL;
+        }
 #if IS_PPE || WITH_TRANSPORT_SHMEM
-            //need to connect local processes over shared memory
-            if (conn->id.phys.nid == ni->iface->id.phys.nid) {
-                if (get_param(PTL_ENABLE_MEM)) {
+        //need to connect local processes over shared memory
+        if ((ni->options & PTL_NI_PHYSICAL) &&
+            conn->id.phys.nid == ni->iface->id.phys.nid) {
+            if (get_param(PTL_ENABLE_MEM)) {
 #if IS_PPE
-                    conn->transport = transport_mem;
+                conn->transport = transport_mem;
 #elif WITH_TRANSPORT_SHMEM
-                    conn->transport = transport_shmem;
+                conn->transport = transport_shmem;
 #endif
-                    conn->state = CONN_STATE_CONNECTED;
-                }
+                conn->state = CONN_STATE_CONNECTED;
             }
+        }
+#endif
+
+        conn->id = id;
+
+        /* Get the IP address from the NID. */
+        conn->sin.sin_family = AF_INET;
+        conn->sin.sin_addr.s_addr = nid_to_addr(id.phys.nid);
+        conn->sin.sin_port = pid_to_port(id.phys.pid);
+
+#if WITH_TRANSPORT_UDP
+        /* Logical peers are reached at the address from the map. */
+        if ((ni->options & PTL_NI_LOGICAL) &&
+            conn->transport.type == CONN_TYPE_UDP) {
+            conn->udp.dest_addr = conn->sin;
+            ptl_info("new connection: %s:%i\n",
+                     inet_ntoa(conn->udp.dest_addr.sin_addr),
+                     htons(conn->udp.dest_addr.sin_port));
+        }
+#endif
+
+        /* Publish the new conn at the head of its bucket. The
+         * table holds the reference from conn_alloc. */
+        conn->hash_next = ni->conns.hash[bucket];
+        __sync_synchronize();
+        ni->conns.hash[bucket] = conn;
+
+        conn_get(conn);
+    }
+
+    PTL_FASTLOCK_UNLOCK(&ni->conns.lock);
+
+    return conn;
+}
+
+#if !IS_PPE
+/**
+ * Get the loopback connection of an NI. It is created on first use.
+ *
+ * @param[in] ni the NI
+ *
+ * @return the conn_t and takes a reference on it
+ */
+static conn_t *get_self_conn(ni_t *ni)
+{
+    conn_t *conn;
+
+    conn = *(conn_t * volatile *)&ni->self.conn;
+    if (likely(conn != NULL)) {
+        conn_get(conn);
+        return conn;
+    }
+
+    PTL_FASTLOCK_LOCK(&ni->conns.lock);
+
+    conn = ni->self.conn;
+    if (!conn) {
+        if (conn_alloc(ni, &conn)) {
+            PTL_FASTLOCK_UNLOCK(&ni->conns.lock);
+            WARN();
+            return NULL;
+        }
+
+        conn->id = ni->iface->id;
+        conn->transport = transport_self;
+        conn->state = CONN_STATE_CONNECTED;
+
+        /* The NI holds the reference from conn_alloc. */
+        __sync_synchronize();
+        ni->self.conn = conn;
+    }
+
+    conn_get(conn);
+
+    PTL_FASTLOCK_UNLOCK(&ni->conns.lock);
+
+    return conn;
+}
+#endif
+
+/**
+ * Get connection info for a given process id.
+ *
+ * Messages an NI sends to itself go through the loopback transport
+ * (see ptl_self.c), unless PTL_ENABLE_SELF is 0.
+ *
+ * @param[in] ni the NI from which to get the connection
+ * @param[in] id the process ID to lookup
+ *
+ * @return the conn_t and takes a reference on it
+ */
+conn_t *get_conn(ni_t *ni, ptl_process_t id)
+{
+#if !IS_PPE
+    if (is_self(ni, id) && get_param(PTL_ENABLE_SELF))
+        return get_self_conn(ni);
 #endif
 
-            conn->id = id;
+    return get_peer_conn(ni, id);
+}
+
+/**
+ * Wait for a connection to be established.
+ *
+ * Handshakes that were lost or rejected, because the peer was not
+ * ready yet, are restarted periodically.
+ *
+ * @param[in] ni the NI
+ * @param[in] conn the connection
+ *
+ * @return status
+ */
+static int wait_connected(ni_t *ni, conn_t *conn)
+{
+    int err = PTL_OK;
+#if WITH_TRANSPORT_IB || WITH_TRANSPORT_UDP
+    int retries = CONNECT_RETRIES;
 
-            /* Get the IP address from the NID. */
-            conn->sin.sin_family = AF_INET;
-            conn->sin.sin_addr.s_addr = nid_to_addr(id.phys.nid);
-            conn->sin.sin_port = pid_to_port(id.phys.pid);
+    pthread_mutex_lock(&conn->mutex);
 
-            /* insert new conn into binary tree */
-            ret = tsearch(conn, &ni->physical.tree, compare_conn_id);
-            if (!ret) {
+    while (conn->state < CONN_STATE_CONNECTED) {
+        struct timespec ts;
+        int timedout;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += CONNECT_RETRY_NSEC;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+
+        if (ni->options & PTL_NI_APP_PROGRESS) {
+            /* Nobody else will process the reply. */
+            struct timespec now;
+
+            pthread_mutex_unlock(&conn->mutex);
+            do {
+                ni_progress(ni);
+                clock_gettime(CLOCK_REALTIME, &now);
+            } while (conn->state < CONN_STATE_CONNECTED &&
+                     (now.tv_sec < ts.tv_sec ||
+                      (now.tv_sec == ts.tv_sec && now.tv_nsec < ts.tv_nsec)));
+            pthread_mutex_lock(&conn->mutex);
+
+            timedout = conn->state < CONN_STATE_CONNECTED;
+        } else {
+            timedout = pthread_cond_timedwait(&conn->move_wait, &conn->mutex,
+                                              &ts) == ETIMEDOUT;
+        }
+
+        if (timedout && conn->state == CONN_STATE_DISCONNECTED) {
+            if (--retries == 0 || conn->transport.init_connect(ni, conn)) {
                 WARN();
-                conn_put(conn);
-                conn = NULL;
-            } else {
-                conn_get(conn);
+                err = PTL_FAIL;
+                break;
             }
         }
+    }
+
+    pthread_mutex_unlock(&conn->mutex);
+#else
+    if (conn->state < CONN_STATE_CONNECTED)
+        err = PTL_FAIL;
+#endif
+
+    return err;
+}
+
+/**
+ * Connect to a set of peers.
+ *
+ * All the handshakes are started before waiting for any of them, so
+ * that they proceed in parallel in the progress thread instead of
+ * one at a time on first use.
+ *
+ * @param[in] ni the NI
+ * @param[in] num_targets the number of targets
+ * @param[in] targets the IDs of the targets, or NULL to use ranks
+ * 0 to num_targets-1 on a logical NI
+ * @param[in] wait if non zero, wait for all the connections
+ *
+ * @return status
+ */
+int connect_peers(ni_t *ni, ptl_size_t num_targets,
+                  const ptl_process_t *targets, int wait)
+{
+    conn_t **conns;
+    ptl_size_t num_conns = 0;
+    ptl_size_t i;
+    int err = PTL_OK;
 
-        PTL_FASTLOCK_UNLOCK(&ni->physical.lock);
+    conns = calloc(num_targets, sizeof(conn_t *));
+    if (!conns && num_targets) {
+        WARN();
+        return PTL_NO_SPACE;
     }
 
-    return conn;
+    for (i = 0; i < num_targets; i++) {
+        ptl_process_t id;
+        conn_t *conn;
+
+        if (targets) {
+            id = targets[i];
+        } else {
+            id.rank = i;
+        }
+
+        if (is_self(ni, id))
+            continue;
+
+        conn = get_conn(ni, id);
+        if (!conn) {
+            err = PTL_ARG_INVALID;
+            break;
+        }
+
+        conns[num_conns++] = conn;
+
+        pthread_mutex_lock(&conn->mutex);
+        if (conn->state == CONN_STATE_DISCONNECTED &&
+            conn->transport.init_connect(ni, conn)) {
+            WARN();
+            err = PTL_FAIL;
+        }
+        pthread_mutex_unlock(&conn->mutex);
+
+        if (err)
+            break;
+    }
+
+    for (i = 0; i < num_conns; i++) {
+        if (wait && err == PTL_OK)
+            err = wait_connected(ni, conns[i]);
+
+        conn_put(conns[i]);
+    }
+
+    free(conns);
+
+    return err;
 }
 
 #if WITH_TRANSPORT_IB
@@ -264,34 +541,18 @@ static void initiate_disconnect_one(conn_t *conn)
     pthread_mutex_unlock(&conn->mutex);
 }
 
-static void initiate_disconnect_one_twalk(const void *data, const VISIT which,
-                                          const int depth)
-{
-    conn_t *conn = *(conn_t **)data;
-
-    if (which != leaf && which != postorder)
-        return;
-
-    initiate_disconnect_one(conn);
-}
-
 /* When an application destroy an NI, it cannot just close its
  * connections because there might be some packets in flight. So it
  * just informs the remote sides that it is ready to shutdown. */
 void initiate_disconnect_all(ni_t *ni)
 {
-    if (ni->options & PTL_NI_LOGICAL) {
-        int i;
-        const int map_size = ni->logical.map_size;
-
-        /* Send a disconnect message. */
-        for (i = 0; i < map_size; i++) {
-            conn_t *conn = ni->logical.rank_table[i].connect;
+    unsigned int i;
+    conn_t *conn;
 
+    /* Send a disconnect message. */
+    for (i = 0; i <= ni->conns.hash_mask; i++) {
+        for (conn = ni->conns.hash[i]; conn; conn = conn->hash_next)
             initiate_disconnect_one(conn);
-        }
-    } else {
-        twalk(ni->physical.tree, initiate_disconnect_one_twalk);
     }
 }
 
@@ -347,29 +608,35 @@ static void destroy_conn(void *data)
  */
 void destroy_conns(ni_t *ni)
 {
-    if (ni->options & PTL_NI_LOGICAL) {
-        if (ni->logical.mapping) {
-            int i;
-            const int map_size = ni->logical.map_size;
-
-            /* Destroy active connections. */
-            for (i = 0; i < map_size; i++) {
-                entry_t *entry = &ni->logical.rank_table[i];
-                destroy_conn(entry->connect);
-                entry->connect = NULL;
-            }
-        }
-    } else {
-#ifdef HAVE_TDESTROY
-        tdestroy(ni->physical.tree, destroy_conn);
-#else
-        while (ni->physical.tree != NULL) {
-            destroy_conn(*(void **)ni->physical.tree);
-            tdelete(*(void **)ni->physical.tree, &ni->physical.tree,
-                    compare_conn_id);
+    unsigned int i;
+    conn_t *conn;
+    conn_t *next;
+
+    if (!ni->conns.hash)
+        return;
+
+    for (i = 0; i <= ni->conns.hash_mask; i++) {
+        for (conn = ni->conns.hash[i]; conn; conn = next) {
+            next = conn->hash_next;
+            destroy_conn(conn);
         }
-#endif
+        ni->conns.hash[i] = NULL;
     }
+
+#if !IS_PPE
+    /* Drop the messages that were never delivered. */
+    while (!list_empty(&ni->self.queue)) {
+        buf_t *buf = list_first_entry(&ni->self.queue, buf_t, list);
+
+        list_del(&buf->list);
+        buf_put(buf);
+    }
+
+    if (ni->self.conn) {
+        conn_put(ni->self.conn);
+        ni->self.conn = NULL;
+    }
+#endif
 }
 
 #if WITH_TRANSPORT_IB
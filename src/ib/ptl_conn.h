@@ -36,6 +36,9 @@ enum transport_type {
 #if WITH_TRANSPORT_UDP
     CONN_TYPE_UDP,
 #endif
+#if !IS_PPE
+    CONN_TYPE_SELF,
+#endif
 };
 
 struct md;
@@ -50,6 +53,12 @@ struct transport {
     /* Allocate a transport buffer suited for this transport. */
     int (*buf_alloc) (ni_t *ni, struct buf ** buf_p);
 
+    /* Allocate a transport buffer with room for length bytes of put
+     * data, when the transport has buffers larger than a buf_t for
+     * that. Optional. */
+    int (*buf_alloc_eager) (ni_t *ni, ptl_size_t length,
+                            struct buf ** buf_p);
+
     /* Initiate a connection to a remote node. */
     int (*init_connect) (ni_t *ni, struct conn * conn);
 
@@ -80,6 +89,7 @@ struct transport {
 extern struct transport transport_rdma;
 extern struct transport transport_udp;
 extern struct transport transport_shmem;
+extern struct transport transport_self;
 
 /**
  * Per connection information.
@@ -95,6 +105,9 @@ struct conn {
 
     struct transport transport;
 
+    /* Next conn in the same bucket of the NI connection table. */
+    struct conn *hash_next;
+
     union {
 #if WITH_TRANSPORT_IB
         struct {
@@ -153,7 +166,6 @@ struct conn {
         struct {
             struct sockaddr_in dest_addr;
             atomic_t fragment_seq;
-            atomic_t is_waiting;    /* set if waiting for connection request response to arrive */
             struct list_head waiting_bufs;  /* list of bufs waiting for connection to be established */
 #if WITH_RUDP
             atomic_t recv_seq_num;  /*sequence number for reliability */
@@ -168,6 +180,20 @@ struct conn {
     pthread_cond_t move_wait;
 #endif
 
+#if !IS_PPE
+    /* Target side. CT acks for that peer waiting to be sent as one
+     * merged ack (see tgt_merge_ack()). Protected by the NI
+     * ack_merge lock. */
+    struct {
+        struct list_head list;  /* on the NI list while count != 0 */
+        uint32_t md_handle;
+        unsigned int count;
+        unsigned int failures;
+        unsigned int disabled;
+        ptl_size_t mlength;
+        uint64_t deadline;      /* in microseconds */
+    } ack_merge;
+#endif
 };
 
 typedef struct conn conn_t;
@@ -295,10 +321,32 @@ static inline int compare_id(const ptl_process_t *id1,
                                                 id2->phys.pid);
 }
 
+/**
+ * Check whether an ID designates the NI itself.
+ *
+ * @param[in] ni the NI
+ * @param[in] id a rank for a logical NI, or a nid/pid
+ *
+ * @return non zero if it is ourself
+ */
+static inline int is_self(const struct ni *ni, ptl_process_t id)
+{
+    if (ni->options & PTL_NI_LOGICAL)
+        return id.rank == ni->id.rank;
+    else
+        return id.phys.nid == ni->id.phys.nid &&
+            id.phys.pid == ni->id.phys.pid;
+}
+
 conn_t *get_conn(struct ni *ni, ptl_process_t id);
 
+conn_t *get_peer_conn(struct ni *ni, ptl_process_t id);
+
 void destroy_conns(struct ni *ni);
 
+int connect_peers(struct ni *ni, ptl_size_t num_targets,
+                  const ptl_process_t *targets, int wait);
+
 int conn_init(void *arg, void *parm);
 
 void conn_fini(void *arg);
@@ -0,0 +1,344 @@
+/**
+ * @file ptl_copy.c
+ *
+ * Copy engine for bulk data.
+ *
+ * Copies of at least PTL_COPY_NT_SIZE bytes use streaming stores,
+ * with the widest vectors the CPU supports. By default that is the
+ * size of the last level cache: a copy that large evicts its own data
+ * before the receiver reads it, so there is no point in writing it
+ * through the cache. Copies of at least PTL_COPY_MT_SIZE bytes are
+ * split in chunks between PTL_COPY_THREADS threads and the caller.
+ */
+
+#include "ptl_loc.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_NT_COPY 1
+#endif
+
+/* Size of the pieces of a multi-threaded copy. */
+#define COPY_CHUNK		(256 * 1024)
+
+/* How far ahead of the copy the source is prefetched. */
+#define PREFETCH_DIST	(512)
+
+typedef void (*copy_fn_t)(void *dst, const void *src, size_t len);
+
+size_t copy_large_size = SIZE_MAX;
+
+static copy_fn_t nt_copy;              /* streaming copy, if any */
+static size_t nt_size;
+static size_t mt_size;
+
+static struct {
+    /* Held by the caller of a multi-threaded copy. */
+    pthread_mutex_t job_mutex;
+
+    /* Protects the fields below. */
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned int generation;
+    int stop;
+    int busy;
+    int num_threads;
+    pthread_t *threads;
+
+    /* The current copy. */
+    char *dst;
+    const char *src;
+    size_t len;
+    copy_fn_t fn;
+    int num_chunks;
+    atomic_t next_chunk;
+} pool = {
+    .job_mutex = PTHREAD_MUTEX_INITIALIZER,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .start = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+#if HAVE_NT_COPY
+/* Copy enough bytes to align the destination. */
+static inline size_t copy_head(char **d, const char **s, size_t len,
+                               size_t align)
+{
+    size_t head = -(uintptr_t) *d & (align - 1);
+
+    if (head > len)
+        head = len;
+
+    memcpy(*d, *s, head);
+    *d += head;
+    *s += head;
+
+    return len - head;
+}
+
+static void nt_copy_sse2(void *dst, const void *src, size_t len)
+{
+    char *d = dst;
+    const char *s = src;
+
+    len = copy_head(&d, &s, len, 16);
+
+    for (; len >= 64; len -= 64, d += 64, s += 64) {
+        __m128i a, b, c, e;
+
+        _mm_prefetch(s + PREFETCH_DIST, _MM_HINT_NTA);
+
+        a = _mm_loadu_si128((const __m128i *)s);
+        b = _mm_loadu_si128((const __m128i *)(s + 16));
+        c = _mm_loadu_si128((const __m128i *)(s + 32));
+        e = _mm_loadu_si128((const __m128i *)(s + 48));
+        _mm_stream_si128((__m128i *)d, a);
+        _mm_stream_si128((__m128i *)(d + 16), b);
+        _mm_stream_si128((__m128i *)(d + 32), c);
+        _mm_stream_si128((__m128i *)(d + 48), e);
+    }
+
+    /* Streaming stores are weakly ordered. */
+    _mm_sfence();
+
+    memcpy(d, s, len);
+}
+
+__attribute__ ((target("avx")))
+static void nt_copy_avx(void *dst, const void *src, size_t len)
+{
+    char *d = dst;
+    const char *s = src;
+
+    len = copy_head(&d, &s, len, 32);
+
+    for (; len >= 128; len -= 128, d += 128, s += 128) {
+        __m256i a, b, c, e;
+
+        _mm_prefetch(s + PREFETCH_DIST, _MM_HINT_NTA);
+        _mm_prefetch(s + PREFETCH_DIST + 64, _MM_HINT_NTA);
+
+        a = _mm256_loadu_si256((const __m256i *)s);
+        b = _mm256_loadu_si256((const __m256i *)(s + 32));
+        c = _mm256_loadu_si256((const __m256i *)(s + 64));
+        e = _mm256_loadu_si256((const __m256i *)(s + 96));
+        _mm256_stream_si256((__m256i *)d, a);
+        _mm256_stream_si256((__m256i *)(d + 32), b);
+        _mm256_stream_si256((__m256i *)(d + 64), c);
+        _mm256_stream_si256((__m256i *)(d + 96), e);
+    }
+
+    _mm_sfence();
+
+    memcpy(d, s, len);
+}
+#endif
+
+/**
+ * @brief Copy the chunks of the current copy until there are none left.
+ */
+static void copy_chunks(void)
+{
+    size_t offset;
+    size_t len;
+    int i;
+
+    while ((i = atomic_inc(&pool.next_chunk)) < pool.num_chunks) {
+        offset = (size_t)i * COPY_CHUNK;
+        len = pool.len - offset;
+        if (len > COPY_CHUNK)
+            len = COPY_CHUNK;
+
+        pool.fn(pool.dst + offset, pool.src + offset, len);
+    }
+}
+
+static void *copy_thread(void *arg)
+{
+    unsigned int generation = 0;
+
+    pthread_mutex_lock(&pool.mutex);
+
+    for (;;) {
+        while (!pool.stop && pool.generation == generation)
+            pthread_cond_wait(&pool.start, &pool.mutex);
+
+        if (pool.stop)
+            break;
+
+        generation = pool.generation;
+        pthread_mutex_unlock(&pool.mutex);
+
+        copy_chunks();
+
+        pthread_mutex_lock(&pool.mutex);
+        if (--pool.busy == 0)
+            pthread_cond_signal(&pool.done);
+    }
+
+    pthread_mutex_unlock(&pool.mutex);
+
+    return NULL;
+}
+
+/**
+ * @brief Split a copy between the copy threads and the caller.
+ *
+ * @return status. PTL_FAIL if the threads are busy with another copy.
+ */
+static int copy_mt(void *dst, const void *src, size_t len, copy_fn_t fn)
+{
+    if (pthread_mutex_trylock(&pool.job_mutex))
+        return PTL_FAIL;
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.dst = dst;
+    pool.src = src;
+    pool.len = len;
+    pool.fn = fn;
+    pool.num_chunks = (len + COPY_CHUNK - 1) / COPY_CHUNK;
+    atomic_set(&pool.next_chunk, 0);
+    pool.busy = pool.num_threads;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.mutex);
+
+    copy_chunks();
+
+    pthread_mutex_lock(&pool.mutex);
+    while (pool.busy)
+        pthread_cond_wait(&pool.done, &pool.mutex);
+    pthread_mutex_unlock(&pool.mutex);
+
+    pthread_mutex_unlock(&pool.job_mutex);
+
+    return PTL_OK;
+}
+
+static void plain_copy(void *dst, const void *src, size_t len)
+{
+    memcpy(dst, src, len);
+}
+
+/**
+ * @brief Copy at least copy_large_size bytes.
+ *
+ * @param[in] dst the destination address
+ * @param[in] src the source address
+ * @param[in] len the number of bytes to copy
+ */
+void copy_large(void *dst, const void *src, size_t len)
+{
+    copy_fn_t fn = plain_copy;
+
+    if (nt_copy && len >= nt_size)
+        fn = nt_copy;
+
+    if (pool.num_threads && len >= mt_size &&
+        copy_mt(dst, src, len, fn) == PTL_OK)
+        return;
+
+    fn(dst, src, len);
+}
+
+/**
+ * @brief Return the size of the last level cache.
+ */
+static size_t llc_size(void)
+{
+    long size = 0;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    if (size <= 0)
+        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (size <= 0)
+        size = 8 * 1024 * 1024;
+
+    return size;
+}
+
+/**
+ * @brief Choose the copy functions and start the copy threads.
+ *
+ * Must be called after init_param.
+ *
+ * @return status
+ */
+int copy_engine_init(void)
+{
+    int num_threads;
+    int err;
+    int i;
+
+    nt_copy = NULL;
+
+#if HAVE_NT_COPY
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+        nt_copy = nt_copy_avx;
+    else
+        nt_copy = nt_copy_sse2;
+#endif
+
+    nt_size = get_param(PTL_COPY_NT_SIZE);
+    if (!get_param(PTL_COPY_NT))
+        nt_copy = NULL;
+    else if (nt_size == 0)
+        nt_size = llc_size();
+    mt_size = get_param(PTL_COPY_MT_SIZE);
+    num_threads = get_param(PTL_COPY_THREADS);
+
+    if (num_threads) {
+        pool.threads = calloc(num_threads, sizeof(pthread_t));
+        if (!pool.threads) {
+            WARN();
+            return PTL_NO_SPACE;
+        }
+
+        pool.stop = 0;
+
+        for (i = 0; i < num_threads; i++) {
+            err = pthread_create(&pool.threads[i], NULL, copy_thread, NULL);
+            if (err) {
+                ptl_warn("copy thread creation failed\n");
+                break;
+            }
+            pool.num_threads++;
+        }
+    }
+
+    copy_large_size = SIZE_MAX;
+    if (nt_copy)
+        copy_large_size = nt_size;
+    if (pool.num_threads && mt_size < copy_large_size)
+        copy_large_size = mt_size;
+
+    return PTL_OK;
+}
+
+/**
+ * @brief Stop the copy threads.
+ */
+void copy_engine_fini(void)
+{
+    int i;
+
+    copy_large_size = SIZE_MAX;
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.stop = 1;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.mutex);
+
+    for (i = 0; i < pool.num_threads; i++)
+        pthread_join(pool.threads[i], NULL);
+
+    free(pool.threads);
+    pool.threads = NULL;
+    pool.num_threads = 0;
+}
@@ -0,0 +1,38 @@
+/**
+ * @file ptl_copy.h
+ *
+ * @brief Copy engine for bulk data moved by the library.
+ */
+
+#ifndef PTL_COPY_H
+#define PTL_COPY_H
+
+/* Copies at least that long go through copy_large(). */
+extern size_t copy_large_size;
+
+void copy_large(void *dst, const void *src, size_t len);
+
+int copy_engine_init(void);
+
+void copy_engine_fini(void);
+
+/**
+ * @brief Copy bulk data.
+ *
+ * Small copies are a plain memcpy. Large ones may use streaming
+ * stores, which keep the destination out of the cache, and may be
+ * split between copy threads.
+ *
+ * @param[in] dst the destination address
+ * @param[in] src the source address
+ * @param[in] len the number of bytes to copy
+ */
+static inline void ptl_copy(void *dst, const void *src, size_t len)
+{
+    if (likely(len < copy_large_size))
+        memcpy(dst, src, len);
+    else
+        copy_large(dst, src, len);
+}
+
+#endif /* PTL_COPY_H */
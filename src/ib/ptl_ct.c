@@ -26,6 +26,10 @@ int ct_init(void *arg, void *unused)
     INIT_LIST_HEAD(&ct->trig_list);
     atomic_set(&ct->list_size, 0);
 
+#if !IS_PPE || USE_XPMEM
+    ct->info = &ct->local_info;
+#endif
+
     return PTL_OK;
 }
 
@@ -54,9 +58,15 @@ int ct_new(void *arg)
 
     assert(list_empty(&ct->trig_list));
 
-    ct->info.interrupt = 0;
-    ct->info.event.failure = 0;
-    ct->info.event.success = 0;
+#if IS_PPE && !USE_XPMEM
+    ct->info = ppe_shm_alloc(sizeof(struct ct_info), &ct->ppe.ct_mapping);
+    if (!ct->info)
+        return PTL_NO_SPACE;
+#endif
+
+    ct->info->interrupt = 0;
+    ct->info->event.failure = 0;
+    ct->info->event.success = 0;
 
     return PTL_OK;
 }
@@ -72,9 +82,16 @@ void ct_cleanup(void *arg)
 {
     ct_t *ct = arg;
 
-    ct->info.interrupt = 0;
-    ct->info.event.failure = 0;
-    ct->info.event.success = 0;
+#if IS_PPE && !USE_XPMEM
+    if (ct->info) {
+        ppe_shm_free(&ct->ppe.ct_mapping);
+        ct->info = NULL;
+    }
+#else
+    ct->info->interrupt = 0;
+    ct->info->event.failure = 0;
+    ct->info->event.success = 0;
+#endif
 }
 
 /**
@@ -209,7 +226,7 @@ int _PtlCTFree(PPEGBL ptl_handle_ct_t ct_handle)
     PTL_FASTLOCK_UNLOCK(&ni->ct_list_lock);
 
     /* clean up pending operations */
-    ct->info.interrupt = 1;
+    ct->info->interrupt = 1;
     ct_check(ct);
 
     ct_cleanup(ct);
@@ -264,7 +281,7 @@ int _PtlCTCancelTriggered(PPEGBL ptl_handle_ct_t ct_handle)
     ct = to_obj(MYGBL_ POOL_ANY, ct_handle);
 #endif
 
-    ct->info.interrupt = 1;
+    ct->info->interrupt = 1;
     ct_check(ct);
 
     err = PTL_OK;
@@ -317,7 +334,9 @@ int _PtlCTGet(PPEGBL ptl_handle_ct_t ct_handle, ptl_ct_event_t *event_p)
     ct = to_obj(MYGBL_ POOL_ANY, ct_handle);
 #endif
 
-    *event_p = ct->info.event;
+    ni_progress(obj_to_ni(ct));
+
+    *event_p = ct->info->event;
 
     err = PTL_OK;
     ct_put(ct);
@@ -371,7 +390,7 @@ int _PtlCTWait(PPEGBL ptl_handle_ct_t ct_handle, uint64_t threshold,
     ct = to_obj(MYGBL_ POOL_ANY, ct_handle);
 #endif
 
-    err = PtlCTWait_work(&ct->info, threshold, event_p);
+    err = PtlCTWait_work(obj_to_ni(ct), ct->info, threshold, event_p);
 
     ct_put(ct);
 #ifndef NO_ARG_VALIDATION
@@ -436,7 +455,7 @@ int _PtlCTPoll(PPEGBL const ptl_handle_ct_t *ct_handles,
             err = PTL_ARG_INVALID;
             goto err2;
         }
-        cts_info[i] = &cts[i]->info;
+        cts_info[i] = cts[i]->info;
 
         i2 = i;
 
@@ -451,13 +470,14 @@ int _PtlCTPoll(PPEGBL const ptl_handle_ct_t *ct_handles,
 #else
     for (i = 0; i < size; i++) {
         cts[i] = to_obj(MYGBL_ POOL_ANY, ct_handles[i]);
-        cts_info[i] = &cts[i]->info;
+        cts_info[i] = cts[i]->info;
     }
     i2 = size - 1;
 #endif
 
     err =
-        PtlCTPoll_work(cts_info, thresholds, size, timeout, event_p, which_p);
+        PtlCTPoll_work(obj_to_ni(cts[0]), cts_info, thresholds, size, timeout,
+                       event_p, which_p);
 
 #ifndef NO_ARG_VALIDATION
   err2:
@@ -495,7 +515,7 @@ void ct_check(ct_t *ct)
 
         if (buf->type == BUF_INIT) {
             ptl_info("check for init BUF triggering\n");
-            if (ct->info.interrupt) {
+            if (ct->info->interrupt) {
                 list_del(l);
                 atomic_dec(&ct->list_size);
 
@@ -507,7 +527,7 @@ void ct_check(ct_t *ct)
                     ptl_warn("Error in cleanup on ct interrupt\n");
 
                 PTL_FASTLOCK_LOCK(&ct->lock);
-            } else if ((ct->info.event.success + ct->info.event.failure) >=
+            } else if ((ct->info->event.success + ct->info->event.failure) >=
                        buf->ct_threshold) {
                 list_del(l);
                 atomic_dec(&ct->list_size);
@@ -526,7 +546,7 @@ void ct_check(ct_t *ct)
 #ifdef WITH_TRIG_ME_OPS
         } else if (buf->type == BUF_TRIGGERED_ME) {
              ptl_info("check for triggered ME ops\n");
-             if (ct->info.interrupt) {
+             if (ct->info->interrupt) {
                 list_del(l);
                 atomic_dec(&ct->list_size);
 
@@ -536,10 +556,10 @@ void ct_check(ct_t *ct)
                 buf_put(buf);
 
                 PTL_FASTLOCK_LOCK(&ct->lock);
-            } else if ((ct->info.event.success + ct->info.event.failure) >=
+            } else if ((ct->info->event.success + ct->info->event.failure) >=
                        buf->ct_threshold) {
                 ptl_info("ME operation triggered: %i on ct of: %i and threshold %i\n", 
-                         buf->op,ct->info.event.success,buf->ct_threshold);
+                         buf->op,ct->info->event.success,buf->ct_threshold);
                 list_del(l);
                 atomic_dec(&ct->list_size);
 
@@ -550,14 +570,14 @@ void ct_check(ct_t *ct)
                 PTL_FASTLOCK_LOCK(&ct->lock);
             } else {
                 ptl_info("ME operation not triggered %i:%i threshold: %i\n",
-                         (int)ct->info.event.success,
-                         (int)ct->info.event.failure, (int)buf->ct_threshold);
+                         (int)ct->info->event.success,
+                         (int)ct->info->event.failure, (int)buf->ct_threshold);
             }
 #endif
         } else {
             ptl_info("check for BUF triggering\n");
             assert(buf->type == BUF_TRIGGERED);
-            if (ct->info.interrupt) {
+            if (ct->info->interrupt) {
                 list_del(l);
                 atomic_dec(&ct->list_size);
 
@@ -567,7 +587,7 @@ void ct_check(ct_t *ct)
                 buf_put(buf);
 
                 PTL_FASTLOCK_LOCK(&ct->lock);
-            } else if ((ct->info.event.success + ct->info.event.failure) >=
+            } else if ((ct->info->event.success + ct->info->event.failure) >=
                        buf->threshold) {
                 list_del(l);
                 atomic_dec(&ct->list_size);
@@ -593,7 +613,7 @@ void ct_check(ct_t *ct)
 static void ct_set(ct_t *ct, ptl_ct_event_t new_ct)
 {
     /* set new value */
-    ct->info.event = new_ct;
+    ct->info->event = new_ct;
 
     /* check to see if this triggers any further
      * actions */
@@ -658,13 +678,13 @@ static void ct_inc(ct_t *ct, ptl_ct_event_t increment)
 {
     /* increment ct by value */
     if (likely(increment.success))
-        (void)__sync_add_and_fetch(&ct->info.event.success,
+        (void)__sync_add_and_fetch(&ct->info->event.success,
                                    increment.success);
     else
-        (void)__sync_add_and_fetch(&ct->info.event.failure,
+        (void)__sync_add_and_fetch(&ct->info->event.failure,
                                    increment.failure);
 
-    ptl_info("CT inc, CT: %p new val: %i value inc'd by: %i failures: %i\n",ct,ct->info.event.success,increment.success,ct->info.event.failure);     
+    ptl_info("CT inc, CT: %p new val: %i value inc'd by: %i failures: %i\n",ct,ct->info->event.success,increment.success,ct->info->event.failure);     
 
     /* check to see if this triggers any further
      * actions */
@@ -791,7 +811,7 @@ int _PtlTriggeredCTInc(PPEGBL ptl_handle_ct_t ct_handle,
     ni = obj_to_ni(trig_ct);
 #endif
 
-    if ((trig_ct->info.event.failure + trig_ct->info.event.success) >=
+    if ((trig_ct->info->event.failure + trig_ct->info->event.success) >=
         threshold) {
         /* Fast path. Condition is already met. */
         ct_inc(ct, increment);
@@ -885,7 +905,7 @@ int _PtlTriggeredCTSet(PPEGBL ptl_handle_ct_t ct_handle,
     ni = obj_to_ni(trig_ct);
 #endif
 
-    if ((trig_ct->info.event.failure + trig_ct->info.event.success) >=
+    if ((trig_ct->info->event.failure + trig_ct->info->event.success) >=
         threshold) {
         /* Fast path. Condition already met. */
         ct_set(ct, new_ct);
@@ -930,7 +950,7 @@ static void do_trig_ct_op(buf_t *buf)
     ct_t *ct = buf->ct;
 
     /* we're a zombie */
-    if (ct->info.interrupt)
+    if (ct->info->interrupt)
         goto done;
 
     switch (buf->op) {
@@ -965,7 +985,7 @@ void post_ct(buf_t *buf, ct_t *ct)
     PTL_FASTLOCK_LOCK(&ct->lock);
 
     /* 1st check to see whether the condition is already met. */
-    if ((ct->info.event.success + ct->info.event.failure) >=
+    if ((ct->info->event.success + ct->info->event.failure) >=
         buf->ct_threshold) {
         PTL_FASTLOCK_UNLOCK(&ct->lock);
 
@@ -978,7 +998,7 @@ void post_ct(buf_t *buf, ct_t *ct)
         list_add(&buf->list, &ct->trig_list);
 
         /* We must check again to avoid a race with make_ct_event/ct_inc_ct_set. */
-        if ((ct->info.event.success + ct->info.event.failure) >=
+        if ((ct->info->event.success + ct->info->event.failure) >=
             buf->ct_threshold) {
             /* Something arrived while we were adding the buffer. */
             PTL_FASTLOCK_UNLOCK(&ct->lock);
@@ -1002,7 +1022,7 @@ static void post_trig_ct(buf_t *buf, ct_t *trig_ct)
     PTL_FASTLOCK_LOCK(&trig_ct->lock);
 
     /* 1st check to see whether the condition is already met. */
-    if ((trig_ct->info.event.failure + trig_ct->info.event.success) >=
+    if ((trig_ct->info->event.failure + trig_ct->info->event.success) >=
         buf->threshold) {
         PTL_FASTLOCK_UNLOCK(&trig_ct->lock);
         ptl_info("triggered ct already met conditions\n");
@@ -1017,7 +1037,7 @@ static void post_trig_ct(buf_t *buf, ct_t *trig_ct)
         list_add(&buf->list, &trig_ct->trig_list);
 
         /* We must check again to avoid a race with make_ct_event/ct_inc_ct_set. */
-        if ((trig_ct->info.event.success + trig_ct->info.event.failure) >=
+        if ((trig_ct->info->event.success + trig_ct->info->event.failure) >=
             buf->threshold) {
             /* Something arrived while we were adding the buffer. */
             PTL_FASTLOCK_UNLOCK(&trig_ct->lock);
@@ -1038,16 +1058,35 @@ static void post_trig_ct(buf_t *buf, ct_t *trig_ct)
 void make_ct_event(ct_t *ct, buf_t *buf, enum ct_bytes bytes)
 {
     if (unlikely(buf->ni_fail))
-        (void)__sync_add_and_fetch(&ct->info.event.failure, 1);
+        (void)__sync_add_and_fetch(&ct->info->event.failure, 1);
     else if (likely(bytes == CT_EVENTS))
-        (void)__sync_add_and_fetch(&ct->info.event.success, 1);
+        (void)__sync_add_and_fetch(&ct->info->event.success, 1);
     else if (likely(bytes == CT_MBYTES))
-        (void)__sync_add_and_fetch(&ct->info.event.success, buf->mlength);
+        (void)__sync_add_and_fetch(&ct->info->event.success, buf->mlength);
     else {
         assert(bytes == CT_RBYTES);
-        (void)__sync_add_and_fetch(&ct->info.event.success, buf->rlength);
+        (void)__sync_add_and_fetch(&ct->info->event.success, buf->rlength);
     }
 
     if (atomic_read(&ct->list_size))
         ct_check(ct);
 }
+
+/**
+ * @brief Update a counting event for several operations at once.
+ *
+ * @param[in] ct The counting event to update.
+ * @param[in] success The amount to add to the success field.
+ * @param[in] failure The amount to add to the failure field.
+ */
+void make_ct_merged_event(ct_t *ct, ptl_size_t success, ptl_size_t failure)
+{
+    if (failure)
+        (void)__sync_add_and_fetch(&ct->info->event.failure, failure);
+
+    if (success)
+        (void)__sync_add_and_fetch(&ct->info->event.success, success);
+
+    if (atomic_read(&ct->list_size))
+        ct_check(ct);
+}
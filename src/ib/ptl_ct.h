@@ -30,7 +30,13 @@ struct ct {
     } ppe;
 #endif
 
-    struct ct_info info;
+    /* The counters, shared with the client on a PPE. Without XPMEM
+     * they are in a memfd of their own. */
+    struct ct_info *info;
+
+#if !IS_PPE || USE_XPMEM
+    struct ct_info local_info;
+#endif
 };
 
 typedef struct ct ct_t;
@@ -60,6 +66,8 @@ void post_ct_local(struct buf *buf, ct_t *ct);
 
 void make_ct_event(ct_t *ct, struct buf *buf, enum ct_bytes bytes);
 
+void make_ct_merged_event(ct_t *ct, ptl_size_t success, ptl_size_t failure);
+
 /**
  * Allocate a new ct object.
  *
@@ -8,13 +8,16 @@
 #include "ptl_sync.h"
 #include "ptl_timer.h"
 
+/* The PPE progresses the NIs. */
+#define ni_progress(ni) (0)
+
 #else
 #include "ptl_loc.h"
 #include "ptl_timer.h"
 #endif
 
 atomic_t keep_polling;
-int PtlCTWait_work(struct ct_info *ct_info, uint64_t threshold,
+int PtlCTWait_work(struct ni *ni, struct ct_info *ct_info, uint64_t threshold,
                    ptl_ct_event_t *event_p)
 {
     int err;
@@ -37,7 +40,8 @@ int PtlCTWait_work(struct ct_info *ct_info, uint64_t threshold,
         }
 
         /* memory barrier */
-        sched_yield();
+        if (!ni_progress(ni))
+            sched_yield();
     }
     atomic_dec(&keep_polling);
 
@@ -86,9 +90,10 @@ static int ct_poll_loop(int size, struct ct_info *cts_info[],
     return PTL_CT_NONE_REACHED;
 }
 
-int PtlCTPoll_work(struct ct_info *cts_info[], const ptl_size_t *thresholds,
-                   unsigned int size, ptl_time_t timeout,
-                   ptl_ct_event_t *event_p, unsigned int *which_p)
+int PtlCTPoll_work(struct ni *ni, struct ct_info *cts_info[],
+                   const ptl_size_t *thresholds, unsigned int size,
+                   ptl_time_t timeout, ptl_ct_event_t *event_p,
+                   unsigned int *which_p)
 {
     int err;
     int have_timeout = (timeout != PTL_TIME_FOREVER);
@@ -121,7 +126,8 @@ int PtlCTPoll_work(struct ct_info *cts_info[], const ptl_size_t *thresholds,
             }
         }
 
-        SPINLOCK_BODY();
+        if (!ni_progress(ni))
+            SPINLOCK_BODY();
     }
 
     atomic_dec(&keep_polling);
@@ -8,8 +8,11 @@ struct ct_info {
 						     getting shut down */
 };
 
-int PtlCTPoll_work(struct ct_info *cts_info[], const ptl_size_t *thresholds,
-                   unsigned int size, ptl_time_t timeout,
-                   ptl_ct_event_t *event_p, unsigned int *which_p);
-int PtlCTWait_work(struct ct_info *ct_info, uint64_t threshold,
+struct ni;
+
+int PtlCTPoll_work(struct ni *ni, struct ct_info *cts_info[],
+                   const ptl_size_t *thresholds, unsigned int size,
+                   ptl_time_t timeout, ptl_ct_event_t *event_p,
+                   unsigned int *which_p);
+int PtlCTWait_work(struct ni *ni, struct ct_info *ct_info, uint64_t threshold,
                    ptl_ct_event_t *event_p);
@@ -70,6 +70,11 @@ int data_size(data_t *data)
             break;
 #endif
 
+#if !IS_PPE
+        case DATA_FMT_SELF:
+            break;
+#endif
+
         default:
             abort();
             break;
@@ -91,9 +96,9 @@ int data_size(data_t *data)
  *
  * @return status
  */
-int append_immediate_data(void *start, mr_t **mr_list, int num_iov,
-                          data_dir_t dir, ptl_size_t offset,
-                          ptl_size_t length, buf_t *buf)
+int append_immediate_data(void *start, const ptl_size_t *iov_end,
+                          mr_t **mr_list, int num_iov, data_dir_t dir,
+                          ptl_size_t offset, ptl_size_t length, buf_t *buf)
 {
     int err;
     data_t *data = (data_t *)(buf->data + buf->length);
@@ -108,15 +113,20 @@ int append_immediate_data(void *start, mr_t **mr_list, int num_iov,
 
         if (num_iov) {
             err =
-                iov_copy_out(data->immediate.data, start, mr_list, num_iov,
-                             offset, length);
+                iov_copy_out(data->immediate.data, start, iov_end, mr_list,
+                             num_iov, offset, length);
             if (err) {
                 WARN();
                 return err;
             }
         } else {
-            void *from = addr_to_ppe(start + offset, mr_list[0]);
-            memcpy(data->immediate.data, from, length);
+            err =
+                copy_from_app(data->immediate.data, start + offset,
+                              mr_list[0], length);
+            if (err) {
+                WARN();
+                return err;
+            }
         }
 
         buf->length += sizeof(*data) + length;
@@ -25,6 +25,7 @@ enum data_fmt {
 
 #if WITH_TRANSPORT_UDP
     DATA_FMT_UDP,
+    DATA_FMT_UDP_RNDV,          /* data pulled by the target */
 #endif
 
 #if WITH_TRANSPORT_SHMEM && USE_KNEM
@@ -40,6 +41,10 @@ enum data_fmt {
     DATA_FMT_MEM_DMA,
     DATA_FMT_MEM_INDIRECT,
 #endif
+
+#if !IS_PPE
+    DATA_FMT_SELF,
+#endif
 };
 
 typedef enum data_fmt data_fmt_t;
@@ -48,6 +53,9 @@ struct mem_iovec {
 #if WITH_TRANSPORT_SHMEM && USE_KNEM
     uint64_t cookie;
     uint64_t offset;            /* add to cookie to get address */
+#endif
+#if IS_PPE && !USE_XPMEM
+    pid_t pid;                  /* owner of addr */
 #endif
     void *addr;
     uint64_t length;
@@ -79,6 +87,10 @@ struct data {
         /* DMA or Indirect shmem data */
         struct {
             unsigned int num_mem_iovecs;
+#if IS_PPE
+            /* Offset into the first iovec, for the indirect format. */
+            uint64_t iovec_offset;
+#endif
             struct mem_iovec mem_iovec[0];
         } mem;
 #endif
@@ -132,6 +144,17 @@ struct data {
             int target_done;
         } udp;
 #endif
+
+#if !IS_PPE
+        /* Initiator MD, accessed in place by the target when the
+         * initiator is itself. */
+        struct {
+            void *start;
+            const ptl_size_t *iov_end;
+            uint64_t offset;
+            uint32_t num_iov;
+        } self;
+#endif
     };
 } __attribute__ ((__packed__));
 
@@ -141,8 +164,9 @@ struct mr;
 
 int data_size(data_t *data);
 
-int append_immediate_data(void *start, struct mr **mr_list, int num_iov,
-                          data_dir_t dir, ptl_size_t offset,
-                          ptl_size_t length, struct buf *buf);
+int append_immediate_data(void *start, const ptl_size_t *iov_end,
+                          struct mr **mr_list, int num_iov, data_dir_t dir,
+                          ptl_size_t offset, ptl_size_t length,
+                          struct buf *buf);
 
 #endif /* PTL_DATA_H */
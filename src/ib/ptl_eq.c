@@ -36,7 +36,11 @@ void eq_cleanup(void *arg)
 
     if (eq->eqe_list) {
         PTL_FASTLOCK_DESTROY(&eq->eqe_list->lock);
+#if IS_PPE && !USE_XPMEM
+        ppe_shm_free(&eq->ppe.eqe_list);
+#else
         free(eq->eqe_list);
+#endif
     }
     eq->eqe_list = NULL;
 }
@@ -113,7 +117,12 @@ int _PtlEQAlloc(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t count,
     count += ni->limits.max_pt_index + 1;
 
     eq->eqe_list_size = sizeof(struct eqe_list) + count * sizeof(eqe_t);
+#if IS_PPE && !USE_XPMEM
+    /* Shared with the client through a memfd. */
+    eq->eqe_list = ppe_shm_alloc(eq->eqe_list_size, &eq->ppe.eqe_list);
+#else
     eq->eqe_list = calloc(1, eq->eqe_list_size);
+#endif
     if (!eq->eqe_list) {
         err = PTL_NO_SPACE;
         (void)__sync_fetch_and_sub(&ni->current.max_eqs, 1);
@@ -270,6 +279,8 @@ int _PtlEQGet(PPEGBL ptl_handle_eq_t eq_handle, ptl_event_t *event_p)
     eq = to_obj(MYGBL_ POOL_ANY, eq_handle);
 #endif
 
+    ni_progress(obj_to_ni(eq));
+
     err = PtlEQGet_work(eq->eqe_list, event_p);
 
     eq_put(eq);
@@ -322,7 +333,7 @@ int _PtlEQWait(PPEGBL ptl_handle_eq_t eq_handle, ptl_event_t *event_p)
     eq = to_obj(MYGBL_ POOL_ANY, eq_handle);
 #endif
 
-    err = PtlEQWait_work(eq->eqe_list, event_p);
+    err = PtlEQWait_work(obj_to_ni(eq), eq->eqe_list, event_p);
 
     eq_put(eq);
 #ifndef NO_ARG_VALIDATION
@@ -406,7 +417,8 @@ int _PtlEQPoll(PPEGBL const ptl_handle_eq_t * eq_handles, unsigned int size,
     i2 = size - 1;
 #endif
 
-    err = PtlEQPoll_work(eqes_list, size, timeout, event_p, which_p);
+    err = PtlEQPoll_work(obj_to_ni(eqs[0]), eqes_list, size, timeout,
+                         event_p, which_p);
 
 #ifndef NO_ARG_VALIDATION
   err2:
@@ -532,6 +544,36 @@ void make_init_event(buf_t *restrict buf, eq_t *restrict eq,
     check_waiter(eq->eqe_list);
 }
 
+/**
+ * @brief Add an event for an operation that failed before a buf was made.
+ *
+ * @param[in] eq The event queue.
+ * @param[in] type The event type.
+ * @param[in] user_ptr The user pointer of the operation.
+ * @param[in] ni_fail The reason of the failure.
+ */
+void make_init_fail_event(eq_t *restrict eq, ptl_event_kind_t type,
+                          void *user_ptr, ptl_ni_fail_t ni_fail)
+{
+    ptl_event_t *ev;
+
+    PTL_FASTLOCK_LOCK(&eq->eqe_list->lock);
+
+    ev = reserve_ev(eq);
+    ev->type = type;
+    ev->user_ptr = user_ptr;
+    ev->ni_fail_type = ni_fail;
+    ev->mlength = 0;
+    ev->remote_offset = 0;
+
+    if (eq->overflowing)
+        process_overflowing(eq);
+
+    PTL_FASTLOCK_UNLOCK(&eq->eqe_list->lock);
+
+    check_waiter(eq->eqe_list);
+}
+
 /**
  * @brief Fill in event struct in memory.
  *
@@ -41,6 +41,9 @@ void eq_cleanup(void *arg);
 
 void make_init_event(buf_t *buf, eq_t *eq, ptl_event_kind_t type);
 
+void make_init_fail_event(eq_t *eq, ptl_event_kind_t type, void *user_ptr,
+                          ptl_ni_fail_t ni_fail);
+
 void fill_target_event(buf_t *buf, ptl_event_kind_t type, void *user_ptr,
                        void *start, ptl_event_t *ev);
 
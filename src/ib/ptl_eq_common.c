@@ -15,6 +15,9 @@
 #include "ptl_sync.h"
 #include "ptl_timer.h"
 
+/* The PPE progresses the NIs. */
+#define ni_progress(ni) (0)
+
 #else
 #include "ptl_loc.h"
 #include "ptl_timer.h"
@@ -118,8 +121,12 @@ static inline int check_eq(struct eqe_list *eqe_list, ptl_event_t *event_p)
 
 /**
  * Do the work for PtlEQWait
+ *
+ * @param[in] ni the NI owning the queue, progressed while waiting if it
+ * has no progress thread. NULL in the light library.
  */
-int PtlEQWait_work(struct eqe_list *eqe_list, ptl_event_t *event_p)
+int PtlEQWait_work(struct ni *ni, struct eqe_list *eqe_list,
+                   ptl_event_t *event_p)
 {
     int err;
     atomic_inc(&keep_polling);
@@ -131,8 +138,8 @@ int PtlEQWait_work(struct eqe_list *eqe_list, ptl_event_t *event_p)
             break;
         }
 
-        sched_yield();
-
+        if (!ni_progress(ni))
+            sched_yield();
 
     }
     atomic_dec(&eqe_list->waiter);
@@ -143,10 +150,13 @@ int PtlEQWait_work(struct eqe_list *eqe_list, ptl_event_t *event_p)
 
 /**
  * Do the work for PtlEQPoll.
+ *
+ * @param[in] ni the NI owning the queues, progressed while waiting if
+ * it has no progress thread. NULL in the light library.
  */
-int PtlEQPoll_work(struct eqe_list *eqe_list_in[], unsigned int size,
-                   ptl_time_t timeout, ptl_event_t *event_p,
-                   unsigned int *which_p)
+int PtlEQPoll_work(struct ni *ni, struct eqe_list *eqe_list_in[],
+                   unsigned int size, ptl_time_t timeout,
+                   ptl_event_t *event_p, unsigned int *which_p)
 {
     int err;
     uint64_t nstart;
@@ -190,7 +200,8 @@ int PtlEQPoll_work(struct eqe_list *eqe_list_in[], unsigned int size,
             }
         }
 
-        sched_yield();
+        if (!ni_progress(ni))
+            sched_yield();
     }
 
   out:
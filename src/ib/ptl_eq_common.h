@@ -10,6 +10,8 @@
 
 #include "ptl_locks.h"
 
+struct ni;
+
 /**
  * Event queue entry.
  */
@@ -41,9 +43,10 @@ struct eqe_list {
 };
 
 int PtlEQGet_work(struct eqe_list *eqe_list, ptl_event_t *event_p);
-int PtlEQWait_work(struct eqe_list *eqe_list, ptl_event_t *event_p);
-int PtlEQPoll_work(struct eqe_list *eqe_list_in[], unsigned int size,
-                   ptl_time_t timeout, ptl_event_t *event_p,
-                   unsigned int *which_p);
+int PtlEQWait_work(struct ni *ni, struct eqe_list *eqe_list,
+                   ptl_event_t *event_p);
+int PtlEQPoll_work(struct ni *ni, struct eqe_list *eqe_list_in[],
+                   unsigned int size, ptl_time_t timeout,
+                   ptl_event_t *event_p, unsigned int *which_p);
 
 #endif /* PTL_EQ_COMMON_H */
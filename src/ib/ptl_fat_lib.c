@@ -53,6 +53,8 @@ void gbl_release(ref_t *ref)
 #endif
     iface_fini(gbl);
 
+    copy_engine_fini();
+
     pthread_mutex_destroy(&gbl->gbl_mutex);
 }
 
@@ -193,15 +195,17 @@ static void dump_everything(int unused)
             if (ni->options & PTL_NI_LOGICAL) {
                 printf("  Connections on logical NI:\n");
 
-                if (ni->logical.rank_table) {
-                    for (k = 0; k < ni->logical.map_size; k++) {
-                        struct rank_entry *entry = &ni->logical.rank_table[k];
-                        printf("    rank            = %d\n", entry->rank);
+                for (k = 0; k <= ni->conns.hash_mask; k++) {
+                    conn_t *conn;
+
+                    for (conn = ni->conns.hash[k]; conn;
+                         conn = conn->hash_next) {
+                        printf("    nid/pid         = %x/%x\n",
+                               conn->id.phys.nid, conn->id.phys.pid);
                         printf("    max pending wr  = %d\n",
-                               entry->connect->rdma.max_req_avail);
+                               conn->rdma.max_req_avail);
                         printf("    pending send wr = %d\n",
-                               atomic_read(&entry->connect->
-                                           rdma.num_req_posted));
+                               atomic_read(&conn->rdma.num_req_posted));
                     }
                 }
             }
@@ -264,6 +268,10 @@ int gbl_init(gbl_t *gbl)
         goto err;
     }
 
+    err = copy_engine_init();
+    if (err)
+        goto err;
+
     return PTL_OK;
 
   err:
@@ -35,8 +35,14 @@ typedef struct gbl {
 
     /* PPE specific. */
 
+#if USE_XPMEM
     /* Mapping of the whole process. */
     xpmem_apid_t apid;
+#else
+    /* The client, whose memory is accessed with
+     * process_vm_readv/writev. */
+    pid_t pid;
+#endif
 
     /* Number of the progress thread assigned to this client. */
     unsigned int prog_thread;
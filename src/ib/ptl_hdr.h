@@ -27,6 +27,8 @@ enum hdr_op {
 
     /* Either way. */
     OP_RDMA_DISC,
+    OP_UDP_PULL,                       /* target asks for rendezvous data */
+    OP_UDP_PULL_DATA,                  /* initiator sends it */
 
     /* from target to init. Do not change the order. */
     OP_REPLY,
@@ -34,6 +36,7 @@ enum hdr_op {
     OP_CT_ACK,
     OP_OC_ACK,
     OP_NO_ACK,                         /* when remote ME has ACK_DISABLE */
+    OP_MERGED_ACK,                     /* several CT acks at once */
 
     OP_LAST,
 };
@@ -89,7 +92,8 @@ typedef struct req_hdr {
     unsigned int ack_req:4;
     unsigned int atom_type:4;
     unsigned int atom_op:5;
-    unsigned int reserved_19:19;
+    unsigned int ack_merge:1;   /* ack can be merged, h1.handle is the MD */
+    unsigned int reserved_18:18;
     __le64 rlength;
     __le64 roffset;
     __le64 match_bits;
@@ -109,4 +113,25 @@ typedef struct ack_hdr {
     __le64 moffset;
 } ack_hdr_t;
 
+/* Header for a merged ack, which acknowledges several requests that
+ * asked for a CT ack on the same MD. h1.handle is the handle of that
+ * MD. */
+typedef struct merged_ack_hdr {
+    struct hdr_common h1;
+    __le32 count;               /* number of requests acknowledged */
+    __le32 failures;            /* how many of them failed */
+    __le32 disabled;            /* how many hit an ME with ACK_DISABLE */
+    __le64 mlength;             /* total length of the others */
+} merged_ack_hdr_t;
+
+/* Header for the UDP rendezvous messages. For a pull, h1.handle is
+ * the handle of the initiator buf, and a chunk of its data is asked
+ * for. The same header, followed by the chunk, comes back. */
+typedef struct udp_pull_hdr {
+    struct hdr_common h1;
+    __le64 cookie;              /* target buf, returned as is */
+    __le64 offset;              /* offset in the initiator data */
+    __le64 length;              /* length of the chunk */
+} udp_pull_hdr_t;
+
 #endif /* PTL_HDR_H */
@@ -216,6 +216,14 @@ int PtlNIInit_UDP(gbl_t *gbl, ni_t *ni)
 
 void cleanup_udp(ni_t *ni)
 {
+    struct list_head *l, *t;
+
+    /* Forget the rendezvous puts still pulling their data. */
+    PTL_FASTLOCK_LOCK(&ni->udp_lock);
+    list_for_each_safe(l, t, &ni->udp_rndv_list) {
+        list_del(l);
+    }
+    PTL_FASTLOCK_UNLOCK(&ni->udp_lock);
 
     ni->iface->udp.ni_count--;
     if (ni->iface->udp.ni_count <= 0) {
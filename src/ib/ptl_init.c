@@ -8,6 +8,7 @@
 static char *init_state_name[] = {
     [STATE_INIT_START] = "start",
     [STATE_INIT_PREP_REQ] = "prepare_req",
+    [STATE_INIT_PREP_DATA] = "prepare_data",
     [STATE_INIT_WAIT_CONN] = "wait_conn",
     [STATE_INIT_SEND_REQ] = "send_req",
     [STATE_INIT_COPY_IN] = "copy_in",
@@ -113,88 +114,88 @@ static inline void make_ct_reply_event(buf_t *buf)
 }
 
 /**
- * @brief initiator start state.
- *
- * This state analyzes the request
- * and determines the buf event mask.
+ * @brief Compute the initiator event mask of a request.
  *
- * @param[in] buf the request buf.
- * @return next state.
+ * @param[in] hdr the request header.
+ * @param[in] put_md the md the data is sent from, or NULL.
+ * @param[in] get_md the md the data is received into, or NULL.
+ * @return the event mask.
  */
-static int start(buf_t *buf)
+unsigned int req_event_mask(const req_hdr_t *hdr, const md_t *put_md,
+                            const md_t *get_md)
 {
-    req_hdr_t *hdr = (req_hdr_t *) buf->data;
+    unsigned int event_mask = 0;
 
-    if (buf->put_md) {
-        if (buf->put_md->options & PTL_MD_EVENT_SUCCESS_DISABLE)
-            buf->event_mask |= XI_PUT_SUCCESS_DISABLE_EVENT;
+    if (put_md) {
+        if (put_md->options & PTL_MD_EVENT_SUCCESS_DISABLE)
+            event_mask |= XI_PUT_SUCCESS_DISABLE_EVENT;
 
-        if (buf->put_md->options & PTL_MD_EVENT_SEND_DISABLE)
-            buf->event_mask |= XI_PUT_SEND_DISABLE_EVENT;
+        if (put_md->options & PTL_MD_EVENT_SEND_DISABLE)
+            event_mask |= XI_PUT_SEND_DISABLE_EVENT;
 
-        if (buf->put_md->options & PTL_MD_EVENT_CT_BYTES)
-            buf->event_mask |= XI_PUT_CT_BYTES;
+        if (put_md->options & PTL_MD_EVENT_CT_BYTES)
+            event_mask |= XI_PUT_CT_BYTES;
     }
 
-    if (buf->get_md) {
-        if (buf->get_md->options & PTL_MD_EVENT_SUCCESS_DISABLE)
-            buf->event_mask |= XI_GET_SUCCESS_DISABLE_EVENT;
+    if (get_md) {
+        if (get_md->options & PTL_MD_EVENT_SUCCESS_DISABLE)
+            event_mask |= XI_GET_SUCCESS_DISABLE_EVENT;
 
-        if (buf->get_md->options & PTL_MD_EVENT_CT_BYTES)
-            buf->event_mask |= XI_GET_CT_BYTES;
+        if (get_md->options & PTL_MD_EVENT_CT_BYTES)
+            event_mask |= XI_GET_CT_BYTES;
     }
 
     switch (hdr->h1.operation) {
         case OP_PUT:
         case OP_ATOMIC:
-            if (buf->put_md->eq)
-                buf->event_mask |= XI_SEND_EVENT;
+            if (put_md->eq)
+                event_mask |= XI_SEND_EVENT;
 
             if (hdr->ack_req) {
                 /* Some sort of ACK has been requested. */
-                buf->event_mask |= XI_RECEIVE_EXPECTED;
+                event_mask |= XI_RECEIVE_EXPECTED;
 
-                if (hdr->ack_req == PTL_ACK_REQ && buf->put_md->eq)
-                    buf->event_mask |= XI_ACK_EVENT;
+                if (hdr->ack_req == PTL_ACK_REQ && put_md->eq)
+                    event_mask |= XI_ACK_EVENT;
 
                 /* All three forms of ACK can generate a counting
                  * event. */
-                if (buf->put_md->ct &&
-                    (buf->put_md->options & PTL_MD_EVENT_CT_ACK))
-                    buf->event_mask |= XI_CT_ACK_EVENT;
+                if (put_md->ct &&
+                    (put_md->options & PTL_MD_EVENT_CT_ACK))
+                    event_mask |= XI_CT_ACK_EVENT;
             }
 
-            if (buf->put_md->ct &&
-                (buf->put_md->options & PTL_MD_EVENT_CT_SEND))
-                buf->event_mask |= XI_CT_SEND_EVENT;
+            if (put_md->ct &&
+                (put_md->options & PTL_MD_EVENT_CT_SEND))
+                event_mask |= XI_CT_SEND_EVENT;
             break;
         case OP_GET:
-            buf->event_mask |= XI_RECEIVE_EXPECTED;
+            event_mask |= XI_RECEIVE_EXPECTED;
 
-            if (buf->get_md->eq)
-                buf->event_mask |= XI_REPLY_EVENT;
+            if (get_md->eq)
+                event_mask |= XI_REPLY_EVENT;
 
-            if (buf->get_md->ct &&
-                (buf->get_md->options & PTL_MD_EVENT_CT_REPLY))
-                buf->event_mask |= XI_CT_REPLY_EVENT;
+            if (get_md->ct &&
+                (get_md->options & PTL_MD_EVENT_CT_REPLY))
+                event_mask |= XI_CT_REPLY_EVENT;
             break;
         case OP_FETCH:
         case OP_SWAP:
-            buf->event_mask |= XI_RECEIVE_EXPECTED;
+            event_mask |= XI_RECEIVE_EXPECTED;
 
-            if (buf->put_md->eq)
-                buf->event_mask |= XI_SEND_EVENT;
+            if (put_md->eq)
+                event_mask |= XI_SEND_EVENT;
 
-            if (buf->get_md->eq)
-                buf->event_mask |= XI_REPLY_EVENT;
+            if (get_md->eq)
+                event_mask |= XI_REPLY_EVENT;
 
-            if (buf->put_md->ct &&
-                (buf->put_md->options & PTL_MD_EVENT_CT_SEND))
-                buf->event_mask |= XI_CT_SEND_EVENT;
+            if (put_md->ct &&
+                (put_md->options & PTL_MD_EVENT_CT_SEND))
+                event_mask |= XI_CT_SEND_EVENT;
 
-            if (buf->get_md->ct &&
-                (buf->get_md->options & PTL_MD_EVENT_CT_REPLY))
-                buf->event_mask |= XI_CT_REPLY_EVENT;
+            if (get_md->ct &&
+                (get_md->options & PTL_MD_EVENT_CT_REPLY))
+                event_mask |= XI_CT_REPLY_EVENT;
             break;
         default:
             WARN();
@@ -202,29 +203,39 @@ static int start(buf_t *buf)
             break;
     }
 
-    return STATE_INIT_PREP_REQ;
+    return event_mask;
 }
 
 /**
- * @brief initiator prepare request state.
+ * @brief initiator start state.
  *
- * This state builds the request message
- * header and optional data descriptors.
+ * This state analyzes the request
+ * and determines the buf event mask.
  *
  * @param[in] buf the request buf.
  * @return next state.
  */
-static int prepare_req(buf_t *buf)
+static int start(buf_t *buf)
 {
-    int err;
-    ni_t *ni = obj_to_ni(buf);
-    req_hdr_t *hdr = (req_hdr_t *) buf->data;
-    ptl_size_t length = buf->rlength;
+    buf->event_mask |= req_event_mask((req_hdr_t *) buf->data, buf->put_md,
+                                      buf->get_md);
 
+    return STATE_INIT_PREP_REQ;
+}
+
+/**
+ * @brief Fill in the request header fields that only depend on the NI
+ * and the target.
+ *
+ * @param[in] ni the NI.
+ * @param[in] hdr the request header.
+ * @param[in] target the target process.
+ */
+void init_req_hdr(ni_t *ni, req_hdr_t *hdr, ptl_process_t target)
+{
     hdr->h1.version = PTL_HDR_VER_1;
     hdr->h1.ni_type = ni->ni_type;
     hdr->h1.pkt_fmt = PKT_FMT_REQ;
-    hdr->h1.handle = cpu_to_le32(buf_to_handle(buf));
     hdr->h1.operand = 0;
     hdr->h1.physical = !!(ni->options & PTL_NI_PHYSICAL);
     ptl_info("request uses physical: %x or logical addressing: %x \n",
@@ -235,26 +246,89 @@ static int prepare_req(buf_t *buf)
 #if WITH_TRANSPORT_UDP
     ptl_info("initiator nid: %i pid: %i NI: %p\n", le32_to_cpu(hdr->h1.src_nid),
              le32_to_cpu(hdr->h1.src_pid), ni);
-    ptl_info("buffer handle: %i %i buf:%p\n", hdr->h1.handle,
-             le32_to_cpu(hdr->h1.handle), &buf);
 #endif
-    hdr->rlength = cpu_to_le64(length);
-    hdr->roffset = cpu_to_le64(buf->roffset);
 
 #if IS_PPE
     hdr->h1.physical = !!(ni->options & PTL_NI_PHYSICAL);
     if (ni->options & PTL_NI_PHYSICAL) {
         hdr->h1.src_nid = cpu_to_le32(ni->id.phys.nid);
         hdr->h1.src_pid = cpu_to_le32(ni->id.phys.pid);
-        hdr->h1.dst_nid = cpu_to_le32(buf->target.phys.nid);
-        hdr->h1.dst_pid = cpu_to_le32(buf->target.phys.pid);
+        hdr->h1.dst_nid = cpu_to_le32(target.phys.nid);
+        hdr->h1.dst_pid = cpu_to_le32(target.phys.pid);
         hdr->h1.hash = cpu_to_le32(ni->mem.hash);
     } else {
         hdr->h1.src_rank = cpu_to_le32(ni->id.rank);
-        hdr->h1.dst_rank = cpu_to_le32(buf->target.rank);
+        hdr->h1.dst_rank = cpu_to_le32(target.rank);
         hdr->h1.hash = cpu_to_le32(ni->mem.hash);
     }
 #endif
+}
+
+/**
+ * @brief initiator prepare request state.
+ *
+ * This state builds the request message
+ * header and optional data descriptors.
+ *
+ * @param[in] buf the request buf.
+ * @return next state.
+ */
+static int prepare_req(buf_t *buf)
+{
+    init_req_hdr(obj_to_ni(buf), (req_hdr_t *) buf->data, buf->target);
+
+    return STATE_INIT_PREP_DATA;
+}
+
+#if !IS_PPE
+/**
+ * @brief Check whether the ack of a request can be merged.
+ *
+ * The data must travel in the request, so the target never reads
+ * the MD, and the transport must be reliable.
+ *
+ * @param[in] buf the request buf.
+ *
+ * @return non zero if the ack can be merged.
+ */
+static int can_merge_ack(buf_t *buf)
+{
+    if (!buf->data_out || buf->data_out->data_fmt != DATA_FMT_IMMEDIATE ||
+        buf->num_mr)
+        return 0;
+
+#if WITH_TRANSPORT_UDP
+    if (buf->conn->transport.type == CONN_TYPE_UDP)
+        return 0;
+#endif
+
+    return 1;
+}
+#endif
+
+/**
+ * @brief initiator prepare data state.
+ *
+ * This state completes the request message header and
+ * builds the optional data descriptors. Prepared operations
+ * start here, with the rest of the header already built.
+ *
+ * @param[in] buf the request buf.
+ * @return next state.
+ */
+static int prepare_data(buf_t *buf)
+{
+    int err;
+    req_hdr_t *hdr = (req_hdr_t *) buf->data;
+    ptl_size_t length = buf->rlength;
+
+    hdr->h1.handle = cpu_to_le32(buf_to_handle(buf));
+#if WITH_TRANSPORT_UDP
+    ptl_info("buffer handle: %i %i buf:%p\n", hdr->h1.handle,
+             le32_to_cpu(hdr->h1.handle), &buf);
+#endif
+    hdr->rlength = cpu_to_le64(length);
+    hdr->roffset = cpu_to_le64(buf->roffset);
 
     buf->length = sizeof(req_hdr_t);
 
@@ -346,6 +420,31 @@ static int prepare_req(buf_t *buf)
         buf->event_mask |= XI_RECEIVE_EXPECTED;
     }
 
+#if !IS_PPE
+    /* Same thing when we are the target and copy straight out of the
+     * MD, which must not go away before we are done. */
+    if (buf->data_out && buf->data_out->data_fmt == DATA_FMT_SELF) {
+        hdr->ack_req = PTL_ACK_REQ;
+        buf->event_mask |= XI_RECEIVE_EXPECTED;
+    }
+#endif
+
+#if !IS_PPE
+    /* A CT ack only updates the counting event of the MD, so the
+     * target may merge it with others (see tgt_merge_ack()). The
+     * request does not wait for it then, but the MD is kept until
+     * the merged ack comes back. Acks that nobody counts are not
+     * delayed. */
+    hdr->ack_merge = 0;
+    if (get_param(PTL_ACK_MERGE) && hdr->ack_req == PTL_CT_ACK_REQ &&
+        (buf->event_mask & XI_CT_ACK_EVENT) && can_merge_ack(buf)) {
+        hdr->ack_merge = 1;
+        hdr->h1.handle = cpu_to_le32(md_to_handle(buf->put_md));
+        buf->event_mask &= ~(XI_RECEIVE_EXPECTED | XI_CT_ACK_EVENT);
+        md_get(buf->put_md);
+    }
+#endif
+
     /* For immediate data we can cause an early send event provided
      * we request a send completion event */
     if (buf->event_mask & (XI_SEND_EVENT | XI_CT_SEND_EVENT) &&
@@ -411,19 +510,30 @@ static int wait_conn(buf_t *buf)
 #if WITH_TRANSPORT_UDP
         ptl_info("SM: start waiting on %p %p\n", &conn->move_wait,
                  &conn->mutex);
-        atomic_inc(&conn->udp.is_waiting);
 #endif
 
 
 #if WITH_TRANSPORT_IB || WITH_TRANSPORT_UDP
 #if WITH_TRANSPORT_UDP
         if (buf->udp.i_am_prog_thread == 1){
+            /* The reply is processed by this very thread and takes
+             * the connection mutex. */
+            pthread_mutex_unlock(&conn->mutex);
             while (conn->state < CONN_STATE_CONNECTED)
                 progress_thread_udp(ni);
+            pthread_mutex_lock(&conn->mutex);
+        }
+        else if (ni->options & PTL_NI_APP_PROGRESS) {
+            /* Nobody else will process the reply. */
+            pthread_mutex_unlock(&conn->mutex);
+            while (conn->state < CONN_STATE_CONNECTED)
+                ni_progress(ni);
+            pthread_mutex_lock(&conn->mutex);
         }
         else{
 #endif
-            pthread_cond_wait(&conn->move_wait, &conn->mutex);
+            while (conn->state < CONN_STATE_CONNECTED)
+                pthread_cond_wait(&conn->move_wait, &conn->mutex);
 #if WITH_TRANSPORT_UDP
         }
 #endif
@@ -528,6 +638,11 @@ static int send_error(buf_t *buf)
 {
     /* Release the put MD. */
     if (buf->put_md) {
+#if !IS_PPE
+        /* No merged ack will come back for this request. */
+        if (((req_hdr_t *) buf->data)->ack_merge)
+            md_put(buf->put_md);
+#endif
         md_put(buf->put_md);
         buf->put_md = NULL;
     }
@@ -555,7 +670,8 @@ static int init_copy_in(buf_t *buf)
 
     ret =
         iov_copy_in(buf->transfer.noknem.data, buf->transfer.noknem.iovecs,
-                    NULL, buf->transfer.noknem.num_iovecs,
+                    buf->transfer.noknem.iov_end, NULL,
+                    buf->transfer.noknem.num_iovecs,
                     buf->transfer.noknem.offset, to_copy);
     if (ret == PTL_FAIL) {
         WARN();
@@ -593,7 +709,8 @@ static int init_copy_out(buf_t *buf)
 
     ret =
         iov_copy_out(buf->transfer.noknem.data, buf->transfer.noknem.iovecs,
-                     NULL, buf->transfer.noknem.num_iovecs,
+                     buf->transfer.noknem.iov_end, NULL,
+                     buf->transfer.noknem.num_iovecs,
                      buf->transfer.noknem.offset, to_copy);
     if (ret == PTL_FAIL) {
         WARN();
@@ -658,7 +775,7 @@ static int init_copy_in(buf_t *buf)
 	assert(to_copy <= buf->transfer.udp.length_left);
 
 	ret = iov_copy_in(buf->transfer.udp.data, buf->transfer.udp.iovecs,
-					  NULL,
+					  buf->transfer.udp.iov_end, NULL,
 					  buf->transfer.udp.num_iovecs,
 					  buf->transfer.udp.offset,
 					  to_copy);
@@ -697,7 +814,7 @@ static int init_copy_out(buf_t *buf)
 		to_copy = buf->transfer.udp.length_left;
 
 	ret = iov_copy_out(buf->transfer.udp.data, buf->transfer.udp.iovecs,
-					   NULL,
+					   buf->transfer.udp.iov_end, NULL,
 					   buf->transfer.udp.num_iovecs,
 					   buf->transfer.udp.offset,
 					   to_copy);
@@ -798,6 +915,13 @@ static int wait_comp(buf_t *buf)
  */
 static int early_send_event(buf_t *buf)
 {
+#if !IS_PPE
+    /* No merged ack will come back for this request. */
+    if (buf->ni_fail == PTL_NI_UNDELIVERABLE &&
+        ((req_hdr_t *) buf->data)->ack_merge)
+        md_put(buf->put_md);
+#endif
+
     /* Release the put MD before posting the SEND event. */
     md_put(buf->put_md);
     buf->put_md = NULL;
@@ -907,8 +1031,8 @@ static int data_in(buf_t *buf)
 
     if (md->num_iov) {
         err =
-            iov_copy_in(data, (ptl_iovec_t *)md->start, md->mr_list,
-                        md->num_iov, offset, length);
+            iov_copy_in(data, (ptl_iovec_t *)md->start, md->iov_end,
+                        md->mr_list, md->num_iov, offset, length);
         if (err)
             return STATE_INIT_ERROR;
     } else {
@@ -924,10 +1048,13 @@ static int data_in(buf_t *buf)
                 return STATE_INIT_ERROR;
         }
 
-        memcpy(addr_to_ppe(start, mr), data, length);
+        err = copy_to_app(start, mr, data, length);
 
         if (!md->ppe.mr_start)
             mr_put(mr);
+
+        if (err)
+            return STATE_INIT_ERROR;
 #else
         memcpy(start, data, length);
 #endif
@@ -1064,7 +1191,8 @@ static int reply_event(buf_t *buf)
                 int err;
                 err =
                     iov_copy_in(buf->recv_buf->transfer.udp.my_iovec.iov_base,
-                                buf->get_md->start, buf->get_md->mr_list,
+                                buf->get_md->start, buf->get_md->iov_end,
+                                buf->get_md->mr_list,
                                 buf->get_md->num_iov, buf->get_offset,
                                 buf->mlength);
                 buf->recv_buf->transfer.udp.num_iovecs = buf->get_md->num_iov;
@@ -1108,6 +1236,54 @@ static void error(buf_t *buf)
     /* TODO log the error */
 }
 
+#if !IS_PPE
+/**
+ * @brief Process a merged ack.
+ *
+ * Drops the MD references held for the requests the ack covers,
+ * then updates the counting event of the MD for all of them.
+ *
+ * @param[in] ni the NI.
+ * @param[in] buf the received ack.
+ *
+ * @return status
+ */
+int process_merged_ack(ni_t *ni, buf_t *buf)
+{
+    const merged_ack_hdr_t *hdr = (merged_ack_hdr_t *) buf->data;
+    unsigned int count = le32_to_cpu(hdr->count);
+    unsigned int failures = le32_to_cpu(hdr->failures);
+    ptl_size_t success = count - failures - le32_to_cpu(hdr->disabled);
+    unsigned int options;
+    ct_t *ct;
+    md_t *md;
+
+    md = to_md(MYNIGBL_ le32_to_cpu(hdr->h1.handle));
+    if (unlikely(!md)) {
+        WARN();
+        return PTL_FAIL;
+    }
+
+    ct = md->ct;
+    options = md->options;
+
+    /* Release the MD before posting the events, like ack_event()
+     * does. The lookup reference goes too. */
+    while (count--)
+        md_put(md);
+    md_put(md);
+
+    if (ct && (options & PTL_MD_EVENT_CT_ACK)) {
+        if (options & PTL_MD_EVENT_CT_BYTES)
+            success = le64_to_cpu(hdr->mlength);
+
+        make_ct_merged_event(ct, success, failures);
+    }
+
+    return PTL_OK;
+}
+#endif
+
 /**
  * @brief initiator cleanup state.
  *
@@ -1171,7 +1347,7 @@ static void cleanup(buf_t *buf)
  * in the start state. It may exit the state machine for
  * one of the wait states (wait_conn, wait_comp, wait_recv)
  * and be reentered when the event occurs. The state
- * machine is protected by buf->mutex so only one thread at
+ * machine is protected by buf->lock so only one thread at
  * a time can work on a given message. It can be executed
  * on an application thread, the IB connection thread or
  * a progress thread. The state machine drops the reference
@@ -1189,7 +1365,7 @@ int process_init(buf_t *buf)
     int err = PTL_OK;
     enum init_state state;
 
-    pthread_mutex_lock(&buf->mutex);
+    PTL_YIELDLOCK_LOCK(&buf->lock);
 
     state = buf->init_state;
 
@@ -1204,6 +1380,9 @@ int process_init(buf_t *buf)
             case STATE_INIT_PREP_REQ:
                 state = prepare_req(buf);
                 break;
+            case STATE_INIT_PREP_DATA:
+                state = prepare_data(buf);
+                break;
             case STATE_INIT_WAIT_CONN:
                 state = wait_conn(buf);
                 if (state == STATE_INIT_WAIT_CONN)
@@ -1266,19 +1445,20 @@ int process_init(buf_t *buf)
             case STATE_INIT_CLEANUP:
 #if WITH_TRANSPORT_UDP
                 if (buf->conn->transport.type == CONN_TYPE_UDP) {
-                    pthread_mutex_unlock(&buf->mutex);
+                    PTL_YIELDLOCK_UNLOCK(&buf->lock);
                     ni_t *ni;
                     ni = obj_to_ni(buf);
                     while (atomic_read(&ni->udp.self_recv) > 0) {
-                        sched_yield();
+                        if (!ni_progress(ni))
+                            sched_yield();
                         SPINLOCK_BODY();
                     }
-                    pthread_mutex_lock(&buf->mutex);
+                    PTL_YIELDLOCK_LOCK(&buf->lock);
                 }
 #endif
                 cleanup(buf);
                 buf->init_state = STATE_INIT_DONE;
-                pthread_mutex_unlock(&buf->mutex);
+                PTL_YIELDLOCK_UNLOCK(&buf->lock);
                 buf_put(buf);
                 return err;
             case STATE_INIT_DONE:
@@ -1302,6 +1482,6 @@ int process_init(buf_t *buf)
      * to wait for an external event such as an IB send completion. */
     ptl_info("exiting process init with pending task\n");
     buf->init_state = state;
-    pthread_mutex_unlock(&buf->mutex);
+    PTL_YIELDLOCK_UNLOCK(&buf->lock);
     return err;
 }
@@ -6,6 +6,57 @@
 
 #include "ptl_loc.h"
 
+/**
+ * Find the iovec element that contains an offset.
+ *
+ * The MDs and LE/MEs keep the end offset of each of their iovec
+ * elements, so the element is found with a binary search. The other
+ * iovecs are walked.
+ *
+ * @param[in] iov address of iovec array
+ * @param[in] iov_end end offset of each iovec element, or NULL
+ * @param[in] num_iov number of entries in iovec array
+ * @param[in,out] offset_p offset into iovec, returned as the offset
+ * into the element found
+ *
+ * @return index of the first element ending after the offset, or
+ * num_iov if the offset is past the end of the iovec
+ */
+ptl_size_t iov_find(const ptl_iovec_t *iov, const ptl_size_t *iov_end,
+                    ptl_size_t num_iov, ptl_size_t *offset_p)
+{
+    ptl_size_t offset = *offset_p;
+    ptl_size_t lo;
+    ptl_size_t hi;
+    ptl_size_t mid;
+
+    if (!iov_end) {
+        for (lo = 0; lo < num_iov; lo++) {
+            if (offset < iov[lo].iov_len)
+                break;
+            offset -= iov[lo].iov_len;
+        }
+
+        *offset_p = offset;
+        return lo;
+    }
+
+    lo = 0;
+    hi = num_iov;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (iov_end[mid] > offset)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+
+    if (lo)
+        *offset_p = offset - iov_end[lo - 1];
+
+    return lo;
+}
+
 /**
  * Copy data from an iovec to linear buffer.
  *
@@ -13,29 +64,29 @@
  *
  * @param[in] dst address of destination buffer
  * @param[in] iov address of iovec array
+ * @param[in] iov_end end offset of each iovec element, or NULL
  * @param[in] num_iov number of entries in iovec array
  * @param[in] offset offset into iovec
  * @param[in] length number of bytes to copy
  *
  * @return status
  */
-int iov_copy_out(void *dst, ptl_iovec_t *iov, mr_t **mr_list,
-                 ptl_size_t num_iov, ptl_size_t offset, ptl_size_t length)
+int iov_copy_out(void *dst, ptl_iovec_t *iov, const ptl_size_t *iov_end,
+                 mr_t **mr_list, ptl_size_t num_iov, ptl_size_t offset,
+                 ptl_size_t length)
 {
-    unsigned int i;
+    ptl_size_t i;
     ptl_size_t dst_offset = 0;
     ptl_size_t bytes;
+    int err;
 
     /* Find starting point in iovec from offset. i is the index of the first iovec. */
-    for (i = 0; i < num_iov; i++, iov++) {
-        if (offset > iov->iov_len)
-            offset -= iov->iov_len;
-        else
-            break;
-    }
+    i = iov_find(iov, iov_end, num_iov, &offset);
+    iov += i;
 
-    /* check if we ran off the end of the iovec before we started */
-    if (i >= num_iov) {
+    /* check if we ran off the end of the iovec before we started. An
+     * empty copy can start at the very end. */
+    if (i >= num_iov && (offset || !num_iov)) {
         WARN();
         return PTL_FAIL;
     }
@@ -47,8 +98,12 @@ int iov_copy_out(void *dst, ptl_iovec_t *iov, mr_t **mr_list,
         if (bytes > length)
             bytes = length;
 
-        memcpy(dst + dst_offset,
-               addr_to_ppe(iov->iov_base + offset, mr_list[i]), bytes);
+        err = copy_from_app(dst + dst_offset, iov->iov_base + offset,
+                            mr_list[i], bytes);
+        if (err) {
+            WARN();
+            return err;
+        }
 
         offset = 0;
         length -= bytes;
@@ -71,25 +126,24 @@ int iov_copy_out(void *dst, ptl_iovec_t *iov, mr_t **mr_list,
  *
  * @param[in] src address of source buffer
  * @param[in] iov address of iovec array
+ * @param[in] iov_end end offset of each iovec element, or NULL
  * @param[in] num_iov number of entries in iovec array
  * @param[in] offset offset into iovec
  * @param[in] length number of bytes to copy
  *
  * @return status
  */
-int iov_copy_in(void *src, ptl_iovec_t *iov, mr_t **mr_list,
-                ptl_size_t num_iov, ptl_size_t offset, ptl_size_t length)
+int iov_copy_in(void *src, ptl_iovec_t *iov, const ptl_size_t *iov_end,
+                mr_t **mr_list, ptl_size_t num_iov, ptl_size_t offset,
+                ptl_size_t length)
 {
-    unsigned int i;
+    ptl_size_t i;
     ptl_size_t src_offset = 0;
     ptl_size_t bytes;
+    int err;
 
-    for (i = 0; i < num_iov; i++, iov++) {
-        if (offset >= iov->iov_len)
-            offset -= iov->iov_len;
-        else
-            break;
-    }
+    i = iov_find(iov, iov_end, num_iov, &offset);
+    iov += i;
 
     if (i >= num_iov) {
         WARN();
@@ -102,8 +156,12 @@ int iov_copy_in(void *src, ptl_iovec_t *iov, mr_t **mr_list,
         if (bytes > length)
             bytes = length;
 
-        memcpy(addr_to_ppe(iov->iov_base + offset, mr_list[i]),
-               src + src_offset, bytes);
+        err = copy_to_app(iov->iov_base + offset, mr_list[i],
+                          src + src_offset, bytes);
+        if (err) {
+            WARN();
+            return err;
+        }
 
         offset = 0;
         length -= bytes;
@@ -127,6 +185,7 @@ int iov_copy_in(void *src, ptl_iovec_t *iov, mr_t **mr_list,
  * @param[in] atom_size the size of each atomic operand
  * @param[in] src address of source buffer
  * @param[in] iov address of iovec array
+ * @param[in] iov_end end offset of each iovec element, or NULL
  * @param[in] num_iov number of entries in iovec array
  * @param[in] offset offset into iovec
  * @param[in] length number of bytes to copy
@@ -134,23 +193,19 @@ int iov_copy_in(void *src, ptl_iovec_t *iov, mr_t **mr_list,
  * @return status
  */
 int iov_atomic_in(atom_op_t op, int atom_size, void *src, ptl_iovec_t *iov,
-                  mr_t **mr_list, ptl_size_t num_iov, ptl_size_t offset,
-                  ptl_size_t length)
+                  const ptl_size_t *iov_end, mr_t **mr_list,
+                  ptl_size_t num_iov, ptl_size_t offset, ptl_size_t length)
 {
     ptl_size_t i;
-    ptl_size_t iov_offset = 0;
+    ptl_size_t iov_offset = offset;
     ptl_size_t src_offset = 0;
-    ptl_size_t dst_offset = 0;
     ptl_size_t bytes;
+    int err;
 
-    for (i = 0; i < num_iov && dst_offset < offset; i++, iov++) {
-        iov_offset = offset - dst_offset;
-        if (iov_offset > iov->iov_len)
-            iov_offset = iov->iov_len;
-        dst_offset += iov_offset;
-    }
+    i = iov_find(iov, iov_end, num_iov, &iov_offset);
+    iov += i;
 
-    if (dst_offset < offset) {
+    if (i >= num_iov && iov_offset) {
         WARN();
         return PTL_FAIL;
     }
@@ -190,8 +245,12 @@ int iov_atomic_in(atom_op_t op, int atom_size, void *src, ptl_iovec_t *iov,
         if (src_offset + bytes > length)
             bytes = length - src_offset;
 
-        op(addr_to_ppe(iov->iov_base + iov_offset, mr_list[i]),
-           src + src_offset, bytes);
+        err = atomic_to_app(op, iov->iov_base + iov_offset, mr_list[i],
+                            src + src_offset, bytes);
+        if (err) {
+            WARN();
+            return err;
+        }
 
         iov_offset = 0;
         src_offset += bytes;
@@ -217,6 +276,7 @@ int iov_atomic_in(atom_op_t op, int atom_size, void *src, ptl_iovec_t *iov,
  * will not fit into the data segment.
  *
  * @param[in] iov the iovec list
+ * @param[in] iov_end end offset of each iovec element, or NULL
  * @param[in] num_iov the number of entries in the iovec list
  * @param[in] offset the offset of the data region into the data segment
  * @param[in] length the length of the data region
@@ -226,30 +286,21 @@ int iov_atomic_in(atom_op_t op, int atom_size, void *src, ptl_iovec_t *iov,
  * @return number of iovec elements on success
  * @return -1 on failure
  */
-int iov_count_elem(ptl_iovec_t *iov, ptl_size_t num_iov, ptl_size_t offset,
-                   ptl_size_t length, ptl_size_t *index_p, ptl_size_t *base_p)
+int iov_count_elem(ptl_iovec_t *iov, const ptl_size_t *iov_end,
+                   ptl_size_t num_iov, ptl_size_t offset, ptl_size_t length,
+                   ptl_size_t *index_p, ptl_size_t *base_p)
 {
     ptl_size_t index_start;
     ptl_size_t index_stop;
     ptl_size_t iov_len;
+    ptl_size_t end;
+    ptl_size_t hi;
+    ptl_size_t mid;
 
     /* find the index of the iovec element and its starting
      * offset that contains the start of the data region */
-    for (index_start = 0; index_start < num_iov; index_start++) {
-        iov_len = iov->iov_len;
-
-        if (offset < iov_len) {
-            /* Adjust total length so we start at the beggining of
-             * that iovec buffer. */
-            length += offset;
-
-            *base_p = offset;
-            break;
-        }
-
-        offset -= iov_len;
-        iov++;
-    }
+    end = offset + length;
+    index_start = iov_find(iov, iov_end, num_iov, &offset);
 
     /* Check out of range. */
     if (unlikely(index_start == num_iov)) {
@@ -257,16 +308,35 @@ int iov_count_elem(ptl_iovec_t *iov, ptl_size_t num_iov, ptl_size_t offset,
         return -1;
     }
 
+    *base_p = offset;
+
     /* find the index of the iovec element that contains the
      * end of the data region */
-    for (index_stop = index_start; index_stop < num_iov; index_stop++) {
-        iov_len = iov->iov_len;
+    if (iov_end) {
+        index_stop = index_start;
+        hi = num_iov;
+        while (index_stop < hi) {
+            mid = index_stop + (hi - index_stop) / 2;
+            if (iov_end[mid] >= end)
+                hi = mid;
+            else
+                index_stop = mid + 1;
+        }
+    } else {
+        /* Adjust total length so we start at the beggining of
+         * that iovec buffer. */
+        length += offset;
+        iov += index_start;
 
-        if (length <= iov_len)
-            break;
+        for (index_stop = index_start; index_stop < num_iov; index_stop++) {
+            iov_len = iov->iov_len;
 
-        length -= iov_len;
-        iov++;
+            if (length <= iov_len)
+                break;
+
+            length -= iov_len;
+            iov++;
+        }
     }
 
     /* Check out of range. */
@@ -59,6 +59,7 @@ void le_cleanup(void *arg)
 
         free(le->mr_list);
         le->mr_list = NULL;
+        le->iov_end = NULL;
     }
 
     (void)__sync_fetch_and_sub(&ni->current.max_entries, 1);
@@ -184,7 +185,12 @@ int le_get_mr(ni_t *restrict ni, const ptl_le_t *le_init, le_t *le)
 
     if (le_init->options & PTL_IOVEC) {
 
-#if IS_PPE
+#if IS_PPE && !USE_XPMEM
+        if (mr_snapshot_app
+            (ni, le_init->start, le_init->length * sizeof(ptl_iovec_t),
+             &le->mr_start) != PTL_OK)
+            return PTL_ARG_INVALID;
+#elif IS_PPE
         if (!mr_lookup_app
             (ni, le_init->start, le_init->length * sizeof(ptl_iovec_t),
              &le->mr_start) == PTL_OK)
@@ -194,10 +200,14 @@ int le_get_mr(ni_t *restrict ni, const ptl_le_t *le_init, le_t *le)
         le->num_iov = le_init->length;
         le->length = 0;
 
-        le->mr_list = calloc(le->num_iov, sizeof(mr_t *));
+        /* The end offset of each iovec follows the mrs. */
+        le->mr_list =
+            calloc(le->num_iov, sizeof(mr_t *) + sizeof(ptl_size_t));
         if (!le->mr_list)
             return PTL_NO_SPACE;
 
+        le->iov_end = (ptl_size_t *)&le->mr_list[le->num_iov];
+
         iov = (ptl_iovec_t *)addr_to_ppe(le_init->start, le->mr_start);
 
         for (i = 0; i < le->num_iov; i++) {
@@ -207,6 +217,7 @@ int le_get_mr(ni_t *restrict ni, const ptl_le_t *le_init, le_t *le)
             if (le->mr_list[i]->readonly)
                 return PTL_ARG_INVALID;
             le->length += iov->iov_len;
+            le->iov_end[i] = le->length;
             iov++;
         }
     } else {
@@ -312,12 +323,23 @@ static void flush_from_unexpected_list(le_t *le,
         int err;
         int state;
 
-        pthread_mutex_lock(&buf->mutex);
+        PTL_YIELDLOCK_LOCK(&buf->lock);
 
         /* It is possible that there is a still a transfer occurring
          * on this buffer. So wait for it to finish. */
-        if (buf->unexpected_busy)
-            pthread_cond_wait(&buf->cond, &buf->mutex);
+        if (buf->unexpected_busy) {
+            ni_t *ni = obj_to_ni(buf);
+
+            PTL_YIELDLOCK_UNLOCK(&buf->lock);
+
+            pthread_mutex_lock(&ni->unexpected_mutex);
+            while (buf->unexpected_busy)
+                pthread_cond_wait(&ni->unexpected_cond,
+                                  &ni->unexpected_mutex);
+            pthread_mutex_unlock(&ni->unexpected_mutex);
+
+            PTL_YIELDLOCK_LOCK(&buf->lock);
+        }
         assert(buf->unexpected_busy == 0);
 
         assert(buf->matching.le == NULL);
@@ -333,7 +355,7 @@ static void flush_from_unexpected_list(le_t *le,
 
         state = buf->tgt_state;
 
-        pthread_mutex_unlock(&buf->mutex);
+        PTL_YIELDLOCK_UNLOCK(&buf->lock);
 
         if (state == STATE_TGT_WAIT_APPEND) {
             err = process_tgt(buf);
@@ -775,6 +797,7 @@ int _PtlLEUnlink(PPEGBL ptl_handle_le_t le_handle)
     }
 
     while (atomic_read(&le->busy) == 1) {
+        ni_progress(obj_to_ni(le));
         SPINLOCK_BODY();
     }
 
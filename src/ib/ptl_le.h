@@ -41,6 +41,7 @@ enum list_element_type {
 	void			*start;		\
 	mr_t		    *mr_start;	\
 	mr_t			**mr_list;	\
+	ptl_size_t		*iov_end;	\
 	ptl_size_t		length;		\
 	ptl_pt_index_t		pt_index;	\
 	ptl_list_t		ptl_list;	\
@@ -11,6 +11,14 @@
 #include "ptl_loc.h"
 
 #include <sys/un.h>
+#if !USE_XPMEM
+/* <sys/prctl.h> brings the kernel types, which clash with
+ * ptl_byteorder.h. */
+#include <sys/syscall.h>
+#ifndef PR_SET_PTRACER
+#define PR_SET_PTRACER 0x59616d61
+#endif
+#endif
 
 /*
  * per process global state
@@ -50,6 +58,21 @@ static struct {
 
     /* XPMEM segid for that whole process. */
     xpmem_segid_t segid;
+
+    /* The comm pad, as given by the PPE. */
+    struct xpmem_map comm_pad_mapping;
+
+    /* Held from the allocation of an EQ or a CT to the mapping of its
+     * segment, for the memfds to be received in order. */
+    pthread_mutex_t map_mutex;
+
+    /* Whether data movement operations wait for the PPE. */
+    int async;
+
+    /* Command ring to the PPE, if the PPE had one left, for the
+     * operations that don't wait. Threads take turns to fill it. */
+    struct ppe_ring *ring;
+    PTL_FASTLOCK_TYPE ring_lock;
 } ppe;
 
 /**
@@ -99,6 +122,7 @@ static inline void ppebuf_release(ppebuf_t *buf)
                          ppe.ppebufs_addr, ppe.ppebufs_ppeaddr);
 }
 
+#if USE_XPMEM
 /* Attach to an XPMEM segment. */
 static void *map_segment(struct xpmem_map *mapping)
 {
@@ -145,6 +169,41 @@ static inline void fill_mapping_info(const void *addr_in, size_t length,
     mapping->size = length;
     mapping->segid = ppe.segid;
 }
+#else
+/* Map the memfd the PPE sent for a segment. */
+static void *map_segment(struct xpmem_map *mapping)
+{
+    int fd;
+
+    fd = ppe_recv_fd(ppe.s);
+    if (fd == -1) {
+        WARN();
+        return NULL;
+    }
+
+    mapping->ptr_attach =
+        mmap(NULL, mapping->offset + mapping->size, PROT_READ | PROT_WRITE,
+             MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping->ptr_attach == MAP_FAILED) {
+        WARN();
+        mapping->ptr_attach = NULL;
+        return NULL;
+    }
+
+    return mapping->ptr_attach + mapping->offset;
+}
+
+/* Unmap a segment. */
+static void unmap_segment(struct xpmem_map *mapping)
+{
+    if (mapping->ptr_attach &&
+        munmap(mapping->ptr_attach, mapping->offset + mapping->size) != 0)
+        WARN();
+
+    mapping->ptr_attach = NULL;
+}
+#endif
 
 /**
  * @brief Cleanup shared memory resources.
@@ -153,14 +212,21 @@ static inline void fill_mapping_info(const void *addr_in, size_t length,
  */
 static void release_ppe_resources(void)
 {
+#if USE_XPMEM
     if (ppe.segid != -1)
         xpmem_remove(ppe.segid);
+#endif
 
     if (ppe.s != -1)
         close(ppe.s);
 
-    if (ppe.ppebufs_addr)
-        unmap_segment(ppe.ppebufs_addr);
+    if (ppe.ppe_comm_pad) {
+        unmap_segment(&ppe.comm_pad_mapping);
+        ppe.ppe_comm_pad = NULL;
+        ppe.ppebufs_addr = NULL;
+    }
+
+    ppe.ring = NULL;
 }
 
 /* Establish the link with the PPE. */
@@ -175,6 +241,7 @@ static int connect_to_ppe(void)
     struct sockaddr_un ppe_sock_addr;
     size_t len;
 
+#if USE_XPMEM
     /* XPMEM the whole memory of that process. */
     ppe.segid =
         xpmem_make(0, 0xffffffffffffffffUL, XPMEM_PERMIT_MODE, (void *)0600);
@@ -182,6 +249,11 @@ static int connect_to_ppe(void)
         fprintf(stderr, "a\n");
         goto exit_fail;
     }
+#else
+    /* The PPE accesses the memory of that process with
+     * process_vm_readv/writev instead. */
+    ppe.segid = -1;
+#endif
 
     /* Connect to the PPE. */
     if ((ppe.s = socket(AF_UNIX, SOCK_STREAM, 0)) == -1) {
@@ -219,6 +291,20 @@ static int connect_to_ppe(void)
         WARN();
         goto exit_fail;
     }
+
+#if !USE_XPMEM
+    {
+        struct ucred cred;
+        socklen_t cred_len = sizeof(cred);
+
+        /* Let the PPE access this process even when ptrace is
+         * restricted to descendants. It's fine if that fails, since
+         * the PPE may be allowed anyway. */
+        if (getsockopt(ppe.s, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len)
+            == 0)
+            syscall(SYS_prctl, PR_SET_PTRACER, cred.pid, 0, 0, 0);
+    }
+#endif
 #else
 
     /* For Kitten, we already have all the info we need to talk to the PPE in our
@@ -282,9 +368,17 @@ static int connect_to_ppe(void)
         goto exit_fail;
     }
 
+    /* And the command ring, if any */
+    if ((p = getenv("PPE_RING_INDEX")) != NULL) {
+        msg.rep.ring_index = strtol(p, NULL, 0);
+    } else {
+        msg.rep.ring_index = -1;
+    }
+
 #endif
 
-    ppe.ppe_comm_pad = map_segment(&msg.rep.ppebufs_mapping);
+    ppe.comm_pad_mapping = msg.rep.ppebufs_mapping;
+    ppe.ppe_comm_pad = map_segment(&ppe.comm_pad_mapping);
     if (ppe.ppe_comm_pad == NULL) {
         WARN();
         goto exit_fail;
@@ -297,6 +391,14 @@ static int connect_to_ppe(void)
     ppe.ppebufs_offset = ppe.ppebufs_addr - ppe.ppebufs_ppeaddr;
     ppe.queue = &ppe.ppe_comm_pad->q[msg.rep.queue_index].queue;
 
+    if (msg.rep.ring_index >= 0 &&
+        msg.rep.ring_index < ppe.ppe_comm_pad->num_rings) {
+        ppe.ring = (void *)ppe.ppe_comm_pad +
+            ppe.ppe_comm_pad->rings_offset +
+            msg.rep.ring_index * sizeof(struct ppe_ring);
+        PTL_FASTLOCK_INIT(&ppe.ring_lock);
+    }
+
     /* This client can now communicate through regular messages with the PPE. */
     return PTL_OK;
 
@@ -314,6 +416,7 @@ static void transfer_msg(ppebuf_t *buf)
      * parameter. */
     buf->obj.next = NULL;
     buf->completed = 0;
+    buf->async = 0;
     buf->cookie = ppe.cookie;
 
     enqueue((void *)(uintptr_t) ppe.ppebufs_offset, ppe.queue, (obj_t *)buf);
@@ -323,6 +426,75 @@ static void transfer_msg(ppebuf_t *buf)
         SPINLOCK_BODY();
 }
 
+/* Get a buffer for an operation that may not wait for the PPE. With a
+ * command ring, it is the next free slot, and the ring stays locked
+ * until submit_msg(). */
+static inline int cmd_alloc(ppebuf_t **buf_p)
+{
+    struct ppe_ring *ring = ppe.ring;
+
+    if (!ppe.async || !ring)
+        return ppebuf_alloc(buf_p);
+
+    PTL_FASTLOCK_LOCK(&ppe.ring_lock);
+
+    /* Wait for the PPE to give slots back. */
+    while (ring->head - ring->tail >= PPE_RING_SIZE)
+        SPINLOCK_BODY();
+
+    *buf_p = &ring->slot[ring->head & (PPE_RING_SIZE - 1)];
+
+    return PTL_OK;
+}
+
+/* Transfer a message to the PPE without waiting for the reply. The
+ * PPE releases the buffer, and reports an error on the MD. */
+static void submit_msg(ppebuf_t *buf)
+{
+    struct ppe_ring *ring = ppe.ring;
+
+    if (ring) {
+        /* The command must be visible before the new head. */
+        __sync_synchronize();
+        ring->head++;
+
+        PTL_FASTLOCK_UNLOCK(&ppe.ring_lock);
+        return;
+    }
+
+    buf->obj.next = NULL;
+    buf->async = 1;
+    buf->cookie = ppe.cookie;
+
+    enqueue((void *)(uintptr_t) ppe.ppebufs_offset, ppe.queue, (obj_t *)buf);
+}
+
+#ifndef NO_ARG_VALIDATION
+/* Check what can be checked without the PPE, since an operation
+ * submitted asynchronously has no return code for the errors found
+ * there. */
+static inline int check_md_handle(ptl_handle_md_t md_handle)
+{
+    if (!ppe.ppe_comm_pad)
+        return PTL_NO_INIT;
+
+    if (md_handle == PTL_INVALID_HANDLE ||
+        (md_handle >> HANDLE_SHIFT) != POOL_MD)
+        return PTL_ARG_INVALID;
+
+    return PTL_OK;
+}
+
+static inline int check_atomic_args(ptl_op_t operation,
+                                    ptl_datatype_t datatype)
+{
+    if (operation >= PTL_OP_LAST || datatype >= PTL_DATATYPE_LAST)
+        return PTL_ARG_INVALID;
+
+    return PTL_OK;
+}
+#endif
+
 int PtlInit(void)
 {
     int ret;
@@ -347,6 +519,9 @@ int PtlInit(void)
             goto err1;
         }
 
+        ppe.async = get_param(PTL_PPE_ASYNC);
+        pthread_mutex_init(&ppe.map_mutex, NULL);
+
         ret = connect_to_ppe();
         if (ret != PTL_OK) {
             goto err1;
@@ -611,6 +786,32 @@ int PtlGetMap(ptl_handle_ni_t ni_handle, ptl_size_t map_size,
     return err;
 }
 
+int PtlNIConnect(ptl_handle_ni_t ni_handle, ptl_size_t num_targets,
+                 const ptl_process_t *targets)
+{
+    ppebuf_t *buf;
+    int err;
+
+    if ((err = ppebuf_alloc(&buf))) {
+        WARN();
+        return err;
+    }
+
+    buf->op = OP_PtlNIConnect;
+
+    buf->msg.PtlNIConnect.ni_handle = ni_handle;
+    buf->msg.PtlNIConnect.num_targets = num_targets;
+    buf->msg.PtlNIConnect.targets = targets;
+
+    transfer_msg(buf);
+
+    err = buf->msg.ret;
+
+    ppebuf_release(buf);
+
+    return err;
+}
+
 int PtlPTAlloc(ptl_handle_ni_t ni_handle, unsigned int options,
                ptl_handle_eq_t eq_handle, ptl_pt_index_t pt_index_req,
                ptl_pt_index_t *pt_index)
@@ -1045,6 +1246,8 @@ int PtlCTAlloc(ptl_handle_ni_t ni_handle, ptl_handle_ct_t *ct_handle)
 
     buf->msg.PtlCTAlloc.ni_handle = ni_handle;
 
+    pthread_mutex_lock(&ppe.map_mutex);
+
     transfer_msg(buf);
 
     err = buf->msg.ret;
@@ -1058,6 +1261,11 @@ int PtlCTAlloc(ptl_handle_ni_t ni_handle, ptl_handle_ct_t *ct_handle)
             // call ctfree
             abort();
         }
+    }
+
+    pthread_mutex_unlock(&ppe.map_mutex);
+
+    if (err == PTL_OK) {
 
         *ct_handle = buf->msg.PtlCTAlloc.ct_handle;
 
@@ -1160,7 +1368,7 @@ int PtlCTWait(ptl_handle_ct_t ct_handle, ptl_size_t test,
 
     ct = get_light_ct(ct_handle);
     if (ct)
-        err = PtlCTWait_work(ct->info, test, event);
+        err = PtlCTWait_work(NULL, ct->info, test, event);
     else
         err = PTL_ARG_INVALID;
 
@@ -1200,7 +1408,7 @@ int PtlCTPoll(const ptl_handle_ct_t *ct_handles, const ptl_size_t *tests,
         cts_info[i] = ct->info;
     }
 
-    err = PtlCTPoll_work(cts_info, tests, size, timeout, event, which);
+    err = PtlCTPoll_work(NULL, cts_info, tests, size, timeout, event, which);
 
   done:
     if (cts_info)
@@ -1266,7 +1474,16 @@ int PtlPut(ptl_handle_md_t md_handle, ptl_size_t local_offset,
     ppebuf_t *buf;
     int err;
 
-    if ((err = ppebuf_alloc(&buf))) {
+#ifndef NO_ARG_VALIDATION
+    err = check_md_handle(md_handle);
+    if (err)
+        return err;
+
+    if (ack_req > PTL_OC_ACK_REQ)
+        return PTL_ARG_INVALID;
+#endif
+
+    if ((err = cmd_alloc(&buf))) {
         WARN();
         return err;
     }
@@ -1284,6 +1501,11 @@ int PtlPut(ptl_handle_md_t md_handle, ptl_size_t local_offset,
     buf->msg.PtlPut.user_ptr = user_ptr;
     buf->msg.PtlPut.hdr_data = hdr_data;
 
+    if (ppe.async) {
+        submit_msg(buf);
+        return PTL_OK;
+    }
+
     transfer_msg(buf);
 
     err = buf->msg.ret;
@@ -1301,7 +1523,13 @@ int PtlGet(ptl_handle_md_t md_handle, ptl_size_t local_offset,
     ppebuf_t *buf;
     int err;
 
-    if ((err = ppebuf_alloc(&buf))) {
+#ifndef NO_ARG_VALIDATION
+    err = check_md_handle(md_handle);
+    if (err)
+        return err;
+#endif
+
+    if ((err = cmd_alloc(&buf))) {
         WARN();
         return err;
     }
@@ -1317,6 +1545,11 @@ int PtlGet(ptl_handle_md_t md_handle, ptl_size_t local_offset,
     buf->msg.PtlGet.remote_offset = remote_offset;
     buf->msg.PtlGet.user_ptr = user_ptr;
 
+    if (ppe.async) {
+        submit_msg(buf);
+        return PTL_OK;
+    }
+
     transfer_msg(buf);
 
     err = buf->msg.ret;
@@ -1336,7 +1569,20 @@ int PtlAtomic(ptl_handle_md_t md_handle, ptl_size_t local_offset,
     ppebuf_t *buf;
     int err;
 
-    if ((err = ppebuf_alloc(&buf))) {
+#ifndef NO_ARG_VALIDATION
+    err = check_md_handle(md_handle);
+    if (err)
+        return err;
+
+    if (ack_req > PTL_OC_ACK_REQ)
+        return PTL_ARG_INVALID;
+
+    err = check_atomic_args(operation, datatype);
+    if (err)
+        return err;
+#endif
+
+    if ((err = cmd_alloc(&buf))) {
         WARN();
         return err;
     }
@@ -1356,6 +1602,11 @@ int PtlAtomic(ptl_handle_md_t md_handle, ptl_size_t local_offset,
     buf->msg.PtlAtomic.operation = operation;
     buf->msg.PtlAtomic.datatype = datatype;
 
+    if (ppe.async) {
+        submit_msg(buf);
+        return PTL_OK;
+    }
+
     transfer_msg(buf);
 
     err = buf->msg.ret;
@@ -1376,7 +1627,21 @@ int PtlFetchAtomic(ptl_handle_md_t get_md_handle, ptl_size_t local_get_offset,
     ppebuf_t *buf;
     int err;
 
-    if ((err = ppebuf_alloc(&buf))) {
+#ifndef NO_ARG_VALIDATION
+    err = check_md_handle(get_md_handle);
+    if (err)
+        return err;
+
+    err = check_md_handle(put_md_handle);
+    if (err)
+        return err;
+
+    err = check_atomic_args(operation, datatype);
+    if (err)
+        return err;
+#endif
+
+    if ((err = cmd_alloc(&buf))) {
         WARN();
         return err;
     }
@@ -1397,6 +1662,11 @@ int PtlFetchAtomic(ptl_handle_md_t get_md_handle, ptl_size_t local_get_offset,
     buf->msg.PtlFetchAtomic.operation = operation;
     buf->msg.PtlFetchAtomic.datatype = datatype;
 
+    if (ppe.async) {
+        submit_msg(buf);
+        return PTL_OK;
+    }
+
     transfer_msg(buf);
 
     err = buf->msg.ret;
@@ -1468,6 +1738,125 @@ int PtlAtomicSync(void)
     return err;
 }
 
+int PtlPutPrepare(ptl_handle_md_t md_handle, ptl_ack_req_t ack_req,
+                  ptl_process_t target_id, ptl_pt_index_t pt_index,
+                  ptl_match_bits_t match_bits, void *user_ptr,
+                  ptl_handle_prep_t *prep_handle)
+{
+    ppebuf_t *buf;
+    int err;
+
+    if ((err = ppebuf_alloc(&buf))) {
+        WARN();
+        return err;
+    }
+
+    buf->op = OP_PtlPutPrepare;
+
+    buf->msg.PtlPutPrepare.md_handle = md_handle;
+    buf->msg.PtlPutPrepare.ack_req = ack_req;
+    buf->msg.PtlPutPrepare.target_id = target_id;
+    buf->msg.PtlPutPrepare.pt_index = pt_index;
+    buf->msg.PtlPutPrepare.match_bits = match_bits;
+    buf->msg.PtlPutPrepare.user_ptr = user_ptr;
+
+    transfer_msg(buf);
+
+    err = buf->msg.ret;
+    *prep_handle = buf->msg.PtlPutPrepare.prep_handle;
+
+    ppebuf_release(buf);
+
+    return err;
+}
+
+int PtlAtomicPrepare(ptl_handle_md_t md_handle, ptl_ack_req_t ack_req,
+                     ptl_process_t target_id, ptl_pt_index_t pt_index,
+                     ptl_match_bits_t match_bits, void *user_ptr,
+                     ptl_op_t operation, ptl_datatype_t datatype,
+                     ptl_handle_prep_t *prep_handle)
+{
+    ppebuf_t *buf;
+    int err;
+
+    if ((err = ppebuf_alloc(&buf))) {
+        WARN();
+        return err;
+    }
+
+    buf->op = OP_PtlAtomicPrepare;
+
+    buf->msg.PtlAtomicPrepare.md_handle = md_handle;
+    buf->msg.PtlAtomicPrepare.ack_req = ack_req;
+    buf->msg.PtlAtomicPrepare.target_id = target_id;
+    buf->msg.PtlAtomicPrepare.pt_index = pt_index;
+    buf->msg.PtlAtomicPrepare.match_bits = match_bits;
+    buf->msg.PtlAtomicPrepare.user_ptr = user_ptr;
+    buf->msg.PtlAtomicPrepare.operation = operation;
+    buf->msg.PtlAtomicPrepare.datatype = datatype;
+
+    transfer_msg(buf);
+
+    err = buf->msg.ret;
+    *prep_handle = buf->msg.PtlAtomicPrepare.prep_handle;
+
+    ppebuf_release(buf);
+
+    return err;
+}
+
+int PtlPreparedIssue(ptl_handle_prep_t prep_handle, ptl_size_t local_offset,
+                     ptl_size_t length, ptl_size_t remote_offset,
+                     ptl_hdr_data_t hdr_data)
+{
+    ppebuf_t *buf;
+    int err;
+
+    if ((err = ppebuf_alloc(&buf))) {
+        WARN();
+        return err;
+    }
+
+    buf->op = OP_PtlPreparedIssue;
+
+    buf->msg.PtlPreparedIssue.prep_handle = prep_handle;
+    buf->msg.PtlPreparedIssue.local_offset = local_offset;
+    buf->msg.PtlPreparedIssue.length = length;
+    buf->msg.PtlPreparedIssue.remote_offset = remote_offset;
+    buf->msg.PtlPreparedIssue.hdr_data = hdr_data;
+
+    transfer_msg(buf);
+
+    err = buf->msg.ret;
+
+    ppebuf_release(buf);
+
+    return err;
+}
+
+int PtlPreparedRelease(ptl_handle_prep_t prep_handle)
+{
+    ppebuf_t *buf;
+    int err;
+
+    if ((err = ppebuf_alloc(&buf))) {
+        WARN();
+        return err;
+    }
+
+    buf->op = OP_PtlPreparedRelease;
+
+    buf->msg.PtlPreparedRelease.prep_handle = prep_handle;
+
+    transfer_msg(buf);
+
+    err = buf->msg.ret;
+
+    ppebuf_release(buf);
+
+    return err;
+}
+
 //todo: protect with lock
 struct light_eq {
     struct list_head list;
@@ -1514,6 +1903,8 @@ int PtlEQAlloc(ptl_handle_ni_t ni_handle, ptl_size_t count,
     buf->msg.PtlEQAlloc.ni_handle = ni_handle;
     buf->msg.PtlEQAlloc.count = count;
 
+    pthread_mutex_lock(&ppe.map_mutex);
+
     transfer_msg(buf);
 
     err = buf->msg.ret;
@@ -1521,19 +1912,20 @@ int PtlEQAlloc(ptl_handle_ni_t ni_handle, ptl_size_t count,
     *eq_handle = buf->msg.PtlEQAlloc.eq_handle;
 
     if (err == PTL_OK) {
-        struct eqe_list *local_eqe_list;
-
         eq->eqe_list_map = buf->msg.PtlEQAlloc.eqe_list;
-        local_eqe_list = map_segment(&eq->eqe_list_map);
+        eq->eqe_list = map_segment(&eq->eqe_list_map);
 
-        if (local_eqe_list == NULL) {
+        if (eq->eqe_list == NULL) {
             // todo: call eqfree and return an error
             abort();
         }
+    }
+
+    pthread_mutex_unlock(&ppe.map_mutex);
 
+    if (err == PTL_OK) {
         /* Store the new EQ locally. */
         eq->eq_handle = *eq_handle;
-        eq->eqe_list = local_eqe_list;
         list_add(&eq->list, &EQs_list);
     }
 
@@ -1614,7 +2006,7 @@ int PtlEQWait(ptl_handle_eq_t eq_handle, ptl_event_t *event)
 
     eq = get_light_eq(eq_handle);
     if (eq)
-        err = PtlEQWait_work(eq->eqe_list, event);
+        err = PtlEQWait_work(NULL, eq->eqe_list, event);
     else
         err = PTL_ARG_INVALID;
 
@@ -1653,7 +2045,7 @@ int PtlEQPoll(const ptl_handle_eq_t * eq_handles, unsigned int size,
         eqes_list[i] = eq->eqe_list;
     }
 
-    err = PtlEQPoll_work(eqes_list, size, timeout, event, which);
+    err = PtlEQPoll_work(NULL, eqes_list, size, timeout, event, which);
 
   done:
     if (eqes_list)
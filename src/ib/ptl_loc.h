@@ -58,6 +58,7 @@
 #include "ptl_ref.h"
 #include "ptl_atomic.h"
 #include "ptl_param.h"
+#include "ptl_copy.h"
 #include "ptl_evloop.h"
 #include "ptl_pool.h"
 #include "ptl_queue.h"
@@ -79,6 +80,7 @@
 #include "ptl_buf.h"
 #include "ptl_eq.h"
 #include "ptl_hdr.h"
+#include "ptl_prep.h"
 #include "ptl_misc.h"
 #include "ptl_knem.h"
 
@@ -99,6 +101,7 @@ enum tgt_state {
     STATE_TGT_START,
     STATE_TGT_DROP,
     STATE_TGT_GET_MATCH,
+    STATE_TGT_FAST,
     STATE_TGT_GET_LENGTH,
     STATE_TGT_WAIT_CONN,
     STATE_TGT_DATA,
@@ -125,6 +128,7 @@ enum tgt_state {
 enum init_state {
     STATE_INIT_START,
     STATE_INIT_PREP_REQ,
+    STATE_INIT_PREP_DATA,
     STATE_INIT_WAIT_CONN,
     STATE_INIT_SEND_REQ,
     STATE_INIT_COPY_IN,
@@ -210,26 +214,42 @@ struct transports {
 };
 extern struct transports transports;
 
-int iov_copy_out(void *dst, ptl_iovec_t *iov, mr_t **mr_list,
-                 ptl_size_t num_iov, ptl_size_t offset, ptl_size_t length);
+ptl_size_t iov_find(const ptl_iovec_t *iov, const ptl_size_t *iov_end,
+                    ptl_size_t num_iov, ptl_size_t *offset_p);
 
-int iov_copy_in(void *src, ptl_iovec_t *iov, mr_t **mr_list,
-                ptl_size_t num_iov, ptl_size_t offset, ptl_size_t length);
+int iov_copy_out(void *dst, ptl_iovec_t *iov, const ptl_size_t *iov_end,
+                 mr_t **mr_list, ptl_size_t num_iov, ptl_size_t offset,
+                 ptl_size_t length);
+
+int iov_copy_in(void *src, ptl_iovec_t *iov, const ptl_size_t *iov_end,
+                mr_t **mr_list, ptl_size_t num_iov, ptl_size_t offset,
+                ptl_size_t length);
 
 int iov_atomic_in(atom_op_t op, int atom_size, void *src, ptl_iovec_t *iov,
-                  mr_t **mr_list, ptl_size_t num_iov, ptl_size_t offset,
-                  ptl_size_t length);
+                  const ptl_size_t *iov_end, mr_t **mr_list,
+                  ptl_size_t num_iov, ptl_size_t offset, ptl_size_t length);
 
-int iov_count_elem(ptl_iovec_t *iov, ptl_size_t num_iov, ptl_size_t offset,
-                   ptl_size_t length, ptl_size_t *index_p,
-                   ptl_size_t *base_p);
+int iov_count_elem(ptl_iovec_t *iov, const ptl_size_t *iov_end,
+                   ptl_size_t num_iov, ptl_size_t offset, ptl_size_t length,
+                   ptl_size_t *index_p, ptl_size_t *base_p);
 
 int process_rdma_desc(buf_t *buf);
 
+unsigned int req_event_mask(const req_hdr_t *hdr, const md_t *put_md,
+                            const md_t *get_md);
+
+void init_req_hdr(ni_t *ni, req_hdr_t *hdr, ptl_process_t target);
+
 int process_init(buf_t *buf);
 
 int process_tgt(buf_t *buf);
 
+#if !IS_PPE
+void flush_merged_acks(ni_t *ni, int all);
+
+int process_merged_ack(ni_t *ni, buf_t *buf);
+#endif
+
 int check_match(buf_t *buf, const me_t *me);
 
 int check_perm(buf_t *buf, const le_t *le);
@@ -269,13 +289,13 @@ int PtlNIInit_UDP(gbl_t *gbl, ni_t *ni);
 void cleanup_udp(ni_t *ni);
 
 #if WITH_TRANSPORT_UDP
-void PtlSetMap_udp(ni_t *ni, ptl_size_t map_size,
-                   const ptl_process_t *mapping);
 void disconnect_conn_locked(conn_t *conn);
 void udp_send(ni_t *ni, buf_t *buf, struct sockaddr_in *dest);
 buf_t *udp_receive(ni_t *ni);
 void process_recv_udp(ni_t *ni, buf_t *buf);
 void progress_thread_udp(ni_t *ni);
+int udp_recv_rndv(ni_t *ni, buf_t *buf);
+void udp_rndv_progress(ni_t *ni);
 #else
 static inline void progress_thread_udp(ni_t *ni)
 {
@@ -293,6 +313,43 @@ static inline void *addr_to_ppe(void *addr, mr_t *mr)
     return mr->ppe_addr + (addr - mr->addr);
 }
 
+#if USE_XPMEM
+/* Copy from/to client memory, given an mr to which the address belong
+ * to. */
+static inline int copy_from_app(void *dst, void *addr, mr_t *mr,
+                                ptl_size_t length)
+{
+    ptl_copy(dst, addr_to_ppe(addr, mr), length);
+    return PTL_OK;
+}
+
+static inline int copy_to_app(void *addr, mr_t *mr, const void *src,
+                              ptl_size_t length)
+{
+    ptl_copy(addr_to_ppe(addr, mr), src, length);
+    return PTL_OK;
+}
+
+/* Apply an atomic operation to client memory. */
+static inline int atomic_to_app(atom_op_t op, void *addr, mr_t *mr,
+                                void *src, ptl_size_t length)
+{
+    op(addr_to_ppe(addr, mr), src, length);
+    return PTL_OK;
+}
+#else
+/* Without XPMEM, the client memory can't be mapped, and is copied
+ * with process_vm_readv/writev. See ptl_cma.c. */
+int copy_from_app(void *dst, void *addr, mr_t *mr, ptl_size_t length);
+int copy_to_app(void *addr, mr_t *mr, const void *src, ptl_size_t length);
+int atomic_to_app(atom_op_t op, void *addr, mr_t *mr, void *src,
+                  ptl_size_t length);
+int cma_read(pid_t pid, void *dst, const void *addr, ptl_size_t length);
+int cma_write(pid_t pid, void *addr, const void *src, ptl_size_t length);
+int cma_copy(pid_t dst_pid, void *dst, pid_t src_pid, const void *src,
+             ptl_size_t length);
+#endif
+
 static inline int start_progress_thread(ni_t *ni)
 {
     return PTL_OK;
@@ -302,13 +359,53 @@ static inline void stop_progress_thread(ni_t *ni)
 {
 }
 
+static inline int ni_progress(ni_t *ni)
+{
+    return 0;
+}
+
 #else
 
 #define addr_to_ppe(addr,dontcare) (addr)
 
-/* There is a progress thread per NI when the PPE is not used. */
+#define copy_from_app(dst,addr,dontcare,length) \
+	(ptl_copy(dst, addr, length), PTL_OK)
+#define copy_to_app(addr,dontcare,src,length) \
+	(ptl_copy(addr, src, length), PTL_OK)
+#define atomic_to_app(op,addr,dontcare,src,length) \
+	((op)(addr, src, length), PTL_OK)
+
+/* There is a progress thread per NI when the PPE is not used, unless
+ * the NI is progressed by the application. */
 int start_progress_thread(ni_t *ni);
 void stop_progress_thread(ni_t *ni);
+void try_progress(ni_t *ni);
+
+/* Loopback transport. */
+void progress_self(ni_t *ni);
+
+/**
+ * Progress an NI opened with PTL_NI_APP_PROGRESS from a thread that
+ * waits for it. Otherwise, only deliver the messages the NI sent to
+ * itself, which the caller may be waiting for.
+ *
+ * @param[in] ni the NI.
+ *
+ * @return non zero if the NI has no progress thread.
+ */
+static inline int ni_progress(ni_t *ni)
+{
+    if (likely(!(ni->options & PTL_NI_APP_PROGRESS))) {
+        if (unlikely(!list_empty(&ni->self.queue)))
+            try_progress(ni);
+
+        return 0;
+    }
+
+    try_progress(ni);
+
+    return 1;
+}
 #endif
 
 int _PtlInit(gbl_t *gbl);
@@ -4,6 +4,8 @@
 #ifdef HAVE_CONFIG_H
 # include "config.h"
 #endif
+#include <sched.h>
+
 #include "ptl_sync.h"
 
 #ifdef HAVE_PTHREAD_SPIN_INIT
@@ -29,5 +31,32 @@ typedef struct ptl_spin_exclusive_s {   /* stolen from Qthreads */
                                    __sync_synchronize(); }
 #endif // ifdef HAVE_PTHREAD_SPIN_INIT
 
+/* A one word lock for objects that are seldom contended but may be
+ * held for a while, such as a buf going through its state machine. A
+ * waiter spins briefly, then yields the CPU to the owner. */
+typedef struct {
+    volatile int locked;
+} ptl_yieldlock_t;
+
+static inline void ptl_yieldlock_lock(ptl_yieldlock_t *x)
+{
+    int spins = 0;
+
+    while (__sync_lock_test_and_set(&x->locked, 1)) {
+        while (x->locked) {
+            if (++spins < 100)
+                SPINLOCK_BODY();
+            else
+                sched_yield();
+        }
+    }
+}
+
+#define PTL_YIELDLOCK_TYPE ptl_yieldlock_t
+#define PTL_YIELDLOCK_INIT(x)    do { (x)->locked = 0; } while (0)
+#define PTL_YIELDLOCK_DESTROY(x) do { } while (0)
+#define PTL_YIELDLOCK_LOCK(x)    ptl_yieldlock_lock(x)
+#define PTL_YIELDLOCK_UNLOCK(x)  __sync_lock_release(&(x)->locked)
+
 #endif // ifndef PTL_LOCKS_H
 /* vim:set expandtab: */
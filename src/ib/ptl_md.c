@@ -42,6 +42,7 @@ void md_cleanup(void *arg)
     if (md->internal_data) {
         free(md->internal_data);
         md->internal_data = NULL;
+        md->iov_end = NULL;
     }
 #if IS_PPE
     if (md->ppe.mr_start) {
@@ -81,7 +82,7 @@ static int init_iovec(md_t *md, const ptl_iovec_t *iov_list, int num_iov)
 
     md->num_iov = num_iov;
 
-    md->internal_data = calloc(num_iov, sizeof(mr_t)
+    md->internal_data = calloc(num_iov, sizeof(mr_t) + sizeof(ptl_size_t)
 #if WITH_TRANSPORT_IB
                                + sizeof(struct ibv_sge)
 #endif
@@ -99,6 +100,9 @@ static int init_iovec(md_t *md, const ptl_iovec_t *iov_list, int num_iov)
     md->mr_list = p;
     p += num_iov * sizeof(mr_t);
 
+    md->iov_end = p;
+    p += num_iov * sizeof(ptl_size_t);
+
 #if WITH_TRANSPORT_IB
     sge = md->sge_list = p;
     p += num_iov * sizeof(struct ibv_sge);
@@ -135,13 +139,19 @@ static int init_iovec(md_t *md, const ptl_iovec_t *iov_list, int num_iov)
         mr_t *mr;
 
         md->length += iov->iov_len;
+        md->iov_end[i] = md->length;
 
         err = mr_lookup_app(ni, iov->iov_base, iov->iov_len, &md->mr_list[i]);
         if (err)
             goto err3;
 
         mr = md->mr_list[i];
+#if IS_PPE && !USE_XPMEM
+        /* Not mapped. The PPE copies from the client. */
+        iov_addr = iov->iov_base;
+#else
         iov_addr = addr_to_ppe(iov->iov_base, mr);
+#endif
 
 #if WITH_TRANSPORT_IB
         sge->addr = cpu_to_le64((uintptr_t) iov_addr);
@@ -155,6 +165,9 @@ static int init_iovec(md_t *md, const ptl_iovec_t *iov_list, int num_iov)
 #if WITH_TRANSPORT_SHMEM && USE_KNEM
         mem_iovec->cookie = mr->knem_cookie;
         mem_iovec->offset = iov_addr - mr->addr;
+#endif
+#if IS_PPE && !USE_XPMEM
+        mem_iovec->pid = ni->mem.pid;
 #endif
         mem_iovec->addr = iov_addr;
         mem_iovec->length = iov->iov_len;
@@ -245,10 +258,17 @@ int _PtlMDBind(PPEGBL ptl_handle_ni_t ni_handle, const ptl_md_t *md_init,
     if (md_init->options & PTL_IOVEC) {
 #if IS_PPE
         /* Lookup the IOVEC list. */
+#if USE_XPMEM
         err =
             mr_lookup_app(ni, md_init->start,
                           md_init->length * sizeof(ptl_iovec_t),
                           &md->ppe.mr_start);
+#else
+        err =
+            mr_snapshot_app(ni, md_init->start,
+                            md_init->length * sizeof(ptl_iovec_t),
+                            &md->ppe.mr_start);
+#endif
         if (err)
             goto err3;
 
@@ -51,6 +51,10 @@ struct md {
 	 * can hold one mr per iovec contained in internal_data	 */
     mr_t **mr_list;
 
+        /** offset in the md of the end of each iovec, to find
+	 * the iovec that contains an offset by binary search */
+    ptl_size_t *iov_end;
+
 #if WITH_TRANSPORT_SHMEM || IS_PPE
         /** list of info for each iovec for use in long
 	 * messages sent through shared memory */
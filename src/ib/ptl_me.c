@@ -422,6 +422,7 @@ int _PtlMEUnlink(PPEGBL ptl_handle_me_t me_handle)
     /* make sure the me isn't still involved in any final
      * cleanup before we unlink it */
     while (atomic_read(&me->busy) == 1) {
+        ni_progress(obj_to_ni(me));
         SPINLOCK_BODY();
     }
 
@@ -512,7 +513,7 @@ void do_trig_me_op(buf_t *buf, ct_t *ct)
 {
 
     /* if we're a zombie */
-    if (ct->info.interrupt) {
+    if (ct->info->interrupt) {
         ptl_info("this CT is being shut down, don't trigger anything on it\n");
         goto done;
     }
@@ -548,7 +549,7 @@ static void post_trig_me(buf_t *buf, ct_t *me_ct)
     PTL_FASTLOCK_LOCK(&me_ct->lock);
 
     /* 1st check to see whether the condition is already met. */
-    if ((me_ct->info.event.failure + me_ct->info.event.success) >=
+    if ((me_ct->info->event.failure + me_ct->info->event.success) >=
         buf->ct_threshold) {
         PTL_FASTLOCK_UNLOCK(&me_ct->lock);
 
@@ -560,7 +561,7 @@ static void post_trig_me(buf_t *buf, ct_t *me_ct)
         list_add(&buf->list, &me_ct->trig_list);
 
         /* We must check again to avoid a race with make_ct_event/ct_inc_ct_set. */
-        if ((me_ct->info.event.success + me_ct->info.event.failure) >=
+        if ((me_ct->info->event.success + me_ct->info->event.failure) >=
             buf->ct_threshold) {
             /* Something arrived while we were adding the buffer. */
             PTL_FASTLOCK_UNLOCK(&me_ct->lock);
@@ -23,12 +23,26 @@ ptl_size_t copy_mem_to_mem(ni_t *ni, data_dir_t dir,
         copied =
             knem_copy(ni, local_mr->knem_cookie, local_addr - local_mr->addr,
                       remote_iovec->cookie, remote_iovec->offset, len);
+#elif IS_PPE && !USE_XPMEM
+    pid_t local_pid = local_mr->obj.obj_ni->mem.pid;
+    int err;
+
+    /* Both sides are in clients. */
+    if (dir == DATA_DIR_IN)
+        err =
+            cma_copy(local_pid, local_addr, remote_iovec->pid,
+                     remote_iovec->addr, len);
+    else
+        err =
+            cma_copy(remote_iovec->pid, remote_iovec->addr, local_pid,
+                     local_addr, len);
+    copied = err ? 0 : len;
 #elif IS_PPE
     local_addr = addr_to_ppe(local_addr, local_mr);
     if (dir == DATA_DIR_IN)
-        memcpy(local_addr, remote_iovec->addr, len);
+        ptl_copy(local_addr, remote_iovec->addr, len);
     else
-        memcpy(remote_iovec->addr, local_addr, len);
+        ptl_copy(remote_iovec->addr, local_addr, len);
     copied = len;
 #endif
 
@@ -88,6 +102,13 @@ static ptl_size_t do_mem_copy(buf_t *buf, ptl_size_t rem_len,
             if (len > iov->iov_len - *loc_off)
                 len = iov->iov_len - *loc_off;
 
+            /* Skip an empty segment, or one already copied. */
+            if (!len) {
+                *loc_off = 0;
+                (*loc_index)++;
+                continue;
+            }
+
             err = mr_lookup_app(obj_to_ni(buf), addr, len, &mr);
             if (err)
                 break;
@@ -156,30 +177,33 @@ int mem_do_transfer(buf_t *buf)
     struct mem_iovec iovec;
 
     iovec = *buf->transfer.mem.cur_rem_iovec;
+    advance_remote_addr(&iovec, buf->transfer.mem.cur_rem_off);
+    iovec.length -= buf->transfer.mem.cur_rem_off;
 
     while (*resid > 0) {
+        ptl_size_t len = iovec.length;
 
-#if WITH_TRANSPORT_SHMEM && USE_KNEM
-        iovec.offset += buf->transfer.mem.cur_rem_off;
-#endif
-        iovec.length -= buf->transfer.mem.cur_rem_off;
-
-        if (iovec.length > *resid)
-            iovec.length = *resid;
+        if (len > *resid)
+            len = *resid;
 
-        bytes =
-            do_mem_copy(buf, iovec.length, &iovec, &iov_index, &iov_off,
-                        buf->le->num_iov, dir);
-        if (!bytes)
-            return PTL_FAIL;
+        /* The remote iovecs may have empty segments. */
+        if (len) {
+            bytes =
+                do_mem_copy(buf, len, &iovec, &iov_index, &iov_off,
+                            buf->le->num_iov, dir);
+            if (!bytes)
+                return PTL_FAIL;
 
-        *resid -= bytes;
-        buf->cur_loc_iov_index = iov_index;
-        buf->cur_loc_iov_off = iov_off;
-        buf->transfer.mem.cur_rem_off += bytes;
+            *resid -= bytes;
+            buf->cur_loc_iov_index = iov_index;
+            buf->cur_loc_iov_off = iov_off;
+            buf->transfer.mem.cur_rem_off += bytes;
+            iovec.length -= bytes;
+        }
 
-        if (*resid && buf->transfer.mem.cur_rem_off >= iovec.length) {
-            if (buf->transfer.mem.num_rem_iovecs) {
+        if (*resid && iovec.length == 0) {
+            if (buf->transfer.mem.num_rem_iovecs > 1) {
+                buf->transfer.mem.num_rem_iovecs--;
                 buf->transfer.mem.cur_rem_iovec++;
                 iovec = *buf->transfer.mem.cur_rem_iovec;
                 buf->transfer.mem.cur_rem_off = 0;
@@ -193,17 +217,32 @@ int mem_do_transfer(buf_t *buf)
 }
 #endif
 
-/* Computes a hash (crc32 based), to identify which group this NI belong to. */
+/* Computes a hash (crc32 based), to identify which group this NI
+ * belong to. The whole map goes through it, so use a byte table
+ * rather than one bit at a time. */
 static uint32_t crc32(const unsigned char *p, uint32_t crc, int size)
 {
-    while (size--) {
-        int n;
+    static uint32_t table[256];
+    static int table_init;
+
+    if (unlikely(!table_init)) {
+        uint32_t i;
 
-        crc ^= *p++;
-        for (n = 0; n < 8; n++)
-            crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+        for (i = 0; i < 256; i++) {
+            uint32_t c = i;
+            int n;
+
+            for (n = 0; n < 8; n++)
+                c = (c >> 1) ^ ((c & 1) ? 0xedb88320 : 0);
+            table[i] = c;
+        }
+        __sync_synchronize();
+        table_init = 1;
     }
 
+    while (size--)
+        crc = (crc >> 8) ^ table[(crc ^ *p++) & 0xff];
+
     return crc;
 }
 
@@ -233,7 +272,7 @@ int PtlSetMap_mem(ni_t *ni, ptl_size_t map_size, const ptl_process_t *mapping)
                 /* Connect local ranks through XPMEM or SHMEM. */
                 ptl_info("mem enabled \n");
                 id.rank = i;
-                conn = get_conn(ni, id);
+                conn = get_peer_conn(ni, id);
                 if (!conn) {
                     /* It's hard to recover from here. */
                     WARN();
@@ -6,13 +6,34 @@
 
 #include "ptl_loc.h"
 
+/**
+ * @brief Allocate a buf from the transport of a connection.
+ *
+ * The transport can pick a larger buffer when length is not 0, so
+ * that the data of a put is copied in it.
+ *
+ * @param[in] conn the connection to the target
+ * @param[in] length the length of the put, or 0
+ * @param[out] buf_p pointer to return value
+ *
+ * @return status
+ */
+static inline int conn_buf_alloc(ni_t *ni, conn_t *conn, ptl_size_t length,
+                                 buf_t **buf_p)
+{
+    if (length && conn->transport.buf_alloc_eager)
+        return conn->transport.buf_alloc_eager(ni, length, buf_p);
+
+    return conn->transport.buf_alloc(ni, buf_p);
+}
+
 /**
  * @brief Allocate a buf or sbuf depending on transport type.
  *
  * @return status
  */
 static int get_transport_buf(ni_t *ni, ptl_process_t target_id,
-                             buf_t **retbuf)
+                             ptl_size_t length, buf_t **retbuf)
 {
     conn_t *conn;
     int err;
@@ -26,7 +47,7 @@ static int get_transport_buf(ni_t *ni, ptl_process_t target_id,
         return PTL_FAIL;
 
     /* allocate the correct type of buf */
-    err = conn->transport.buf_alloc(ni, &buf);
+    err = conn_buf_alloc(ni, conn, length, &buf);
     if (unlikely(err)) {
         conn_put(conn);
         return err;
@@ -44,16 +65,12 @@ static int get_transport_buf(ni_t *ni, ptl_process_t target_id,
 
 #ifndef NO_ARG_VALIDATION
 /**
- * @brief check parameters for a put type operation
+ * @brief check the ack request of a put or atomic type operation
  *
  * @return status
  */
-static int check_put(md_t *md, ptl_size_t local_offset, ptl_size_t length,
-                     ptl_ack_req_t ack_req, ni_t *ni)
+static int check_ack_req(md_t *md, ptl_ack_req_t ack_req)
 {
-    if (local_offset + length > md->length)
-        return PTL_ARG_INVALID;
-
     if (ack_req > PTL_OC_ACK_REQ)
         return PTL_ARG_INVALID;
 
@@ -63,6 +80,20 @@ static int check_put(md_t *md, ptl_size_t local_offset, ptl_size_t length,
     if (ack_req == PTL_CT_ACK_REQ && !md->ct)
         return PTL_ARG_INVALID;
 
+    return PTL_OK;
+}
+
+/**
+ * @brief check the length of a put type operation
+ *
+ * @return status
+ */
+static int check_put_length(md_t *md, ptl_size_t local_offset,
+                            ptl_size_t length, ni_t *ni)
+{
+    if (local_offset + length > md->length)
+        return PTL_ARG_INVALID;
+
     if (length > ni->limits.max_msg_size)
         return PTL_ARG_INVALID;
 
@@ -74,6 +105,23 @@ static int check_put(md_t *md, ptl_size_t local_offset, ptl_size_t length,
 
     return PTL_OK;
 }
+
+/**
+ * @brief check parameters for a put type operation
+ *
+ * @return status
+ */
+static int check_put(md_t *md, ptl_size_t local_offset, ptl_size_t length,
+                     ptl_ack_req_t ack_req, ni_t *ni)
+{
+    int err;
+
+    err = check_ack_req(md, ack_req);
+    if (err)
+        return err;
+
+    return check_put_length(md, local_offset, length, ni);
+}
 #endif
 
 /**
@@ -110,7 +158,7 @@ int _PtlPut(PPEGBL ptl_handle_md_t md_handle, ptl_size_t local_offset,
         goto err2;
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, length, &buf);
     if (unlikely(err))
         goto err2;
 
@@ -141,6 +189,9 @@ int _PtlPut(PPEGBL ptl_handle_md_t md_handle, ptl_size_t local_offset,
     if (unlikely(err))
         goto err1;
 
+    /* Give the target a chance to answer right away. */
+    ni_progress(ni);
+
     gbl_put();
     return PTL_OK;
 
@@ -199,7 +250,8 @@ int _PtlTriggeredPut(PPEGBL ptl_handle_md_t md_handle,
         goto err3;
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    /* The buf waits for the trigger, so it is not an eager one. */
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err3;
 
@@ -292,7 +344,7 @@ int _PtlGet(PPEGBL ptl_handle_md_t md_handle, ptl_size_t local_offset,
         goto err2;
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err2;
 
@@ -317,6 +369,9 @@ int _PtlGet(PPEGBL ptl_handle_md_t md_handle, ptl_size_t local_offset,
     if (unlikely(err)) 
         goto err1;
 
+    /* Give the target a chance to answer right away. */
+    ni_progress(ni);
+
     gbl_put();
     return PTL_OK;
 
@@ -374,7 +429,7 @@ int _PtlTriggeredGet(PPEGBL ptl_handle_md_t md_handle,
         goto err3;
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err3;
 
@@ -414,13 +469,12 @@ int _PtlTriggeredGet(PPEGBL ptl_handle_md_t md_handle,
 
 #ifndef NO_ARG_VALIDATION
 /**
- * @brief check parameters for a atomic type operation
+ * @brief check the length of an atomic type operation
  *
  * @return status
  */
-static int check_atomic(md_t *md, ptl_size_t local_offset, ptl_size_t length,
-                        ni_t *ni, ptl_ack_req_t ack_req, ptl_op_t atom_op,
-                        ptl_datatype_t atom_type)
+static int check_atomic_length(md_t *md, ptl_size_t local_offset,
+                               ptl_size_t length, ni_t *ni)
 {
     if (local_offset + length > md->length)
         return PTL_ARG_INVALID;
@@ -428,15 +482,16 @@ static int check_atomic(md_t *md, ptl_size_t local_offset, ptl_size_t length,
     if (length > ni->limits.max_atomic_size)
         return PTL_ARG_INVALID;
 
-    if (ack_req > PTL_OC_ACK_REQ)
-        return PTL_ARG_INVALID;
-
-    if (ack_req == PTL_ACK_REQ && !md->eq)
-        return PTL_ARG_INVALID;
-
-    if (ack_req == PTL_CT_ACK_REQ && !md->ct)
-        return PTL_ARG_INVALID;
+    return PTL_OK;
+}
 
+/**
+ * @brief check the operation and datatype of an atomic operation
+ *
+ * @return status
+ */
+static int check_atomic_op(ptl_op_t atom_op, ptl_datatype_t atom_type)
+{
     if (atom_op >= PTL_OP_LAST)
         return PTL_ARG_INVALID;
 
@@ -457,6 +512,28 @@ static int check_atomic(md_t *md, ptl_size_t local_offset, ptl_size_t length,
     return PTL_OK;
 }
 
+/**
+ * @brief check parameters for a atomic type operation
+ *
+ * @return status
+ */
+static int check_atomic(md_t *md, ptl_size_t local_offset, ptl_size_t length,
+                        ni_t *ni, ptl_ack_req_t ack_req, ptl_op_t atom_op,
+                        ptl_datatype_t atom_type)
+{
+    int err;
+
+    err = check_atomic_length(md, local_offset, length, ni);
+    if (err)
+        return err;
+
+    err = check_ack_req(md, ack_req);
+    if (err)
+        return err;
+
+    return check_atomic_op(atom_op, atom_type);
+}
+
 /**
  * @brief check for overlap between get and put MDs.
  *
@@ -526,7 +603,7 @@ int _PtlAtomic(PPEGBL ptl_handle_md_t md_handle, ptl_size_t local_offset,
         goto err2;
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err2;
 
@@ -555,6 +632,9 @@ int _PtlAtomic(PPEGBL ptl_handle_md_t md_handle, ptl_size_t local_offset,
     if (unlikely(err)) 
         goto err1;
 
+    /* Give the target a chance to answer right away. */
+    ni_progress(ni);
+
     gbl_put();
     return PTL_OK;
 
@@ -616,7 +696,7 @@ int _PtlTriggeredAtomic(PPEGBL ptl_handle_md_t md_handle,
         goto err3;
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err3;
 
@@ -720,7 +800,7 @@ int _PtlFetchAtomic(PPEGBL ptl_handle_md_t get_md_handle,
     }
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err3;
 
@@ -752,6 +832,9 @@ int _PtlFetchAtomic(PPEGBL ptl_handle_md_t get_md_handle,
     if (unlikely(err)) 
         goto err1;
 
+    /* Give the target a chance to answer right away. */
+    ni_progress(ni);
+
     gbl_put();
     return PTL_OK;
 
@@ -840,7 +923,7 @@ int _PtlTriggeredFetchAtomic(PPEGBL ptl_handle_md_t get_md_handle,
     }
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err4;
 
@@ -1015,7 +1098,7 @@ int _PtlSwap(PPEGBL ptl_handle_md_t get_md_handle,
     }
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err3;
 
@@ -1054,6 +1137,9 @@ int _PtlSwap(PPEGBL ptl_handle_md_t get_md_handle,
     if (unlikely(err)) 
         goto err1;
 
+    /* Give the target a chance to answer right away. */
+    ni_progress(ni);
+
     gbl_put();
     return PTL_OK;
 
@@ -1141,7 +1227,7 @@ int _PtlTriggeredSwap(PPEGBL ptl_handle_md_t get_md_handle,
     }
 #endif
 
-    err = get_transport_buf(ni, target_id, &buf);
+    err = get_transport_buf(ni, target_id, 0, &buf);
     if (unlikely(err))
         goto err4;
 
@@ -1266,3 +1352,297 @@ int _PtlEndBundle(PPEGBL ptl_handle_ni_t ni_handle)
   err0:
     return err;
 }
+
+/**
+ * @brief Release the resources of a prepared operation.
+ *
+ * @param[in] arg the prepared operation
+ */
+void prep_cleanup(void *arg)
+{
+    prep_t *prep = arg;
+
+    if (prep->md) {
+        md_put(prep->md);
+        prep->md = NULL;
+    }
+
+    if (prep->conn) {
+        conn_put(prep->conn);
+        prep->conn = NULL;
+    }
+}
+
+/**
+ * @brief Build a prepared put or atomic operation.
+ *
+ * Takes over the reference to the md.
+ *
+ * @return status
+ */
+static int prepare_op(md_t *md, enum hdr_op operation, ptl_ack_req_t ack_req,
+                      ptl_process_t target_id, ptl_pt_index_t pt_index,
+                      ptl_match_bits_t match_bits, void *user_ptr,
+                      ptl_op_t atom_op, ptl_datatype_t atom_type,
+                      ptl_handle_prep_t *prep_handle)
+{
+    int err;
+    ni_t *ni = obj_to_ni(md);
+    prep_t *prep;
+    req_hdr_t *hdr;
+
+    err = prep_alloc(ni, &prep);
+    if (unlikely(err)) {
+        md_put(md);
+        return err;
+    }
+
+    prep->md = md;
+
+    /* lookup or allocate a conn_t struct to hold per target info */
+    prep->conn = get_conn(ni, target_id);
+    if (unlikely(!prep->conn)) {
+        prep_put(prep);
+        return PTL_FAIL;
+    }
+
+    prep->target = target_id;
+    prep->user_ptr = user_ptr;
+
+    hdr = &prep->hdr;
+    memset(hdr, 0, sizeof(*hdr));
+    init_req_hdr(ni, hdr, target_id);
+    hdr->h1.operation = operation;
+    hdr->uid = cpu_to_le32(ni->uid);
+    hdr->pt_index = cpu_to_le32(pt_index);
+    hdr->match_bits = cpu_to_le64(match_bits);
+    hdr->ack_req = ack_req;
+    hdr->atom_op = atom_op;
+    hdr->atom_type = atom_type;
+
+    prep->event_mask = req_event_mask(hdr, md, NULL);
+
+    *prep_handle = prep_to_handle(prep);
+
+    return PTL_OK;
+}
+
+/**
+ * @brief Prepare a put operation.
+ *
+ * @return status
+ */
+int _PtlPutPrepare(PPEGBL ptl_handle_md_t md_handle, ptl_ack_req_t ack_req,
+                   ptl_process_t target_id, ptl_pt_index_t pt_index,
+                   ptl_match_bits_t match_bits, void *user_ptr,
+                   ptl_handle_prep_t *prep_handle)
+{
+    int err;
+    md_t *md;
+
+    err = gbl_get();
+    if (unlikely(err))
+        goto err0;
+
+    md = to_md(MYGBL_ md_handle);
+    if (unlikely(!md)) {
+        err = PTL_ARG_INVALID;
+        goto err1;
+    }
+
+#ifndef NO_ARG_VALIDATION
+    err = check_ack_req(md, ack_req);
+    if (err)
+        goto err2;
+#endif
+
+    err = prepare_op(md, OP_PUT, ack_req, target_id, pt_index, match_bits,
+                     user_ptr, 0, 0, prep_handle);
+
+    gbl_put();
+    return err;
+
+#ifndef NO_ARG_VALIDATION
+  err2:
+    md_put(md);
+#endif
+  err1:
+    gbl_put();
+  err0:
+    return err;
+}
+
+/**
+ * @brief Prepare an atomic operation.
+ *
+ * @return status
+ */
+int _PtlAtomicPrepare(PPEGBL ptl_handle_md_t md_handle,
+                      ptl_ack_req_t ack_req, ptl_process_t target_id,
+                      ptl_pt_index_t pt_index, ptl_match_bits_t match_bits,
+                      void *user_ptr, ptl_op_t atom_op,
+                      ptl_datatype_t atom_type,
+                      ptl_handle_prep_t *prep_handle)
+{
+    int err;
+    md_t *md;
+
+    err = gbl_get();
+    if (unlikely(err))
+        goto err0;
+
+    md = to_md(MYGBL_ md_handle);
+    if (unlikely(!md)) {
+        err = PTL_ARG_INVALID;
+        goto err1;
+    }
+
+#ifndef NO_ARG_VALIDATION
+    err = check_ack_req(md, ack_req);
+    if (err)
+        goto err2;
+
+    err = check_atomic_op(atom_op, atom_type);
+    if (err)
+        goto err2;
+#endif
+
+    err = prepare_op(md, OP_ATOMIC, ack_req, target_id, pt_index, match_bits,
+                     user_ptr, atom_op, atom_type, prep_handle);
+
+    gbl_put();
+    return err;
+
+#ifndef NO_ARG_VALIDATION
+  err2:
+    md_put(md);
+#endif
+  err1:
+    gbl_put();
+  err0:
+    return err;
+}
+
+/**
+ * @brief Issue a prepared operation.
+ *
+ * The request header is copied from the prepared operation and the
+ * initiator state machine is entered past the start state, since the
+ * event mask is already known.
+ *
+ * @return status
+ */
+int _PtlPreparedIssue(PPEGBL ptl_handle_prep_t prep_handle,
+                      ptl_size_t local_offset, ptl_size_t length,
+                      ptl_size_t remote_offset, ptl_hdr_data_t hdr_data)
+{
+    int err;
+    prep_t *prep;
+    md_t *md;
+    ni_t *ni;
+    buf_t *buf;
+    req_hdr_t *hdr;
+
+    err = gbl_get();
+    if (unlikely(err))
+        goto err0;
+
+    prep = to_prep(MYGBL_ prep_handle);
+    if (unlikely(!prep)) {
+        err = PTL_ARG_INVALID;
+        goto err1;
+    }
+
+    md = prep->md;
+    ni = obj_to_ni(md);
+
+#ifndef NO_ARG_VALIDATION
+    if (prep->hdr.h1.operation == OP_PUT)
+        err = check_put_length(md, local_offset, length, ni);
+    else
+        err = check_atomic_length(md, local_offset, length, ni);
+    if (err)
+        goto err2;
+#endif
+
+    err = conn_buf_alloc(ni, prep->conn, length, &buf);
+    if (unlikely(err))
+        goto err2;
+
+    assert(buf->type == BUF_FREE);
+    buf->type = BUF_INIT;
+
+    conn_get(prep->conn);
+    buf->conn = prep->conn;
+
+    hdr = (req_hdr_t *) buf->data;
+    *hdr = prep->hdr;
+    hdr->hdr_data = cpu_to_le64(hdr_data);
+    buf->rlength = length;
+    buf->roffset = remote_offset;
+
+    /* The buf holds its own reference to the md. */
+    md_get(md);
+    buf->target = prep->target;
+    buf->put_md = md;
+    buf->put_eq = md->eq;
+    buf->put_ct = md->ct;
+    buf->user_ptr = prep->user_ptr;
+    buf->put_offset = local_offset;
+    buf->event_mask |= prep->event_mask;
+    buf->init_state = STATE_INIT_PREP_DATA;
+
+    prep_put(prep);
+
+    err = process_init(buf);
+    if (unlikely(err))
+        goto err1;
+
+    /* Give the target a chance to answer right away. */
+    ni_progress(ni);
+
+    gbl_put();
+    return PTL_OK;
+
+  err2:
+    prep_put(prep);
+  err1:
+    gbl_put();
+  err0:
+    return err;
+}
+
+/**
+ * @brief Release a prepared operation.
+ *
+ * @return status
+ */
+int _PtlPreparedRelease(PPEGBL ptl_handle_prep_t prep_handle)
+{
+    int err;
+    prep_t *prep;
+
+    err = gbl_get();
+    if (unlikely(err))
+        goto err0;
+
+    prep = to_prep(MYGBL_ prep_handle);
+    if (unlikely(!prep)) {
+        err = PTL_ARG_INVALID;
+        goto err1;
+    }
+
+    /* Drop the reference we just took and the one from the
+     * allocation. Issued operations hold their own references to
+     * the md and the connection. */
+    prep_put(prep);
+    prep_put(prep);
+
+    gbl_put();
+    return PTL_OK;
+
+  err1:
+    gbl_put();
+  err0:
+    return err;
+}
@@ -16,6 +16,10 @@ uint64_t *global_umn_counter;
 ev_io global_umn_watcher;
 ni_t *global_nis[8];
 int global_ni_count;
+#else
+/* The regions of the PPE stay valid for the life of the client, so
+ * they are always cached. */
+static const int global_umn_init = 1;
 #endif
 
 /**
@@ -91,7 +95,12 @@ void mr_cleanup(void *arg)
 
 #if IS_PPE
     if (mr->ppe_addr != (void *)-1) {
+#if USE_XPMEM
         xpmem_detach((void *)((uintptr_t) mr->ppe_addr & ~(pagesize - 1)));
+#else
+        /* A copy from mr_snapshot_app(). */
+        free(mr->ppe_addr);
+#endif
         mr->ppe_addr = (void *)-1;
     }
 #endif
@@ -194,7 +203,7 @@ static int mr_create(ni_t *ni, void *start, ptl_size_t length, mr_t **mr_p)
     umn_register(ni, mr, start, length);
 #endif
 
-#if IS_PPE
+#if IS_PPE && USE_XPMEM
     if (length == 0) {
         /* Nothing to map. ppe_addr should never be used. Leave it at
          * -1. */
@@ -283,6 +292,54 @@ static int mr_create(ni_t *ni, void *start, ptl_size_t length, mr_t **mr_p)
     return err;
 }
 
+#if IS_PPE && !USE_XPMEM
+/**
+ * Copy a read-only address range of the application, like an iovec
+ * array.
+ *
+ * Without XPMEM, the PPE has no mapping of the application memory. The
+ * new mr isn't in the mr cache, and has its own copy of the range in
+ * ppe_addr, so addr_to_ppe() works on it.
+ *
+ * @param[in] ni in which to lookup range
+ * @param[in] start starting address of memory range in application space
+ * @param[in] length length of range
+ * @param[out] mr_p address of return value
+ *
+ * @return status
+ */
+int mr_snapshot_app(ni_t *ni, void *start, ptl_size_t length, mr_t **mr_p)
+{
+    int err;
+    mr_t *mr;
+
+    err = mr_alloc(ni, &mr);
+    if (err) {
+        WARN();
+        return err;
+    }
+
+    mr->ppe_addr = malloc(length ? length : 1);
+    if (!mr->ppe_addr) {
+        mr->ppe_addr = (void *)-1;
+        mr_put(mr);
+        return PTL_NO_SPACE;
+    }
+
+    err = cma_read(ni->mem.pid, mr->ppe_addr, start, length);
+    if (err) {
+        mr_put(mr);
+        return PTL_ARG_INVALID;
+    }
+
+    mr->addr = start;
+    mr->length = length;
+    *mr_p = mr;
+
+    return PTL_OK;
+}
+#endif
+
 /**
  * Lookup an mr in the mr cache.
  *
@@ -447,6 +504,14 @@ int mr_lookup(ni_t *ni, struct ni_mr_tree *tree, void *start,
         mr = *mr_p;
         mr_get(mr);
         res = RB_INSERT(the_root, &tree->tree, mr);
+        if (res && global_umn_init != 1) {
+            /* Without a registration cache, an older region starting
+             * at the same address may still be in the tree. Replace
+             * it; its users hold their own references. */
+            RB_REMOVE(the_root, &tree->tree, res);
+            mr_put(res);
+            res = RB_INSERT(the_root, &tree->tree, mr);
+        }
 //this can happen if using Qlogic
 #if !WITH_ZERO_MRS
         assert(res == NULL);           /* should never happen */
@@ -66,6 +66,10 @@ static inline int mr_lookup_self(ni_t *ni, void *start, ptl_size_t length,
     return mr_lookup(ni, &ni->mr_self, start, length, mr);
 }
 
+#if IS_PPE && !USE_XPMEM
+int mr_snapshot_app(ni_t *ni, void *start, ptl_size_t length, mr_t **mr_p);
+#endif
+
 void cleanup_mr_trees(ni_t *ni);
 
 #if IS_PPE
@@ -142,6 +142,16 @@ static int init_pools(ni_t *ni)
         return err;
     }
 
+    ni->prep_pool.cleanup = prep_cleanup;
+
+    err =
+        pool_init(gbl, &ni->prep_pool, "prep", sizeof(prep_t), POOL_PREP,
+                  (obj_t *)ni);
+    if (err) {
+        WARN();
+        return err;
+    }
+
     ni->buf_pool.setup = buf_setup;
     ni->buf_pool.init = buf_init;
     ni->buf_pool.fini = buf_fini;
@@ -171,47 +181,154 @@ static int init_pools(ni_t *ni)
 }
 
 /*
- * create_tables
- *	initialize private rank table in NI
- *	we are not yet connected to remote QPs
+ * prewarm_pools - grow the pools used by every operation to
+ *	PTL_POOL_PREWARM objects, so the first operations don't pay
+ *	for the slab allocations
  */
-static int create_tables(ni_t *ni)
+static int prewarm_pools(ni_t *ni)
 {
+    int num_objs = get_param(PTL_POOL_PREWARM);
+    pool_t *pools[] = {
+        &ni->mr_pool, &ni->md_pool, &ni->me_pool, &ni->le_pool,
+        &ni->buf_pool,
+    };
+    int err;
     int i;
-    conn_t *conn;
-    const ptl_size_t map_size = ni->logical.map_size;
-    ptl_process_t *mapping = ni->logical.mapping;
 
-    ni->logical.rank_table = calloc(map_size, sizeof(entry_t));
-    if (!ni->logical.rank_table) {
-        WARN();
-        return PTL_NO_SPACE;
+    for (i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+        err = pool_prewarm(pools[i], num_objs);
+        if (err)
+            return err;
     }
 
-    ptl_info("mapping table: \n");
+    return PTL_OK;
+}
 
-    for (i = 0; i < map_size; i++) {
-        entry_t *entry = &ni->logical.rank_table[i];
+/*
+ * ni_shrink_pools - give the memory of the free slabs of the NI
+ *	pools back to the OS. Called by the progress loop, which only
+ *	looks at the pools every PTL_POOL_IDLE_USEC, and forced when a
+ *	pool cannot grow
+ */
+void ni_shrink_pools(ni_t *ni, int force)
+{
+#if !IS_PPE
+    if (!force) {
+        unsigned long usec;
+        struct timespec ts;
+        uint64_t now;
+
+        /* Don't read the clock on every pass. */
+        if (++ni->pool_idle.ticks & 1023)
+            return;
 
-        entry->rank = i;
-        entry->nid = mapping[i].phys.nid;
-        entry->pid = mapping[i].phys.pid;
+        usec = get_param(PTL_POOL_IDLE_USEC);
+        if (!usec)
+            return;
 
-        if (conn_alloc(ni, &entry->connect))
-            return PTL_FAIL;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        now = ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+        if (now < ni->pool_idle.deadline)
+            return;
 
-        /* convert nid/pid to ipv4 address */
-        conn = entry->connect;
-        conn->sin.sin_family = AF_INET;
-        conn->sin.sin_addr.s_addr = nid_to_addr(entry->nid);
-        conn->sin.sin_port = pid_to_port(entry->pid);
-#if WITH_TRANSPORT_UDP
-//              conn->sin.sin_port = entry->pid;
-        ptl_info("entry: %i, ADDR: %s PID: %i \n", i,
-                 inet_ntoa(conn->sin.sin_addr), (entry->pid));
+        ni->pool_idle.deadline = now + usec;
+    }
 #endif
+
+    pool_shrink(&ni->mr_pool, force);
+    pool_shrink(&ni->md_pool, force);
+    pool_shrink(&ni->me_pool, force);
+    pool_shrink(&ni->le_pool, force);
+    pool_shrink(&ni->eq_pool, force);
+    pool_shrink(&ni->ct_pool, force);
+    pool_shrink(&ni->prep_pool, force);
+    pool_shrink(&ni->buf_pool, force);
+}
+
+/*
+ * count_map_runs
+ *	return the number of runs needed to describe a mapping,
+ *	and fill them in if runs is not NULL
+ */
+static int count_map_runs(ptl_size_t map_size, const ptl_process_t *mapping,
+                          map_run_t *runs)
+{
+    ptl_size_t i = 0;
+    int num_runs = 0;
+
+    while (i < map_size) {
+        ptl_size_t j = i + 1;
+        int32_t nid_step = 0;
+        int32_t pid_step = 0;
+
+        if (j < map_size) {
+            nid_step = mapping[j].phys.nid - mapping[i].phys.nid;
+            pid_step = mapping[j].phys.pid - mapping[i].phys.pid;
+
+            for (j++; j < map_size; j++) {
+                if (mapping[j].phys.nid - mapping[j - 1].phys.nid !=
+                    nid_step ||
+                    mapping[j].phys.pid - mapping[j - 1].phys.pid !=
+                    pid_step)
+                    break;
+            }
+        }
+
+        if (runs) {
+            runs[num_runs].rank = i;
+            runs[num_runs].nid = mapping[i].phys.nid;
+            runs[num_runs].pid = mapping[i].phys.pid;
+            runs[num_runs].nid_step = nid_step;
+            runs[num_runs].pid_step = pid_step;
+        }
+
+        num_runs++;
+        i = j;
     }
 
+    return num_runs;
+}
+
+/*
+ * create_map
+ *	save the rank to nid/pid mapping in the NI, compressed
+ *	into runs if that takes less memory than a full copy.
+ *	connections are created later, on first use
+ */
+static int create_map(ni_t *ni, ptl_size_t map_size,
+                      const ptl_process_t *mapping)
+{
+    int num_runs = 0;
+
+    if (get_param(PTL_COMPRESS_MAP))
+        num_runs = count_map_runs(map_size, mapping, NULL);
+
+    if (num_runs &&
+        num_runs * sizeof(map_run_t) < map_size * sizeof(ptl_process_t)) {
+        ni->logical.runs = malloc(num_runs * sizeof(map_run_t));
+        if (!ni->logical.runs) {
+            WARN();
+            return PTL_NO_SPACE;
+        }
+
+        count_map_runs(map_size, mapping, ni->logical.runs);
+        ni->logical.num_runs = num_runs;
+
+        ptl_info("mapping of %d ranks compressed into %d runs\n",
+                 (int)map_size, num_runs);
+    } else {
+        ni->logical.mapping = malloc(map_size * sizeof(ptl_process_t));
+        if (!ni->logical.mapping) {
+            WARN();
+            return PTL_NO_SPACE;
+        }
+
+        memcpy(ni->logical.mapping, mapping,
+               map_size * sizeof(ptl_process_t));
+    }
+
+    ni->logical.map_size = map_size;
+
     return PTL_OK;
 }
 
@@ -263,6 +380,11 @@ int _PtlNIInit(gbl_t *gbl, ptl_interface_t iface_id, unsigned int options,
         goto err1;
     }
 
+#if IS_PPE
+    /* The PPE progresses all the NIs. */
+    options &= ~PTL_NI_APP_PROGRESS;
+#endif
+
     ni_type = ni_options_to_type(options);
 
     pthread_mutex_lock(&gbl->gbl_mutex);
@@ -320,6 +442,7 @@ int _PtlNIInit(gbl_t *gbl, ptl_interface_t iface_id, unsigned int options,
 #if WITH_TRANSPORT_UDP
     PTL_FASTLOCK_INIT(&ni->udp_lock);
     INIT_LIST_HEAD(&ni->udp_list);
+    INIT_LIST_HEAD(&ni->udp_rndv_list);
 #endif
     RB_INIT(&ni->mr_self.tree);
     PTL_FASTLOCK_INIT(&ni->mr_self.tree_lock);
@@ -331,6 +454,8 @@ int _PtlNIInit(gbl_t *gbl, ptl_interface_t iface_id, unsigned int options,
     PTL_FASTLOCK_INIT(&ni->md_list_lock);
     PTL_FASTLOCK_INIT(&ni->ct_list_lock);
     pthread_mutex_init(&ni->atomic_mutex, NULL);
+    pthread_mutex_init(&ni->unexpected_mutex, NULL);
+    pthread_cond_init(&ni->unexpected_cond, NULL);
     pthread_mutex_init(&ni->pt_mutex, NULL);
 
 #if WITH_TRANSPORT_SHMEM && !USE_KNEM
@@ -338,10 +463,31 @@ int _PtlNIInit(gbl_t *gbl, ptl_interface_t iface_id, unsigned int options,
     INIT_LIST_HEAD(&ni->shmem.noknem_list);
 #endif
 
-    if (options & PTL_NI_PHYSICAL) {
-        PTL_FASTLOCK_INIT(&ni->physical.lock);
+    {
+        /* Round the connection table size up to a power of 2. */
+        unsigned int size = 1;
+
+        while (size < get_param(PTL_CONN_HASH_SIZE))
+            size <<= 1;
+
+        PTL_FASTLOCK_INIT(&ni->conns.lock);
+        ni->conns.hash = calloc(size, sizeof(conn_t *));
+        if (unlikely(!ni->conns.hash)) {
+            WARN();
+            err = PTL_NO_SPACE;
+            goto err3;
+        }
+        ni->conns.hash_mask = size - 1;
     }
 
+#if !IS_PPE
+    ni->self.conn = NULL;
+    INIT_LIST_HEAD(&ni->self.queue);
+    PTL_FASTLOCK_INIT(&ni->self.lock);
+    INIT_LIST_HEAD(&ni->ack_merge.list);
+    PTL_FASTLOCK_INIT(&ni->ack_merge.lock);
+#endif
+
 #if !WITH_TRANSPORT_UDP
     mr_init(ni);
 #endif
@@ -376,6 +522,12 @@ int _PtlNIInit(gbl_t *gbl, ptl_interface_t iface_id, unsigned int options,
     /* Set limits now that we know the transports limits */
     set_limits(ni, desired);
 
+    err = prewarm_pools(ni);
+    if (unlikely(err)) {
+        WARN();
+        goto err3;
+    }
+
     /* Note: pt range is [0..max_pt_index]. */
     ni->pt = calloc(ni->limits.max_pt_index + 1, sizeof(*ni->pt));
     if (unlikely(!ni->pt)) {
@@ -422,7 +574,6 @@ int _PtlSetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
     int err;
     ni_t *ni;
     iface_t *iface;
-    int length;
     int i;
 
     err = gbl_get();
@@ -434,7 +585,7 @@ int _PtlSetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
     if (unlikely(err))
         goto err1;
 
-    if (ni->logical.mapping) {
+    if (ni->logical.map_size) {
         ni_put(ni);
         gbl_put();
 
@@ -455,18 +606,6 @@ int _PtlSetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
         goto err2;
     }
 
-    /* Allocate new mapping and fill-up now. */
-    length = map_size * sizeof(ptl_process_t);
-
-    ni->logical.mapping = malloc(length);
-    if (!ni->logical.mapping) {
-        WARN();
-        goto err2;
-    }
-    ni->logical.map_size = map_size;
-
-    memcpy(ni->logical.mapping, mapping, length);
-
     /* lookup our nid/pid to determine rank */
     ni->id.rank = PTL_RANK_ANY;
 
@@ -486,12 +625,10 @@ int _PtlSetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
 
     if (ni->id.rank == PTL_RANK_ANY) {
         WARN();
-        free(ni->logical.mapping);
-        ni->logical.map_size = 0;
         goto err2;
     }
 
-    err = create_tables(ni);
+    err = create_map(ni, map_size, mapping);
     if (err) {
         WARN();
         goto err2;
@@ -507,12 +644,16 @@ int _PtlSetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
         }
     }
 #if WITH_TRANSPORT_UDP
-    PtlSetMap_udp(ni, map_size, mapping);
     ni->udp.map_done = 1;
     ptl_info("done setting maps. my rank is: %i port: %i\n", ni->id.rank,
              iface->id.phys.pid);
 #endif
 
+    /* Start connecting to everybody now. Failures are not fatal, the
+     * connections will be retried on first use. */
+    if (get_param(PTL_PRECONNECT))
+        connect_peers(ni, map_size, NULL, 0);
+
     ni_put(ni);
     gbl_put();
     return PTL_OK;
@@ -525,11 +666,53 @@ int _PtlSetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
     return PTL_ARG_INVALID;
 }
 
+int _PtlNIConnect(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t num_targets,
+                  const ptl_process_t *targets)
+{
+    int err;
+    ni_t *ni;
+
+    err = gbl_get();
+    if (unlikely(err)) {
+        return err;
+    }
+
+    err = to_ni(MYGBL_ ni_handle, &ni);
+    if (unlikely(err)) {
+        err = PTL_ARG_INVALID;
+        goto err1;
+    }
+
+    if (ni->options & PTL_NI_LOGICAL) {
+        if (!ni->logical.map_size) {
+            /* PtlSetMap has not been called yet. */
+            err = PTL_ARG_INVALID;
+            goto err2;
+        }
+
+        if (!targets)
+            num_targets = ni->logical.map_size;
+    } else if (!targets) {
+        err = PTL_ARG_INVALID;
+        goto err2;
+    }
+
+    err = connect_peers(ni, num_targets, targets, 1);
+
+  err2:
+    ni_put(ni);
+  err1:
+    gbl_put();
+
+    return err;
+}
+
 int _PtlGetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
                ptl_process_t *mapping, ptl_size_t *actual_map_size)
 {
     int err;
     ni_t *ni;
+    ptl_size_t i;
 
     err = gbl_get();
     if (unlikely(err)) {
@@ -548,7 +731,7 @@ int _PtlGetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
         goto err2;
     }
 
-    if (!ni->logical.mapping) {
+    if (!ni->logical.map_size) {
         err = PTL_NO_SPACE;
         goto err2;
     }
@@ -556,9 +739,14 @@ int _PtlGetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
     if (map_size > ni->logical.map_size)
         map_size = ni->logical.map_size;
 
-    if (map_size)
-        memcpy(mapping, ni->logical.mapping,
-               map_size * sizeof(ptl_process_t));
+    if (ni->logical.mapping) {
+        if (map_size)
+            memcpy(mapping, ni->logical.mapping,
+                   map_size * sizeof(ptl_process_t));
+    } else {
+        for (i = 0; i < map_size; i++)
+            mapping[i] = rank_to_phys(ni, i);
+    }
 
     if (actual_map_size)
         *actual_map_size = ni->logical.map_size;
@@ -583,7 +771,7 @@ static void interrupt_cts(ni_t *ni)
     PTL_FASTLOCK_LOCK(&ni->ct_list_lock);
     list_for_each(l, &ni->ct_list) {
         ct = list_entry(l, ct_t, list);
-        ct->info.interrupt = 1;
+        ct->info->interrupt = 1;
     }
     PTL_FASTLOCK_UNLOCK(&ni->ct_list_lock);
 }
@@ -594,7 +782,7 @@ static void ni_cleanup(ni_t *ni)
      * set the value of map size to 0 (otherwise
      * it is undefined) */
     if (ni->options & PTL_NI_LOGICAL) {
-        if (!ni->logical.mapping)
+        if (!ni->logical.mapping && !ni->logical.runs)
             ni->logical.map_size = 0;
     }
 
@@ -602,6 +790,12 @@ static void ni_cleanup(ni_t *ni)
         ni->shutting_down = 1;
         __sync_synchronize();
 
+#if !IS_PPE
+        /* Send the acks still waiting to be merged, while the
+         * connections are up. */
+        flush_merged_acks(ni, 1);
+#endif
+
         if (transports.remote.initiate_disconnect_all)
             transports.remote.initiate_disconnect_all(ni);
 
@@ -619,6 +813,11 @@ static void ni_cleanup(ni_t *ni)
 
     stop_progress_thread(ni);
 
+#if !IS_PPE
+    /* Acks merged since, which also hold connection references. */
+    flush_merged_acks(ni, 1);
+#endif
+
     destroy_conns(ni);
 
     interrupt_cts(ni);
@@ -638,15 +837,23 @@ static void ni_cleanup(ni_t *ni)
             free(ni->logical.mapping);
             ni->logical.mapping = NULL;
         }
-        if (ni->logical.rank_table) {
-            free(ni->logical.rank_table);
-            ni->logical.rank_table = NULL;
+        if (ni->logical.runs) {
+            free(ni->logical.runs);
+            ni->logical.runs = NULL;
+            ni->logical.num_runs = 0;
         }
+        ni->logical.map_size = 0;
+    }
+
+    if (ni->conns.hash) {
+        free(ni->conns.hash);
+        ni->conns.hash = NULL;
     }
 
     pool_fini(&ni->conn_pool);
     pool_fini(&ni->buf_pool);
     pool_fini(&ni->xt_pool);
+    pool_fini(&ni->prep_pool);
     pool_fini(&ni->ct_pool);
     pool_fini(&ni->eq_pool);
     pool_fini(&ni->le_pool);
@@ -660,6 +867,8 @@ static void ni_cleanup(ni_t *ni)
     }
 
     pthread_mutex_destroy(&ni->atomic_mutex);
+    pthread_mutex_destroy(&ni->unexpected_mutex);
+    pthread_cond_destroy(&ni->unexpected_cond);
     pthread_mutex_destroy(&ni->pt_mutex);
     PTL_FASTLOCK_DESTROY(&ni->md_list_lock);
     PTL_FASTLOCK_DESTROY(&ni->ct_list_lock);
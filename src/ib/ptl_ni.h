@@ -11,17 +11,19 @@ struct queue;
 struct conn;
 
 /*
- * rank_entry_t
- *	per private rank table entry info
+ * map_run_t
+ *	a run of consecutive ranks whose nid and pid grow by a
+ *	constant step. Regular layouts (block, cyclic) are stored
+ *	as a short array of runs instead of one ptl_process_t per rank.
  *	only used for logical NIs
  */
-typedef struct rank_entry {
-    ptl_rank_t rank;            /* world rank */
-    ptl_rank_t main_rank;       /* main rank on NID */
-    ptl_nid_t nid;
-    ptl_pid_t pid;
-    struct conn *connect;
-} entry_t;
+typedef struct map_run {
+    ptl_rank_t rank;            /* first rank of the run */
+    ptl_nid_t nid;              /* nid of the first rank */
+    ptl_pid_t pid;              /* pid of the first rank */
+    int32_t nid_step;
+    int32_t pid_step;
+} map_run_t;
 
 /* Used by SHMEM to communicate the PIDs between the local ranks for a
  * physical NI. */
@@ -80,6 +82,11 @@ typedef struct ni {
     /* Serialize atomic operations on this NI. */
     pthread_mutex_t atomic_mutex;
 
+    /* Appends waiting for a buf on an unexpected list to finish its
+     * transfer (see unexpected_busy). Shared by all the bufs. */
+    pthread_mutex_t unexpected_mutex;
+    pthread_cond_t unexpected_cond;
+
     pt_t *pt;
     pthread_mutex_t pt_mutex;
     ptl_pt_index_t last_pt;
@@ -112,6 +119,14 @@ typedef struct ni {
     int has_catcher;
     int catcher_stop;
     int catcher_nosleep;
+    int progress_busy;          /* set while a thread progresses the NI */
+
+    /* When the progress thread looks at the pools again, see
+     * ni_shrink_pools(). */
+    struct {
+        uint64_t deadline;
+        unsigned int ticks;
+    } pool_idle;
 #endif
 
     int cleanup_state;
@@ -155,6 +170,12 @@ typedef struct ni {
         void *first_queue;      /* addr of rank 0 queue, in the comm pad */
         char *comm_pad_shm_name;
 
+        /* Eager buffers, in the comm pad after the sbufs. Puts up to
+         * eager_size bytes are copied into one. 0 if there are
+         * none. */
+        pool_t eager_sbuf_pool;
+        ptl_size_t eager_size;
+
 #if !USE_KNEM
         /* Bounce buffers used when KNEM is not available. They are
          * created and linked by rank 0. */
@@ -180,7 +201,11 @@ typedef struct ni {
 
 #ifdef IS_PPE
         int in_set;
+#if USE_XPMEM
         xpmem_apid_t apid;      /* from the struct client the client belongs to. */
+#else
+        pid_t pid;              /* of the client the NI belongs to. */
+#endif
         queue_t *internal_queue;
 
                 /** entry in PPE physical NI cache */
@@ -229,6 +254,10 @@ typedef struct ni {
 #if WITH_TRANSPORT_UDP
     PTL_FASTLOCK_TYPE udp_lock;
     struct list_head udp_list;
+
+    /* Target bufs pulling the data of a rendezvous put, protected
+     * by udp_lock. */
+    struct list_head udp_rndv_list;
 #endif
 
     /* object allocation pools */
@@ -238,34 +267,50 @@ typedef struct ni {
     pool_t le_pool;
     pool_t eq_pool;
     pool_t ct_pool;
+    pool_t prep_pool;
     pool_t xt_pool;
     pool_t buf_pool;
     pool_t sbuf_pool;
     pool_t conn_pool;
 
-    /* Connection mappings. */
-    union {
-        struct {
-            /* Logical NI. */
+    /* Connections. They are kept in a hash table keyed on the
+     * nid/pid of the peer, for both logical and physical NIs, and
+     * are created on first use. Lookups are lock free; the lock only
+     * serializes insertions. Entries are never removed until the NI
+     * is destroyed. */
+    struct {
+        struct conn **hash;
+        unsigned int hash_mask;
+        PTL_FASTLOCK_TYPE lock;
+    } conns;
 
-            /* On a NID, the process creating the domain is going to
-             * be the one with the lowest PID. Connection attempts to
-             * the other PIDs will be rejected. Also, locally, the
-             * XI/XT will not be queued on the non-main ranks, but on
-             * the main rank. */
+#if !IS_PPE
+    /* Loopback transport. Messages the NI sends to itself wait on
+     * the queue until they can be delivered, right after the sending
+     * operation or by the next progress loop. */
+    struct {
+        struct conn *conn;
+        struct list_head queue;
+        PTL_FASTLOCK_TYPE lock;
+    } self;
 
-            /* Rank table. This is used to connection TO remote ranks */
-            int map_size;
-            struct rank_entry *rank_table;
-            ptl_process_t *mapping;
-        } logical;
+    /* Connections that have merged acks waiting to be sent. */
+    struct {
+        struct list_head list;
+        PTL_FASTLOCK_TYPE lock;
+    } ack_merge;
+#endif
 
-        struct {
-            /* Physical NI. */
-            void *tree;
-            PTL_FASTLOCK_TYPE lock;
-        } physical;
-    };
+    struct {
+        /* Logical NI. Rank to nid/pid mapping, either as a full
+         * copy of the application's mapping or, if it is regular
+         * enough, as an array of runs (see map_run_t). One of
+         * mapping or runs is set once PtlSetMap has been called. */
+        int map_size;
+        ptl_process_t *mapping;
+        map_run_t *runs;
+        int num_runs;
+    } logical;
 } ni_t;
 
 static inline int ni_alloc(pool_t *pool, ni_t **ni_p)
@@ -332,6 +377,44 @@ static inline ni_t *obj_to_ni(const void *obj)
     return ((obj_t *)obj)->obj_ni;
 }
 
+/**
+ * Return the physical ID of a rank on a logical NI.
+ *
+ * @param[in] ni the logical NI
+ * @param[in] rank the rank, must be less than the map size
+ *
+ * @return the physical ID of that rank
+ */
+static inline ptl_process_t rank_to_phys(const ni_t *ni, ptl_rank_t rank)
+{
+    const map_run_t *run;
+    ptl_process_t id;
+    int lo, hi;
+
+    if (ni->logical.mapping)
+        return ni->logical.mapping[rank];
+
+    /* Find the last run starting at or before rank. */
+    lo = 0;
+    hi = ni->logical.num_runs - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+
+        if (ni->logical.runs[mid].rank <= rank)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    run = &ni->logical.runs[lo];
+    id.phys.nid = run->nid + (rank - run->rank) * run->nid_step;
+    id.phys.pid = run->pid + (rank - run->rank) * run->pid_step;
+
+    return id;
+}
+
+void ni_shrink_pools(ni_t *ni, int force);
+
 /* convert ni option flags to a 2 bit type */
 static inline int ni_options_to_type(unsigned int options)
 {
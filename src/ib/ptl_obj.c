@@ -79,7 +79,33 @@ static inline int index_lookup(gbl_t *gbl, unsigned int index, obj_t **obj_p)
     }
 }
 
-#define HANDLE_SHIFT ((sizeof(ptl_handle_any_t)*8)-8)
+/**
+ * Get an index for an object of a pool.
+ *
+ * Indexes of the slabs released by pool_shrink() are reused first, so
+ * that growing and shrinking a pool doesn't exhaust them.
+ *
+ * @pre caller should hold pool->mutex
+ *
+ * @param pool the pool of the object
+ * @param obj the object
+ * @param index_p address of return value
+ *
+ * @return status
+ */
+static int pool_index_get(pool_t *pool, obj_t *obj, unsigned int *index_p)
+{
+    if (pool->num_free_index) {
+        unsigned int index = pool->free_index[--pool->num_free_index];
+
+        pool->gbl->index_map[index] = obj;
+        *index_p = index;
+
+        return PTL_OK;
+    }
+
+    return index_get(pool->gbl, obj, index_p);
+}
 
 /**
  * Return a new zero filled slab.
@@ -89,7 +115,8 @@ static inline int index_lookup(gbl_t *gbl, unsigned int index, obj_t **obj_p)
  * page aligned memory. In the special case that
  * we are creating objects in shared memory the pool
  * has a pre allocated chunk of shared memory that is
- * used instead.
+ * used instead. The memory of a slab released by pool_shrink() is
+ * reused before allocating more.
  *
  * @param pool the pool for which slab is created.
  *
@@ -103,6 +130,8 @@ static void *pool_get_slab(pool_t *pool)
     if (pool->use_pre_alloc_buffer) {
         slab = pool->pre_alloc_buffer;
         pool->pre_alloc_buffer = NULL;
+    } else if (pool->num_released_slabs) {
+        slab = pool->released_slabs[--pool->num_released_slabs];
     } else {
         err = posix_memalign(&slab, pagesize, pool->slab_size);
         if (unlikely(err))
@@ -117,7 +146,7 @@ static void *pool_get_slab(pool_t *pool)
 
 /**
  * get chunk hold new slab.
- * note that we currently never free objects so there are
+ * note that pool_shrink() compacts the chunks so there are
  * never any holes in chunk->slab_list
  *
  * @pre caller should hold pool->mutex
@@ -132,9 +161,9 @@ static int pool_get_chunk(pool_t *pool, chunk_t **chunk_p)
     int err;
     chunk_t *chunk;
 
-    /* see if there is a chunk with room at head of list */
-    if (likely(!list_empty(&pool->chunk_list))) {
-        chunk = list_first_entry(&pool->chunk_list, chunk_t, list);
+    /* see if there is a chunk with room, usually the one at the
+     * head of list */
+    list_for_each_entry(chunk, &pool->chunk_list, list) {
         if (chunk->num_slabs < chunk->max_slabs) {
             *chunk_p = chunk;
             return PTL_OK;
@@ -216,7 +245,7 @@ static int pool_alloc_slab(pool_t *pool)
         obj->obj_parent = pool->parent;
         obj->obj_ni = (pool->parent) ? pool->parent->obj_ni : (ni_t *)obj;
 
-        err = index_get(pool->gbl, obj, &index);
+        err = pool_index_get(pool, obj, &index);
         if (err) {
             WARN();
             //todo: leak
@@ -237,10 +266,236 @@ static int pool_alloc_slab(pool_t *pool)
     }
 
     chunk->num_slabs++;
+    pool->num_slabs++;
+    pool->grows++;
 
     return PTL_OK;
 }
 
+/**
+ * Release a slab whose objects are all free.
+ *
+ * The objects are finalized and their indexes kept for the next
+ * slab. The pages go back to the OS but stay mapped, because another
+ * thread may still be reading the free list through one of the
+ * objects; it then reads zeroes and retries.
+ *
+ * @pre caller should hold pool->mutex, and own all the objects
+ *
+ * @param pool the pool of the slab
+ * @param slab the slab to release
+ *
+ * @return status
+ */
+static int pool_release_slab(pool_t *pool, slab_info_t *slab)
+{
+    void **released_slabs;
+    unsigned int *free_index;
+    uint8_t *p = slab->addr;
+    int i;
+
+    released_slabs = realloc(pool->released_slabs,
+                             (pool->num_released_slabs + 1) *
+                             sizeof(*released_slabs));
+    if (!released_slabs)
+        return PTL_NO_SPACE;
+    pool->released_slabs = released_slabs;
+
+    free_index = realloc(pool->free_index,
+                         (pool->num_free_index + pool->obj_per_slab) *
+                         sizeof(*free_index));
+    if (!free_index)
+        return PTL_NO_SPACE;
+    pool->free_index = free_index;
+
+    for (i = 0; i < pool->obj_per_slab; i++) {
+        obj_t *obj = (obj_t *)p;
+        unsigned int index = obj_handle_to_index(obj->obj_handle);
+
+        if (pool->fini)
+            pool->fini(obj);
+
+        pool->gbl->index_map[index] = NULL;
+        pool->free_index[pool->num_free_index++] = index;
+
+        p += pool->round_size;
+    }
+
+#if WITH_TRANSPORT_IB
+    if (slab->mr) {
+        ibv_dereg_mr(slab->mr);
+        slab->mr = NULL;
+    }
+#endif
+
+    madvise(slab->addr, pool->slab_size & ~(pagesize - 1), MADV_DONTNEED);
+
+    pool->released_slabs[pool->num_released_slabs++] = slab->addr;
+    slab->addr = NULL;
+    pool->num_slabs--;
+
+    return PTL_OK;
+}
+
+static int compare_obj(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)*(obj_t * const *)a;
+    uintptr_t y = (uintptr_t)*(obj_t * const *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int compare_slab(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)(*(slab_info_t * const *)a)->addr;
+    uintptr_t y = (uintptr_t)(*(slab_info_t * const *)b)->addr;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Give back the memory of the slabs whose objects are all free.
+ *
+ * Unless forced, a pool that grew since the previous call is left
+ * alone, so it is only trimmed once a burst is over. The pool keeps
+ * at least min_objs objects. The free list is drained while the
+ * slabs are looked at; a thread finding it empty waits for the pool
+ * mutex, and then finds the objects that were kept.
+ *
+ * @param pool the pool to shrink
+ * @param force shrink even if the pool grew recently
+ *
+ * @return number of slabs released
+ */
+int pool_shrink(pool_t *pool, int force)
+{
+    obj_t *obj;
+    obj_t *drained = NULL;
+    obj_t **objs = NULL;
+    slab_info_t **slabs = NULL;
+    chunk_t *chunk;
+    uint8_t *end;
+    int num_objs = 0;
+    int num_slabs = 0;
+    int released = 0;
+    int i, j, k;
+
+    /* A pool in preallocated memory cannot shrink. */
+    if (!pool->name || pool->use_pre_alloc_buffer)
+        return 0;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (!force && pool->grows != pool->shrink_grows) {
+        pool->shrink_grows = pool->grows;
+        goto done;
+    }
+
+    /* Not enough free objects for a whole slab. */
+    if ((pool->num_slabs - 1) * pool->obj_per_slab < pool->min_objs ||
+        pool->num_slabs * pool->obj_per_slab - atomic_read(&pool->count) <
+        pool->obj_per_slab)
+        goto done;
+
+    while ((obj = ll_dequeue_obj(&pool->free_list))) {
+        obj->next = drained;
+        drained = obj;
+        num_objs++;
+    }
+
+    objs = malloc(num_objs * sizeof(*objs));
+    slabs = malloc(pool->num_slabs * sizeof(*slabs));
+    if (!objs || !slabs) {
+        while ((obj = drained)) {
+            drained = obj->next;
+            ll_enqueue_obj(&pool->free_list, obj);
+        }
+        goto done;
+    }
+
+    for (i = 0, obj = drained; obj; obj = obj->next)
+        objs[i++] = obj;
+
+    list_for_each_entry(chunk, &pool->chunk_list, list) {
+        for (i = 0; i < chunk->num_slabs; i++)
+            slabs[num_slabs++] = &chunk->slab_list[i];
+    }
+
+    /* Sort both by address, to count the free objects of each slab
+     * in one pass. */
+    qsort(objs, num_objs, sizeof(*objs), compare_obj);
+    qsort(slabs, num_slabs, sizeof(*slabs), compare_slab);
+
+    for (i = 0, j = 0; i < num_slabs; i++) {
+        int first = j;
+
+        end = (uint8_t *)slabs[i]->addr +
+            pool->obj_per_slab * pool->round_size;
+        while (j < num_objs && (uint8_t *)objs[j] < end)
+            j++;
+
+        if (j - first == pool->obj_per_slab &&
+            (pool->num_slabs - 1) * pool->obj_per_slab >= pool->min_objs &&
+            pool_release_slab(pool, slabs[i]) == PTL_OK) {
+            released++;
+            continue;
+        }
+
+        for (k = first; k < j; k++)
+            ll_enqueue_obj(&pool->free_list, objs[k]);
+    }
+
+    /* Fill the holes left by the released slabs. */
+    list_for_each_entry(chunk, &pool->chunk_list, list) {
+        for (i = chunk->num_slabs - 1; i >= 0; i--) {
+            if (!chunk->slab_list[i].addr)
+                chunk->slab_list[i] =
+                    chunk->slab_list[--chunk->num_slabs];
+        }
+    }
+
+  done:
+    pthread_mutex_unlock(&pool->mutex);
+
+    free(objs);
+    free(slabs);
+
+    return released;
+}
+
+/**
+ * Grow a pool to hold a number of objects.
+ *
+ * Used at NI creation, so that the first operations don't pay for the
+ * slab allocations. pool_shrink() then keeps that many objects.
+ *
+ * @param pool the pool to grow
+ * @param num_objs the number of objects
+ *
+ * @return status
+ */
+int pool_prewarm(pool_t *pool, int num_objs)
+{
+    int err = PTL_OK;
+
+    if (!pool->name || pool->use_pre_alloc_buffer)
+        return PTL_OK;
+
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->min_objs = num_objs;
+
+    while (pool->num_slabs * pool->obj_per_slab < num_objs) {
+        err = pool_alloc_slab(pool);
+        if (err)
+            break;
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+
+    return err;
+}
+
 /**
  * Cleanup an object pool.
  *
@@ -301,6 +556,17 @@ int pool_fini(pool_t *pool)
         free(chunk);
     }
 
+    for (i = 0; i < pool->num_released_slabs; i++)
+        free(pool->released_slabs[i]);
+
+    free(pool->released_slabs);
+    pool->released_slabs = NULL;
+    pool->num_released_slabs = 0;
+
+    free(pool->free_index);
+    pool->free_index = NULL;
+    pool->num_free_index = 0;
+
     return err;
 }
 
@@ -336,6 +602,10 @@ int pool_init(gbl_t *gbl, pool_t *pool, char *name, int size,
         pool->slab_size = pagesize;
 
     pool->obj_per_slab = pool->slab_size / pool->round_size;
+    pool->num_slabs = 0;
+    pool->min_objs = 0;
+    pool->grows = 0;
+    pool->shrink_grows = 0;
 
     if (!pool->obj_per_slab) {
         ptl_error("Well that's embarassing but "
@@ -411,20 +681,38 @@ int obj_alloc(pool_t *pool, obj_t **obj_p)
              * SBUF pool, so we must busy wait until a new buffer appears
              * on the list. */
             do {
+                if (pool->starved)
+                    pool->starved(pool);
                 SPINLOCK_BODY();
             } while ((obj = ll_dequeue_obj(&pool->free_list)) == NULL);
         } else {
-            do {
+            int shrunk = 0;
+
+            while (!obj) {
                 pthread_mutex_lock(&pool->mutex);
-                err = pool_alloc_slab(pool);
+
+                /* Another thread may have grown the pool, or
+                 * pool_shrink() put the objects back, while this one
+                 * waited for the lock. */
+                obj = ll_dequeue_obj(&pool->free_list);
+                err = obj ? PTL_OK : pool_alloc_slab(pool);
+
                 pthread_mutex_unlock(&pool->mutex);
 
-                if (unlikely(err)) {
+                if (unlikely(err == PTL_NO_SPACE && !shrunk &&
+                             pool->parent)) {
+                    /* Memory is short. Release the free slabs of all
+                     * the NI pools and try again. */
+                    ni_shrink_pools(pool->parent->obj_ni, 1);
+                    shrunk = 1;
+                } else if (unlikely(err)) {
                     atomic_dec(&pool->count);
                     WARN();
                     return err;
+                } else if (!obj) {
+                    obj = ll_dequeue_obj(&pool->free_list);
                 }
-            } while ((obj = ll_dequeue_obj(&pool->free_list)) == NULL);
+            }
         }
     }
 
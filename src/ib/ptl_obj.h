@@ -64,6 +64,10 @@ int pool_init(struct gbl *gbl, pool_t *pool, char *name, int size,
 
 int pool_fini(pool_t *pool);
 
+int pool_prewarm(pool_t *pool, int num_objs);
+
+int pool_shrink(pool_t *pool, int force);
+
 void obj_release(ref_t *ref);
 
 int obj_alloc(pool_t *pool, obj_t **p_obj);
@@ -110,6 +114,7 @@ static inline int obj_put(obj_t *obj)
 }
 
 #define HANDLE_INDEX_MASK	(0x00ffffff)
+#define HANDLE_SHIFT ((sizeof(ptl_handle_any_t)*8)-8)
 
 /**
  * Convert a handle to an object index.
@@ -243,6 +243,18 @@ param_t param[] = {
                       .max = LONG_MAX,
                       .val = 500,
                       },
+    [PTL_SHMEM_EAGER_SIZE] = {
+                              .name = "PTL_SHMEM_EAGER_SIZE",
+                              .min = 0,
+                              .max = 1 * MiB,
+                              .val = 16 * KiB,
+                              },
+    [PTL_NUM_SHMEM_EAGER_SBUF] = {
+                                  .name = "PTL_NUM_SHMEM_EAGER_SBUF",
+                                  .min = 1,
+                                  .max = 100000,
+                                  .val = 64,
+                                  },
     [PTL_LOG_LEVEL] = {
                        .name = "PTL_LOG_LEVEL",
                        .min = 0,
@@ -279,6 +291,132 @@ param_t param[] = {
                                    .max = 1,
                                    .val = 0,
                                   },
+    [PTL_CONN_HASH_SIZE] = {
+                            .name = "PTL_CONN_HASH_SIZE",
+                            .min = 1,
+                            .max = 16 * MiB,
+                            .val = 4 * KiB,
+                            },
+    [PTL_COMPRESS_MAP] = {
+                          .name = "PTL_COMPRESS_MAP",
+                          .min = 0,
+                          .max = 1,
+                          .val = 1,
+                          },
+    [PTL_PRECONNECT] = {
+                        .name = "PTL_PRECONNECT",
+                        .min = 0,
+                        .max = 1,
+                        .val = 0,
+                        },
+    [PTL_ENABLE_SELF] = {
+                         .name = "PTL_ENABLE_SELF",
+                         .min = 0,
+                         .max = 1,
+                         .val = 1,
+                         },
+    [PTL_ENABLE_FAST_PATH] = {
+                              .name = "PTL_ENABLE_FAST_PATH",
+                              .min = 0,
+                              .max = 1,
+                              .val = 1,
+                              },
+    [PTL_ACK_MERGE] = {
+                       .name = "PTL_ACK_MERGE",
+                       .min = 0,
+                       .max = 1,
+                       .val = 0,
+                       },
+    [PTL_ACK_MERGE_MAX] = {
+                           .name = "PTL_ACK_MERGE_MAX",
+                           .min = 1,
+                           .max = 1 * MiB,
+                           .val = 32,
+                           },
+    [PTL_ACK_MERGE_USEC] = {
+                            .name = "PTL_ACK_MERGE_USEC",
+                            .min = 0,
+                            .max = 1000000,
+                            .val = 50,
+                            },
+    [PTL_UDP_RNDV] = {
+                      .name = "PTL_UDP_RNDV",
+                      .min = 0,
+                      .max = 1,
+                      .val = 1,
+                      },
+    [PTL_UDP_RNDV_THRESHOLD] = {
+                                .name = "PTL_UDP_RNDV_THRESHOLD",
+                                .min = 0,
+                                .max = 1 * GiB,
+                                .val = 64 * KiB,
+                                },
+    [PTL_UDP_RNDV_CHUNK] = {
+                            .name = "PTL_UDP_RNDV_CHUNK",
+                            .min = 1 * KiB,
+                            .max = 64 * KiB,
+                            .val = 64 * KiB,
+                            },
+    [PTL_UDP_RNDV_USEC] = {
+                           .name = "PTL_UDP_RNDV_USEC",
+                           .min = 1000,
+                           .max = 10000000,
+                           .val = 100000,
+                           },
+    [PTL_POOL_PREWARM] = {
+                          .name = "PTL_POOL_PREWARM",
+                          .min = 0,
+                          .max = 1 * MiB,
+                          .val = 0,
+                          },
+    [PTL_POOL_IDLE_USEC] = {
+                            .name = "PTL_POOL_IDLE_USEC",
+                            .min = 0,
+                            .max = 1000000000,
+                            .val = 1000000,
+                            },
+    [PTL_COPY_NT] = {
+                     .name = "PTL_COPY_NT",
+                     .min = 0,
+                     .max = 1,
+                     .val = 1,
+                     },
+    [PTL_COPY_NT_SIZE] = {
+                          .name = "PTL_COPY_NT_SIZE",
+                          .min = 0,
+                          .max = 1 * GiB,
+                          .val = 0,
+                          },
+    [PTL_COPY_THREADS] = {
+                          .name = "PTL_COPY_THREADS",
+                          .min = 0,
+                          .max = 64,
+                          .val = 0,
+                          },
+    [PTL_COPY_MT_SIZE] = {
+                          .name = "PTL_COPY_MT_SIZE",
+                          .min = 64 * KiB,
+                          .max = 1 * GiB,
+                          .val = 4 * MiB,
+                          },
+    [PTL_PPE_ASYNC] = {
+                       .name = "PTL_PPE_ASYNC",
+                       .min = 0,
+                       .max = 1,
+                       .val = 1,
+                       },
+    [PTL_PPE_RINGS] = {
+                       .name = "PTL_PPE_RINGS",
+                       .min = 0,
+                       .max = 4096,
+                       .val = 64,
+                       },
+    [PTL_PPE_PIN_THREADS] = {
+                             .name = "PTL_PPE_PIN_THREADS",
+                             .min = 0,
+                             .max = 1,
+                             .val = 0,
+                             },
 };
 
 /**
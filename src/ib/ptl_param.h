@@ -47,6 +47,8 @@ enum {
     PTL_EQ_WAIT_LOOP_COUNT,
     PTL_EQ_POLL_LOOP_COUNT,
     PTL_NUM_SBUF,
+    PTL_SHMEM_EAGER_SIZE,
+    PTL_NUM_SHMEM_EAGER_SBUF,
 
     PTL_LOG_LEVEL,
     PTL_DEBUG,
@@ -54,6 +56,27 @@ enum {
     PTL_BOUNCE_NUM_BUFS,
     PTL_BOUNCE_BUF_SIZE,
     PTL_DISABLE_MEM_REG_CACHE,
+    PTL_CONN_HASH_SIZE,
+    PTL_COMPRESS_MAP,
+    PTL_PRECONNECT,
+    PTL_ENABLE_SELF,
+    PTL_ENABLE_FAST_PATH,
+    PTL_ACK_MERGE,
+    PTL_ACK_MERGE_MAX,
+    PTL_ACK_MERGE_USEC,
+    PTL_UDP_RNDV,
+    PTL_UDP_RNDV_THRESHOLD,
+    PTL_UDP_RNDV_CHUNK,
+    PTL_UDP_RNDV_USEC,
+    PTL_POOL_PREWARM,
+    PTL_POOL_IDLE_USEC,
+    PTL_COPY_NT,
+    PTL_COPY_NT_SIZE,
+    PTL_COPY_THREADS,
+    PTL_COPY_MT_SIZE,
+    PTL_PPE_ASYNC,
+    PTL_PPE_RINGS,
+    PTL_PPE_PIN_THREADS,
     PTL_PARAM_LAST,             /* keep me last */
 };
 
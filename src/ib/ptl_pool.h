@@ -11,11 +11,10 @@
  * Slabs are maintained in 'chunks' which are page sized arrays of
  * slab_info structs.
  *
- * And chunks are maintained in circular lists within pools. The
- * current design is very simple and only allows the object resources
- * in a pool to grow. Additional work would allow this design to
- * dynamically grow and shrink the amount of memory used in a given
- * pool.
+ * And chunks are maintained in circular lists within pools. A pool
+ * grows when its free list is empty. pool_shrink() gives the memory
+ * of the slabs whose objects are all free back to the OS, and
+ * pool_prewarm() grows a pool ahead of time.
  *
  * Pools are designed to allow an object to 'own' pools of other objects
  * in a heirarchy. All objects eventually belong to an NI which is the
@@ -40,6 +39,7 @@ enum obj_type {
     POOL_MD,
     POOL_EQ,
     POOL_CT,
+    POOL_PREP,
     POOL_BUF,
     POOL_SBUF,
     POOL_PPEBUF,
@@ -111,6 +111,10 @@ struct pool {
         /** if set, called when object moved to the free list */
     void (*cleanup) (void *arg);
 
+        /** if set, called while waiting for an object to be freed
+         * in a pool that cannot expand */
+    void (*starved) (struct pool *pool);
+
         /** list of chunks each of which holds an array of slab descriptors */
     struct list_head chunk_list;
 
@@ -143,6 +147,24 @@ struct pool {
 
         /** address of preallocated slab */
     void *pre_alloc_buffer;
+
+        /** number of slabs holding objects */
+    int num_slabs;
+
+        /** pool_shrink() keeps at least that many objects */
+    int min_objs;
+
+        /** slabs added, and that count at the last pool_shrink() */
+    unsigned int grows;
+    unsigned int shrink_grows;
+
+        /** slabs released by pool_shrink(), reused before new ones */
+    void **released_slabs;
+    int num_released_slabs;
+
+        /** indexes of the objects in the released slabs */
+    unsigned int *free_index;
+    int num_free_index;
 };
 
 typedef struct pool pool_t;
@@ -32,3 +32,118 @@ char *ptl_ppe_socket_name(void)
 
     return socket_name;
 }
+
+#if !USE_XPMEM
+
+/* Allocate some zeroed memory to share with a client, in a memfd. */
+void *ppe_shm_alloc(size_t size, struct xpmem_map *mapping)
+{
+    void *addr;
+    int fd;
+
+    fd = memfd_create("portals-ppe", MFD_CLOEXEC);
+    if (fd == -1) {
+        WARN();
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) == -1) {
+        WARN();
+        close(fd);
+        return NULL;
+    }
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        WARN();
+        close(fd);
+        return NULL;
+    }
+
+    mapping->source_addr = addr;
+    mapping->size = size;
+    mapping->offset = 0;
+    mapping->fd = fd;
+    mapping->ptr_attach = NULL;
+
+    return addr;
+}
+
+/* Release memory from ppe_shm_alloc(). */
+void ppe_shm_free(struct xpmem_map *mapping)
+{
+    if (mapping->fd != -1) {
+        close(mapping->fd);
+        mapping->fd = -1;
+    }
+
+    if (mapping->source_addr) {
+        munmap((void *)mapping->source_addr, mapping->size);
+        mapping->source_addr = NULL;
+    }
+}
+
+/* Pass a file descriptor on a unix socket. */
+int ppe_send_fd(int s, int fd)
+{
+    char byte = 0;
+    struct iovec iov = {.iov_base = &byte,.iov_len = 1 };
+    union {
+        struct cmsghdr cmsg;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *cmsg;
+
+    memset(&control, 0, sizeof(control));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    if (sendmsg(s, &msg, MSG_NOSIGNAL) != 1)
+        return PTL_FAIL;
+
+    return PTL_OK;
+}
+
+/* Receive a file descriptor sent with ppe_send_fd(). Return -1 on
+ * error. */
+int ppe_recv_fd(int s)
+{
+    char byte;
+    struct iovec iov = {.iov_base = &byte,.iov_len = 1 };
+    union {
+        struct cmsghdr cmsg;
+        char buf[CMSG_SPACE(sizeof(int))];
+    } control;
+    struct msghdr msg = {
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof(control.buf),
+    };
+    struct cmsghdr *cmsg;
+    int fd;
+
+    if (recvmsg(s, &msg, MSG_CMSG_CLOEXEC) != 1)
+        return -1;
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+        cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+        return -1;
+
+    memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+    return fd;
+}
+
+#endif
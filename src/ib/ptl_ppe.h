@@ -12,6 +12,7 @@ char *ptl_ppe_socket_name(void);
 
 enum ppe_op {
     OP_PtlAtomic = 1,
+    OP_PtlAtomicPrepare,
     OP_PtlAtomicSync,
     OP_PtlCTAlloc,
     OP_PtlCTCancelTriggered,
@@ -36,6 +37,7 @@ enum ppe_op {
     OP_PtlMEAppend,
     OP_PtlMESearch,
     OP_PtlMEUnlink,
+    OP_PtlNIConnect,
     OP_PtlNIFini,
     OP_PtlNIHandle,
     OP_PtlNIInit,
@@ -44,7 +46,10 @@ enum ppe_op {
     OP_PtlPTDisable,
     OP_PtlPTEnable,
     OP_PtlPTFree,
+    OP_PtlPreparedIssue,
+    OP_PtlPreparedRelease,
     OP_PtlPut,
+    OP_PtlPutPrepare,
     OP_PtlSetMap,
     OP_PtlSwap,
     OP_PtlTriggeredAtomic,
@@ -101,6 +106,12 @@ struct ppe_msg {
             ptl_size_t actual_map_size;
         } PtlGetMap;
 
+        struct {
+            ptl_handle_ni_t ni_handle;
+            ptl_size_t num_targets;
+            const ptl_process_t *targets;
+        } PtlNIConnect;
+
         struct {
             ptl_handle_ni_t ni_handle;
             unsigned int options;
@@ -254,6 +265,40 @@ struct ppe_msg {
             ptl_datatype_t datatype;
         } PtlAtomic;
 
+        struct {
+            ptl_handle_md_t md_handle;
+            ptl_ack_req_t ack_req;
+            ptl_process_t target_id;
+            ptl_pt_index_t pt_index;
+            ptl_match_bits_t match_bits;
+            void *user_ptr;
+            ptl_handle_prep_t prep_handle;
+        } PtlPutPrepare;
+
+        struct {
+            ptl_handle_md_t md_handle;
+            ptl_ack_req_t ack_req;
+            ptl_process_t target_id;
+            ptl_pt_index_t pt_index;
+            ptl_match_bits_t match_bits;
+            void *user_ptr;
+            ptl_op_t operation;
+            ptl_datatype_t datatype;
+            ptl_handle_prep_t prep_handle;
+        } PtlAtomicPrepare;
+
+        struct {
+            ptl_handle_prep_t prep_handle;
+            ptl_size_t local_offset;
+            ptl_size_t length;
+            ptl_size_t remote_offset;
+            ptl_hdr_data_t hdr_data;
+        } PtlPreparedIssue;
+
+        struct {
+            ptl_handle_prep_t prep_handle;
+        } PtlPreparedRelease;
+
         struct {
             ptl_handle_md_t get_md_handle;
             ptl_size_t local_get_offset;
@@ -423,6 +468,10 @@ typedef struct ppebuf {
 	 * buffer. */
     unsigned int completed;
 
+        /** Set to 1 when the client does not wait for the reply. The
+	 * PPE frees the buffer, and reports an error on the MD. */
+    unsigned int async;
+
         /** Message from client to PPE, with response from PPE. */
     struct ppe_msg msg;
 } ppebuf_t;
@@ -430,6 +479,24 @@ typedef struct ppebuf {
 /* Maximum number of progress threads on the PPE. */
 #define MAX_PROGRESS_THREADS 10
 
+/* Number of command slots in a ring. Must be a power of 2. */
+#define PPE_RING_SIZE 64
+
+/* Command ring, from a client to the PPE, for the operations the
+ * client does not wait for. The client is the only producer, and the
+ * progress thread of that client the only consumer. The PPE processes
+ * all the commands between tail and head, then gives their slots back
+ * at once by moving tail. */
+struct ppe_ring {
+    /* Next slot to fill. Only written by the client. */
+    volatile unsigned int head __attribute__ ((aligned(64)));
+
+    /* Next slot to process. Only written by the PPE. */
+    volatile unsigned int tail __attribute__ ((aligned(64)));
+
+    ppebuf_t slot[PPE_RING_SIZE] __attribute__ ((aligned(64)));
+};
+
 /* Communication PAD. Created by the PPE and shared with the clients. */
 struct ppe_comm_pad {
     /* Clients enqueue ppebufs here, and PPE consummes. */
@@ -441,6 +508,10 @@ struct ppe_comm_pad {
      * mapped through XPMEM by the PPE. */
     pool_t ppebuf_pool __attribute__ ((aligned(64)));
 
+    /* The command rings, after the ppebufs slab. */
+    int num_rings;
+    size_t rings_offset;
+
     /* The ppebufs slab. */
     ppebuf_t ppebuf_slab[0] __attribute__ ((aligned(4096)));
 };
@@ -463,6 +534,7 @@ union msg_ppe_client {
         struct xpmem_map ppebufs_mapping;
         void *ppebufs_ppeaddr;
         int queue_index;
+        int ring_index;         /* -1 if no ring was left */
     } rep;
 };
 
@@ -573,6 +645,20 @@ int _PtlTriggeredFetchAtomic(PPEGBL ptl_handle_md_t get_md_handle,
                              ptl_handle_ct_t trig_ct_handle,
                              ptl_size_t threshold);
 int _PtlAtomicSync(void);
+int _PtlPutPrepare(PPEGBL ptl_handle_md_t md_handle, ptl_ack_req_t ack_req,
+                   ptl_process_t target_id, ptl_pt_index_t pt_index,
+                   ptl_match_bits_t match_bits, void *user_ptr,
+                   ptl_handle_prep_t *prep_handle);
+int _PtlAtomicPrepare(PPEGBL ptl_handle_md_t md_handle,
+                      ptl_ack_req_t ack_req, ptl_process_t target_id,
+                      ptl_pt_index_t pt_index, ptl_match_bits_t match_bits,
+                      void *user_ptr, ptl_op_t atom_op,
+                      ptl_datatype_t atom_type,
+                      ptl_handle_prep_t *prep_handle);
+int _PtlPreparedIssue(PPEGBL ptl_handle_prep_t prep_handle,
+                      ptl_size_t local_offset, ptl_size_t length,
+                      ptl_size_t remote_offset, ptl_hdr_data_t hdr_data);
+int _PtlPreparedRelease(PPEGBL ptl_handle_prep_t prep_handle);
 int _PtlSwap(PPEGBL ptl_handle_md_t get_md_handle,
              ptl_size_t local_get_offset, ptl_handle_md_t put_md_handle,
              ptl_size_t local_put_offset, ptl_size_t length,
@@ -596,6 +682,8 @@ int _PtlSetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
                const ptl_process_t *mapping);
 int _PtlGetMap(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t map_size,
                ptl_process_t *mapping, ptl_size_t *actual_map_size);
+int _PtlNIConnect(PPEGBL ptl_handle_ni_t ni_handle, ptl_size_t num_targets,
+                  const ptl_process_t *targets);
 int _PtlNIStatus(PPEGBL ptl_handle_ni_t ni_handle, ptl_sr_index_t index,
                  ptl_sr_value_t *status);
 int _PtlNIHandle(PPEGBL ptl_handle_any_t handle, ptl_handle_ni_t *ni_handle);
@@ -625,6 +713,7 @@ int _PtlPTEnable(PPEGBL ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index);
 
 #define _PtlAtomic PtlAtomic
 #define _PtlAtomicSync PtlAtomicSync
+#define _PtlAtomicPrepare PtlAtomicPrepare
 #define _PtlCTAlloc PtlCTAlloc
 #define _PtlCTCancelTriggered PtlCTCancelTriggered
 #define _PtlCTFree PtlCTFree
@@ -653,6 +742,7 @@ int _PtlPTEnable(PPEGBL ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index);
 #define _PtlMEAppend PtlMEAppend
 #define _PtlMESearch PtlMESearch
 #define _PtlMEUnlink PtlMEUnlink
+#define _PtlNIConnect PtlNIConnect
 #define _PtlNIHandle PtlNIHandle
 #define _PtlNIStatus PtlNIStatus
 #define _PtlPTAlloc PtlPTAlloc
@@ -660,6 +750,9 @@ int _PtlPTEnable(PPEGBL ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index);
 #define _PtlPTEnable PtlPTEnable
 #define _PtlPTFree PtlPTFree
 #define _PtlPut PtlPut
+#define _PtlPutPrepare PtlPutPrepare
+#define _PtlPreparedIssue PtlPreparedIssue
+#define _PtlPreparedRelease PtlPreparedRelease
 #define _PtlSetMap PtlSetMap
 #define _PtlStartBundle PtlStartBundle
 #define _PtlSwap PtlSwap
@@ -0,0 +1,102 @@
+/**
+ * @file ptl_prep.h
+ */
+
+#ifndef PTL_PREP_H
+#define PTL_PREP_H
+
+/**
+ * Prepared operation object.
+ *
+ * Holds what a put or an atomic issued many times with the same MD,
+ * target, portal index and match bits has in common.
+ */
+struct prep {
+        /** object base class */
+    obj_t obj;
+
+        /** md the data is taken from, referenced */
+    struct md *md;
+
+        /** connection to the target, referenced */
+    struct conn *conn;
+
+        /** target process */
+    ptl_process_t target;
+
+        /** user pointer passed back with the events */
+    void *user_ptr;
+
+        /** initiator event mask, as computed by the start state */
+    unsigned int event_mask;
+
+        /** request header, except for the per operation fields */
+    req_hdr_t hdr;
+};
+
+typedef struct prep prep_t;
+
+void prep_cleanup(void *arg);
+
+/**
+ * Allocate a new prepared operation object.
+ *
+ * @param[in] ni the ni for which to allocate a prepared operation
+ * @param[out] prep_p the location in which to return the object
+ *
+ * @return status
+ */
+static inline int prep_alloc(ni_t *ni, prep_t **prep_p)
+{
+    int err;
+    obj_t *obj;
+
+    err = obj_alloc(&ni->prep_pool, &obj);
+    if (err) {
+        *prep_p = NULL;
+        return err;
+    }
+
+    *prep_p = container_of(obj, prep_t, obj);
+    return PTL_OK;
+}
+
+/**
+ * Convert a prepared operation handle to its object.
+ *
+ * Takes a reference to the object.
+ *
+ * @param[in] handle the prepared operation handle
+ *
+ * @return the object or NULL if the handle is invalid
+ */
+static inline prep_t *to_prep(PPEGBL ptl_handle_prep_t handle)
+{
+    return to_obj(MYGBL_ POOL_PREP, (ptl_handle_any_t) handle);
+}
+
+/**
+ * Drop a reference to a prepared operation.
+ *
+ * @param[in] prep the prepared operation
+ *
+ * @return status
+ */
+static inline int prep_put(prep_t *prep)
+{
+    return obj_put(&prep->obj);
+}
+
+/**
+ * Get the handle of a prepared operation.
+ *
+ * @param[in] prep the prepared operation
+ *
+ * @return the handle
+ */
+static inline ptl_handle_prep_t prep_to_handle(prep_t *prep)
+{
+    return (ptl_handle_prep_t)prep->obj.obj_handle;
+}
+
+#endif /* PTL_PREP_H */
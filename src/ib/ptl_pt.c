@@ -276,7 +276,8 @@ int _PtlPTDisable(PPEGBL ptl_handle_ni_t ni_handle, ptl_pt_index_t pt_index)
     pt->state = PT_DISABLED;
     while (pt->num_tgt_active) {
         PTL_FASTLOCK_UNLOCK(&pt->lock);
-        sched_yield();
+        if (!ni_progress(ni))
+            sched_yield();
         PTL_FASTLOCK_LOCK(&pt->lock);
     }
     PTL_FASTLOCK_UNLOCK(&pt->lock);
@@ -301,8 +301,8 @@ static int rdma_init_prepare_transfer(md_t *md, data_dir_t dir,
         mr_t *mr;
         if (md->num_iov) {
             err =
-                append_immediate_data(md->start, md->mr_list, md->num_iov,
-                                      dir, offset, length, buf);
+                append_immediate_data(md->start, md->iov_end, md->mr_list,
+                                      md->num_iov, dir, offset, length, buf);
         } else {
             err =
                 mr_lookup_app(obj_to_ni(md), md->start + offset, length, &mr);
@@ -312,7 +312,7 @@ static int rdma_init_prepare_transfer(md_t *md, data_dir_t dir,
             }
 
             err =
-                append_immediate_data(md->start, &mr, md->num_iov, dir,
+                append_immediate_data(md->start, NULL, &mr, md->num_iov, dir,
                                       offset, length, buf);
 
             mr_put(mr);
@@ -323,8 +323,8 @@ static int rdma_init_prepare_transfer(md_t *md, data_dir_t dir,
         /* Find the index and offset of the first IOV as well as the
          * total number of IOVs to transfer. */
         num_sge =
-            iov_count_elem(iovecs, md->num_iov, offset, length, &iov_start,
-                           &iov_offset);
+            iov_count_elem(iovecs, md->iov_end, md->num_iov, offset, length,
+                           &iov_start, &iov_offset);
         if (num_sge < 0) {
             WARN();
             return PTL_FAIL;
@@ -51,6 +51,10 @@ static int comp_poll(ni_t *ni, int num_wc, struct ibv_wc wc_list[],
     while (ni->catcher_stop == 0 && ret == 0) {
         ret = ibv_poll_cq(ni->rdma.cq, num_wc, wc_list);
         if (ret <= 0) {
+            /* Called by the application. Don't block. */
+            if (ni->options & PTL_NI_APP_PROGRESS)
+                return 0;
+
             rep_poll++;
             pthread_yield();
 
@@ -281,6 +285,11 @@ static int recv_packet(buf_t *buf)
             return STATE_RECV_REQ;
     } else if (hdr->operation >= OP_REPLY) {
         return STATE_RECV_INIT;
+#if WITH_TRANSPORT_UDP
+    } else if (hdr->operation == OP_UDP_PULL ||
+               hdr->operation == OP_UDP_PULL_DATA) {
+        return udp_recv_rndv(obj_to_ni(buf), buf);
+#endif
     } else {
 #if WITH_TRANSPORT_IB
         /* Disconnect. */
@@ -363,7 +372,9 @@ static int recv_req(buf_t *buf)
 
 #if WITH_TRANSPORT_UDP
     //REG: indicate that this buffer is OK to free later
-    if (buf->tgt_state != STATE_TGT_WAIT_APPEND) {
+    //A rendezvous put is freed once all its data has been pulled
+    if (buf->tgt_state != STATE_TGT_WAIT_APPEND &&
+        buf->tgt_state != STATE_TGT_UDP) {
         buf->completed = 1;
     } else {
         buf->completed = 0;
@@ -387,6 +398,18 @@ static int recv_init(PPEGBL buf_t *buf)
     buf_t *init_buf;
     ack_hdr_t *hdr = (ack_hdr_t *) buf->data;
 
+#if !IS_PPE
+    /* A merged ack has no initiator buf, only an MD. */
+    if (hdr->h1.operation == OP_MERGED_ACK) {
+        err = process_merged_ack(obj_to_ni(buf), buf);
+        if (err)
+            return STATE_RECV_DROP_BUF;
+
+        buf_put(buf);
+        return STATE_RECV_REPOST;
+    }
+#endif
+
     /* lookup the buf handle to get original buf */
     err = to_buf(MYGBL_ le32_to_cpu(hdr->h1.handle), &init_buf);
     if (err) {
@@ -413,7 +436,7 @@ static int recv_init(PPEGBL buf_t *buf)
 
 #if WITH_TRANSPORT_UDP
     conn_t *conn;
-    conn = get_conn(buf->obj.obj_ni, buf->obj.obj_ni->id);
+    conn = get_peer_conn(buf->obj.obj_ni, buf->obj.obj_ni->id);
 
     if (conn->transport.type == CONN_TYPE_UDP) {
         ptl_info("udp connection processing \n");
@@ -579,6 +602,9 @@ void progress_thread_udp(ni_t *ni)
         int err;
         buf_t *udp_buf;
 
+        /* Ask again for the rendezvous data that did not come. */
+        udp_rndv_progress(ni);
+
         udp_buf = udp_receive(ni);
 
         if (udp_buf != NULL) {
@@ -638,9 +664,9 @@ void progress_thread_udp(ni_t *ni)
                     if (udp_buf->put_ct != NULL) {
                         ptl_info("putct is : %p \n", udp_buf->put_ct);
                     }
-                    pthread_mutex_init(&udp_buf->mutex, NULL);
+                    PTL_YIELDLOCK_INIT(&udp_buf->lock);
                     udp_buf->obj.obj_ni = ni;
-                    udp_buf->conn = get_conn(ni, ni->id);
+                    udp_buf->conn = get_peer_conn(ni, ni->id);
                     udp_buf->conn->state = CONN_STATE_CONNECTED;
                     process_recv_udp(ni, udp_buf);
                     break;
@@ -685,23 +711,17 @@ void progress_thread_udp(ni_t *ni)
                 case BUF_UDP_CONN_REP:{
                     ptl_info
                         ("UDP connection reply received, validating connection \n");
-                    udp_buf->conn->state = CONN_STATE_CONNECTED;
-
-                    udp_buf->conn->udp.dest_addr = udp_buf->udp.src_addr;
-
-                    int result;
-
-                    //release the thread waiting on the establishment of a connection
-                    while (1) {
-                        result = atomic_read(&udp_buf->conn->udp.is_waiting);
-                        if (result > 0) {
-                            ptl_info("release wait on %p \n",
-                                     &udp_buf->conn->move_wait);
-                            pthread_cond_broadcast(&udp_buf->conn->move_wait);
-                            atomic_set(&udp_buf->conn->udp.is_waiting, 0);
-                            break;
-                        }
-                    }
+                    conn_t *conn = udp_buf->conn;
+
+                    /* Waiters check the state under the mutex, so the
+                     * broadcast cannot be lost, and nobody needs to be
+                     * waiting yet (e.g. PtlNIConnect without waiting). */
+                    pthread_mutex_lock(&conn->mutex);
+                    conn->state = CONN_STATE_CONNECTED;
+                    conn->udp.dest_addr = udp_buf->udp.src_addr;
+                    ptl_info("release wait on %p \n", &conn->move_wait);
+                    pthread_cond_broadcast(&conn->move_wait);
+                    pthread_mutex_unlock(&conn->mutex);
                     ptl_info("connection valid for reply\n");
                     break;
                 }
@@ -782,9 +802,9 @@ void progress_thread_udp(ni_t *ni)
 }
 #endif
 
-#if WITH_TRANSPORT_SHMEM || IS_PPE || WITH_TRANSPORT_UDP
 /**
- * Process a received message in shared memory.
+ * Process a received message in shared memory, or from the NI
+ * itself.
  *
  * @param ni the ni to poll.
  * @param buf the received buffer.
@@ -831,7 +851,6 @@ void process_recv_mem(ni_t *ni, buf_t *buf)
   exit:
     return;
 }
-#endif
 
 #if WITH_TRANSPORT_UDP
 /**
@@ -890,168 +909,208 @@ void process_recv_udp(ni_t *ni, buf_t *buf)
 
 #if !IS_PPE
 /**
- * Progress thread. Waits for ib, udp, and/or shared memory messages.
+ * Look once for ib, udp, and/or shared memory messages and process
+ * them.
  *
- * @param arg opaque pointer to ni.
+ * @param[in] ni the NI to progress.
  */
-
-static void *progress_thread(void *arg)
+static void progress(ni_t *ni)
 {
-    ni_t *ni = arg;
 #if WITH_TRANSPORT_SHMEM
     int err = 0;
 #endif
 
-    while (!ni->catcher_stop
-#if WITH_TRANSPORT_SHMEM
-           //  || atomic_read(&ni->sbuf_pool.count)
-#endif
-        ) {
+    progress_self(ni);
+
+    /* Send the merged acks that have waited long enough. */
+    flush_merged_acks(ni, 0);
 
-        progress_thread_rdma(ni);
+    /* Give back the memory the pools grew for a burst. */
+    ni_shrink_pools(ni, 0);
 
-        progress_thread_udp(ni);
+    progress_thread_rdma(ni);
+
+    progress_thread_udp(ni);
 
 #if WITH_TRANSPORT_SHMEM
-        /* Shared memory. Physical NIs don't have a receive queue. */
-        if (ni->shmem.queue) {
-            
-            buf_t *shmem_buf;
-
-            shmem_buf = shmem_dequeue(ni);
-
-            if (shmem_buf) {
-                switch (shmem_buf->type) {
-                    case BUF_SHMEM_SEND:{
-                        buf_t *buf;
-
-                        /* Mark it for return now. The target state machine might
-                         * change its type to BUF_SHMEM_SEND. */
-                        shmem_buf->type = BUF_SHMEM_RETURN;
-
-                        err = buf_alloc(ni, &buf);
-                        if (err) {
-                            WARN();
-                        } else {
-                            buf->data = shmem_buf->internal_data;
-                            buf->length = shmem_buf->length;
-                            buf->mem_buf = shmem_buf;
-                            INIT_LIST_HEAD(&buf->list);
-                            process_recv_mem(ni, buf);
-                        }
+    /* Shared memory. Physical NIs don't have a receive queue. */
+    if (ni->shmem.queue) {
+        
+        buf_t *shmem_buf;
+
+        shmem_buf = shmem_dequeue(ni);
+
+        if (shmem_buf) {
+            switch (shmem_buf->type) {
+                case BUF_SHMEM_SEND:{
+                    buf_t *buf;
+
+                    /* Mark it for return now. The target state machine might
+                     * change its type to BUF_SHMEM_SEND. */
+                    shmem_buf->type = BUF_SHMEM_RETURN;
+
+                    err = buf_alloc(ni, &buf);
+                    if (err) {
+                        WARN();
+                    } else {
+                        buf->data = buf_data_area(shmem_buf);
+                        buf->length = shmem_buf->length;
+                        buf->mem_buf = shmem_buf;
+                        INIT_LIST_HEAD(&buf->list);
+                        process_recv_mem(ni, buf);
+                    }
 
 #if WITH_TRANSPORT_SHMEM && !USE_KNEM
-                        /* Don't send back if it's on the noknem list. */
-                        PTL_FASTLOCK_LOCK(&ni->shmem.noknem_lock);
-                        if (!list_empty(&buf->list)) {
-                            PTL_FASTLOCK_UNLOCK(&ni->shmem.noknem_lock);
-                            break;
-                        }
+                    /* Don't send back if it's on the noknem list. */
+                    PTL_FASTLOCK_LOCK(&ni->shmem.noknem_lock);
+                    if (!list_empty(&buf->list)) {
                         PTL_FASTLOCK_UNLOCK(&ni->shmem.noknem_lock);
+                        break;
+                    }
+                    PTL_FASTLOCK_UNLOCK(&ni->shmem.noknem_lock);
 #endif
 #if WITH_TRANSPORT_IB
-                        if (buf_ref_cnt(buf) == 1 && 
-                            !(buf->event_mask & XI_RECEIVE_EXPECTED) && 
-                            (buf->type == BUF_TGT)) {
-                            ptl_warn("freeing a shared mem buf of type: %i with mask %X \n",buf->type, buf->event_mask);
-			    buf->type = BUF_FREE;
-			    buf_put(buf);
-			}
+                    if (buf_ref_cnt(buf) == 1 && 
+                        !(buf->event_mask & XI_RECEIVE_EXPECTED) && 
+                        (buf->type == BUF_TGT)) {
+                        ptl_warn("freeing a shared mem buf of type: %i with mask %X \n",buf->type, buf->event_mask);
+                        buf->type = BUF_FREE;
+                        buf_put(buf);
+                    }
 #endif
-                        if (shmem_buf->type == BUF_SHMEM_SEND ||
-                            shmem_buf->shmem.index_owner != ni->mem.index) {
-                            /* Requested to send the buffer back, or not the
-                             * owner. Send the buffer back in both cases. */
-                            shmem_enqueue(ni, shmem_buf,
-                                          shmem_buf->shmem.index_owner);
-                        } else {
-                            /* It was returned to us with a message from a remote
-                             * rank. From send_message_shmem(). */
-                            buf_put(shmem_buf);
-                        }
+                    if (shmem_buf->type == BUF_SHMEM_SEND ||
+                        shmem_buf->shmem.index_owner != ni->mem.index) {
+                        /* Requested to send the buffer back, or not the
+                         * owner. Send the buffer back in both cases. */
+                        shmem_enqueue(ni, shmem_buf,
+                                      shmem_buf->shmem.index_owner);
+                    } else {
+                        /* It was returned to us with a message from a remote
+                         * rank. From send_message_shmem(). */
+                        buf_put(shmem_buf);
                     }
-                        break;
+                }
+                    break;
 
-                    case BUF_SHMEM_RETURN:
-                        /* Buffer returned to us by remote node. */
-                        assert(shmem_buf->shmem.index_owner == ni->mem.index);
+                case BUF_SHMEM_RETURN:
+                    /* Buffer returned to us by remote node. */
+                    assert(shmem_buf->shmem.index_owner == ni->mem.index);
 
-                        /* From send_message_shmem(). */
-                        buf_put(shmem_buf);
-                        break;
+                    /* From send_message_shmem(). */
+                    buf_put(shmem_buf);
+                    break;
 
-                    default:
-                        /* Should not happen. */
-                        abort();
-                }
+                default:
+                    /* Should not happen. */
+                    abort();
             }
         }
+    }
 #endif
 
 #if WITH_TRANSPORT_SHMEM && !USE_KNEM
-        struct list_head *l, *t;
-
-        /* TODO: instead of having a lock, the initiator should send
-         * the buf to itself, and on receiving it, the progress thread
-         * will put it on the list. That way, only the progress thread
-         * has access to the list. */
-        PTL_FASTLOCK_LOCK(&ni->shmem.noknem_lock);
+    struct list_head *l, *t;
+
+    /* TODO: instead of having a lock, the initiator should send
+     * the buf to itself, and on receiving it, the progress thread
+     * will put it on the list. That way, only the progress thread
+     * has access to the list. */
+    PTL_FASTLOCK_LOCK(&ni->shmem.noknem_lock);
+
+    list_for_each_safe(l, t, &ni->shmem.noknem_list) {
+        buf_t *buf = list_entry(l, buf_t, list);
+        struct noknem *noknem = buf->transfer.noknem.noknem;
+
+        if (buf->transfer.noknem.transfer_state_expected == noknem->state) {
+            if (noknem->state == 0){
+                err = process_init(buf);
+                if (unlikely(err))
+                    ptl_warn("Error in non-knem shared memory initiator processing\n");
+            }
+            else if (noknem->state == 2) {
+                if (noknem->init_done) {
+                    buf_t *shmem_buf = buf->mem_buf;
 
-        list_for_each_safe(l, t, &ni->shmem.noknem_list) {
-            buf_t *buf = list_entry(l, buf_t, list);
-            struct noknem *noknem = buf->transfer.noknem.noknem;
+                    /* The transfer is now done. Remove from
+                     * noknem_list. */
+                    list_del(&buf->list);
 
-            if (buf->transfer.noknem.transfer_state_expected == noknem->state) {
-                if (noknem->state == 0){
-                    err = process_init(buf);
+                    err = process_tgt(buf);
                     if (unlikely(err))
-                        ptl_warn("Error in non-knem shared memory initiator processing\n");
-                }
-                else if (noknem->state == 2) {
-                    if (noknem->init_done) {
-                        buf_t *shmem_buf = buf->mem_buf;
-
-                        /* The transfer is now done. Remove from
-                         * noknem_list. */
-                        list_del(&buf->list);
-
-                        err = process_tgt(buf);
-                        if (unlikely(err))
-                            ptl_warn("Error in non-knem shared memory target processing");
-
-                        if (shmem_buf->type == BUF_SHMEM_SEND ||
-                            shmem_buf->shmem.index_owner != ni->mem.index) {
-                            /* Requested to send the buffer back, or not the
-                             * owner. Send the buffer back in both cases. */
-                            shmem_enqueue(ni, shmem_buf,
-                                          shmem_buf->shmem.index_owner);
-                        } else {
-                            /* It was returned to us with a message from a remote
-                             * rank. From send_message_shmem(). */
-                            buf_put(shmem_buf);
-                        }
+                        ptl_warn("Error in non-knem shared memory target processing");
 
+                    if (shmem_buf->type == BUF_SHMEM_SEND ||
+                        shmem_buf->shmem.index_owner != ni->mem.index) {
+                        /* Requested to send the buffer back, or not the
+                         * owner. Send the buffer back in both cases. */
+                        shmem_enqueue(ni, shmem_buf,
+                                      shmem_buf->shmem.index_owner);
                     } else {
-                        err = process_tgt(buf);
-                        if (unlikely(err))
-                            ptl_warn("Error in non-knem shared memory target processing");
+                        /* It was returned to us with a message from a remote
+                         * rank. From send_message_shmem(). */
+                        buf_put(shmem_buf);
                     }
+
+                } else {
+                    err = process_tgt(buf);
+                    if (unlikely(err))
+                        ptl_warn("Error in non-knem shared memory target processing");
                 }
             }
         }
+    }
 
-        PTL_FASTLOCK_UNLOCK(&ni->shmem.noknem_lock);
+    PTL_FASTLOCK_UNLOCK(&ni->shmem.noknem_lock);
 #endif
+}
+
+/**
+ * Progress thread. Waits for ib, udp, and/or shared memory messages.
+ *
+ * @param arg opaque pointer to ni.
+ */
+
+static void *progress_thread(void *arg)
+{
+    ni_t *ni = arg;
+
+    while (!ni->catcher_stop
+#if WITH_TRANSPORT_SHMEM
+           //  || atomic_read(&ni->sbuf_pool.count)
+#endif
+        ) {
+        try_progress(ni);
     }
 
     return NULL;
 }
 
+/**
+ * Make progress, from the progress thread or from an application
+ * thread. Only one thread progresses the NI at a time; others, and
+ * nested calls from the progress code itself, return immediately.
+ *
+ * @param[in] ni the NI to progress.
+ */
+void try_progress(ni_t *ni)
+{
+    if (__sync_lock_test_and_set(&ni->progress_busy, 1))
+        return;
+
+    progress(ni);
+
+    __sync_lock_release(&ni->progress_busy);
+}
+
 /* Add a progress thread. */
 int start_progress_thread(ni_t *ni)
 {
     int ret;
 
+    /* The application threads drive the progress. */
+    if (ni->options & PTL_NI_APP_PROGRESS)
+        return PTL_OK;
+
     /* Keep the communication thread active at the end to terminate it */
     ni->catcher_nosleep = 0;
     atomic_set(&keep_polling, 0);
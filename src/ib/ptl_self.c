@@ -0,0 +1,250 @@
+/**
+ * @file ptl_self.c
+ *
+ * @brief Loopback transport.
+ *
+ * Used for the messages an NI sends to itself, instead of looping
+ * them through the network or the shared memory queues.
+ *
+ * A message is copied into a receive buffer queued on the NI. It
+ * cannot be processed right away because the initiator state
+ * machine still holds the sending buffer. Instead it is delivered by
+ * the operation that sent it, as soon as it has returned from
+ * process_init() (see ni_progress()), or else by the next progress
+ * loop. Large data is not staged in the message: the target state
+ * machine copies it once, directly between the MD and the ME/LE.
+ */
+
+#include "ptl_loc.h"
+
+static int self_init_connect(ni_t *ni, conn_t *conn)
+{
+    /* Nothing to do. */
+    conn->state = CONN_STATE_CONNECTED;
+
+    return PTL_OK;
+}
+
+/**
+ * @brief Send a message to ourselves.
+ *
+ * @param[in] buf the buffer to send
+ * @param[in] from_init whether the buffer comes from the initiator
+ *
+ * @return status
+ */
+static int self_send_message(buf_t *buf, int from_init)
+{
+    int err;
+    ni_t *ni = obj_to_ni(buf);
+    buf_t *recv_buf;
+
+    err = buf_alloc(ni, &recv_buf);
+    if (unlikely(err)) {
+        WARN();
+        return err;
+    }
+
+    memcpy(recv_buf->internal_data, buf->data, buf->length);
+    recv_buf->length = buf->length;
+
+    PTL_FASTLOCK_LOCK(&ni->self.lock);
+    list_add_tail(&recv_buf->list, &ni->self.queue);
+    PTL_FASTLOCK_UNLOCK(&ni->self.lock);
+
+    return PTL_OK;
+}
+
+static void self_set_send_flags(buf_t *buf, int can_signal)
+{
+    /* The message is copied when it is sent. */
+    buf->event_mask |= XX_INLINE;
+}
+
+/**
+ * @brief Build and append a data segment to a request message.
+ *
+ * Short data is sent inline, like the other transports do, since the
+ * atomic operations depend on it. Otherwise the segment only
+ * describes where the data is in the MD.
+ *
+ * @param[in] md the md that contains the data
+ * @param[in] dir the data direction, in or out
+ * @param[in] offset the offset into the md
+ * @param[in] length the length of the data
+ * @param[in] buf the buf the add the data segment to
+ *
+ * @return status
+ */
+static int self_init_prepare_transfer(md_t *md, data_dir_t dir,
+                                      ptl_size_t offset, ptl_size_t length,
+                                      buf_t *buf)
+{
+    data_t *data = (data_t *)(buf->data + buf->length);
+
+    if (length <= get_param(PTL_MAX_INLINE_DATA))
+        return append_immediate_data(md->start, md->iov_end, NULL,
+                                     md->num_iov, dir, offset, length, buf);
+
+    data->data_fmt = DATA_FMT_SELF;
+    data->self.start = md->start;
+    data->self.iov_end = md->iov_end;
+    data->self.offset = offset;
+    data->self.num_iov = md->num_iov;
+
+    buf->length += sizeof(*data);
+
+    assert(buf->length <= BUF_DATA_SIZE);
+
+    return PTL_OK;
+}
+
+static int self_tgt_data_out(buf_t *buf, data_t *data)
+{
+    if (data->data_fmt != DATA_FMT_SELF) {
+        WARN();
+        return STATE_TGT_ERROR;
+    }
+
+    return STATE_TGT_RDMA;
+}
+
+/**
+ * @brief Copy data between two buffers, each of which can be an
+ * iovec.
+ *
+ * @param[in] dst the destination start address or iovec array
+ * @param[in] dst_iov_end the end offsets of the destination iovec, or NULL
+ * @param[in] dst_num_iov the size of the destination iovec, or 0
+ * @param[in] dst_offset the offset into the destination
+ * @param[in] src the source start address or iovec array
+ * @param[in] src_iov_end the end offsets of the source iovec, or NULL
+ * @param[in] src_num_iov the size of the source iovec, or 0
+ * @param[in] src_offset the offset into the source
+ * @param[in] length the number of bytes to copy
+ *
+ * @return status
+ */
+static int self_copy(void *dst, const ptl_size_t *dst_iov_end,
+                     ptl_size_t dst_num_iov, ptl_size_t dst_offset,
+                     void *src, const ptl_size_t *src_iov_end,
+                     ptl_size_t src_num_iov, ptl_size_t src_offset,
+                     ptl_size_t length)
+{
+    ptl_iovec_t *iov;
+    ptl_size_t bytes;
+    int err;
+
+    if (!src_num_iov) {
+        if (!dst_num_iov) {
+            ptl_copy(dst + dst_offset, src + src_offset, length);
+            return PTL_OK;
+        }
+
+        return iov_copy_in(src + src_offset, dst, dst_iov_end, NULL,
+                           dst_num_iov, dst_offset, length);
+    }
+
+    if (!dst_num_iov)
+        return iov_copy_out(dst + dst_offset, src, src_iov_end, NULL,
+                            src_num_iov, src_offset, length);
+
+    /* Both sides are iovecs. Copy one source segment at a time. */
+    for (iov = src; src_num_iov && length; iov++, src_num_iov--) {
+        if (src_offset >= iov->iov_len) {
+            src_offset -= iov->iov_len;
+            continue;
+        }
+
+        bytes = iov->iov_len - src_offset;
+        if (bytes > length)
+            bytes = length;
+
+        err = iov_copy_in(iov->iov_base + src_offset, dst, dst_iov_end,
+                          NULL, dst_num_iov, dst_offset, bytes);
+        if (err)
+            return err;
+
+        src_offset = 0;
+        dst_offset += bytes;
+        length -= bytes;
+    }
+
+    if (length) {
+        WARN();
+        return PTL_FAIL;
+    }
+
+    return PTL_OK;
+}
+
+/**
+ * @brief Transfer the data of a put or a get, all at once.
+ *
+ * @param[in] buf The message buf received by the target.
+ *
+ * @return status
+ */
+static int self_do_transfer(buf_t *buf)
+{
+    int err;
+    me_t *me = buf->me;
+    data_t *data;
+
+    if (buf->rdma_dir == DATA_DIR_IN) {
+        data = buf->data_in;
+
+        err = self_copy(me->start, me->iov_end, me->num_iov, buf->moffset,
+                        data->self.start, data->self.iov_end,
+                        data->self.num_iov, data->self.offset,
+                        buf->put_resid);
+        buf->put_resid = 0;
+    } else {
+        data = buf->data_out;
+
+        err = self_copy(data->self.start, data->self.iov_end,
+                        data->self.num_iov, data->self.offset, me->start,
+                        me->iov_end, me->num_iov, buf->moffset,
+                        buf->get_resid);
+        buf->get_resid = 0;
+    }
+
+    if (err)
+        WARN();
+
+    return err;
+}
+
+/**
+ * @brief Deliver the messages the NI sent to itself.
+ *
+ * Only called from the progress function, so these messages are
+ * never processed by two threads at once.
+ *
+ * @param[in] ni the NI.
+ */
+void progress_self(ni_t *ni)
+{
+    buf_t *buf;
+
+    while (!list_empty(&ni->self.queue)) {
+        PTL_FASTLOCK_LOCK(&ni->self.lock);
+        buf = list_first_entry(&ni->self.queue, buf_t, list);
+        list_del(&buf->list);
+        PTL_FASTLOCK_UNLOCK(&ni->self.lock);
+
+        INIT_LIST_HEAD(&buf->list);
+        process_recv_mem(ni, buf);
+    }
+}
+
+struct transport transport_self = {
+    .type = CONN_TYPE_SELF,
+    .buf_alloc = buf_alloc,
+    .init_connect = self_init_connect,
+    .send_message = self_send_message,
+    .set_send_flags = self_set_send_flags,
+    .init_prepare_transfer = self_init_prepare_transfer,
+    .post_tgt_dma = self_do_transfer,
+    .tgt_data_out = self_tgt_data_out,
+};
@@ -60,6 +60,61 @@ static int shmem_init_connect(ni_t *ni, conn_t *conn)
     return PTL_OK;
 }
 
+/**
+ * @brief Allocate a buf for a put of length bytes.
+ *
+ * Puts too large to be inlined in a regular sbuf, but not larger than
+ * PTL_SHMEM_EAGER_SIZE, get a buffer from the eager pool. Their data
+ * is then copied in it instead of going through a bounce buffer or
+ * KNEM.
+ *
+ * @param[in] ni the network interface
+ * @param[in] length the length of the put
+ * @param[out] buf_p pointer to return value
+ *
+ * @return status
+ */
+static int shmem_buf_alloc_eager(ni_t *ni, ptl_size_t length,
+                                 buf_t **buf_p)
+{
+    int err;
+    obj_t *obj;
+
+    if (length <= get_param(PTL_MAX_INLINE_DATA) ||
+        length > ni->shmem.eager_size)
+        return sbuf_alloc(ni, buf_p);
+
+    err = obj_alloc(&ni->shmem.eager_sbuf_pool, &obj);
+    if (err) {
+        *buf_p = NULL;
+        return err;
+    }
+
+    *buf_p = container_of(obj, buf_t, obj);
+    return PTL_OK;
+}
+
+/**
+ * @brief Whether the data can be copied in the buffer.
+ *
+ * @param[in] buf the buf
+ * @param[in] dir the data direction, in or out
+ * @param[in] length the length of the data
+ *
+ * @return 1 if the data is immediate, 0 otherwise
+ */
+static inline int shmem_data_fits(buf_t *buf, data_dir_t dir,
+                                  ptl_size_t length)
+{
+    if (length <= get_param(PTL_MAX_INLINE_DATA))
+        return 1;
+
+    /* Only the data out of eager buffers can be larger. Replies are
+     * still limited to PTL_MAX_INLINE_DATA by the target. */
+    return buf->data_size > BUF_DATA_SIZE && dir == DATA_DIR_OUT &&
+        buf->length + sizeof(data_t) + length <= buf->data_size;
+}
+
 #if USE_KNEM
 static void append_init_data_shmem_direct(data_t *data, mr_t *mr, void *addr,
                                           ptl_size_t length, buf_t *buf)
@@ -125,18 +180,18 @@ static int shmem_init_prepare_transfer(md_t *md, data_dir_t dir,
     ptl_size_t iov_start = 0;
     ptl_size_t iov_offset = 0;
 
-    if (length <= get_param(PTL_MAX_INLINE_DATA)) {
+    if (shmem_data_fits(buf, dir, length)) {
         err =
-            append_immediate_data(md->start, NULL, md->num_iov, dir, offset,
-                                  length, buf);
+            append_immediate_data(md->start, md->iov_end, NULL, md->num_iov,
+                                  dir, offset, length, buf);
     } else if (md->options & PTL_IOVEC) {
         ptl_iovec_t *iovecs = md->start;
 
         /* Find the index and offset of the first IOV as well as the
          * total number of IOVs to transfer. */
         num_sge =
-            iov_count_elem(iovecs, md->num_iov, offset, length, &iov_start,
-                           &iov_offset);
+            iov_count_elem(iovecs, md->iov_end, md->num_iov, offset, length,
+                           &iov_start, &iov_offset);
         if (num_sge < 0) {
             WARN();
             return PTL_FAIL;
@@ -168,7 +223,7 @@ static int shmem_init_prepare_transfer(md_t *md, data_dir_t dir,
     }
 
     if (!err)
-        assert(buf->length <= BUF_DATA_SIZE);
+        assert(buf->length <= buf->data_size);
 
     return err;
 }
@@ -209,8 +264,10 @@ static void attach_bounce_buffer(buf_t *buf, data_t *data)
             ll_dequeue_obj_alien(&ni->shmem.bounce_buf.head->free_list,
                                  ni->shmem.bounce_buf.head,
                                  ni->shmem.bounce_buf.head->head_index0)) ==
-           NULL)
+           NULL) {
+        ni_progress(ni);
         SPINLOCK_BODY();
+    }
 
     buf->transfer.noknem.data = bb;
     buf->transfer.noknem.data_length = ni->shmem.bounce_buf.buf_size;
@@ -222,6 +279,7 @@ static void attach_bounce_buffer(buf_t *buf, data_t *data)
 
 static void append_init_data_noknem_iovec(data_t *data, md_t *md,
                                           int iov_start, int num_iov,
+                                          ptl_size_t iov_offset,
                                           ptl_size_t length, buf_t *buf)
 {
     data->data_fmt = DATA_FMT_NOKNEM;
@@ -236,7 +294,8 @@ static void append_init_data_noknem_iovec(data_t *data, md_t *md,
 
     buf->transfer.noknem.num_iovecs = num_iov;
     buf->transfer.noknem.iovecs = &((ptl_iovec_t *)md->start)[iov_start];
-    buf->transfer.noknem.offset = 0;
+    buf->transfer.noknem.iov_end = NULL;
+    buf->transfer.noknem.offset = iov_offset;
 
     buf->transfer.noknem.length_left = length;
 
@@ -262,6 +321,7 @@ static void append_init_data_noknem_direct(data_t *data, mr_t *mr, void *addr,
 
     buf->transfer.noknem.num_iovecs = 1;
     buf->transfer.noknem.iovecs = &buf->transfer.noknem.my_iovec;
+    buf->transfer.noknem.iov_end = NULL;
     buf->transfer.noknem.offset = 0;
 
     buf->transfer.noknem.length_left = length;
@@ -286,16 +346,15 @@ static int noknem_init_prepare_transfer(md_t *md, data_dir_t dir,
                                         buf_t *buf)
 {
     int err = PTL_OK;
-    req_hdr_t *hdr = (req_hdr_t *) buf->data;
     data_t *data = (data_t *)(buf->data + buf->length);
     int num_sge;
     ptl_size_t iov_start = 0;
     ptl_size_t iov_offset = 0;
 
-    if (length <= get_param(PTL_MAX_INLINE_DATA)) {
+    if (shmem_data_fits(buf, dir, length)) {
         err =
-            append_immediate_data(md->start, NULL, md->num_iov, dir, offset,
-                                  length, buf);
+            append_immediate_data(md->start, md->iov_end, NULL, md->num_iov,
+                                  dir, offset, length, buf);
     } else {
         if (dir == DATA_DIR_IN)
             buf->data_in->noknem.state = 2;
@@ -308,20 +367,15 @@ static int noknem_init_prepare_transfer(md_t *md, data_dir_t dir,
             /* Find the index and offset of the first IOV as well as the
              * total number of IOVs to transfer. */
             num_sge =
-                iov_count_elem(iovecs, md->num_iov, offset, length,
-                               &iov_start, &iov_offset);
+                iov_count_elem(iovecs, md->iov_end, md->num_iov, offset,
+                               length, &iov_start, &iov_offset);
             if (num_sge < 0) {
                 WARN();
                 return PTL_FAIL;
             }
 
             append_init_data_noknem_iovec(data, md, iov_start, num_sge,
-                                          length, buf);
-
-            /* @todo this is completely bogus */
-            /* Adjust the header offset for iov start. */
-            hdr->roffset =
-                cpu_to_le64(le64_to_cpu(hdr->roffset) - iov_offset);
+                                          iov_offset, length, buf);
         } else {
             void *addr;
             mr_t *mr;
@@ -338,7 +392,7 @@ static int noknem_init_prepare_transfer(md_t *md, data_dir_t dir,
     }
 
     if (!err)
-        assert(buf->length <= BUF_DATA_SIZE);
+        assert(buf->length <= buf->data_size);
 
     return err;
 }
@@ -369,7 +423,8 @@ static int noknem_do_transfer(buf_t *buf)
 
             err =
                 iov_copy_in(buf->transfer.noknem.data,
-                            buf->transfer.noknem.iovecs, NULL,
+                            buf->transfer.noknem.iovecs,
+                            buf->transfer.noknem.iov_end, NULL,
                             buf->transfer.noknem.num_iovecs,
                             buf->transfer.noknem.offset, to_copy);
         } else {
@@ -379,7 +434,8 @@ static int noknem_do_transfer(buf_t *buf)
 
             err =
                 iov_copy_out(buf->transfer.noknem.data,
-                             buf->transfer.noknem.iovecs, NULL,
+                             buf->transfer.noknem.iovecs,
+                             buf->transfer.noknem.iov_end, NULL,
                              buf->transfer.noknem.num_iovecs,
                              buf->transfer.noknem.offset, to_copy);
 
@@ -426,11 +482,13 @@ static int noknem_tgt_data_out(buf_t *buf, data_t *data)
     if ((buf->rdma_dir == DATA_DIR_IN && buf->put_resid) ||
         (buf->rdma_dir == DATA_DIR_OUT && buf->get_resid)) {
         if (buf->me->options & PTL_IOVEC) {
-            buf->transfer.noknem.num_iovecs = buf->me->length;
+            buf->transfer.noknem.num_iovecs = buf->me->num_iov;
             buf->transfer.noknem.iovecs = buf->me->start;
+            buf->transfer.noknem.iov_end = buf->me->iov_end;
         } else {
             buf->transfer.noknem.num_iovecs = 1;
             buf->transfer.noknem.iovecs = &buf->transfer.noknem.my_iovec;
+            buf->transfer.noknem.iov_end = NULL;
 
             buf->transfer.noknem.my_iovec.iov_base = buf->me->start;
             buf->transfer.noknem.my_iovec.iov_len = buf->me->length;
@@ -450,6 +508,7 @@ static int noknem_tgt_data_out(buf_t *buf, data_t *data)
 struct transport transport_shmem = {
     .type = CONN_TYPE_SHMEM,
     .buf_alloc = sbuf_alloc,
+    .buf_alloc_eager = shmem_buf_alloc_eager,
     .init_connect = shmem_init_connect,
     .send_message = shmem_send_message,
     .set_send_flags = shmem_set_send_flags,
@@ -464,6 +523,51 @@ struct transport transport_shmem = {
 #endif
 };
 
+/**
+ * @brief Wait for a shared memory buffer to be returned.
+ *
+ * The buffers come back through the progress function, so run it
+ * if the NI has no progress thread.
+ *
+ * @param[in] pool the sbuf pool
+ */
+static void sbuf_starved(pool_t *pool)
+{
+    ni_progress(container_of(pool, ni_t, sbuf_pool));
+}
+
+/**
+ * @brief Wait for an eager buffer to be returned.
+ *
+ * @param[in] pool the eager sbuf pool
+ */
+static void eager_sbuf_starved(pool_t *pool)
+{
+    ni_progress(container_of(pool, ni_t, shmem.eager_sbuf_pool));
+}
+
+/**
+ * @brief Init an eager buffer.
+ *
+ * Called once when the buffer is created.
+ *
+ * @param[in] arg the buf
+ * @param[in] parm unused
+ *
+ * @return status
+ */
+static int eager_sbuf_init(void *arg, void *parm)
+{
+    buf_t *buf = arg;
+    int err;
+
+    err = buf_init(arg, parm);
+
+    buf->data_size = buf->obj.obj_pool->round_size - real_buf_t_size();
+
+    return err;
+}
+
 /**
  * @brief Cleanup shared memory resources.
  *
@@ -472,6 +576,7 @@ struct transport transport_shmem = {
 static void release_shmem_resources(ni_t *ni)
 {
     pool_fini(&ni->sbuf_pool);
+    pool_fini(&ni->shmem.eager_sbuf_pool);
 
     if (ni->shmem.comm_pad != MAP_FAILED) {
         munmap(ni->shmem.comm_pad, ni->shmem.comm_pad_size);
@@ -511,6 +616,7 @@ static int setup_commpad(ni_t *ni)
     int err;
     int i;
     int pid_table_size;
+    size_t data_size;
 
     /*
      * Buffers in shared memory. The buffers will be allocated later,
@@ -523,11 +629,36 @@ static int setup_commpad(ni_t *ni)
     ni->sbuf_pool.init = buf_init;
     ni->sbuf_pool.fini = buf_fini;
     ni->sbuf_pool.cleanup = buf_cleanup;
+    ni->sbuf_pool.starved = sbuf_starved;
     ni->sbuf_pool.use_pre_alloc_buffer = 1;
-    ni->sbuf_pool.round_size = real_buf_t_size();
+    /* Keep the sbufs on cache line boundaries, so the hot fields at
+     * the start of a buf_t share as few lines as possible. */
+    ni->sbuf_pool.round_size = ROUND_UP(real_buf_t_size(), linesize);
     ni->sbuf_pool.slab_size =
         ni->shmem.per_proc_comm_buf_numbers * ni->sbuf_pool.round_size;
 
+    /* Followed by the eager buffers. Their message is after the
+     * buf_t, with room for a put header and eager_size bytes. */
+    ni->shmem.eager_size = get_param(PTL_SHMEM_EAGER_SIZE);
+    data_size = sizeof(req_hdr_t) + sizeof(data_t) + ni->shmem.eager_size;
+    data_size = ROUND_UP(data_size, linesize);
+
+    if (data_size > BUF_DATA_SIZE) {
+        ni->shmem.eager_sbuf_pool.setup = buf_setup;
+        ni->shmem.eager_sbuf_pool.init = eager_sbuf_init;
+        ni->shmem.eager_sbuf_pool.fini = buf_fini;
+        ni->shmem.eager_sbuf_pool.cleanup = buf_cleanup;
+        ni->shmem.eager_sbuf_pool.starved = eager_sbuf_starved;
+        ni->shmem.eager_sbuf_pool.use_pre_alloc_buffer = 1;
+        ni->shmem.eager_sbuf_pool.round_size =
+            ROUND_UP(real_buf_t_size() + data_size, linesize);
+        ni->shmem.eager_sbuf_pool.slab_size =
+            get_param(PTL_NUM_SHMEM_EAGER_SBUF) *
+            ni->shmem.eager_sbuf_pool.round_size;
+    } else {
+        ni->shmem.eager_size = 0;
+    }
+
     /* Open KNEM device */
     if (knem_init(ni)) {
         WARN();
@@ -542,13 +673,15 @@ static int setup_commpad(ni_t *ni)
         /* Create a unique name for the shared memory file. Use the hash
          * created from the mapping. */
         snprintf(comm_pad_shm_name, sizeof(comm_pad_shm_name),
-                 "/portals4-shmem-%x-%d", ni->mem.hash, ni->options);
+                 "/portals4-shmem-%x-%d", ni->mem.hash,
+                 ni->options & ~PTL_NI_APP_PROGRESS);
     }
     ni->shmem.comm_pad_shm_name = strdup(comm_pad_shm_name);
 
     /* Allocate a pool of buffers in the mmapped region. */
     ni->shmem.per_proc_comm_buf_size =
-        sizeof(queue_t) + ni->sbuf_pool.slab_size;
+        sizeof(queue_t) + ni->sbuf_pool.slab_size +
+        ni->shmem.eager_sbuf_pool.slab_size;
 
     pid_table_size = ni->mem.node_size * sizeof(struct shmem_pid_table);
     pid_table_size = ROUND_UP(pid_table_size, pagesize);
@@ -675,6 +808,20 @@ static int setup_commpad(ni_t *ni)
         WARN();
         goto exit_fail;
     }
+
+    if (ni->shmem.eager_size) {
+        ni->shmem.eager_sbuf_pool.pre_alloc_buffer =
+            (void *)(ni->shmem.queue + 1) + ni->sbuf_pool.slab_size;
+
+        err =
+            pool_init(ni->iface->gbl, &ni->shmem.eager_sbuf_pool,
+                      "eager sbuf", ni->shmem.eager_sbuf_pool.round_size,
+                      POOL_SBUF, (obj_t *)ni);
+        if (err) {
+            WARN();
+            goto exit_fail;
+        }
+    }
 #if !USE_KNEM
     /* Initialize the bounce buffers and let index 0 link them
      * together. */
@@ -800,7 +947,7 @@ static int PtlNIInit_shmem(gbl_t *gbl, ni_t *ni)
         }
 
         /* Physical interface. We are connected to ourselves. */
-        conn = get_conn(ni, ni->id);
+        conn = get_peer_conn(ni, ni->id);
         if (!conn) {
             /* It's hard to recover from here. */
             WARN();
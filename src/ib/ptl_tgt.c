@@ -12,6 +12,7 @@ static char *tgt_state_name[] = {
     [STATE_TGT_START] = "tgt_start",
     [STATE_TGT_DROP] = "tgt_drop",
     [STATE_TGT_GET_MATCH] = "tgt_get_match",
+    [STATE_TGT_FAST] = "tgt_fast",
     [STATE_TGT_GET_LENGTH] = "tgt_get_length",
     [STATE_TGT_WAIT_CONN] = "tgt_wait_conn",
     [STATE_TGT_DATA] = "tgt_data",
@@ -125,15 +126,15 @@ static int tgt_copy_in(buf_t *buf, me_t *me, void *data)
         }
 
         err =
-            iov_copy_in(data, addr_to_ppe(me->start, mr), me->mr_list,
-                        me->num_iov, offset, length);
+            iov_copy_in(data, addr_to_ppe(me->start, mr), me->iov_end,
+                        me->mr_list, me->num_iov, offset, length);
 
         if (!me->mr_start)
             mr_put(mr);
 #else
         err =
-            iov_copy_in(data, (ptl_iovec_t *)me->start, me->mr_list,
-                        me->num_iov, offset, length);
+            iov_copy_in(data, (ptl_iovec_t *)me->start, me->iov_end,
+                        me->mr_list, me->num_iov, offset, length);
 #endif
     } else {
         void *start = me->start + offset;
@@ -150,15 +151,14 @@ static int tgt_copy_in(buf_t *buf, me_t *me, void *data)
             }
         }
 
-        memcpy(addr_to_ppe(start, mr), data, length);
-        err = PTL_OK;
+        err = copy_to_app(start, mr, data, length);
 
         if (!me->mr_start)
             mr_put(mr);
 #else
-        memcpy(start, data, length);
-#endif
+        ptl_copy(start, data, length);
         err = PTL_OK;
+#endif
     }
 
     return err;
@@ -203,16 +203,16 @@ static int atomic_in(buf_t *buf, me_t *me, void *data)
 
         err =
             iov_atomic_in(op, atom_type_size[hdr->atom_type], data,
-                          addr_to_ppe(me->start, mr), me->mr_list,
-                          me->num_iov, offset, length);
+                          addr_to_ppe(me->start, mr), me->iov_end,
+                          me->mr_list, me->num_iov, offset, length);
 
         if (!me->mr_start)
             mr_put(mr);
 #else
         err =
             iov_atomic_in(op, atom_type_size[hdr->atom_type], data,
-                          (ptl_iovec_t *)me->start, me->mr_list, me->num_iov,
-                          offset, length);
+                          (ptl_iovec_t *)me->start, me->iov_end, me->mr_list,
+                          me->num_iov, offset, length);
 #endif
     } else {
         void *start = me->start + offset;
@@ -229,14 +229,14 @@ static int atomic_in(buf_t *buf, me_t *me, void *data)
             }
         }
 
-        (*op) (addr_to_ppe(start, mr), data, length);
+        err = atomic_to_app(op, start, mr, data, length);
 
         if (!me->mr_start)
             mr_put(mr);
 #else
         (*op) (start, data, length);
-#endif
         err = PTL_OK;
+#endif
     }
 
     return err;
@@ -336,19 +336,21 @@ static int init_local_offset(buf_t *buf)
 
     if (me->num_iov) {
         ptl_iovec_t *iov = (ptl_iovec_t *)me->start;
-        ptl_size_t i = 0;
-        ptl_size_t loc_offset = 0;
-        ptl_size_t iov_offset = 0;
-
-        for (i = 0; i < me->num_iov && loc_offset < buf->moffset; i++, iov++) {
-            iov_offset = buf->moffset - loc_offset;
-            if (iov_offset > iov->iov_len)
-                iov_offset = iov->iov_len;
-            loc_offset += iov_offset;
+        ptl_size_t iov_offset = buf->moffset;
+        ptl_size_t i;
+
+        i = iov_find(iov, me->iov_end, me->num_iov, &iov_offset);
+        if (i >= me->num_iov) {
+            if (iov_offset)
+                return PTL_FAIL;
+
+            /* Nothing to transfer, start at the end of the last
+             * iovec. */
+            i = me->num_iov - 1;
+            iov_offset = me->iov_end[i] - (i ? me->iov_end[i - 1] : 0);
         }
 
-        if (loc_offset < buf->moffset)
-            return PTL_FAIL;
+        iov += i;
 
         buf->cur_loc_iov_index = i;
         buf->cur_loc_iov_off = iov_offset;
@@ -369,6 +371,58 @@ static int init_local_offset(buf_t *buf)
     return PTL_OK;
 }
 
+/**
+ * @brief Check whether a request can take the target fast path.
+ *
+ * That is a put or an atomic with immediate data, which fits in the
+ * limits and needs at most a counting ack.
+ *
+ * @param[in] buf The message buf received by the target.
+ * @param[in] hdr The request header.
+ *
+ * @return 1 if the fast path can be tried, 0 otherwise.
+ */
+static inline int tgt_fast_ok(const buf_t *buf, const req_hdr_t *hdr)
+{
+    const ni_t *ni = obj_to_ni(buf);
+    const data_t *data = buf->data_in;
+    uint64_t rlength;
+
+    if (!get_param(PTL_ENABLE_FAST_PATH))
+        return 0;
+
+    if (!data || data->data_fmt != DATA_FMT_IMMEDIATE || buf->data_out)
+        return 0;
+
+    switch (hdr->ack_req) {
+        case PTL_NO_ACK_REQ:
+            break;
+        case PTL_CT_ACK_REQ:
+            if (buf->conn->state < CONN_STATE_CONNECTED)
+                return 0;
+            break;
+        default:
+            return 0;
+    }
+
+#if WITH_TRANSPORT_UDP
+    /* UDP receives need some special handling. */
+    if (buf->conn->transport.type == CONN_TYPE_UDP)
+        return 0;
+#endif
+
+    rlength = le64_to_cpu(hdr->rlength);
+
+    if (buf->operation == OP_PUT)
+        return rlength <= ni->limits.max_msg_size;
+
+    if (buf->operation == OP_ATOMIC)
+        return rlength <= ni->limits.max_atomic_size &&
+            hdr->atom_op <= PTL_BXOR && hdr->atom_type < PTL_DATATYPE_LAST;
+
+    return 0;
+}
+
 /**
  * @brief target start state.
  *
@@ -435,13 +489,20 @@ static int tgt_start(buf_t *buf)
     ptl_info("buffer ni: %p \n", buf->obj.obj_ni);
     ptl_info("buf start: %p \n", buf->start);
 
-    buf->conn = get_conn(ni, ni->id);
+    /* Our own messages come in on the loopback transport, unless it
+     * is disabled. */
+    if (is_self(ni, initiator))
+        buf->conn = get_conn(ni, initiator);
+    else
+        buf->conn = get_peer_conn(ni, ni->id);
     if (buf->conn->transport.type != CONN_TYPE_UDP) {
         conn_put(buf->conn);
         buf->conn = get_conn(ni, initiator);
     }
     buf->conn->state = CONN_STATE_CONNECTED;
-    buf->conn->udp.dest_addr = buf->conn->sin;
+    /* Don't clobber the transport data of a local (shmem) connection. */
+    if (buf->conn->transport.type == CONN_TYPE_UDP)
+        buf->conn->udp.dest_addr = buf->conn->sin;
 #endif
 #if !WITH_TRANSPORT_UDP
     buf->conn = get_conn(ni, initiator);
@@ -472,6 +533,10 @@ static int tgt_start(buf_t *buf)
         return STATE_TGT_DROP;
     }
 
+    /* The fast path checks the portal table state itself. */
+    if (tgt_fast_ok(buf, hdr))
+        return STATE_TGT_FAST;
+
     /* synchronize with enable/disable APIs */
     PTL_FASTLOCK_LOCK(&buf->pt->lock);
     if (buf->pt->state != PT_ENABLED) {
@@ -749,6 +814,10 @@ static int tgt_get_match(buf_t *buf)
             if (buf->conn->transport.type == CONN_TYPE_MEM) {
 #endif
                 if (buf->data != buf->internal_data) {
+                    /* The data of an eager buffer does not fit, but
+                     * only the headers are needed from now on. */
+                    if (buf->length > BUF_DATA_SIZE)
+                        buf->length = BUF_DATA_SIZE;
                     memcpy(buf->internal_data, buf->data, buf->length);
                     buf->data = buf->internal_data;
                 }
@@ -912,6 +981,109 @@ static int tgt_get_length(buf_t *buf)
     return STATE_TGT_DATA;
 }
 
+/**
+ * @brief target fast path state.
+ *
+ * This state is reached after the start state for the requests
+ * accepted by tgt_fast_ok(). It does the work of the get match, get
+ * length, data, data in and comm event states in one pass, for a
+ * persistent list element on the priority list that the request fits
+ * in. Anything else goes back to the get match state before any
+ * change is made.
+ *
+ * @param[in] buf The message buf received by the target.
+ *
+ * @return The next state.
+ */
+static int tgt_fast(buf_t *buf)
+{
+    ni_t *ni = obj_to_ni(buf);
+    pt_t *pt = buf->pt;
+    const req_hdr_t *hdr = (req_hdr_t *) buf->data;
+    uint64_t rlength = le64_to_cpu(hdr->rlength);
+    uint64_t roffset = le64_to_cpu(hdr->roffset);
+    void *data = buf->data_in->immediate.data;
+    le_t *le;
+    int err;
+
+    /* synchronize with enable/disable and LE/ME append/search APIs */
+    PTL_FASTLOCK_LOCK(&pt->lock);
+    if (pt->state != PT_ENABLED) {
+        PTL_FASTLOCK_UNLOCK(&pt->lock);
+        buf->ni_fail = PTL_NI_PT_DISABLED;
+        WARN();
+        return STATE_TGT_DROP;
+    }
+    pt->num_tgt_active++;
+
+    list_for_each_entry(le, &pt->priority_list, list) {
+        if ((ni->options & PTL_NI_NO_MATCHING) ||
+            check_match(buf, (me_t *)le))
+            goto found_one;
+    }
+
+    /* Overflow list or drop. */
+    goto slow_path;
+
+  found_one:
+    /* Only MEs can have PTL_ME_MANAGE_LOCAL set. */
+    if ((le->options & (PTL_ME_USE_ONCE | PTL_ME_MANAGE_LOCAL)) ||
+        roffset > le->length || rlength > le->length - roffset ||
+        check_perm(buf, le) != PTL_NI_OK)
+        goto slow_path;
+
+    le_get(le);
+    buf->le = le;
+    buf->matching_list = PTL_PRIORITY_LIST;
+
+    PTL_FASTLOCK_UNLOCK(&pt->lock);
+
+    init_events(buf);
+
+    buf->mlength = rlength;
+    buf->moffset = roffset;
+    buf->put_resid = rlength;
+    buf->get_resid = 0;
+
+    err = init_local_offset(buf);
+    if (err)
+        return STATE_TGT_ERROR;
+
+    if (buf->conn->state >= CONN_STATE_CONNECTED)
+        set_buf_dest(buf, buf->conn);
+
+    buf->rdma_dir = DATA_DIR_IN;
+
+    if (buf->operation == OP_PUT) {
+        err = tgt_copy_in(buf, buf->me, data);
+    } else {
+        pthread_mutex_lock(&ni->atomic_mutex);
+        err = atomic_in(buf, buf->me, data);
+        pthread_mutex_unlock(&ni->atomic_mutex);
+    }
+    if (err)
+        return STATE_TGT_ERROR;
+
+    atomic_set(&le->busy, 1);
+
+    if (buf->event_mask & XT_COMM_EVENT)
+        make_comm_event(buf);
+
+    if (buf->event_mask & XT_CT_COMM_EVENT)
+        make_ct_comm_event(buf);
+
+    if (buf->event_mask & XT_ACK_EVENT)
+        return STATE_TGT_SEND_ACK;
+
+    return STATE_TGT_CLEANUP;
+
+  slow_path:
+    PTL_FASTLOCK_UNLOCK(&pt->lock);
+
+    /* Matching again is harmless since nothing changed. */
+    return STATE_TGT_GET_MATCH;
+}
+
 /**
  * @brief target wait conn state.
  *
@@ -1065,16 +1237,17 @@ static int tgt_data_out(buf_t *buf)
             }
 
             err =
-                append_immediate_data(addr_to_ppe(me->start, mr), me->mr_list,
-                                      me->num_iov, DATA_DIR_OUT, buf->moffset,
-                                      buf->mlength, buf->send_buf);
+                append_immediate_data(addr_to_ppe(me->start, mr), me->iov_end,
+                                      me->mr_list, me->num_iov, DATA_DIR_OUT,
+                                      buf->moffset, buf->mlength,
+                                      buf->send_buf);
 
             if (!me->mr_start)
                 mr_put(mr);
 #else
             err =
-                append_immediate_data(me->start, me->mr_list, me->num_iov,
-                                      DATA_DIR_OUT, buf->moffset,
+                append_immediate_data(me->start, me->iov_end, me->mr_list,
+                                      me->num_iov, DATA_DIR_OUT, buf->moffset,
                                       buf->mlength, buf->send_buf);
 #endif
         } else {
@@ -1094,7 +1267,7 @@ static int tgt_data_out(buf_t *buf)
             }
 
             err =
-                append_immediate_data(me->start, &mr, me->num_iov,
+                append_immediate_data(me->start, NULL, &mr, me->num_iov,
                                       DATA_DIR_OUT, buf->moffset,
                                       buf->mlength, buf->send_buf);
 
@@ -1102,7 +1275,7 @@ static int tgt_data_out(buf_t *buf)
                 mr_put(mr);
 #else
             err =
-                append_immediate_data(me->start, NULL, me->num_iov,
+                append_immediate_data(me->start, NULL, NULL, me->num_iov,
                                       DATA_DIR_OUT, buf->moffset,
                                       buf->mlength, buf->send_buf);
 #endif
@@ -1529,8 +1702,10 @@ static int tgt_swap_data_in(buf_t *buf)
 
     if (unlikely(me->num_iov)) {
         err =
-            iov_copy_out(copy, (ptl_iovec_t *)me->start, NULL, me->num_iov,
-                         buf->moffset, buf->mlength);
+            iov_copy_out(copy,
+                         (ptl_iovec_t *)addr_to_ppe(me->start, me->mr_start),
+                         me->iov_end, me->mr_list, me->num_iov, buf->moffset,
+                         buf->mlength);
         if (err)
             return STATE_TGT_ERROR;
 
@@ -1550,7 +1725,19 @@ static int tgt_swap_data_in(buf_t *buf)
             }
         }
 #endif
+#if IS_PPE && !USE_XPMEM
+        /* Not mapped. Swap a copy, as for an iovec. */
+        err = copy_from_app(copy, start, mr, buf->mlength);
+        if (err) {
+            if (!me->mr_start)
+                mr_put(mr);
+            return STATE_TGT_ERROR;
+        }
+
+        dst = copy;
+#else
         dst = addr_to_ppe(start, mr);
+#endif
     }
 
     /* immediate data might not be aligned.  Make sure it's aligned */
@@ -1560,6 +1747,12 @@ static int tgt_swap_data_in(buf_t *buf)
     }
     err = swap_data_in(hdr->atom_op, hdr->atom_type, dst, source, operand);
 
+#if IS_PPE && !USE_XPMEM
+    if (!err && !me->num_iov)
+        err =
+            copy_to_app(me->start + buf->moffset, mr, copy, buf->mlength);
+#endif
+
 #if IS_PPE
     if (!me->mr_start)
         mr_put(mr);
@@ -1596,13 +1789,16 @@ static int tgt_swap_data_in(buf_t *buf)
 static int tgt_comm_event(buf_t *buf)
 {
     if (buf->le && buf->le->ptl_list == PTL_OVERFLOW_LIST) {
+        ni_t *ni = obj_to_ni(buf);
 
         /* The buf should be on the unexpected list, unless an
          * append/search operation removed it since the buffer was in
          * the check_match state. Tell the potential waiter the buffer
          * is now ready. */
+        pthread_mutex_lock(&ni->unexpected_mutex);
         buf->unexpected_busy = 0;
-        pthread_cond_signal(&buf->cond);
+        pthread_cond_broadcast(&ni->unexpected_cond);
+        pthread_mutex_unlock(&ni->unexpected_mutex);
     }
 
     if (buf->me)
@@ -1627,6 +1823,198 @@ static int tgt_comm_event(buf_t *buf)
     return STATE_TGT_CLEANUP;
 }
 
+#if !IS_PPE
+/**
+ * @brief Get the current time for the ack merging timer.
+ *
+ * @return the time in microseconds.
+ */
+static inline uint64_t ack_merge_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Send the acks merged for a connection.
+ *
+ * The NI ack_merge lock must be held.
+ *
+ * @param[in] ni The NI.
+ * @param[in] conn The connection to the initiator.
+ *
+ * @return status
+ */
+static int send_merged_ack(ni_t *ni, conn_t *conn)
+{
+    int err;
+    buf_t *ack_buf;
+    merged_ack_hdr_t *hdr;
+
+    err = conn->transport.buf_alloc(ni, &ack_buf);
+    if (unlikely(err)) {
+        WARN();
+        return err;
+    }
+
+    hdr = (merged_ack_hdr_t *) ack_buf->data;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->h1.version = PTL_HDR_VER_1;
+    hdr->h1.operation = OP_MERGED_ACK;
+    hdr->h1.handle = cpu_to_le32(conn->ack_merge.md_handle);
+    hdr->count = cpu_to_le32(conn->ack_merge.count);
+    hdr->failures = cpu_to_le32(conn->ack_merge.failures);
+    hdr->disabled = cpu_to_le32(conn->ack_merge.disabled);
+    hdr->mlength = cpu_to_le64(conn->ack_merge.mlength);
+
+    ack_buf->length = sizeof(*hdr);
+    ack_buf->conn = conn;
+    set_buf_dest(ack_buf, conn);
+
+    conn->transport.set_send_flags(ack_buf, 1);
+
+    err = conn->transport.send_message(ack_buf, 0);
+    if (err)
+        WARN();
+
+    buf_put(ack_buf);
+
+    return err;
+}
+
+/**
+ * @brief Send the acks merged for a connection and forget them.
+ *
+ * The NI ack_merge lock must be held.
+ *
+ * @param[in] ni The NI.
+ * @param[in] conn The connection to the initiator.
+ * @param[in] force Forget the acks even if they could not be sent.
+ */
+static void flush_merged_ack_locked(ni_t *ni, conn_t *conn, int force)
+{
+    if (send_merged_ack(ni, conn) && !force)
+        return;
+
+    conn->ack_merge.count = 0;
+    list_del_init(&conn->ack_merge.list);
+    conn_put(conn);
+}
+
+/**
+ * @brief Send the merged acks that have waited long enough.
+ *
+ * Called from the progress loop, and with all set when the NI is
+ * shut down.
+ *
+ * @param[in] ni The NI.
+ * @param[in] all Send all the merged acks, whatever their age.
+ */
+void flush_merged_acks(ni_t *ni, int all)
+{
+    struct list_head *l, *t;
+    uint64_t now;
+
+    if (list_empty(&ni->ack_merge.list))
+        return;
+
+    now = all ? 0 : ack_merge_now();
+
+    PTL_FASTLOCK_LOCK(&ni->ack_merge.lock);
+
+    list_for_each_safe(l, t, &ni->ack_merge.list) {
+        conn_t *conn = list_entry(l, conn_t, ack_merge.list);
+
+        if (all || conn->ack_merge.deadline <= now)
+            flush_merged_ack_locked(ni, conn, all);
+    }
+
+    PTL_FASTLOCK_UNLOCK(&ni->ack_merge.lock);
+}
+
+/**
+ * @brief Send the merged acks of a connection before a reply.
+ *
+ * @param[in] ni The NI.
+ * @param[in] conn The connection to the initiator.
+ */
+static void flush_conn_merged_ack(ni_t *ni, conn_t *conn)
+{
+    PTL_FASTLOCK_LOCK(&ni->ack_merge.lock);
+
+    if (conn->ack_merge.count)
+        flush_merged_ack_locked(ni, conn, 0);
+
+    PTL_FASTLOCK_UNLOCK(&ni->ack_merge.lock);
+}
+
+/**
+ * @brief Merge a CT ack with the other acks for the same initiator.
+ *
+ * The initiator flagged the request when the only thing it needs
+ * from the ack is to update the counting event of the MD. Instead
+ * of sending one ack per request, the acks for the same MD are
+ * counted and sent as one when there are PTL_ACK_MERGE_MAX of
+ * them, when an ack for another MD or a reply is sent to the same
+ * initiator, or after PTL_ACK_MERGE_USEC.
+ *
+ * @param[in] buf The message buf received by the target.
+ *
+ * @return The next state.
+ */
+static int tgt_merge_ack(buf_t *buf)
+{
+    ni_t *ni = obj_to_ni(buf);
+    conn_t *conn = buf->conn;
+    const req_hdr_t *hdr = (req_hdr_t *) buf->data;
+    uint32_t md_handle = le32_to_cpu(hdr->h1.handle);
+    int disabled = buf->le && (buf->le->options & PTL_LE_ACK_DISABLE);
+
+    if (buf->le && buf->le->ptl_list == PTL_PRIORITY_LIST) {
+        /* The LE must be released before we sent the ack. */
+        le_put(buf->le);
+        atomic_set(&buf->me->busy, 0);
+        buf->le = NULL;
+    }
+
+    PTL_FASTLOCK_LOCK(&ni->ack_merge.lock);
+
+    /* A merged ack is for one MD only. */
+    if (conn->ack_merge.count && conn->ack_merge.md_handle != md_handle)
+        flush_merged_ack_locked(ni, conn, 1);
+
+    if (!conn->ack_merge.count) {
+        conn->ack_merge.md_handle = md_handle;
+        conn->ack_merge.failures = 0;
+        conn->ack_merge.disabled = 0;
+        conn->ack_merge.mlength = 0;
+        conn->ack_merge.deadline =
+            ack_merge_now() + get_param(PTL_ACK_MERGE_USEC);
+
+        conn_get(conn);
+        list_add_tail(&conn->ack_merge.list, &ni->ack_merge.list);
+    }
+
+    conn->ack_merge.count++;
+    if (buf->ni_fail)
+        conn->ack_merge.failures++;
+    else if (disabled)
+        conn->ack_merge.disabled++;
+    else
+        conn->ack_merge.mlength += buf->mlength;
+
+    if (conn->ack_merge.count >= get_param(PTL_ACK_MERGE_MAX))
+        flush_merged_ack_locked(ni, conn, 0);
+
+    PTL_FASTLOCK_UNLOCK(&ni->ack_merge.lock);
+
+    return STATE_TGT_CLEANUP;
+}
+#endif
+
 /**
  * @brief target send ack state.
  *
@@ -1644,6 +2032,11 @@ static int tgt_send_ack(buf_t *buf)
     ack_hdr_t *ack_hdr = (ack_hdr_t *) buf->data;
     const int ack_req = ((req_hdr_t *) (buf->data))->ack_req;
 
+#if !IS_PPE
+    if (((req_hdr_t *) (buf->data))->ack_merge)
+        return tgt_merge_ack(buf);
+#endif
+
     /* Find a buffer to send the ack. Depending on the transport we
      * may or may not be able to reuse the buffer in which we got the
      * request. */
@@ -1666,7 +2059,7 @@ static int tgt_send_ack(buf_t *buf)
 
 
             ack_buf = buf->mem_buf;
-            ack_hdr = (ack_hdr_t *) ack_buf->internal_data;
+            ack_hdr = (ack_hdr_t *) buf_data_area(ack_buf);
 #if WITH_TRANSPORT_SHMEM || IS_PPE
         }
 #endif
@@ -1762,6 +2155,18 @@ static int tgt_send_ack(buf_t *buf)
                 break;
 #endif
 
+#if !IS_PPE
+            case CONN_TYPE_SELF:
+                ack_buf->conn = buf->conn;
+
+                err = ack_buf->conn->transport.send_message(ack_buf, 0);
+                if (err) {
+                    WARN();
+                    return STATE_TGT_ERROR;
+                }
+                break;
+#endif
+
 #if WITH_TRANSPORT_IB
             case CONN_TYPE_RDMA:
                 /* That should not be possible. */
@@ -1805,6 +2210,12 @@ static int tgt_send_reply(buf_t *buf)
     ni_t *ni = obj_to_ni(buf);
     rep_hdr->h1.ni_type = ni->ni_type;
 
+#if !IS_PPE
+    /* The merged acks must not arrive after the reply. */
+    if (unlikely(buf->conn->ack_merge.count))
+        flush_conn_merged_ack(ni, buf->conn);
+#endif
+
     if (buf->le && buf->le->ptl_list == PTL_PRIORITY_LIST) {
         /* The LE must be released before we sent the ack. */
         le_put(buf->le);
@@ -2063,7 +2474,7 @@ int process_tgt(buf_t *buf)
     ptl_info("locking buffer for target processing \n");
 #endif
 
-    pthread_mutex_lock(&buf->mutex);
+    PTL_YIELDLOCK_LOCK(&buf->lock);
 
 #if WITH_TRANSPORT_UDP
     ptl_info("got lock for target buffer processing \n");
@@ -2082,6 +2493,9 @@ int process_tgt(buf_t *buf)
             case STATE_TGT_GET_MATCH:
                 state = tgt_get_match(buf);
                 break;
+            case STATE_TGT_FAST:
+                state = tgt_fast(buf);
+                break;
             case STATE_TGT_GET_LENGTH:
                 state = tgt_get_length(buf);
                 break;
@@ -2163,7 +2577,7 @@ int process_tgt(buf_t *buf)
             case STATE_TGT_CLEANUP_2:
                 tgt_cleanup_2(buf);
                 buf->tgt_state = STATE_TGT_DONE;
-                pthread_mutex_unlock(&buf->mutex);
+                PTL_YIELDLOCK_UNLOCK(&buf->lock);
 #if WITH_TRANSPORT_UDP
                 ni_t *ni = obj_to_ni(buf);
                 if (atomic_read(&ni->udp.self_recv) == 0)
@@ -2181,6 +2595,6 @@ int process_tgt(buf_t *buf)
   exit:
     buf->tgt_state = state;
   done:
-    pthread_mutex_unlock(&buf->mutex);
+    PTL_YIELDLOCK_UNLOCK(&buf->lock);
     return err;
 }
@@ -60,6 +60,7 @@ static void append_init_data_udp_iovec(data_t *data, md_t *md, int iov_start,
     int i;
 
     buf->transfer.udp.iovecs = calloc(1, sizeof(ptl_iovec_t) * num_iov);
+    buf->transfer.udp.iov_end = NULL;
 
     for (i = 0; i < num_iov; i++) {
         buf->transfer.udp.iovecs[i].iov_base = md->udp_list[i].iov_base;
@@ -93,12 +94,33 @@ static void append_init_data_udp_direct(data_t *data, mr_t *mr, void *addr,
 
     buf->transfer.udp.num_iovecs = 1;
     buf->transfer.udp.iovecs = &buf->transfer.udp.my_iovec;
+    buf->transfer.udp.iov_end = NULL;
     buf->transfer.udp.offset = 0;
 
     buf->transfer.udp.length_left = length;
 
 }
 
+/**
+ * @brief Get the largest payload that fits in one datagram with its buf.
+ *
+ * @param[in] ni the network interface
+ *
+ * @return the payload size
+ */
+static ptl_size_t udp_max_payload(ni_t *ni)
+{
+    int max_msg_size = 1488;
+    socklen_t len = sizeof(max_msg_size);
+
+    getsockopt(ni->iface->udp.connect_s, SOL_SOCKET, SO_SNDBUF,
+               &max_msg_size, &len);
+    if (max_msg_size > 65507)
+        max_msg_size = 65507;
+
+    return max_msg_size - sizeof(buf_t);
+}
+
 /**
  * @brief Build and append a data segment to a request message.
  *
@@ -142,7 +164,8 @@ static int init_prepare_transfer_udp(md_t *md, data_dir_t dir,
 
         ptl_info("small transfer inlining data \n");
         if (append_immediate_data
-            (md->start, mr_list, md->num_iov, dir, offset, length, buf))
+            (md->start, md->iov_end, mr_list, md->num_iov, dir, offset,
+             length, buf))
             abort();
     } else {
         if (md->options & PTL_IOVEC) {
@@ -152,8 +175,8 @@ static int init_prepare_transfer_udp(md_t *md, data_dir_t dir,
             // Find the index and offset of the first IOV as well as the
             //  total number of IOVs to transfer. 
             num_sge =
-                iov_count_elem(iovecs, md->num_iov, offset, length,
-                               &iov_start, &iov_offset);
+                iov_count_elem(iovecs, md->iov_end, md->num_iov, offset,
+                               length, &iov_start, &iov_offset);
             if (num_sge < 0) {
                 WARN();
                 return PTL_FAIL;
@@ -175,6 +198,18 @@ static int init_prepare_transfer_udp(md_t *md, data_dir_t dir,
                 buf->mr_list[buf->num_mr + 1] = mr;
                 buf->num_mr++;
                 append_init_data_udp_direct(data, mr, addr, length, buf);
+
+                /* Large puts are pulled by the target once matched,
+                 * instead of being sent ahead, and so are the ones
+                 * that would not fit in a single datagram. The MR
+                 * keeps the data around until the ack comes back. */
+                if (dir == DATA_DIR_OUT && hdr->h1.operation == OP_PUT &&
+                    get_param(PTL_UDP_RNDV) &&
+                    (length > get_param(PTL_UDP_RNDV_THRESHOLD) ||
+                     length > udp_max_payload(ni)) &&
+                    !is_self(ni, buf->conn->id))
+                    data->data_fmt = DATA_FMT_UDP_RNDV;
+
                 ptl_info("addr to send is: %p, buf addr is: %p \n", addr,
                          buf->transfer.udp.my_iovec.iov_base);
             } else {
@@ -189,6 +224,334 @@ static int init_prepare_transfer_udp(md_t *md, data_dir_t dir,
     return err;
 }
 
+/**
+ * @brief Tell whether a buf is sent with data following it.
+ *
+ * Works on the receiver peeked copy too, hence the use of
+ * internal_data, since the data pointer belongs to the sender.
+ *
+ * @param[in] buf the buf
+ *
+ * @return non zero if the buf has a payload
+ */
+static int udp_has_payload(buf_t *buf)
+{
+    struct hdr_common *hdr = (struct hdr_common *)buf->internal_data;
+
+    /* A rendezvous data chunk, however small. */
+    if (hdr->operation == OP_UDP_PULL_DATA)
+        return 1;
+
+    /* A rendezvous put only carries its header. */
+    if (hdr->operation == OP_PUT && hdr->data_out) {
+        data_t *data = (data_t *)(buf->internal_data + sizeof(req_hdr_t));
+
+        if (data->data_fmt == DATA_FMT_UDP_RNDV)
+            return 0;
+    }
+
+    return buf->rlength > sizeof(buf_t);
+}
+
+static inline uint64_t udp_rndv_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Send a rendezvous message, without payload or with a chunk
+ * of the initiator data.
+ *
+ * @param[in] ni the network interface
+ * @param[in] op OP_UDP_PULL or OP_UDP_PULL_DATA
+ * @param[in] handle the initiator buf handle
+ * @param[in] cookie the target buf
+ * @param[in] offset the offset of the chunk in the initiator data
+ * @param[in] length the length of the chunk
+ * @param[in] addr the chunk, for OP_UDP_PULL_DATA
+ * @param[in] dest where to send the message
+ *
+ * @return status
+ */
+static int udp_send_pull(ni_t *ni, int op, __le32 handle, __le64 cookie,
+                         ptl_size_t offset, ptl_size_t length, void *addr,
+                         struct sockaddr_in *dest)
+{
+    int err;
+    buf_t *buf;
+    udp_pull_hdr_t *hdr;
+
+    err = buf_alloc(ni, &buf);
+    if (err) {
+        WARN();
+        return err;
+    }
+
+    buf->data = buf->internal_data;
+    buf->length = sizeof(*hdr);
+    buf->put_md = NULL;
+    buf->get_md = NULL;
+    memset(&buf->transfer.udp, 0, sizeof(buf->transfer.udp));
+
+    hdr = (udp_pull_hdr_t *) buf->data;
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->h1.version = PTL_HDR_VER_1;
+    hdr->h1.operation = op;
+    hdr->h1.physical = !!(ni->options & PTL_NI_PHYSICAL);
+    hdr->h1.ni_type = ni->ni_type;
+    hdr->h1.handle = handle;
+    hdr->h1.src_nid = cpu_to_le32(ni->id.phys.nid);
+    hdr->h1.src_pid = cpu_to_le32(ni->id.phys.pid);
+    hdr->cookie = cookie;
+    hdr->offset = cpu_to_le64(offset);
+    hdr->length = cpu_to_le64(length);
+
+    if (op == OP_UDP_PULL_DATA) {
+        buf->rlength = length;
+        buf->transfer.udp.my_iovec.iov_base = addr;
+        buf->transfer.udp.my_iovec.iov_len = length;
+        buf->transfer.udp.num_iovecs = 1;
+    } else {
+        buf->rlength = 0;
+    }
+
+    udp_send(ni, buf, dest);
+
+    buf_put(buf);
+
+    return PTL_OK;
+}
+
+/**
+ * @brief Ask the initiator for the next chunk of a rendezvous put.
+ *
+ * Only one chunk is asked for at a time. The NI udp_lock must be
+ * held.
+ *
+ * @param[in] ni the network interface
+ * @param[in] buf the target buf
+ */
+static void udp_rndv_pull(ni_t *ni, buf_t *buf)
+{
+    req_hdr_t *hdr = (req_hdr_t *) buf->internal_data;
+    ptl_size_t length = buf->put_resid;
+
+    if (length > get_param(PTL_UDP_RNDV_CHUNK))
+        length = get_param(PTL_UDP_RNDV_CHUNK);
+    if (length > udp_max_payload(ni))
+        length = udp_max_payload(ni);
+
+    buf->transfer.udp.rndv_time = udp_rndv_now();
+
+    udp_send_pull(ni, OP_UDP_PULL, hdr->h1.handle,
+                  cpu_to_le64((uintptr_t) buf),
+                  buf->mlength - buf->put_resid, length, NULL,
+                  &buf->udp.src_addr);
+}
+
+/**
+ * @brief Start pulling the data of a rendezvous put.
+ *
+ * The target state machine is left until all the matched data has
+ * been received, and resumed by udp_recv_rndv().
+ *
+ * @param[in] buf the target buf
+ *
+ * @return status
+ */
+static int udp_rndv_transfer(buf_t *buf)
+{
+    ni_t *ni = obj_to_ni(buf);
+    struct udp *udp = buf->transfer.udp.udp;
+
+    if (buf->put_resid == 0) {
+        /* Dropped, truncated to nothing, or all pulled already. */
+        udp->init_done = 1;
+        udp->target_done = 1;
+    } else {
+        PTL_FASTLOCK_LOCK(&ni->udp_lock);
+        list_add_tail(&buf->list, &ni->udp_rndv_list);
+        udp_rndv_pull(ni, buf);
+        PTL_FASTLOCK_UNLOCK(&ni->udp_lock);
+    }
+
+    udp->state = 0;
+
+    return PTL_OK;
+}
+
+/**
+ * @brief Send the chunk of a rendezvous put asked for by the target.
+ *
+ * @param[in] ni the network interface
+ * @param[in] buf the received pull
+ */
+static void udp_recv_pull(ni_t *ni, buf_t *buf)
+{
+    udp_pull_hdr_t *hdr = (udp_pull_hdr_t *) buf->data;
+    ptl_size_t offset = le64_to_cpu(hdr->offset);
+    ptl_size_t length = le64_to_cpu(hdr->length);
+    ptl_size_t data_length;
+    buf_t *init_buf;
+    int err;
+
+    err = to_buf(MYNIGBL_ le32_to_cpu(hdr->h1.handle), &init_buf);
+    if (err) {
+        /* Late duplicate of a pull for a completed put. */
+        ptl_info("dropping pull for unknown buf %i\n",
+                 le32_to_cpu(hdr->h1.handle));
+        return;
+    }
+
+    data_length = init_buf->transfer.udp.my_iovec.iov_len;
+
+    if (!init_buf->data_out ||
+        init_buf->data_out->data_fmt != DATA_FMT_UDP_RNDV ||
+        length == 0 || length > udp_max_payload(ni) ||
+        offset > data_length || length > data_length - offset) {
+        WARN();
+    } else {
+        udp_send_pull(ni, OP_UDP_PULL_DATA, hdr->h1.handle, hdr->cookie,
+                      offset, length,
+                      init_buf->transfer.udp.my_iovec.iov_base + offset,
+                      &buf->udp.src_addr);
+    }
+
+    buf_put(init_buf);
+}
+
+/**
+ * @brief Copy a chunk of a rendezvous put into the matched entry.
+ *
+ * Chunks other than the one expected are duplicates, following a
+ * retry, and are dropped.
+ *
+ * @param[in] ni the network interface
+ * @param[in] buf the received chunk
+ */
+static void udp_recv_pull_data(ni_t *ni, buf_t *buf)
+{
+    udp_pull_hdr_t *hdr = (udp_pull_hdr_t *) buf->data;
+    ptl_size_t offset = le64_to_cpu(hdr->offset);
+    ptl_size_t length = le64_to_cpu(hdr->length);
+    buf_t *tgt_buf = NULL;
+    struct list_head *l;
+    mr_t **mr_list;
+    int err;
+
+    PTL_FASTLOCK_LOCK(&ni->udp_lock);
+
+    list_for_each(l, &ni->udp_rndv_list) {
+        buf_t *b = list_entry(l, buf_t, list);
+
+        if ((uintptr_t) b == le64_to_cpu(hdr->cookie)) {
+            tgt_buf = b;
+            break;
+        }
+    }
+
+    if (!tgt_buf || offset != tgt_buf->mlength - tgt_buf->put_resid ||
+        length > tgt_buf->put_resid) {
+        PTL_FASTLOCK_UNLOCK(&ni->udp_lock);
+        ptl_info("dropping duplicate rendezvous chunk at %lu\n",
+                 (unsigned long)offset);
+        goto done;
+    }
+
+    mr_list = (tgt_buf->me->mr_list) ? tgt_buf->me->mr_list :
+        &tgt_buf->me->mr_start;
+    err = iov_copy_in(buf->transfer.udp.data, tgt_buf->transfer.udp.iovecs,
+                      tgt_buf->transfer.udp.iov_end, mr_list,
+                      tgt_buf->transfer.udp.num_iovecs,
+                      tgt_buf->transfer.udp.offset + offset, length);
+    assert(err == PTL_OK);
+
+    tgt_buf->put_resid -= length;
+
+    if (tgt_buf->put_resid) {
+        udp_rndv_pull(ni, tgt_buf);
+        PTL_FASTLOCK_UNLOCK(&ni->udp_lock);
+        goto done;
+    }
+
+    list_del(&tgt_buf->list);
+    PTL_FASTLOCK_UNLOCK(&ni->udp_lock);
+
+    /* Resume the target state machine, which will send the ack. */
+    process_tgt(tgt_buf);
+
+    /* Like progress_thread_udp() after recv_req(). */
+    if (tgt_buf->tgt_state != STATE_TGT_WAIT_APPEND) {
+        if (tgt_buf->conn)
+            conn_put(tgt_buf->conn);
+        free(tgt_buf);
+    }
+
+  done:
+    free(buf->transfer.udp.data);
+    buf->transfer.udp.data = NULL;
+}
+
+/**
+ * @brief Process a received rendezvous message.
+ *
+ * @param[in] ni the network interface
+ * @param[in] buf the received buf
+ *
+ * @return the next receive state
+ */
+int udp_recv_rndv(ni_t *ni, buf_t *buf)
+{
+    struct hdr_common *hdr = (struct hdr_common *)buf->data;
+
+    if (hdr->operation == OP_UDP_PULL)
+        udp_recv_pull(ni, buf);
+    else
+        udp_recv_pull_data(ni, buf);
+
+    /* Let progress_thread_udp() free the received buf. */
+    buf->recv_buf = NULL;
+    buf->completed = 1;
+
+    return STATE_RECV_DONE;
+}
+
+/**
+ * @brief Ask again for the chunks that did not come back in time.
+ *
+ * The pull or the data may have been dropped.
+ *
+ * @param[in] ni the network interface
+ */
+void udp_rndv_progress(ni_t *ni)
+{
+    struct list_head *l;
+    uint64_t now;
+
+    if (list_empty(&ni->udp_rndv_list))
+        return;
+
+    now = udp_rndv_now();
+
+    PTL_FASTLOCK_LOCK(&ni->udp_lock);
+
+    list_for_each(l, &ni->udp_rndv_list) {
+        buf_t *buf = list_entry(l, buf_t, list);
+
+        if (now - buf->transfer.udp.rndv_time >=
+            get_param(PTL_UDP_RNDV_USEC)) {
+            ptl_info("pulling rendezvous chunk again for %p\n", buf);
+            udp_rndv_pull(ni, buf);
+        }
+    }
+
+    PTL_FASTLOCK_UNLOCK(&ni->udp_lock);
+}
+
 /**
  * @brief Perform data movement for put/get operations 
  *
@@ -213,6 +576,9 @@ static int do_udp_transfer(buf_t *buf)
         return PTL_OK;
     }
 
+    if (buf->transfer.udp.rndv)
+        return udp_rndv_transfer(buf);
+
     udp->state = 3;
 
     if (*resid) {
@@ -230,7 +596,8 @@ static int do_udp_transfer(buf_t *buf)
                 (buf->me->mr_list) ? buf->me->mr_list : &buf->me->mr_start;
             err =
                 iov_copy_in(buf->transfer.udp.data, buf->transfer.udp.iovecs,
-                            mr_list, buf->transfer.udp.num_iovecs,
+                            buf->transfer.udp.iov_end, mr_list,
+                            buf->transfer.udp.num_iovecs,
                             buf->transfer.udp.offset, to_copy);
         } else {
             //Get operation response
@@ -263,7 +630,8 @@ static int do_udp_transfer(buf_t *buf)
                     me->mr_start;
                 err =
                     iov_copy_out(buf->send_buf->transfer.udp.
-                                 my_iovec.iov_base, buf->me->start, mr_list,
+                                 my_iovec.iov_base, buf->me->start,
+                                 buf->me->iov_end, mr_list,
                                  buf->me->num_iov, buf->transfer.udp.offset,
                                  to_copy);
                 buf->send_buf->transfer.udp.num_iovecs = buf->me->num_iov;
@@ -303,7 +671,8 @@ static int do_udp_transfer(buf_t *buf)
 
 static int udp_tgt_data_out(buf_t *buf, data_t *data)
 {
-    if (data->data_fmt != DATA_FMT_UDP) {
+    if (data->data_fmt != DATA_FMT_UDP &&
+        data->data_fmt != DATA_FMT_UDP_RNDV) {
         assert(0);
         WARN();
         return STATE_TGT_ERROR;
@@ -312,6 +681,7 @@ static int udp_tgt_data_out(buf_t *buf, data_t *data)
     ptl_info("udp_tgt_data_out sets  %p direction: %i\n", buf, buf->rdma_dir);
     buf->transfer.udp.transfer_state_expected = 2;  /* always the target here */
     buf->transfer.udp.udp = &data->udp;
+    buf->transfer.udp.rndv = (data->data_fmt == DATA_FMT_UDP_RNDV);
 
     if ((buf->rdma_dir == DATA_DIR_IN && buf->put_resid) ||
         (buf->rdma_dir == DATA_DIR_OUT && buf->get_resid)) {
@@ -319,10 +689,12 @@ static int udp_tgt_data_out(buf_t *buf, data_t *data)
             buf->transfer.udp.num_iovecs = buf->me->num_iov;
             buf->me->start = addr_to_ppe(buf->me->start, buf->me->mr_start);
             buf->transfer.udp.iovecs = buf->me->start;
+            buf->transfer.udp.iov_end = buf->me->iov_end;
             ptl_info("num iovecs: %i \n", (int)buf->transfer.udp.num_iovecs);
         } else {
             buf->transfer.udp.num_iovecs = 1;
             buf->transfer.udp.iovecs = &buf->transfer.udp.my_iovec;
+            buf->transfer.udp.iov_end = NULL;
 
             buf->transfer.udp.my_iovec.iov_base = buf->me->start;
             buf->transfer.udp.my_iovec.iov_len = buf->me->length;
@@ -365,7 +737,7 @@ void udp_send(ni_t *ni, buf_t *buf, struct sockaddr_in *dest)
     if (((dest->sin_port == ni->id.phys.pid) &&
          (dest->sin_addr.s_addr == nid_to_addr(ni->id.phys.nid)))) {
         ptl_info("sending to self! \n");
-        if (buf->rlength <= sizeof(buf_t)) {
+        if (!udp_has_payload(buf)) {
             if (buf->transfer.udp.conn_msg.msg_type !=
                 le16_to_cpu(UDP_CONN_MSG_REP)) {
                 //the only multiple outstanding self sends that are valid are
@@ -417,7 +789,7 @@ void udp_send(ni_t *ni, buf_t *buf, struct sockaddr_in *dest)
     }
     //the buf has data and is not a small message or an ack
     //TODO: Adjust this to the actual data size available in the buf_t immediate data
-    if (buf->rlength > sizeof(buf_t)) {
+    if (udp_has_payload(buf)) {
         //this means that we have a message that is too large for an immediate send
         //we must send it as a iovec upto the maximum UDP message size (64KB)
 
@@ -687,7 +1059,7 @@ void udp_send(ni_t *ni, buf_t *buf, struct sockaddr_in *dest)
         }
 
 
-    } else if (buf->rlength <= sizeof(buf_t)) { // for immediate data, just send the actual buffer
+    } else {                    // for immediate data, just send the actual buffer
         err =
             ptl_sendto(ni->iface->udp.connect_s, buf, sizeof(*buf), 0,
                        (struct sockaddr *)dest, sizeof(*dest), ni);
@@ -780,7 +1152,7 @@ buf_t *udp_receive(ni_t *ni)
         
     }
     //we are going to be handling multiple messages, implemented through a recvmsg call
-    if (thebuf->rlength > sizeof(buf_t)) {
+    if (udp_has_payload(thebuf)) {
         ptl_info("peek indicates large message of size: %i\n",
                  (int)thebuf->rlength);
 
@@ -1093,50 +1465,6 @@ buf_t *udp_receive(ni_t *ni)
     return (buf_t *)thebuf;
 }
 
-/* change the state of conn; we are now connected (UO & REB) */
-void PtlSetMap_udp(ni_t *ni, ptl_size_t map_size,
-                   const ptl_process_t *mapping)
-{
-    int i;
-
-    ptl_info("Creating a connection for PTlSetMapn");
-    for (i = 0; i < map_size; i++) {
-#if WITH_TRANSPORT_SHMEM
-        if (mapping[i].phys.nid != ni->iface->id.phys.nid) {
-#endif
-            conn_t *conn;
-
-            ptl_process_t id;
-            id.rank = i;
-
-            conn = get_conn(ni, id);
-            if (!conn) {
-                /* It's hard to recover from here. */
-                WARN();
-                abort();
-                return;
-            };
-
-            if (conn->transport.type == CONN_TYPE_UDP)
-                conn->transport = transport_udp;
-
-            conn->udp.dest_addr.sin_addr.s_addr =
-                nid_to_addr(mapping[i].phys.nid);
-            conn->udp.dest_addr.sin_port = pid_to_port(mapping[i].phys.pid);
-            ptl_info("setmap connection: %s:%i rank: %i\n",
-                     inet_ntoa(conn->udp.dest_addr.sin_addr),
-                     htons(conn->udp.dest_addr.sin_port), id.rank);
-
-            //We are not connected until we've exchanged messages
-            conn_put(conn);            /* from get_conn */
-
-        }
-        ptl_info("Done creating connection for PtlSetMap\n");
-#if WITH_TRANSPORT_SHMEM
-    }                                  //end the check for offnode connections
-#endif
-}
-
 /**
  * @param[in] ni
  * @param[in] conn
@@ -7,22 +7,39 @@
 #include "xpmem.h"
 
 /* XPMEM mapping. Maybe this structure should be split into 2
- * differents ones: one for the client and one for the PPE. */
+ * differents ones: one for the client and one for the PPE.
+ *
+ * Without XPMEM, the segment is a memfd created by the PPE, which
+ * sends its descriptor to the client on the client socket. */
 struct xpmem_map {
     /* From source process. */
     const void *source_addr;
     size_t size;
 
+#if USE_XPMEM
     off_t offset;               /* from start of segid to source_addr */
     xpmem_segid_t segid;
+#else
+    off_t offset;               /* from start of the memfd to source_addr */
+    int fd;                     /* memfd, until sent to the client */
+#endif
 
     /* On dest process. */
     void *ptr_attach;           /* registered address with xpmem_attach */
 
+#if USE_XPMEM
     /* Both. */
     struct xpmem_addr addr;
+#endif
 };
 
+#if !USE_XPMEM
+void *ppe_shm_alloc(size_t size, struct xpmem_map *mapping);
+void ppe_shm_free(struct xpmem_map *mapping);
+int ppe_send_fd(int s, int fd);
+int ppe_recv_fd(int s);
+#endif
+
 #endif
 
 #endif /* PTL_XPMEM_H */
@@ -324,6 +324,7 @@ struct HYD_user_global {
     int debug;
 
     int auto_cleanup;
+    int pmi_shm;
 
     struct HYD_env_global global_env;
 };
@@ -6,6 +6,9 @@
 
 AM_CPPFLAGS += -I$(top_srcdir)/pm/utils
 
+# Layout of the node-local PMI segment, shared with the PMI client
+AM_CPPFLAGS += -I$(top_srcdir)/../pmi-simple
+
 bin_PROGRAMS += hydra_pmi_proxy
 
 hydra_pmi_proxy_SOURCES = $(top_srcdir)/pm/pmiserv/pmip.c \
@@ -13,6 +16,7 @@ hydra_pmi_proxy_SOURCES = $(top_srcdir)/pm/pmiserv/pmip.c \
 	$(top_srcdir)/pm/pmiserv/pmip_utils.c \
 	$(top_srcdir)/pm/pmiserv/pmip_pmi_v1.c \
 	$(top_srcdir)/pm/pmiserv/pmip_pmi_v2.c \
+	$(top_srcdir)/pm/pmiserv/pmip_shm.c \
 	$(top_srcdir)/pm/pmiserv/common.c \
 	$(top_srcdir)/pm/pmiserv/pmi_v2_common.c
 hydra_pmi_proxy_CFLAGS = $(AM_CFLAGS)
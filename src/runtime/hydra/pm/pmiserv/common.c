@@ -178,6 +178,65 @@ char *HYD_pmcd_pmi_find_token_keyval(struct HYD_pmcd_token *tokens, int count, c
     return NULL;
 }
 
+#define KVS_MIN_BUCKETS (64)
+
+/* FNV-1a, on the key as stored in a pair */
+static unsigned int kvs_hash(const char *key)
+{
+    unsigned int hash = 2166136261U;
+
+    for (; *key; key++) {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+/* Double the hash table and the index, and rehash the pairs */
+static HYD_status kvs_grow(struct HYD_pmcd_pmi_kvs *kvs)
+{
+    struct HYD_pmcd_pmi_kvs_pair **bucket, **pair_idx, *run;
+    int num_buckets, i;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    num_buckets = kvs->num_buckets ? 2 * kvs->num_buckets : KVS_MIN_BUCKETS;
+
+    HYDU_MALLOC(bucket, struct HYD_pmcd_pmi_kvs_pair **,
+                num_buckets * sizeof(struct HYD_pmcd_pmi_kvs_pair *), status);
+    HYDU_MALLOC(pair_idx, struct HYD_pmcd_pmi_kvs_pair **,
+                num_buckets * sizeof(struct HYD_pmcd_pmi_kvs_pair *), status);
+
+    for (i = 0; i < num_buckets; i++)
+        bucket[i] = NULL;
+
+    i = 0;
+    for (run = kvs->key_pair; run; run = run->next) {
+        unsigned int h = kvs_hash(run->key) & (num_buckets - 1);
+
+        run->hash_next = bucket[h];
+        bucket[h] = run;
+        pair_idx[i++] = run;
+    }
+
+    if (kvs->bucket)
+        HYDU_FREE(kvs->bucket);
+    if (kvs->pair_idx)
+        HYDU_FREE(kvs->pair_idx);
+    kvs->bucket = bucket;
+    kvs->pair_idx = pair_idx;
+    kvs->num_buckets = num_buckets;
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
 HYD_status HYD_pmcd_pmi_allocate_kvs(struct HYD_pmcd_pmi_kvs ** kvs, int pgid)
 {
     HYD_status status = HYD_SUCCESS;
@@ -187,6 +246,14 @@ HYD_status HYD_pmcd_pmi_allocate_kvs(struct HYD_pmcd_pmi_kvs ** kvs, int pgid)
     HYDU_MALLOC(*kvs, struct HYD_pmcd_pmi_kvs *, sizeof(struct HYD_pmcd_pmi_kvs), status);
     HYDU_snprintf((*kvs)->kvs_name, PMI_MAXKVSLEN, "kvs_%d_%d", (int) getpid(), pgid);
     (*kvs)->key_pair = NULL;
+    (*kvs)->tail = NULL;
+    (*kvs)->bucket = NULL;
+    (*kvs)->pair_idx = NULL;
+    (*kvs)->num_buckets = 0;
+    (*kvs)->num_pairs = 0;
+
+    status = kvs_grow(*kvs);
+    HYDU_ERR_POP(status, "unable to allocate kvs hash table\n");
 
   fn_exit:
     HYDU_FUNC_EXIT();
@@ -208,15 +275,33 @@ void HYD_pmcd_free_pmi_kvs_list(struct HYD_pmcd_pmi_kvs *kvs_list)
         HYDU_FREE(key_pair);
         key_pair = tmp;
     }
+    if (kvs_list->bucket)
+        HYDU_FREE(kvs_list->bucket);
+    if (kvs_list->pair_idx)
+        HYDU_FREE(kvs_list->pair_idx);
     HYDU_FREE(kvs_list);
 
     HYDU_FUNC_EXIT();
 }
 
+struct HYD_pmcd_pmi_kvs_pair *HYD_pmcd_pmi_find_kvs(struct HYD_pmcd_pmi_kvs *kvs,
+                                                    const char *key)
+{
+    struct HYD_pmcd_pmi_kvs_pair *run;
+
+    run = kvs->bucket[kvs_hash(key) & (kvs->num_buckets - 1)];
+    for (; run; run = run->hash_next)
+        if (!strcmp(run->key, key))
+            break;
+
+    return run;
+}
+
 HYD_status HYD_pmcd_pmi_add_kvs(const char *key, char *val, struct HYD_pmcd_pmi_kvs *kvs,
                                 int *ret)
 {
-    struct HYD_pmcd_pmi_kvs_pair *key_pair, *run;
+    struct HYD_pmcd_pmi_kvs_pair *key_pair = NULL;
+    unsigned int h;
     HYD_status status = HYD_SUCCESS;
 
     HYDU_FUNC_ENTER();
@@ -229,26 +314,35 @@ HYD_status HYD_pmcd_pmi_add_kvs(const char *key, char *val, struct HYD_pmcd_pmi_
 
     *ret = 0;
 
-    if (kvs->key_pair == NULL) {
-        kvs->key_pair = key_pair;
+    if (HYD_pmcd_pmi_find_kvs(kvs, key_pair->key)) {
+        /* duplicate key found; the first value stays */
+        *ret = -1;
+        HYDU_FREE(key_pair);
+        goto fn_exit;
     }
-    else {
-        run = kvs->key_pair;
-        while (run->next) {
-            if (!strcmp(run->key, key_pair->key)) {
-                /* duplicate key found */
-                *ret = -1;
-                break;
-            }
-            run = run->next;
-        }
-        run->next = key_pair;
+
+    if (kvs->num_pairs == kvs->num_buckets) {
+        status = kvs_grow(kvs);
+        HYDU_ERR_POP(status, "unable to grow kvs hash table\n");
     }
 
+    if (kvs->tail)
+        kvs->tail->next = key_pair;
+    else
+        kvs->key_pair = key_pair;
+    kvs->tail = key_pair;
+
+    h = kvs_hash(key_pair->key) & (kvs->num_buckets - 1);
+    key_pair->hash_next = kvs->bucket[h];
+    kvs->bucket[h] = key_pair;
+    kvs->pair_idx[kvs->num_pairs++] = key_pair;
+
   fn_exit:
     HYDU_FUNC_EXIT();
     return status;
 
   fn_fail:
+    if (key_pair)
+        HYDU_FREE(key_pair);
     goto fn_exit;
 }
@@ -18,11 +18,20 @@ struct HYD_pmcd_pmi_kvs_pair {
     char key[PMI_MAXKEYLEN];
     char val[PMI_MAXVALLEN];
     struct HYD_pmcd_pmi_kvs_pair *next;
+    struct HYD_pmcd_pmi_kvs_pair *hash_next;    /* Next in the same bucket */
 };
 
 struct HYD_pmcd_pmi_kvs {
     char kvs_name[PMI_MAXKVSLEN];       /* Name of this kvs */
-    struct HYD_pmcd_pmi_kvs_pair *key_pair;
+    struct HYD_pmcd_pmi_kvs_pair *key_pair;     /* In the order they were put */
+    struct HYD_pmcd_pmi_kvs_pair *tail;
+
+    /* Hash table of the pairs, with at most one pair per bucket on
+     * average, and the pairs by index for getbyidx */
+    struct HYD_pmcd_pmi_kvs_pair **bucket;
+    struct HYD_pmcd_pmi_kvs_pair **pair_idx;
+    int num_buckets;
+    int num_pairs;
 };
 
 struct HYD_pmcd_hdr {
@@ -79,5 +88,7 @@ HYD_status HYD_pmcd_pmi_allocate_kvs(struct HYD_pmcd_pmi_kvs **kvs, int pgid);
 void HYD_pmcd_free_pmi_kvs_list(struct HYD_pmcd_pmi_kvs *kvs_list);
 HYD_status HYD_pmcd_pmi_add_kvs(const char *key, char *val, struct HYD_pmcd_pmi_kvs *kvs,
                                 int *ret);
+struct HYD_pmcd_pmi_kvs_pair *HYD_pmcd_pmi_find_kvs(struct HYD_pmcd_pmi_kvs *kvs,
+                                                    const char *key);
 
 #endif /* COMMON_H_INCLUDED */
@@ -56,6 +56,9 @@ static HYD_status init_params(void)
     HYD_pmcd_pmip.local.proxy_process_count = -1;
     HYD_pmcd_pmip.local.ckpoint_prefix_list = NULL;
     HYD_pmcd_pmip.local.retries = -1;
+    HYD_pmcd_pmip.local.pmi_shm = NULL;
+    HYD_pmcd_pmip.local.pmi_shm_len = 0;
+    HYD_pmcd_pmip.local.pmi_shm_cached = 0;
 
     HYD_pmcd_pmip.exec_list = NULL;
 
@@ -132,6 +135,8 @@ static void cleanup_params(void)
         HYDU_FREE(HYD_pmcd_pmip.local.ckpoint_prefix_list);
     }
 
+    HYD_pmcd_pmip_shm_finalize();
+
     HYD_pmcd_free_pmi_kvs_list(HYD_pmcd_pmip.local.kvs);
 
 
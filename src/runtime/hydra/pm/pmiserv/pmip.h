@@ -75,6 +75,11 @@ struct HYD_pmcd_pmip {
         char **ckpoint_prefix_list;
 
         int retries;
+
+        /* Node-local PMI segment, if the processes share one */
+        struct PMI_shm_hdr *pmi_shm;
+        size_t pmi_shm_len;
+        int pmi_shm_cached;
     } local;
 
     /* Process segmentation information for this proxy */
@@ -88,4 +93,10 @@ HYD_status HYD_pmcd_pmip_get_params(char **t_argv);
 void HYD_pmcd_pmip_kill_localprocs(void);
 HYD_status HYD_pmcd_pmip_control_cmd_cb(int fd, HYD_event_t events, void *userp);
 
+HYD_status HYD_pmcd_pmip_shm_create(int *fd);
+HYD_status HYD_pmcd_pmip_shm_cache(const char *key, const char *val);
+HYD_status HYD_pmcd_pmip_shm_flush(int fd);
+void HYD_pmcd_pmip_shm_release(void);
+void HYD_pmcd_pmip_shm_finalize(void);
+
 #endif /* PMIP_H_INCLUDED */
@@ -480,6 +480,7 @@ static HYD_status launch_procs(void)
     struct HYD_exec *exec;
     struct HYD_pmcd_hdr hdr;
     int sent, closed, pmi_fds[2] = { HYD_FD_UNSET, HYD_FD_UNSET };
+    int shm_fd = HYD_FD_UNSET;
     struct HYDT_topo_cpuset_t cpuset;
     char ftb_event_payload[HYDT_FTB_MAX_PAYLOAD_DATA];
     HYD_status status = HYD_SUCCESS;
@@ -589,6 +590,14 @@ static HYD_status launch_procs(void)
         goto fn_spawn_complete;
     }
 
+    /* With one PMI_FD per process, they can share a segment with us
+     * for the KVS and the barrier */
+    if (HYD_pmcd_pmip.user_global.pmi_shm == 1 && !using_pmi_port &&
+        !HYD_pmcd_pmip.system_global.pmi_fd && HYD_pmcd_pmip.system_global.pmi_rank == -1) {
+        status = HYD_pmcd_pmip_shm_create(&shm_fd);
+        HYDU_ERR_POP(status, "unable to create the PMI segment\n");
+    }
+
     /* Spawn the processes */
     process_id = 0;
     for (exec = HYD_pmcd_pmip.exec_list; exec; exec = exec->next) {
@@ -735,6 +744,14 @@ static HYD_status launch_procs(void)
                 status = HYDU_append_env_to_list("PMI_SIZE", str, &force_env);
                 HYDU_ERR_POP(status, "unable to add env to list\n");
                 HYDU_FREE(str);
+
+                /* PMI_SHM_FD */
+                if (shm_fd != HYD_FD_UNSET) {
+                    str = HYDU_int_to_str(shm_fd);
+                    status = HYDU_append_env_to_list("PMI_SHM_FD", str, &force_env);
+                    HYDU_ERR_POP(status, "unable to add env to list\n");
+                    HYDU_FREE(str);
+                }
             }
 
             for (j = 0, arg = 0; exec->exec[j]; j++)
@@ -764,6 +781,9 @@ static HYD_status launch_procs(void)
         force_env = NULL;
     }
 
+    if (shm_fd != HYD_FD_UNSET)
+        close(shm_fd);
+
     /* Send the PID list upstream */
     HYD_pmcd_init_header(&hdr);
     hdr.cmd = PID_LIST;
@@ -421,6 +421,10 @@ static HYD_status fn_get(int fd, char *args[])
     goto fn_exit;
 }
 
+/* Whether the processes are waiting for barrier_out on the shared
+ * segment rather than on their sockets */
+static int shm_barrier = 0;
+
 static HYD_status fn_barrier_in(int fd, char *args[])
 {
     static int barrier_count = 0;
@@ -428,7 +432,19 @@ static HYD_status fn_barrier_in(int fd, char *args[])
 
     HYDU_FUNC_ENTER();
 
-    barrier_count++;
+    /* With the shared segment, only the last process of the node
+     * comes to us, and the puts of the node come with it */
+    if (HYD_pmcd_pmip.local.pmi_shm && args[0] && !strcmp(args[0], "shm=1")) {
+        status = HYD_pmcd_pmip_shm_flush(fd);
+        HYDU_ERR_POP(status, "unable to flush the put log\n");
+
+        shm_barrier = 1;
+        barrier_count = HYD_pmcd_pmip.local.proxy_process_count;
+        args++;
+    }
+    else
+        barrier_count++;
+
     if (barrier_count == HYD_pmcd_pmip.local.proxy_process_count) {
         barrier_count = 0;
 
@@ -452,6 +468,12 @@ static HYD_status fn_barrier_out(int fd, char *args[])
 
     HYDU_FUNC_ENTER();
 
+    if (shm_barrier) {
+        shm_barrier = 0;
+        HYD_pmcd_pmip_shm_release();
+        goto fn_exit;
+    }
+
     cmd = HYDU_strdup("cmd=barrier_out\n");
 
     for (i = 0; i < HYD_pmcd_pmip.local.proxy_process_count; i++) {
@@ -469,6 +491,40 @@ static HYD_status fn_barrier_out(int fd, char *args[])
     goto fn_exit;
 }
 
+static HYD_status fn_kvs_cache(int fd, char *args[])
+{
+    struct HYD_pmcd_token *tokens;
+    char *key = NULL;
+    int token_count, i;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    status = HYD_pmcd_pmi_args_to_tokens(args, &tokens, &token_count);
+    HYDU_ERR_POP(status, "unable to convert args to tokens\n");
+
+    if (HYD_pmcd_pmip.local.pmi_shm == NULL)
+        goto fn_exit;
+
+    for (i = 0; i < token_count; i++) {
+        if (!strcmp(tokens[i].key, "key"))
+            key = tokens[i].val;
+        else if (!strcmp(tokens[i].key, "value") && key) {
+            status = HYD_pmcd_pmip_shm_cache(key, tokens[i].val ? tokens[i].val : "");
+            HYDU_ERR_POP(status, "unable to cache keypair\n");
+            key = NULL;
+        }
+    }
+
+  fn_exit:
+    HYD_pmcd_pmi_free_tokens(tokens, token_count);
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
 static HYD_status fn_finalize(int fd, char *args[])
 {
     const char *cmd;
@@ -504,6 +560,7 @@ static struct HYD_pmcd_pmip_pmi_handle pmi_v1_handle_fns_foo[] = {
     {"get", fn_get},
     {"barrier_in", fn_barrier_in},
     {"barrier_out", fn_barrier_out},
+    {"kvs_cache", fn_kvs_cache},
     {"finalize", fn_finalize},
     {"\0", NULL}
 };
@@ -405,13 +405,8 @@ static HYD_status fn_info_getnodeattr(int fd, char *args[])
     /* if a predefined value is not found, we let the code fall back
      * to regular search and return an error to the client */
 
-    found = 0;
-    for (run = HYD_pmcd_pmip.local.kvs->key_pair; run; run = run->next) {
-        if (!strcmp(run->key, key)) {
-            found = 1;
-            break;
-        }
-    }
+    run = HYD_pmcd_pmi_find_kvs(HYD_pmcd_pmip.local.kvs, key);
+    found = (run != NULL);
 
     if (found) {        /* We found the attribute */
         i = 0;
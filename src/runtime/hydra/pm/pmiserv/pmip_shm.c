@@ -0,0 +1,262 @@
+/* -*- Mode: C; c-basic-offset:4 ; -*- */
+/*
+ *  (C) 2008 by Argonne National Laboratory.
+ *      See COPYRIGHT in top-level directory.
+ */
+
+#include "hydra.h"
+#include "pmip.h"
+
+#if defined HAVE_LINUX_FUTEX_H && defined HAVE_SHM_OPEN && defined HAVE_SYS_MMAN_H
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "simple_pmi_shm.h"
+
+/* Puts a process can log between two barriers before they go through
+ * the socket */
+#define PMIP_SHM_PUTS_PER_PROC 16
+
+/* The segment is sparse, so only the used part of the cache costs
+ * memory */
+#define PMIP_SHM_BUCKETS (1 << 16)
+
+/* Pairs per mput, well within the arguments a PMI command can have */
+#define PMIP_SHM_MPUT_PAIRS 200
+
+HYD_status HYD_pmcd_pmip_shm_create(int *fd)
+{
+    struct PMI_shm_hdr *shm;
+    char name[64];
+    size_t len;
+    int max_puts, flags;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    max_puts = HYD_pmcd_pmip.local.proxy_process_count * PMIP_SHM_PUTS_PER_PROC;
+    len = PMI_SHM_SIZE(max_puts, PMIP_SHM_BUCKETS);
+
+    /* The name is only needed until the fd is open */
+    HYDU_snprintf(name, sizeof(name), "/hydra-pmi-%d", (int) getpid());
+    *fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    if (*fd < 0)
+        HYDU_ERR_SETANDJUMP(status, HYD_INTERNAL_ERROR, "shm_open error (%s)\n",
+                            HYDU_strerror(errno));
+    shm_unlink(name);
+
+    /* The processes we launch inherit it */
+    flags = fcntl(*fd, F_GETFD);
+    if (flags < 0 || fcntl(*fd, F_SETFD, flags & ~FD_CLOEXEC) < 0)
+        HYDU_ERR_SETANDJUMP(status, HYD_INTERNAL_ERROR, "fcntl error (%s)\n",
+                            HYDU_strerror(errno));
+
+    if (ftruncate(*fd, len) < 0)
+        HYDU_ERR_SETANDJUMP(status, HYD_INTERNAL_ERROR, "ftruncate error (%s)\n",
+                            HYDU_strerror(errno));
+
+    shm = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+    if (shm == MAP_FAILED)
+        HYDU_ERR_SETANDJUMP(status, HYD_INTERNAL_ERROR, "mmap error (%s)\n",
+                            HYDU_strerror(errno));
+
+    HYDU_snprintf(shm->kvsname, PMI_SHM_NAMELEN, "%s", HYD_pmcd_pmip.local.kvs->kvs_name);
+    shm->local_size = HYD_pmcd_pmip.local.proxy_process_count;
+    shm->max_puts = max_puts;
+    shm->num_buckets = PMIP_SHM_BUCKETS;
+
+    HYD_pmcd_pmip.local.pmi_shm = shm;
+    HYD_pmcd_pmip.local.pmi_shm_len = len;
+
+    /* We answer this one locally anyway */
+    if (HYD_pmcd_pmip.system_global.pmi_process_mapping) {
+        status = HYD_pmcd_pmip_shm_cache("PMI_process_mapping",
+                                         HYD_pmcd_pmip.system_global.pmi_process_mapping);
+        HYDU_ERR_POP(status, "unable to cache the process mapping\n");
+    }
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    if (*fd >= 0)
+        close(*fd);
+    *fd = HYD_FD_UNSET;
+    goto fn_exit;
+}
+
+HYD_status HYD_pmcd_pmip_shm_cache(const char *key, const char *val)
+{
+    struct PMI_shm_hdr *shm = HYD_pmcd_pmip.local.pmi_shm;
+    struct PMI_shm_pair *pair;
+    int mask, i;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    /* Keep a free bucket to end the lookups; the processes ask us
+     * for what is not cached */
+    if (HYD_pmcd_pmip.local.pmi_shm_cached >= shm->num_buckets / 4 * 3 ||
+        strlen(key) >= PMI_SHM_KEYLEN || strlen(val) >= PMI_SHM_VALLEN)
+        goto fn_exit;
+
+    mask = shm->num_buckets - 1;
+    for (i = PMI_shm_hash(key) & mask;; i = (i + 1) & mask) {
+        pair = &PMI_SHM_BUCKETS(shm)[i];
+        if (!pair->ready)
+            break;
+        if (!strcmp(pair->key, key))
+            goto fn_exit;
+    }
+
+    HYDU_snprintf(pair->key, PMI_SHM_KEYLEN, "%s", key);
+    HYDU_snprintf(pair->val, PMI_SHM_VALLEN, "%s", val);
+    pair->ready = 1;
+    HYD_pmcd_pmip.local.pmi_shm_cached++;
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+}
+
+static HYD_status send_mput(int fd, char *buf, int len)
+{
+    struct HYD_pmcd_hdr hdr;
+    int sent, closed;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    buf[len++] = '\n';
+
+    HYD_pmcd_init_header(&hdr);
+    hdr.cmd = PMI_CMD;
+    hdr.pid = fd;
+    hdr.buflen = len;
+    hdr.pmi_version = 1;
+    status =
+        HYDU_sock_write(HYD_pmcd_pmip.upstream.control, &hdr, sizeof(hdr), &sent, &closed);
+    HYDU_ERR_POP(status, "unable to send PMI header upstream\n");
+    HYDU_ASSERT(!closed, status);
+
+    status = HYDU_sock_write(HYD_pmcd_pmip.upstream.control, buf, len, &sent, &closed);
+    HYDU_ERR_POP(status, "unable to send PMI command upstream\n");
+    HYDU_ASSERT(!closed, status);
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+HYD_status HYD_pmcd_pmip_shm_flush(int fd)
+{
+    struct PMI_shm_hdr *shm = HYD_pmcd_pmip.local.pmi_shm;
+    struct PMI_shm_pair *pair;
+    char *buf = NULL;
+    size_t size;
+    int num_puts, len, start, count, i;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    num_puts = shm->num_puts;
+    if (num_puts > shm->max_puts)
+        num_puts = shm->max_puts;
+    if (num_puts == 0)
+        goto fn_exit;
+
+    size = PMI_SHM_NAMELEN + 32 +
+        PMIP_SHM_MPUT_PAIRS * (PMI_SHM_KEYLEN + PMI_SHM_VALLEN + 16);
+    HYDU_MALLOC(buf, char *, size, status);
+
+    start = HYDU_snprintf(buf, size, "cmd=mput kvsname=%s", shm->kvsname);
+    len = start;
+    count = 0;
+    for (i = 0; i < num_puts; i++) {
+        pair = &PMI_SHM_PUTS(shm)[i];
+        if (!pair->ready)
+            continue;
+
+        len += HYDU_snprintf(buf + len, size - len, " key=%s value=%s", pair->key, pair->val);
+        if (++count == PMIP_SHM_MPUT_PAIRS) {
+            status = send_mput(fd, buf, len);
+            HYDU_ERR_POP(status, "unable to send the put log upstream\n");
+            len = start;
+            count = 0;
+        }
+    }
+
+    if (count) {
+        status = send_mput(fd, buf, len);
+        HYDU_ERR_POP(status, "unable to send the put log upstream\n");
+    }
+
+  fn_exit:
+    if (buf)
+        HYDU_FREE(buf);
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+void HYD_pmcd_pmip_shm_release(void)
+{
+    struct PMI_shm_hdr *shm = HYD_pmcd_pmip.local.pmi_shm;
+    int num_puts, i;
+
+    /* Everyone is in the barrier, so nobody is logging puts, and the
+     * cache now has the pairs of the log */
+    num_puts = shm->num_puts;
+    if (num_puts > shm->max_puts)
+        num_puts = shm->max_puts;
+    for (i = 0; i < num_puts; i++)
+        PMI_SHM_PUTS(shm)[i].ready = 0;
+    shm->num_puts = 0;
+    __sync_fetch_and_add(&shm->barrier_gen, 1);
+    syscall(SYS_futex, &shm->barrier_gen, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+void HYD_pmcd_pmip_shm_finalize(void)
+{
+    if (HYD_pmcd_pmip.local.pmi_shm) {
+        munmap(HYD_pmcd_pmip.local.pmi_shm, HYD_pmcd_pmip.local.pmi_shm_len);
+        HYD_pmcd_pmip.local.pmi_shm = NULL;
+    }
+}
+
+#else
+
+HYD_status HYD_pmcd_pmip_shm_create(int *fd)
+{
+    *fd = HYD_FD_UNSET;
+    return HYD_SUCCESS;
+}
+
+HYD_status HYD_pmcd_pmip_shm_cache(const char *key, const char *val)
+{
+    return HYD_SUCCESS;
+}
+
+HYD_status HYD_pmcd_pmip_shm_flush(int fd)
+{
+    return HYD_SUCCESS;
+}
+
+void HYD_pmcd_pmip_shm_release(void)
+{
+}
+
+void HYD_pmcd_pmip_shm_finalize(void)
+{
+}
+
+#endif
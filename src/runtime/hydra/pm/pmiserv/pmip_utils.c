@@ -144,6 +144,17 @@ static HYD_status auto_cleanup_fn(char *arg, char ***argv)
     return status;
 }
 
+static HYD_status pmi_shm_fn(char *arg, char ***argv)
+{
+    HYD_status status = HYD_SUCCESS;
+
+    status = HYDU_set_int(arg, &HYD_pmcd_pmip.user_global.pmi_shm, atoi(**argv));
+
+    (*argv)++;
+
+    return status;
+}
+
 static HYD_status retries_fn(char *arg, char ***argv)
 {
     HYD_status status = HYD_SUCCESS;
@@ -673,6 +684,7 @@ struct HYD_arg_match_table HYD_pmcd_pmip_match_table[] = {
     {"demux", demux_fn, NULL},
     {"iface", iface_fn, NULL},
     {"auto-cleanup", auto_cleanup_fn, NULL},
+    {"pmi-shm", pmi_shm_fn, NULL},
     {"retries", retries_fn, NULL},
 
     /* Executable parameters */
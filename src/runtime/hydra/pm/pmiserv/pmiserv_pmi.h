@@ -37,6 +37,7 @@ struct HYD_pmcd_pmi_pg_scratch {
     int dead_process_count;
 
     struct HYD_pmcd_pmi_kvs *kvs;
+    int kvs_cached;             /* Pairs already pushed to the proxies */
 };
 
 struct HYD_pmcd_pmi_publish {
@@ -44,6 +44,57 @@ static HYD_status cmd_response(int fd, int pid, const char *cmd)
     goto fn_exit;
 }
 
+/* Pairs per kvs_cache, well within the arguments a PMI command can
+ * have */
+#define KVS_CACHE_PAIRS 200
+
+/* Push the pairs put since the last barrier to the proxies, which
+ * cache them for their processes with -enable-pmi-shm */
+static HYD_status push_kvs_cache(struct HYD_pg *pg, int pid)
+{
+    struct HYD_pmcd_pmi_pg_scratch *pg_scratch;
+    struct HYD_pmcd_pmi_kvs_pair *run;
+    struct HYD_proxy *tproxy;
+    char *buf;
+    size_t size;
+    int start, len, i, j;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    pg_scratch = (struct HYD_pmcd_pmi_pg_scratch *) pg->pg_scratch;
+    if (pg_scratch->kvs_cached == pg_scratch->kvs->num_pairs)
+        goto fn_exit;
+
+    size = 32 + KVS_CACHE_PAIRS * (PMI_MAXKEYLEN + PMI_MAXVALLEN + 16);
+    HYDU_MALLOC(buf, char *, size, status);
+
+    start = HYDU_snprintf(buf, size, "cmd=kvs_cache");
+    for (i = pg_scratch->kvs_cached; i < pg_scratch->kvs->num_pairs; i += KVS_CACHE_PAIRS) {
+        len = start;
+        for (j = i; j < pg_scratch->kvs->num_pairs && j < i + KVS_CACHE_PAIRS; j++) {
+            run = pg_scratch->kvs->pair_idx[j];
+            len += HYDU_snprintf(buf + len, size - len, " key=%s value=%s", run->key, run->val);
+        }
+        HYDU_snprintf(buf + len, size - len, "\n");
+
+        for (tproxy = pg->proxy_list; tproxy; tproxy = tproxy->next) {
+            status = cmd_response(tproxy->control_fd, pid, buf);
+            HYDU_ERR_POP(status, "error writing PMI line\n");
+        }
+    }
+    pg_scratch->kvs_cached = pg_scratch->kvs->num_pairs;
+
+    HYDU_FREE(buf);
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
 static HYD_status fn_barrier_in(int fd, int pid, int pgid, char *args[])
 {
     struct HYD_proxy *proxy, *tproxy;
@@ -65,6 +116,11 @@ static HYD_status fn_barrier_in(int fd, int pid, int pgid, char *args[])
         proxy->pg->barrier_count = 0;
         cmd = "cmd=barrier_out\n";
 
+        if (HYD_server_info.user_global.pmi_shm) {
+            status = push_kvs_cache(proxy->pg, pid);
+            HYDU_ERR_POP(status, "unable to push the kvs to the proxies\n");
+        }
+
         for (tproxy = proxy->pg->proxy_list; tproxy; tproxy = tproxy->next) {
             status = cmd_response(tproxy->control_fd, pid, cmd);
             HYDU_ERR_POP(status, "error writing PMI line\n");
@@ -152,6 +208,57 @@ static HYD_status fn_put(int fd, int pid, int pgid, char *args[])
     goto fn_exit;
 }
 
+static HYD_status fn_mput(int fd, int pid, int pgid, char *args[])
+{
+    int i, ret;
+    struct HYD_proxy *proxy;
+    struct HYD_pmcd_pmi_pg_scratch *pg_scratch;
+    char *kvsname, *key = NULL;
+    struct HYD_pmcd_token *tokens;
+    int token_count;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    status = HYD_pmcd_pmi_args_to_tokens(args, &tokens, &token_count);
+    HYDU_ERR_POP(status, "unable to convert args to tokens\n");
+
+    kvsname = HYD_pmcd_pmi_find_token_keyval(tokens, token_count, "kvsname");
+    HYDU_ERR_CHKANDJUMP(status, kvsname == NULL, HYD_INTERNAL_ERROR,
+                        "unable to find token: kvsname\n");
+
+    proxy = HYD_pmcd_pmi_find_proxy(fd);
+    HYDU_ASSERT(proxy, status);
+
+    pg_scratch = (struct HYD_pmcd_pmi_pg_scratch *) proxy->pg->pg_scratch;
+
+    if (strcmp(pg_scratch->kvs->kvs_name, kvsname))
+        HYDU_ERR_SETANDJUMP(status, HYD_INTERNAL_ERROR,
+                            "kvsname (%s) does not match this group's kvs space (%s)\n",
+                            kvsname, pg_scratch->kvs->kvs_name);
+
+    /* The puts a proxy logged for its processes; nobody waits for the
+     * result, and a duplicate keeps the first value as with put */
+    for (i = 0; i < token_count; i++) {
+        if (!strcmp(tokens[i].key, "key"))
+            key = tokens[i].val;
+        else if (!strcmp(tokens[i].key, "value") && key) {
+            status = HYD_pmcd_pmi_add_kvs(key, tokens[i].val ? tokens[i].val : "",
+                                          pg_scratch->kvs, &ret);
+            HYDU_ERR_POP(status, "unable to add keypair to kvs\n");
+            key = NULL;
+        }
+    }
+
+  fn_exit:
+    HYD_pmcd_pmi_free_tokens(tokens, token_count);
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
 static HYD_status fn_get(int fd, int pid, int pgid, char *args[])
 {
     int i;
@@ -194,12 +301,9 @@ static HYD_status fn_get(int fd, int pid, int pgid, char *args[])
                             kvsname, pg_scratch->kvs->kvs_name);
 
     /* Try to find the key */
-    for (run = pg_scratch->kvs->key_pair; run; run = run->next) {
-        if (!strcmp(run->key, key)) {
-            val = run->val;
-            break;
-        }
-    }
+    run = HYD_pmcd_pmi_find_kvs(pg_scratch->kvs, key);
+    if (run)
+        val = run->val;
 
   found_val:
     i = 0;
@@ -233,6 +337,81 @@ static HYD_status fn_get(int fd, int pid, int pgid, char *args[])
     goto fn_exit;
 }
 
+static HYD_status fn_getbyidx(int fd, int pid, int pgid, char *args[])
+{
+    int i, idx;
+    struct HYD_proxy *proxy;
+    struct HYD_pmcd_pmi_pg_scratch *pg_scratch;
+    struct HYD_pmcd_pmi_kvs_pair *run;
+    char *kvsname, *idx_str;
+    char *tmp[HYD_NUM_TMP_STRINGS], *cmd;
+    struct HYD_pmcd_token *tokens;
+    int token_count;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    status = HYD_pmcd_pmi_args_to_tokens(args, &tokens, &token_count);
+    HYDU_ERR_POP(status, "unable to convert args to tokens\n");
+
+    kvsname = HYD_pmcd_pmi_find_token_keyval(tokens, token_count, "kvsname");
+    HYDU_ERR_CHKANDJUMP(status, kvsname == NULL, HYD_INTERNAL_ERROR,
+                        "unable to find token: kvsname\n");
+
+    idx_str = HYD_pmcd_pmi_find_token_keyval(tokens, token_count, "idx");
+    HYDU_ERR_CHKANDJUMP(status, idx_str == NULL, HYD_INTERNAL_ERROR,
+                        "unable to find token: idx\n");
+    idx = atoi(idx_str);
+
+    proxy = HYD_pmcd_pmi_find_proxy(fd);
+    HYDU_ASSERT(proxy, status);
+
+    pg_scratch = (struct HYD_pmcd_pmi_pg_scratch *) proxy->pg->pg_scratch;
+
+    if (strcmp(pg_scratch->kvs->kvs_name, kvsname))
+        HYDU_ERR_SETANDJUMP(status, HYD_INTERNAL_ERROR,
+                            "kvsname (%s) does not match this group's kvs space (%s)\n",
+                            kvsname, pg_scratch->kvs->kvs_name);
+
+    /* The pairs are indexed in the order they were put, so a client
+     * can read them all with one request per pair */
+    run = NULL;
+    if (idx >= 0 && idx < pg_scratch->kvs->num_pairs)
+        run = pg_scratch->kvs->pair_idx[idx];
+
+    i = 0;
+    tmp[i++] = HYDU_strdup("cmd=getbyidx_results rc=");
+    if (run) {
+        tmp[i++] = HYDU_strdup("0 nextidx=");
+        tmp[i++] = HYDU_int_to_str(idx + 1);
+        tmp[i++] = HYDU_strdup(" key=");
+        tmp[i++] = HYDU_strdup(run->key);
+        tmp[i++] = HYDU_strdup(" val=");
+        tmp[i++] = HYDU_strdup(run->val);
+    }
+    else {
+        tmp[i++] = HYDU_strdup("-2 reason=no_more_keyvals");
+    }
+    tmp[i++] = HYDU_strdup("\n");
+    tmp[i++] = NULL;
+
+    status = HYDU_str_alloc_and_join(tmp, &cmd);
+    HYDU_ERR_POP(status, "unable to join strings\n");
+    HYDU_free_strlist(tmp);
+
+    status = cmd_response(fd, pid, cmd);
+    HYDU_ERR_POP(status, "error writing PMI line\n");
+    HYDU_FREE(cmd);
+
+  fn_exit:
+    HYD_pmcd_pmi_free_tokens(tokens, token_count);
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
 static char *mcmd_args[HYD_NUM_TMP_STRINGS] = { NULL };
 
 static int mcmd_num_args = 0;
@@ -710,11 +889,13 @@ static HYD_status fn_lookup_name(int fd, int pid, int pgid, char *args[])
     goto fn_exit;
 }
 
-/* TODO: abort, create_kvs, destroy_kvs, getbyidx */
+/* TODO: abort, create_kvs, destroy_kvs */
 static struct HYD_pmcd_pmi_handle pmi_v1_handle_fns_foo[] = {
     {"barrier_in", fn_barrier_in},
     {"put", fn_put},
+    {"mput", fn_mput},
     {"get", fn_get},
+    {"getbyidx", fn_getbyidx},
     {"spawn", fn_spawn},
     {"publish_name", fn_publish_name},
     {"unpublish_name", fn_unpublish_name},
@@ -142,12 +142,9 @@ static HYD_status fn_info_getjobattr(int fd, int pid, int pgid, char *args[])
         val = pg_scratch->dead_processes;
 
     /* Try to find the key */
-    for (run = pg_scratch->kvs->key_pair; run; run = run->next) {
-        if (!strcmp(run->key, key)) {
-            val = run->val;
-            break;
-        }
-    }
+    run = HYD_pmcd_pmi_find_kvs(pg_scratch->kvs, key);
+    if (run)
+        val = run->val;
 
     i = 0;
     tmp[i++] = HYDU_strdup("cmd=info-getjobattr-response;");
@@ -289,13 +286,8 @@ static HYD_status fn_kvs_get(int fd, int pid, int pgid, char *args[])
 
     pg_scratch = (struct HYD_pmcd_pmi_pg_scratch *) proxy->pg->pg_scratch;
 
-    found = 0;
-    for (run = pg_scratch->kvs->key_pair; run; run = run->next) {
-        if (!strcmp(run->key, key)) {
-            found = 1;
-            break;
-        }
-    }
+    run = HYD_pmcd_pmi_find_kvs(pg_scratch->kvs, key);
+    found = (run != NULL);
 
     if (!found) {
         pg = proxy->pg;
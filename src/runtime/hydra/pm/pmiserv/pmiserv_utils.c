@@ -368,6 +368,10 @@ HYD_status HYD_pmcd_pmi_fill_in_exec_launch_info(struct HYD_pg *pg)
         proxy->exec_launch_info[arg++] =
             HYDU_int_to_str(HYD_server_info.user_global.auto_cleanup);
 
+        proxy->exec_launch_info[arg++] = HYDU_strdup("--pmi-shm");
+        proxy->exec_launch_info[arg++] =
+            HYDU_int_to_str(HYD_server_info.user_global.pmi_shm);
+
         /* Check if we are running in embedded mode */
         ret = MPL_env2str("PMI_FD", (const char **) &pmi_fd);
         if (ret) {      /* PMI_FD already set */
@@ -604,6 +608,7 @@ HYD_status HYD_pmcd_pmi_alloc_pg_scratch(struct HYD_pg *pg)
 
     pg_scratch->dead_processes = HYDU_strdup("");
     pg_scratch->dead_process_count = 0;
+    pg_scratch->kvs_cached = 0;
 
     status = HYD_pmcd_pmi_allocate_kvs(&pg_scratch->kvs, pg->pgid);
     HYDU_ERR_POP(status, "unable to allocate kvs space\n");
@@ -10,6 +10,10 @@ libhydra_la_SOURCES += $(top_srcdir)/tools/demux/demux.c \
 	$(top_srcdir)/tools/demux/demux_internal.h \
 	$(top_srcdir)/tools/demux/demux.h
 
+if hydra_have_epoll
+libhydra_la_SOURCES += $(top_srcdir)/tools/demux/demux_epoll.c
+endif
+
 if hydra_have_poll
 libhydra_la_SOURCES += $(top_srcdir)/tools/demux/demux_poll.c
 endif
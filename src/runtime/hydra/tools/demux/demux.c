@@ -27,6 +27,28 @@ static void signal_cb(int sig)
 }
 #endif /* SIGTTIN and HAVE_ISATTY */
 
+#if defined HAVE_EPOLL
+static HYD_status use_epoll(void)
+{
+    HYD_status status = HYD_SUCCESS;
+
+    status = HYDT_dmxu_epoll_init();
+    HYDU_ERR_POP(status, "unable to create the epoll set\n");
+
+    HYDT_dmxu_fns.wait_for_event = HYDT_dmxu_epoll_wait_for_event;
+    HYDT_dmxu_fns.stdin_valid = HYDT_dmxu_epoll_stdin_valid;
+    HYDT_dmxu_fns.register_fd = HYDT_dmxu_epoll_register_fd;
+    HYDT_dmxu_fns.deregister_fd = HYDT_dmxu_epoll_deregister_fd;
+    HYDT_dmxu_fns.finalize = HYDT_dmxu_epoll_finalize;
+
+  fn_exit:
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+#endif /* HAVE_EPOLL */
+
 HYD_status HYDT_dmx_init(char **demux)
 {
     HYD_status status = HYD_SUCCESS;
@@ -34,7 +56,11 @@ HYD_status HYDT_dmx_init(char **demux)
     HYDU_FUNC_ENTER();
 
     if (!(*demux)) {    /* user didn't specify anything */
-#if defined HAVE_POLL
+#if defined HAVE_EPOLL
+        status = use_epoll();
+        HYDU_ERR_POP(status, "unable to initialize epoll\n");
+        *demux = HYDU_strdup("epoll");
+#elif defined HAVE_POLL
         HYDT_dmxu_fns.wait_for_event = HYDT_dmxu_poll_wait_for_event;
         HYDT_dmxu_fns.stdin_valid = HYDT_dmxu_poll_stdin_valid;
         *demux = HYDU_strdup("poll");
@@ -43,6 +69,12 @@ HYD_status HYDT_dmx_init(char **demux)
         HYDT_dmxu_fns.stdin_valid = HYDT_dmxu_select_stdin_valid;
         *demux = HYDU_strdup("select");
 #endif /* HAVE_SELECT */
+    }
+    else if (!strcmp(*demux, "epoll")) {        /* user wants to use epoll */
+#if defined HAVE_EPOLL
+        status = use_epoll();
+        HYDU_ERR_POP(status, "unable to initialize epoll\n");
+#endif /* HAVE_EPOLL */
     }
     else if (!strcmp(*demux, "poll")) { /* user wants to use poll */
 #if defined HAVE_POLL
@@ -125,6 +157,11 @@ HYD_status HYDT_dmx_register_fd(int num_fds, int *fd, HYD_event_t events, void *
 
     HYDT_dmxu_num_cb_fds += num_fds;
 
+    if (HYDT_dmxu_fns.register_fd) {
+        status = HYDT_dmxu_fns.register_fd(cb_element);
+        HYDU_ERR_POP(status, "demux engine unable to register fds\n");
+    }
+
   fn_exit:
     HYDU_FUNC_EXIT();
     return status;
@@ -147,6 +184,10 @@ HYD_status HYDT_dmx_deregister_fd(int fd)
             if (cb_element->fd[i] == fd) {
                 cb_element->fd[i] = HYD_FD_UNSET;
                 HYDT_dmxu_num_cb_fds--;
+                if (HYDT_dmxu_fns.deregister_fd) {
+                    status = HYDT_dmxu_fns.deregister_fd(fd);
+                    HYDU_ERR_POP(status, "demux engine unable to deregister fd %d\n", fd);
+                }
                 goto fn_exit;
             }
         }
@@ -211,8 +252,17 @@ HYD_status HYDT_dmx_finalize(void)
     }
     HYDT_dmxu_cb_list = NULL;
 
+    if (HYDT_dmxu_fns.finalize) {
+        status = HYDT_dmxu_fns.finalize();
+        HYDU_ERR_POP(status, "demux engine finalize returned error\n");
+    }
+
+  fn_exit:
     HYDU_FUNC_EXIT();
     return status;
+
+  fn_fail:
+    goto fn_exit;
 }
 
 HYD_status HYDT_dmxi_stdin_valid(int *out)
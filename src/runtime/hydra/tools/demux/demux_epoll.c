@@ -0,0 +1,303 @@
+/* -*- Mode: C; c-basic-offset:4 ; -*- */
+/*
+ *  (C) 2008 by Argonne National Laboratory.
+ *      See COPYRIGHT in top-level directory.
+ */
+
+#include "demux_internal.h"
+#include <sys/epoll.h>
+
+/* Unlike poll and select, the fds stay registered with the kernel
+ * between waits, so a wakeup only costs the fds that are ready and
+ * not a scan of every stdio and PMI connection. */
+
+#define EPOLL_MAX_EVENTS 64
+
+static int epoll_fd = -1;
+
+/* Registration of each fd, indexed by the fd */
+static struct HYDT_dmxu_callback **fd_cb = NULL;
+static int fd_cb_len = 0;
+
+/* epoll refuses regular files, which are always ready anyway */
+static int *ready_fds = NULL;
+static int num_ready_fds = 0;
+static int max_ready_fds = 0;
+
+static HYD_status grow_fd_cb(int fd)
+{
+    struct HYDT_dmxu_callback **cb;
+    int len, i;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    for (len = fd_cb_len ? fd_cb_len : 64; len <= fd; len *= 2);
+
+    HYDU_MALLOC(cb, struct HYDT_dmxu_callback **, len * sizeof(struct HYDT_dmxu_callback *),
+                status);
+    for (i = 0; i < fd_cb_len; i++)
+        cb[i] = fd_cb[i];
+    for (; i < len; i++)
+        cb[i] = NULL;
+
+    if (fd_cb)
+        HYDU_FREE(fd_cb);
+    fd_cb = cb;
+    fd_cb_len = len;
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+static HYD_status add_ready_fd(int fd)
+{
+    int *fds, i;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    if (num_ready_fds == max_ready_fds) {
+        HYDU_MALLOC(fds, int *, (max_ready_fds + 4) * sizeof(int), status);
+        for (i = 0; i < num_ready_fds; i++)
+            fds[i] = ready_fds[i];
+        if (ready_fds)
+            HYDU_FREE(ready_fds);
+        ready_fds = fds;
+        max_ready_fds += 4;
+    }
+    ready_fds[num_ready_fds++] = fd;
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+static HYD_status run_callback(struct HYDT_dmxu_callback *run, int fd, int events)
+{
+    HYD_status status = HYD_SUCCESS;
+
+    if (run->callback == NULL)
+        HYDU_ERR_POP(status, "no registered callback found for socket\n");
+
+    status = run->callback(fd, events, run->userp);
+    HYDU_ERR_POP(status, "callback returned error status\n");
+
+  fn_exit:
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+HYD_status HYDT_dmxu_epoll_init(void)
+{
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    /* The processes we launch don't need our registrations */
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+        HYDU_ERR_SETANDJUMP(status, HYD_SOCK_ERROR, "epoll_create1 error (%s)\n",
+                            HYDU_strerror(errno));
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+HYD_status HYDT_dmxu_epoll_register_fd(struct HYDT_dmxu_callback *cb)
+{
+    struct epoll_event ev;
+    int i, fd;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    for (i = 0; i < cb->num_fds; i++) {
+        fd = cb->fd[i];
+
+        if (fd >= fd_cb_len) {
+            status = grow_fd_cb(fd);
+            HYDU_ERR_POP(status, "unable to grow the fd table\n");
+        }
+        fd_cb[fd] = cb;
+
+        ev.events = 0;
+        if (cb->events & HYD_POLLIN)
+            ev.events |= EPOLLIN;
+        if (cb->events & HYD_POLLOUT)
+            ev.events |= EPOLLOUT;
+        ev.data.fd = fd;
+
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            if (errno != EPERM)
+                HYDU_ERR_SETANDJUMP(status, HYD_SOCK_ERROR, "epoll_ctl error (%s)\n",
+                                    HYDU_strerror(errno));
+
+            status = add_ready_fd(fd);
+            HYDU_ERR_POP(status, "unable to add an always ready fd\n");
+        }
+    }
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+HYD_status HYDT_dmxu_epoll_deregister_fd(int fd)
+{
+    struct epoll_event ev;
+    int i;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    if (fd < fd_cb_len)
+        fd_cb[fd] = NULL;
+
+    for (i = 0; i < num_ready_fds; i++) {
+        if (ready_fds[i] == fd) {
+            ready_fds[i] = ready_fds[--num_ready_fds];
+            goto fn_exit;
+        }
+    }
+
+    /* The fd may already be closed, which drops it from the set */
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev) < 0 && errno != EBADF && errno != ENOENT)
+        HYDU_ERR_SETANDJUMP(status, HYD_SOCK_ERROR, "epoll_ctl error (%s)\n",
+                            HYDU_strerror(errno));
+
+  fn_exit:
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+HYD_status HYDT_dmxu_epoll_wait_for_event(int wtime)
+{
+    struct epoll_event ev[EPOLL_MAX_EVENTS];
+    struct HYDT_dmxu_callback *run;
+    int *ready = NULL;
+    int num_ready, i, fd, events, ret, work_done;
+    HYD_status status = HYD_SUCCESS;
+
+    HYDU_FUNC_ENTER();
+
+    /* Convert user specified time to milliseconds for epoll */
+    ret = epoll_wait(epoll_fd, ev, EPOLL_MAX_EVENTS,
+                     num_ready_fds ? 0 : (wtime < 0) ? wtime : (wtime * 1000));
+    if (ret < 0) {
+        if (errno == EINTR) {
+            /* We were interrupted by a system call; this is not an
+             * error case in the regular sense; but the upper layer
+             * needs to gracefully cleanup the processes. */
+            status = HYD_SUCCESS;
+            goto fn_exit;
+        }
+        HYDU_ERR_SETANDJUMP(status, HYD_SOCK_ERROR, "epoll error (%s)\n",
+                            HYDU_strerror(errno));
+    }
+
+    work_done = 0;
+    for (i = 0; i < ret; i++) {
+        fd = ev[i].data.fd;
+
+        /* An earlier callback may have deregistered it */
+        if (fd >= fd_cb_len || fd_cb[fd] == NULL)
+            continue;
+        run = fd_cb[fd];
+        work_done = 1;
+
+        events = 0;
+        if (ev[i].events & EPOLLIN)
+            events |= HYD_POLLIN;
+        if (ev[i].events & EPOLLOUT)
+            events |= HYD_POLLOUT;
+        if (ev[i].events & EPOLLHUP)
+            events |= HYD_POLLHUP;
+
+        /* We only understand EPOLLIN/OUT/HUP */
+        HYDU_ASSERT(!(ev[i].events & ~EPOLLIN & ~EPOLLOUT & ~EPOLLHUP & ~EPOLLERR), status);
+
+        status = run_callback(run, fd, events);
+        HYDU_ERR_POP(status, "error running the callback of fd %d\n", fd);
+    }
+
+    /* The callbacks can deregister the always ready fds, so walk a
+     * copy of them */
+    if (num_ready_fds) {
+        num_ready = num_ready_fds;
+        HYDU_MALLOC(ready, int *, num_ready * sizeof(int), status);
+        for (i = 0; i < num_ready; i++)
+            ready[i] = ready_fds[i];
+
+        for (i = 0; i < num_ready; i++) {
+            fd = ready[i];
+            if (fd >= fd_cb_len || fd_cb[fd] == NULL)
+                continue;
+            run = fd_cb[fd];
+            work_done = 1;
+
+            status = run_callback(run, fd, run->events);
+            HYDU_ERR_POP(status, "error running the callback of fd %d\n", fd);
+        }
+    }
+
+    /* If no work has been done, it must be a timeout */
+    if (!work_done)
+        status = HYD_TIMED_OUT;
+
+  fn_exit:
+    if (ready)
+        HYDU_FREE(ready);
+    HYDU_FUNC_EXIT();
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
+HYD_status HYDT_dmxu_epoll_stdin_valid(int *out)
+{
+    return HYDT_dmxi_stdin_valid(out);
+}
+
+HYD_status HYDT_dmxu_epoll_finalize(void)
+{
+    HYDU_FUNC_ENTER();
+
+    if (epoll_fd >= 0)
+        close(epoll_fd);
+    epoll_fd = -1;
+
+    if (fd_cb)
+        HYDU_FREE(fd_cb);
+    fd_cb = NULL;
+    fd_cb_len = 0;
+
+    if (ready_fds)
+        HYDU_FREE(ready_fds);
+    ready_fds = NULL;
+    num_ready_fds = 0;
+    max_ready_fds = 0;
+
+    HYDU_FUNC_EXIT();
+    return HYD_SUCCESS;
+}
@@ -26,10 +26,24 @@ extern int HYDT_dmxu_got_sigttin;
 struct HYDT_dmxu_fns {
     HYD_status(*wait_for_event) (int wtime);
     HYD_status(*stdin_valid) (int *out);
+
+    /* Optional, for engines that keep their own registrations */
+    HYD_status(*register_fd) (struct HYDT_dmxu_callback * cb);
+    HYD_status(*deregister_fd) (int fd);
+    HYD_status(*finalize) (void);
 };
 
 HYD_status HYDT_dmxi_stdin_valid(int *out);
 
+#if defined HAVE_EPOLL
+HYD_status HYDT_dmxu_epoll_init(void);
+HYD_status HYDT_dmxu_epoll_wait_for_event(int wtime);
+HYD_status HYDT_dmxu_epoll_stdin_valid(int *out);
+HYD_status HYDT_dmxu_epoll_register_fd(struct HYDT_dmxu_callback *cb);
+HYD_status HYDT_dmxu_epoll_deregister_fd(int fd);
+HYD_status HYDT_dmxu_epoll_finalize(void);
+#endif /* HAVE_EPOLL */
+
 #if defined HAVE_POLL
 HYD_status HYDT_dmxu_poll_wait_for_event(int wtime);
 HYD_status HYDT_dmxu_poll_stdin_valid(int *out);
@@ -1181,6 +1181,36 @@ static HYD_status nameserver_fn(char *arg, char ***argv)
     goto fn_exit;
 }
 
+static void pmi_shm_help_fn(void)
+{
+    printf("\n");
+    printf("-enable-pmi-shm: Processes on the same node share the PMI KVS and barrier\n");
+    printf("                 through shared memory with their proxy\n");
+    printf("-disable-pmi-shm: Every PMI request goes through the proxy (default)\n\n");
+    printf("Notes:\n");
+    printf("  * Needs the processes to use the PMI-1 client of this runtime\n\n");
+}
+
+static HYD_status pmi_shm_fn(char *arg, char ***argv)
+{
+    HYD_status status = HYD_SUCCESS;
+
+    if (reading_config_file && HYD_server_info.user_global.pmi_shm != -1) {
+        /* global variable already set; ignore */
+        goto fn_exit;
+    }
+
+    status = HYDU_set_int(arg, &HYD_server_info.user_global.pmi_shm,
+                          !strcmp(arg, "enable-pmi-shm"));
+    HYDU_ERR_POP(status, "error setting pmi shm\n");
+
+  fn_exit:
+    return status;
+
+  fn_fail:
+    goto fn_exit;
+}
+
 static void auto_cleanup_help_fn(void)
 {
     printf("\n");
@@ -1331,6 +1361,10 @@ static HYD_status set_default_values(void)
     if (HYD_server_info.user_global.auto_cleanup == -1)
         HYD_server_info.user_global.auto_cleanup = 1;
 
+    if (HYD_server_info.user_global.pmi_shm == -1 &&
+        MPL_env2bool("HYDRA_PMI_SHM", &HYD_server_info.user_global.pmi_shm) == 0)
+        HYD_server_info.user_global.pmi_shm = 0;
+
     /* Make sure this is either a restart or there is an executable to
      * launch */
     if (HYD_uii_mpx_exec_list == NULL && HYD_server_info.user_global.ckpoint_prefix == NULL)
@@ -1615,6 +1649,8 @@ static struct HYD_arg_match_table match_table[] = {
     {"disable-auto-cleanup", auto_cleanup_fn, auto_cleanup_help_fn},
     {"dac", auto_cleanup_fn, auto_cleanup_help_fn},
     {"enable-auto-cleanup", auto_cleanup_fn, auto_cleanup_help_fn},
+    {"enable-pmi-shm", pmi_shm_fn, pmi_shm_help_fn},
+    {"disable-pmi-shm", pmi_shm_fn, pmi_shm_help_fn},
     {"disable-hostname-propagation", hostname_propagation_fn, hostname_propagation_help_fn},
     {"enable-hostname-propagation", hostname_propagation_fn, hostname_propagation_help_fn},
     {"order-nodes", order_nodes_fn, order_nodes_help_fn},
@@ -57,6 +57,15 @@
 #include "pmi.h"
 #include "simple_pmiutil.h"
 
+#if defined(HAVE_LINUX_FUTEX_H) && defined(HAVE_SYSCALL)
+#define USE_PMI_SHM
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "simple_pmi_shm.h"
+#endif
+
 /* 
    These are global variable used *ONLY* in this file, and are hence
    declared static.
@@ -88,6 +97,19 @@ static int PMI_debug_init = 0;    /* Set this to true to debug the init
 				     handshakes */
 static int PMI_spawned = 0;
 
+#ifdef USE_PMI_SHM
+/* Node-local segment of the proxy, if it gave us one */
+static struct PMI_shm_hdr *PMI_shm = NULL;
+static size_t PMI_shm_len = 0;
+
+static int PMII_shm_attach( void );
+static int PMII_shm_barrier( void );
+static int PMII_shm_put( const char kvsname[], const char key[],
+			 const char value[] );
+static int PMII_shm_get( const char kvsname[], const char key[],
+			 char value[], int length );
+#endif
+
 /* Function prototypes for internal routines */
 static int PMII_getmaxes( int *kvsname_max, int *keylen_max, int *vallen_max );
 static int PMII_Set_from_port( int, int );
@@ -246,6 +268,13 @@ int PMI_Init( int *spawned )
     if ( ! PMI_initialized )
 	PMI_initialized = NORMAL_INIT_WITH_PM;
 
+#ifdef USE_PMI_SHM
+    rc = PMII_shm_attach();
+    if (rc) {
+	return rc;
+    }
+#endif
+
     return( 0 );
 }
 
@@ -331,6 +360,10 @@ int PMI_Barrier( void )
     int err = PMI_SUCCESS;
 
     if ( PMI_initialized > SINGLETON_INIT_BUT_NO_PM) {
+#ifdef USE_PMI_SHM
+	if (PMI_shm)
+	    return PMII_shm_barrier();
+#endif
 	err = GetResponse( "cmd=barrier_in\n", "barrier_out", 0 );
     }
 
@@ -346,6 +379,12 @@ int PMI_Finalize( void )
 	err = GetResponse( "cmd=finalize\n", "finalize_ack", 0 );
 	shutdown( PMI_fd, SHUT_RDWR );
 	close( PMI_fd );
+#ifdef USE_PMI_SHM
+	if (PMI_shm) {
+	    munmap( PMI_shm, PMI_shm_len );
+	    PMI_shm = NULL;
+	}
+#endif
     }
 
     return err;
@@ -418,6 +457,11 @@ int PMI_KVS_Put( const char kvsname[], const char key[], const char value[] )
         strncpy(cached_singinit_val,value,PMI_vallen_max);
 	return 0;
     }
+
+#ifdef USE_PMI_SHM
+    if (PMI_shm && PMII_shm_put( kvsname, key, value ) == 0)
+	return 0;
+#endif
     
     rc = snprintf( buf, PMIU_MAXLINE, 
 			"cmd=put kvsname=%s key=%s value=%s\n",
@@ -448,6 +492,11 @@ int PMI_KVS_Get( const char kvsname[], const char key[], char value[],
        which MPICH2 uses PMI, this is where the test needs to be. */
     if (PMIi_InitIfSingleton() != 0) return -1;
 
+#ifdef USE_PMI_SHM
+    if (PMI_shm && PMII_shm_get( kvsname, key, value, length ) == 0)
+	return 0;
+#endif
+
     rc = snprintf( buf, PMIU_MAXLINE, "cmd=get kvsname=%s key=%s\n", 
 			kvsname, key );
     if (rc < 0) return PMI_FAIL;
@@ -468,6 +517,55 @@ int PMI_KVS_Get( const char kvsname[], const char key[], char value[],
     return err;
 }
 
+/* Index of the next pair for PMI_KVS_Iter_next() */
+static int PMI_iter_next_idx = 0;
+
+static int PMII_iter( const char kvsname[], int idx, char key[], int key_len,
+		      char val[], int val_len )
+{
+    char buf[PMIU_MAXLINE];
+    int err = PMI_SUCCESS;
+    int  rc;
+
+    if (PMIi_InitIfSingleton() != 0) return -1;
+
+    rc = snprintf( buf, PMIU_MAXLINE, "cmd=getbyidx kvsname=%s idx=%d\n",
+		   kvsname, idx );
+    if (rc < 0) return PMI_FAIL;
+
+    err = GetResponse( buf, "getbyidx_results", 0 );
+    if (err == PMI_SUCCESS) {
+	PMIU_getval( "rc", buf, PMIU_MAXLINE );
+	rc = atoi( buf );
+	if ( rc == 0 ) {
+	    PMIU_getval( "nextidx", buf, PMIU_MAXLINE );
+	    PMI_iter_next_idx = atoi( buf );
+	    PMIU_getval( "key", key, key_len );
+	    PMIU_getval( "val", val, val_len );
+	}
+	else {
+	    /* No more pairs */
+	    key[0] = '\0';
+	    val[0] = '\0';
+	}
+    }
+
+    return err;
+}
+
+int PMI_KVS_Iter_first( const char kvsname[], char key[], int key_len,
+			char val[], int val_len )
+{
+    return PMII_iter( kvsname, 0, key, key_len, val, val_len );
+}
+
+int PMI_KVS_Iter_next( const char kvsname[], char key[], int key_len,
+		       char val[], int val_len )
+{
+    return PMII_iter( kvsname, PMI_iter_next_idx, key, key_len, val,
+		      val_len );
+}
+
 /*************************** Name Publishing functions **********************/
 
 int PMI_Publish_name( const char service_name[], const char port[] )
@@ -753,6 +851,120 @@ int PMI_Spawn_multiple(int count,
 
 /***************** Internal routines not part of PMI interface ***************/
 
+#ifdef USE_PMI_SHM
+/* Map the node-local segment given by the proxy in PMI_SHM_FD */
+static int PMII_shm_attach( void )
+{
+    struct stat st;
+    char *p;
+    int fd;
+
+    p = getenv( "PMI_SHM_FD" );
+    if (!p)
+	return 0;
+
+    fd = atoi( p );
+    if (fstat( fd, &st ) < 0) {
+	PMIU_printf( 1, "Unable to stat PMI_SHM_FD %d\n", fd );
+	return PMI_FAIL;
+    }
+
+    PMI_shm = mmap( NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		    fd, 0 );
+    close( fd );
+    if (PMI_shm == MAP_FAILED) {
+	PMI_shm = NULL;
+	PMIU_printf( 1, "Unable to map PMI_SHM_FD %d\n", fd );
+	return PMI_FAIL;
+    }
+    PMI_shm_len = st.st_size;
+
+    return 0;
+}
+
+/* The last process of the node to arrive tells the proxy, and the
+   others sleep until it bumps the generation */
+static int PMII_shm_barrier( void )
+{
+    int gen = PMI_shm->barrier_gen;
+
+    if (__sync_add_and_fetch( &PMI_shm->barrier_count, 1 ) ==
+	PMI_shm->local_size) {
+	PMI_shm->barrier_count = 0;
+	if (PMIU_writeline( PMI_fd, "cmd=barrier_in shm=1\n" ) != 0)
+	    return PMI_FAIL;
+    }
+
+    while (PMI_shm->barrier_gen == gen)
+	syscall( SYS_futex, &PMI_shm->barrier_gen, FUTEX_WAIT, gen, NULL,
+		 NULL, 0 );
+
+    return PMI_SUCCESS;
+}
+
+/* Append to the put log; returns -1 if the pair has to go through
+   the proxy instead */
+static int PMII_shm_put( const char kvsname[], const char key[],
+			 const char value[] )
+{
+    struct PMI_shm_pair *pair;
+    int idx;
+
+    if (strcmp( kvsname, PMI_shm->kvsname ) ||
+	strlen( key ) >= PMI_SHM_KEYLEN || strlen( value ) >= PMI_SHM_VALLEN)
+	return -1;
+
+    idx = __sync_fetch_and_add( &PMI_shm->num_puts, 1 );
+    if (idx >= PMI_shm->max_puts)
+	return -1;
+
+    pair = &PMI_SHM_PUTS(PMI_shm)[idx];
+    strcpy( pair->key, key );
+    strcpy( pair->val, value );
+    __sync_synchronize();
+    pair->ready = 1;
+
+    return 0;
+}
+
+/* Look in the cache, then in the puts of the node since the last
+   barrier; returns -1 if the proxy has to be asked */
+static int PMII_shm_get( const char kvsname[], const char key[],
+			 char value[], int length )
+{
+    struct PMI_shm_pair *pair;
+    int mask, i, n;
+
+    if (strcmp( kvsname, PMI_shm->kvsname ))
+	return -1;
+
+    mask = PMI_shm->num_buckets - 1;
+    for (i = PMI_shm_hash( key ) & mask; ; i = (i + 1) & mask) {
+	pair = &PMI_SHM_BUCKETS(PMI_shm)[i];
+	if (!pair->ready)
+	    break;
+	if (!strcmp( pair->key, key ))
+	    goto found;
+    }
+
+    n = PMI_shm->num_puts;
+    if (n > PMI_shm->max_puts)
+	n = PMI_shm->max_puts;
+    for (i = 0; i < n; i++) {
+	pair = &PMI_SHM_PUTS(PMI_shm)[i];
+	if (pair->ready && !strcmp( pair->key, key ))
+	    goto found;
+    }
+
+    return -1;
+
+ found:
+    strncpy( value, pair->val, length );
+    value[length - 1] = '\0';
+    return 0;
+}
+#endif
+
 /* to get all maxes in one message */
 /* FIXME: This mixes init with get maxes */
 static int PMII_getmaxes( int *kvsname_max, int *keylen_max, int *vallen_max )
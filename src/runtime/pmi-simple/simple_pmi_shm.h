@@ -0,0 +1,63 @@
+/* -*- Mode: C; c-basic-offset:4 ; -*- */
+/*
+ *  (C) 2001 by Argonne National Laboratory.
+ *      See COPYRIGHT in top-level directory.
+ */
+
+/* Node-local PMI segment, shared by a Hydra proxy with the processes
+ * it launches when mpiexec is run with -enable-pmi-shm. The proxy
+ * passes it as PMI_SHM_FD.
+ *
+ * The processes append their puts to the put log and do the barrier
+ * with the barrier count and generation; the last process to arrive
+ * sends a single "barrier_in shm=1" to the proxy, which forwards the
+ * put log upstream in one go. When the barrier completes, the proxy fills the
+ * cache with the pairs put by the whole job since the last barrier,
+ * and bumps the generation, a futex word, to release the processes.
+ * Gets look in the cache and the put log before asking the proxy. */
+
+#ifndef SIMPLE_PMI_SHM_H_INCLUDED
+#define SIMPLE_PMI_SHM_H_INCLUDED
+
+#define PMI_SHM_KEYLEN 64
+#define PMI_SHM_VALLEN 1024
+#define PMI_SHM_NAMELEN 256
+
+struct PMI_shm_pair {
+    volatile int ready;
+    char key[PMI_SHM_KEYLEN];
+    char val[PMI_SHM_VALLEN];
+};
+
+struct PMI_shm_hdr {
+    char kvsname[PMI_SHM_NAMELEN];
+    int local_size;
+    int max_puts;
+    int num_buckets;            /* Power of two */
+
+    volatile int barrier_count;
+    volatile int barrier_gen;
+    volatile int num_puts;
+};
+
+/* The put log follows the header, then the buckets of the cache */
+#define PMI_SHM_PUTS(hdr) ((struct PMI_shm_pair *) ((hdr) + 1))
+#define PMI_SHM_BUCKETS(hdr) (PMI_SHM_PUTS(hdr) + (hdr)->max_puts)
+#define PMI_SHM_SIZE(max_puts, num_buckets)                             \
+    (sizeof(struct PMI_shm_hdr) +                                       \
+     ((max_puts) + (num_buckets)) * sizeof(struct PMI_shm_pair))
+
+/* FNV-1a; the cache is open addressed, with linear probing */
+static inline unsigned int PMI_shm_hash(const char *key)
+{
+    unsigned int h = 2166136261u;
+
+    while (*key) {
+        h ^= (unsigned char) *key++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+#endif /* SIMPLE_PMI_SHM_H_INCLUDED */
@@ -404,6 +404,68 @@ This function gets the value of the specified key in the keyval space.
 @*/
 int PMI_KVS_Get( const char kvsname[], const char key[], char value[], int length);
 
+/*@
+PMI_KVS_Iter_first - initialize the iterator and get the first value
+
+Input Parameters:
++ kvsname - keyval space name
+. key_len - length of key character array
+- val_len - length of val character array
+
+Output Parameters:
++ key - key
+- val - value
+
+Return values:
++ PMI_SUCCESS - keyval pair successfully retrieved from the keyval space
+. PMI_ERR_INVALID_KVS - invalid kvsname argument
+. PMI_ERR_INVALID_KEY - invalid key argument
+. PMI_ERR_INVALID_KEY_LENGTH - invalid key length argument
+. PMI_ERR_INVALID_VAL - invalid val argument
+. PMI_ERR_INVALID_VAL_LENGTH - invalid val length argument
+- PMI_FAIL - failed to initialize the iterator and get the first keyval pair
+
+Notes:
+This function initializes the iterator for the specified keyval space and
+retrieves the first key/val pair.  The pairs come in the order they were
+put.  The end of the keyval space is specified by returning an empty key
+string.  key and val must be at least as long as the values returned by
+PMI_KVS_Get_key_length_max() and PMI_KVS_Get_value_length_max().
+
+@*/
+int PMI_KVS_Iter_first(const char kvsname[], char key[], int key_len, char val[], int val_len);
+
+/*@
+PMI_KVS_Iter_next - get the next keyval pair
+
+Input Parameters:
++ kvsname - keyval space name
+. key_len - length of key character array
+- val_len - length of val character array
+
+Output Parameters:
++ key - key
+- val - value
+
+Return values:
++ PMI_SUCCESS - keyval pair successfully retrieved from the keyval space
+. PMI_ERR_INVALID_KVS - invalid kvsname argument
+. PMI_ERR_INVALID_KEY - invalid key argument
+. PMI_ERR_INVALID_KEY_LENGTH - invalid key length argument
+. PMI_ERR_INVALID_VAL - invalid val argument
+. PMI_ERR_INVALID_VAL_LENGTH - invalid val length argument
+- PMI_FAIL - failed to get the next keyval pair
+
+Notes:
+This function retrieves the next keyval pair from the specified keyval space.
+PMI_KVS_Iter_first() must have been previously called.  The end of the keyval
+space is specified by returning an empty key string.  The output parameters,
+key and val, must be at least as long as the values returned by
+PMI_KVS_Get_key_length_max() and PMI_KVS_Get_value_length_max().
+
+@*/
+int PMI_KVS_Iter_next(const char kvsname[], char key[], int key_len, char val[], int val_len);
+
 /* PMI Process Creation functions */
 
 /*S
@@ -0,0 +1,141 @@
+#include <portals4.h>
+#include <support.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "testing.h"
+
+/* Number of puts sent with each MD. Not a multiple of MERGE_MAX, so
+ * the last acks are only sent when the timer expires. */
+#define NUM_PUTS  30
+#define MERGE_MAX "8"
+
+int main(int   argc,
+         char *argv[])
+{
+    ptl_handle_ni_t ni_h;
+    ptl_pt_index_t  pt_index;
+    uint64_t        target[2 * NUM_PUTS];
+    uint64_t        source[NUM_PUTS];
+    ptl_me_t        me;
+    ptl_handle_me_t me_h;
+    ptl_md_t        md;
+    ptl_handle_md_t md_h;
+    ptl_md_t        bytes_md;
+    ptl_handle_md_t bytes_md_h;
+    ptl_ct_event_t  ctc;
+    ptl_process_t   peer;
+    int             rank, num_procs;
+    int             i;
+
+    /* Merge the CT acks. */
+    setenv("PTL_ACK_MERGE", "1", 1);
+    setenv("PTL_ACK_MERGE_MAX", MERGE_MAX, 1);
+
+    CHECK_RETURNVAL(PtlInit());
+
+    CHECK_RETURNVAL(libtest_init());
+
+    rank = libtest_get_rank();
+    num_procs = libtest_get_size();
+
+    /* Logical, so the peers on the node talk through shared memory. */
+    CHECK_RETURNVAL(PtlNIInit(PTL_IFACE_DEFAULT,
+                              PTL_NI_MATCHING | PTL_NI_LOGICAL, PTL_PID_ANY,
+                              NULL, NULL, &ni_h));
+
+    CHECK_RETURNVAL(PtlSetMap(ni_h, num_procs, libtest_get_mapping(ni_h)));
+
+    /* Each rank sends to the next one. */
+    peer.rank = (rank + 1) % num_procs;
+
+    CHECK_RETURNVAL(PtlPTAlloc(ni_h, 0, PTL_EQ_NONE, PTL_PT_ANY, &pt_index));
+    assert(pt_index == 0);
+
+    memset(target, 0, sizeof(target));
+    me.start = target;
+    me.length = sizeof(target);
+    me.uid = PTL_UID_ANY;
+    me.match_id.rank = PTL_RANK_ANY;
+    me.match_bits = 0;
+    me.ignore_bits = 0;
+    me.min_free = 0;
+    me.options = PTL_ME_OP_PUT | PTL_ME_EVENT_CT_COMM;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &me.ct_handle));
+    CHECK_RETURNVAL(PtlMEAppend(ni_h, pt_index, &me, PTL_PRIORITY_LIST, NULL,
+                                &me_h));
+
+    for (i = 0; i < NUM_PUTS; i++) {
+        source[i] = ((uint64_t)rank << 32) | i;
+    }
+
+    md.start = source;
+    md.length = sizeof(source);
+    md.options = PTL_MD_EVENT_CT_ACK;
+    md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &md, &md_h));
+
+    bytes_md = md;
+    bytes_md.options = PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_BYTES;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &bytes_md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &bytes_md, &bytes_md_h));
+
+    libtest_barrier();
+
+    /* Fill the first half of the target with the first MD, then the
+     * second half with the other one. */
+    for (i = 0; i < NUM_PUTS; i++) {
+        CHECK_RETURNVAL(PtlPut(md_h, i * sizeof(uint64_t), sizeof(uint64_t),
+                               PTL_CT_ACK_REQ, peer, pt_index, 0,
+                               i * sizeof(uint64_t), NULL, 0));
+    }
+
+    CHECK_RETURNVAL(PtlCTWait(md.ct_handle, NUM_PUTS, &ctc));
+    assert(ctc.success == NUM_PUTS && ctc.failure == 0);
+
+    for (i = 0; i < NUM_PUTS; i++) {
+        CHECK_RETURNVAL(PtlPut(bytes_md_h, i * sizeof(uint64_t),
+                               sizeof(uint64_t), PTL_CT_ACK_REQ, peer,
+                               pt_index, 0,
+                               (NUM_PUTS + i) * sizeof(uint64_t), NULL, 0));
+    }
+
+    CHECK_RETURNVAL(PtlCTWait(bytes_md.ct_handle,
+                              NUM_PUTS * sizeof(uint64_t), &ctc));
+    assert(ctc.success == NUM_PUTS * sizeof(uint64_t) && ctc.failure == 0);
+
+    CHECK_RETURNVAL(PtlCTWait(me.ct_handle, 2 * NUM_PUTS, &ctc));
+    assert(ctc.failure == 0);
+
+    /* The data came from the previous rank. */
+    rank = (rank + num_procs - 1) % num_procs;
+    for (i = 0; i < NUM_PUTS; i++) {
+        assert(target[i] == (((uint64_t)rank << 32) | i));
+        assert(target[NUM_PUTS + i] == (((uint64_t)rank << 32) | i));
+    }
+
+    /* No more acks are pending, so the MDs can be released. */
+    CHECK_RETURNVAL(PtlMDRelease(md_h));
+    CHECK_RETURNVAL(PtlMDRelease(bytes_md_h));
+
+    libtest_barrier();
+
+    /* cleanup */
+    CHECK_RETURNVAL(PtlCTFree(md.ct_handle));
+    CHECK_RETURNVAL(PtlCTFree(bytes_md.ct_handle));
+    CHECK_RETURNVAL(PtlMEUnlink(me_h));
+    CHECK_RETURNVAL(PtlCTFree(me.ct_handle));
+    CHECK_RETURNVAL(PtlPTFree(ni_h, pt_index));
+    CHECK_RETURNVAL(PtlNIFini(ni_h));
+    CHECK_RETURNVAL(libtest_fini());
+    PtlFini();
+
+    return 0;
+}
+
+/* vim:set expandtab: */
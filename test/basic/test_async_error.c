@@ -0,0 +1,153 @@
+#include <portals4.h>
+#include <support.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "testing.h"
+
+#define BUF_LEN 4096
+
+/*
+ * An operation with bad arguments either fails at once, or, when it
+ * was submitted without waiting for the PPE, fails on the event queue
+ * and the counter of its MD.
+ */
+static void check_failure(int ret, ptl_handle_eq_t eq_h, ptl_handle_ct_t ct_h,
+                          ptl_event_kind_t type, void *user_ptr,
+                          ptl_size_t *failures)
+{
+    ptl_event_t    ev;
+    ptl_ct_event_t ctc;
+
+    if (ret == PTL_ARG_INVALID) {
+        return;
+    }
+
+    assert(ret == PTL_OK);
+
+    CHECK_RETURNVAL(PtlEQWait(eq_h, &ev));
+    assert(ev.type == type);
+    assert(ev.ni_fail_type != PTL_NI_OK);
+    assert(ev.user_ptr == user_ptr);
+
+    /* PtlCTWait() returns on any failure, so poll for this one. */
+    (*failures)++;
+    do {
+        CHECK_RETURNVAL(PtlCTGet(ct_h, &ctc));
+    } while (ctc.failure < *failures);
+    assert(ctc.success == 0 && ctc.failure == *failures);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    ptl_handle_ni_t ni_h;
+    ptl_pt_index_t  pt_index;
+    unsigned char  *source, *target;
+    ptl_le_t        le;
+    ptl_handle_le_t le_h;
+    ptl_md_t        md;
+    ptl_handle_md_t md_h;
+    ptl_handle_eq_t eq_h;
+    ptl_event_t     ev;
+    ptl_ct_event_t  ctc;
+    ptl_process_t   self;
+    ptl_size_t      failures = 0;
+    int             ret, i;
+
+    CHECK_RETURNVAL(PtlInit());
+
+    CHECK_RETURNVAL(PtlNIInit(PTL_IFACE_DEFAULT,
+                              PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+                              PTL_PID_ANY, NULL, NULL, &ni_h));
+
+    CHECK_RETURNVAL(PtlGetPhysId(ni_h, &self));
+
+    CHECK_RETURNVAL(PtlPTAlloc(ni_h, 0, PTL_EQ_NONE, PTL_PT_ANY, &pt_index));
+
+    source = malloc(BUF_LEN);
+    target = calloc(1, BUF_LEN);
+    assert(source && target);
+
+    for (i = 0; i < BUF_LEN; i++) {
+        source[i] = (unsigned char)i;
+    }
+
+    le.start = target;
+    le.length = BUF_LEN;
+    le.uid = PTL_UID_ANY;
+    le.ct_handle = PTL_CT_NONE;
+    le.options = PTL_LE_OP_PUT | PTL_LE_OP_GET | PTL_LE_EVENT_LINK_DISABLE;
+    CHECK_RETURNVAL(PtlLEAppend(ni_h, pt_index, &le, PTL_PRIORITY_LIST, NULL,
+                                &le_h));
+
+    CHECK_RETURNVAL(PtlEQAlloc(ni_h, 16, &eq_h));
+
+    md.start = source;
+    md.length = BUF_LEN;
+    md.options = PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_REPLY;
+    md.eq_handle = eq_h;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &md, &md_h));
+
+    /* Past the end of the MD. */
+    ret = PtlPut(md_h, BUF_LEN - 10, 100, PTL_CT_ACK_REQ, self, pt_index,
+                 0, 0, (void *)1, 0);
+    check_failure(ret, eq_h, md.ct_handle, PTL_EVENT_SEND, (void *)1,
+                  &failures);
+
+    ret = PtlGet(md_h, BUF_LEN - 10, 100, self, pt_index, 0, 0, (void *)2);
+    check_failure(ret, eq_h, md.ct_handle, PTL_EVENT_REPLY, (void *)2,
+                  &failures);
+
+    /* No logical and on floats. */
+    ret = PtlAtomic(md_h, 0, sizeof(float), PTL_CT_ACK_REQ, self, pt_index,
+                    0, 0, (void *)3, 0, PTL_LAND, PTL_FLOAT);
+    check_failure(ret, eq_h, md.ct_handle, PTL_EVENT_SEND, (void *)3,
+                  &failures);
+
+    /* Bad arguments that never reach the PPE. */
+    ret = PtlPut(PTL_INVALID_HANDLE, 0, 1, PTL_CT_ACK_REQ, self, pt_index,
+                 0, 0, NULL, 0);
+    assert(ret == PTL_ARG_INVALID);
+
+    ret = PtlAtomic(md_h, 0, sizeof(int), PTL_CT_ACK_REQ, self, pt_index,
+                    0, 0, NULL, 0, PTL_OP_LAST, PTL_INT32_T);
+    assert(ret == PTL_ARG_INVALID);
+
+    /* A good put still goes through. */
+    CHECK_RETURNVAL(PtlPut(md_h, 0, BUF_LEN, PTL_CT_ACK_REQ, self, pt_index,
+                           0, 0, (void *)4, 0));
+
+    CHECK_RETURNVAL(PtlEQWait(eq_h, &ev));
+    assert(ev.type == PTL_EVENT_SEND);
+    assert(ev.ni_fail_type == PTL_NI_OK);
+    assert(ev.user_ptr == (void *)4);
+
+    do {
+        CHECK_RETURNVAL(PtlCTGet(md.ct_handle, &ctc));
+    } while (ctc.success == 0);
+    assert(ctc.success == 1 && ctc.failure == failures);
+
+    assert(memcmp(source, target, BUF_LEN) == 0);
+
+    /* cleanup */
+    CHECK_RETURNVAL(PtlMDRelease(md_h));
+    CHECK_RETURNVAL(PtlCTFree(md.ct_handle));
+    CHECK_RETURNVAL(PtlEQFree(eq_h));
+    CHECK_RETURNVAL(PtlLEUnlink(le_h));
+    CHECK_RETURNVAL(PtlPTFree(ni_h, pt_index));
+    CHECK_RETURNVAL(PtlNIFini(ni_h));
+    PtlFini();
+
+    free(source);
+    free(target);
+
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -0,0 +1,158 @@
+#include <portals4.h>
+#include <support.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "testing.h"
+
+/* Large enough to be split between the copy threads. */
+#define BUF_LEN (1024 * 1024 + 4096)
+
+struct op {
+    ptl_size_t md_offset;
+    ptl_size_t le_offset;
+    ptl_size_t length;
+};
+
+/* Aligned and not, short and long, with uneven tails. */
+static const struct op ops[] = {
+    { 0, 0, 1 },
+    { 3, 5, 100 },
+    { 64, 128, 4096 },
+    { 1, 33, 70001 },
+    { 17, 4000, 1024 * 1024 + 3 },
+};
+#define NUM_OPS (sizeof(ops) / sizeof(ops[0]))
+
+static unsigned char value(int rank, ptl_size_t i)
+{
+    return (unsigned char)(rank * 7 + i * 13 + i / 251);
+}
+
+/* Put each op to a peer and check it landed. */
+static void do_puts(ptl_handle_md_t md_h, ptl_handle_ct_t md_ct_h,
+                    ptl_handle_ct_t le_ct_h, unsigned char *target,
+                    ptl_process_t peer, int from, ptl_size_t *count)
+{
+    ptl_ct_event_t ctc;
+    ptl_size_t     i, j;
+
+    for (i = 0; i < NUM_OPS; i++) {
+        memset(target, 0, BUF_LEN);
+        libtest_barrier();
+
+        CHECK_RETURNVAL(PtlPut(md_h, ops[i].md_offset, ops[i].length,
+                               PTL_CT_ACK_REQ, peer, 0, 0, ops[i].le_offset,
+                               NULL, 0));
+
+        (*count)++;
+        CHECK_RETURNVAL(PtlCTWait(md_ct_h, *count, &ctc));
+        assert(ctc.failure == 0);
+        CHECK_RETURNVAL(PtlCTWait(le_ct_h, *count, &ctc));
+        assert(ctc.failure == 0);
+
+        /* The bytes around the put are untouched. */
+        for (j = 0; j < BUF_LEN; j++) {
+            if (j >= ops[i].le_offset &&
+                j < ops[i].le_offset + ops[i].length) {
+                assert(target[j] ==
+                       value(from, ops[i].md_offset + j - ops[i].le_offset));
+            } else {
+                assert(target[j] == 0);
+            }
+        }
+    }
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    ptl_handle_ni_t ni_h;
+    ptl_pt_index_t  pt_index;
+    unsigned char  *source, *target;
+    ptl_le_t        le;
+    ptl_handle_le_t le_h;
+    ptl_md_t        md;
+    ptl_handle_md_t md_h;
+    ptl_process_t   peer;
+    int             rank, num_procs, prev;
+    ptl_size_t      i, count;
+
+    /* Stream every copy, and split the large ones between threads. */
+    setenv("PTL_COPY_NT", "1", 1);
+    setenv("PTL_COPY_NT_SIZE", "1", 1);
+    setenv("PTL_COPY_THREADS", "2", 1);
+    setenv("PTL_COPY_MT_SIZE", "65536", 1);
+
+    CHECK_RETURNVAL(PtlInit());
+
+    CHECK_RETURNVAL(libtest_init());
+
+    rank = libtest_get_rank();
+    num_procs = libtest_get_size();
+    prev = (rank + num_procs - 1) % num_procs;
+
+    CHECK_RETURNVAL(PtlNIInit(PTL_IFACE_DEFAULT,
+                              PTL_NI_NO_MATCHING | PTL_NI_LOGICAL,
+                              PTL_PID_ANY, NULL, NULL, &ni_h));
+
+    CHECK_RETURNVAL(PtlSetMap(ni_h, num_procs, libtest_get_mapping(ni_h)));
+
+    CHECK_RETURNVAL(PtlPTAlloc(ni_h, 0, PTL_EQ_NONE, PTL_PT_ANY, &pt_index));
+    assert(pt_index == 0);
+
+    source = malloc(BUF_LEN);
+    target = calloc(1, BUF_LEN);
+    assert(source && target);
+
+    for (i = 0; i < BUF_LEN; i++) {
+        source[i] = value(rank, i);
+    }
+
+    le.start = target;
+    le.length = BUF_LEN;
+    le.uid = PTL_UID_ANY;
+    le.options = PTL_LE_OP_PUT | PTL_LE_EVENT_CT_COMM;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &le.ct_handle));
+    CHECK_RETURNVAL(PtlLEAppend(ni_h, pt_index, &le, PTL_PRIORITY_LIST, NULL,
+                                &le_h));
+
+    md.start = source;
+    md.length = BUF_LEN;
+    md.options = PTL_MD_EVENT_CT_ACK;
+    md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &md, &md_h));
+
+    count = 0;
+
+    /* To this rank, then from the previous one. */
+    peer.rank = rank;
+    do_puts(md_h, md.ct_handle, le.ct_handle, target, peer, rank, &count);
+
+    peer.rank = (rank + 1) % num_procs;
+    do_puts(md_h, md.ct_handle, le.ct_handle, target, peer, prev, &count);
+
+    libtest_barrier();
+
+    /* cleanup */
+    CHECK_RETURNVAL(PtlMDRelease(md_h));
+    CHECK_RETURNVAL(PtlCTFree(md.ct_handle));
+    CHECK_RETURNVAL(PtlLEUnlink(le_h));
+    CHECK_RETURNVAL(PtlCTFree(le.ct_handle));
+    CHECK_RETURNVAL(PtlPTFree(ni_h, pt_index));
+    CHECK_RETURNVAL(PtlNIFini(ni_h));
+    CHECK_RETURNVAL(libtest_fini());
+    PtlFini();
+
+    free(source);
+    free(target);
+
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -0,0 +1,211 @@
+#include <portals4.h>
+#include <support.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "testing.h"
+
+/* Many segments of different lengths, some empty, spread over their
+ * buffer so that a wrong segment can't land on the right bytes. */
+#define NUM_SEG    300
+#define SEG_STRIDE 512
+#define BUF_LEN    (NUM_SEG * SEG_STRIDE)
+
+struct op {
+    ptl_size_t md_offset;
+    ptl_size_t le_offset;
+    ptl_size_t length;
+};
+
+/* Inline, a few segments, and many segments. */
+static const struct op put_ops[] = {
+    { 0, 0, 100 },
+    { 5000, 1000, 3000 },
+    { 123, 8000, 30000 },
+};
+#define NUM_PUTS (sizeof(put_ops) / sizeof(put_ops[0]))
+
+/* 64 bit sums, which don't straddle segments. */
+static const struct op atomic_op = { 4096, 40000, 64 };
+
+/* Gets back what the first rank put in the next one. */
+static const struct op get_op = { 2000, 8000, 30000 };
+
+static unsigned char value(int rank, ptl_size_t i)
+{
+    return (unsigned char)(rank * 7 + i * 13 + i / 251);
+}
+
+static ptl_size_t make_iovec(ptl_iovec_t *iov, unsigned char *buf)
+{
+    ptl_size_t total = 0;
+    int i;
+
+    for (i = 0; i < NUM_SEG; i++) {
+        iov[i].iov_base = buf + i * SEG_STRIDE;
+        iov[i].iov_len = (i % 17 == 5) ? 0 : 8 * (1 + (i * 37) % 50);
+        total += iov[i].iov_len;
+    }
+
+    return total;
+}
+
+/* Address of the byte at an offset into an iovec. */
+static unsigned char *at(ptl_iovec_t *iov, ptl_size_t offset)
+{
+    while (offset >= iov->iov_len) {
+        offset -= iov->iov_len;
+        iov++;
+    }
+
+    return (unsigned char *)iov->iov_base + offset;
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    ptl_handle_ni_t ni_h;
+    ptl_pt_index_t  pt_index;
+    unsigned char  *source, *target, *reply;
+    ptl_iovec_t     source_iov[NUM_SEG];
+    ptl_iovec_t     target_iov[NUM_SEG];
+    ptl_iovec_t     reply_iov[NUM_SEG];
+    ptl_le_t        le;
+    ptl_handle_le_t le_h;
+    ptl_md_t        md, reply_md;
+    ptl_handle_md_t md_h, reply_md_h;
+    ptl_ct_event_t  ctc;
+    ptl_process_t   peer;
+    int             rank, num_procs, prev;
+    ptl_size_t      total, i;
+
+    CHECK_RETURNVAL(PtlInit());
+
+    CHECK_RETURNVAL(libtest_init());
+
+    rank = libtest_get_rank();
+    num_procs = libtest_get_size();
+    prev = (rank + num_procs - 1) % num_procs;
+
+    CHECK_RETURNVAL(PtlNIInit(PTL_IFACE_DEFAULT,
+                              PTL_NI_NO_MATCHING | PTL_NI_LOGICAL,
+                              PTL_PID_ANY, NULL, NULL, &ni_h));
+
+    CHECK_RETURNVAL(PtlSetMap(ni_h, num_procs, libtest_get_mapping(ni_h)));
+
+    /* Each rank sends to the next one. */
+    peer.rank = (rank + 1) % num_procs;
+
+    CHECK_RETURNVAL(PtlPTAlloc(ni_h, 0, PTL_EQ_NONE, PTL_PT_ANY, &pt_index));
+    assert(pt_index == 0);
+
+    source = malloc(BUF_LEN);
+    target = calloc(1, BUF_LEN);
+    reply = calloc(1, BUF_LEN);
+    assert(source && target && reply);
+
+    total = make_iovec(source_iov, source);
+    make_iovec(target_iov, target);
+    make_iovec(reply_iov, reply);
+    assert(total > atomic_op.le_offset + atomic_op.length);
+
+    for (i = 0; i < total; i++) {
+        *at(source_iov, i) = value(rank, i);
+    }
+
+    le.start = target_iov;
+    le.length = NUM_SEG;
+    le.uid = PTL_UID_ANY;
+    le.options = PTL_IOVEC | PTL_LE_OP_PUT | PTL_LE_OP_GET |
+        PTL_LE_EVENT_CT_COMM;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &le.ct_handle));
+    CHECK_RETURNVAL(PtlLEAppend(ni_h, pt_index, &le, PTL_PRIORITY_LIST, NULL,
+                                &le_h));
+
+    md.start = source_iov;
+    md.length = NUM_SEG;
+    md.options = PTL_IOVEC | PTL_MD_EVENT_CT_ACK;
+    md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &md, &md_h));
+
+    reply_md.start = reply_iov;
+    reply_md.length = NUM_SEG;
+    reply_md.options = PTL_IOVEC | PTL_MD_EVENT_CT_REPLY;
+    reply_md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &reply_md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &reply_md, &reply_md_h));
+
+    libtest_barrier();
+
+    for (i = 0; i < NUM_PUTS; i++) {
+        CHECK_RETURNVAL(PtlPut(md_h, put_ops[i].md_offset, put_ops[i].length,
+                               PTL_CT_ACK_REQ, peer, pt_index, 0,
+                               put_ops[i].le_offset, NULL, 0));
+    }
+
+    /* The target is zero, so the sum is the source. */
+    CHECK_RETURNVAL(PtlAtomic(md_h, atomic_op.md_offset, atomic_op.length,
+                              PTL_CT_ACK_REQ, peer, pt_index, 0,
+                              atomic_op.le_offset, NULL, 0, PTL_SUM,
+                              PTL_INT64_T));
+
+    CHECK_RETURNVAL(PtlCTWait(md.ct_handle, NUM_PUTS + 1, &ctc));
+    assert(ctc.failure == 0);
+
+    CHECK_RETURNVAL(PtlCTWait(le.ct_handle, NUM_PUTS + 1, &ctc));
+    assert(ctc.failure == 0);
+
+    /* The data came from the previous rank, at the right offsets. */
+    for (i = 0; i < NUM_PUTS; i++) {
+        ptl_size_t j;
+
+        for (j = 0; j < put_ops[i].length; j++) {
+            assert(*at(target_iov, put_ops[i].le_offset + j) ==
+                   value(prev, put_ops[i].md_offset + j));
+        }
+    }
+    for (i = 0; i < atomic_op.length; i++) {
+        assert(*at(target_iov, atomic_op.le_offset + i) ==
+               value(prev, atomic_op.md_offset + i));
+    }
+
+    libtest_barrier();
+
+    /* What this rank put in the next one comes back. */
+    CHECK_RETURNVAL(PtlGet(reply_md_h, get_op.md_offset, get_op.length, peer,
+                           pt_index, 0, get_op.le_offset, NULL));
+    CHECK_RETURNVAL(PtlCTWait(reply_md.ct_handle, 1, &ctc));
+    assert(ctc.failure == 0);
+
+    for (i = 0; i < get_op.length; i++) {
+        assert(*at(reply_iov, get_op.md_offset + i) ==
+               value(rank, put_ops[2].md_offset + i));
+    }
+
+    libtest_barrier();
+
+    /* cleanup */
+    CHECK_RETURNVAL(PtlMDRelease(reply_md_h));
+    CHECK_RETURNVAL(PtlCTFree(reply_md.ct_handle));
+    CHECK_RETURNVAL(PtlMDRelease(md_h));
+    CHECK_RETURNVAL(PtlCTFree(md.ct_handle));
+    CHECK_RETURNVAL(PtlLEUnlink(le_h));
+    CHECK_RETURNVAL(PtlCTFree(le.ct_handle));
+    CHECK_RETURNVAL(PtlPTFree(ni_h, pt_index));
+    CHECK_RETURNVAL(PtlNIFini(ni_h));
+    CHECK_RETURNVAL(libtest_fini());
+    PtlFini();
+
+    free(source);
+    free(target);
+    free(reply);
+
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -0,0 +1,107 @@
+#include <portals4.h>
+#include <support.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "testing.h"
+
+/* Enough MDs to grow the pool over many slabs. */
+#define NUM_MDS   1000
+#define NUM_ROUNDS 4
+#define LEN       64
+
+int main(int   argc,
+         char *argv[])
+{
+    ptl_handle_ni_t ni_h;
+    ptl_pt_index_t  pt_index;
+    ptl_handle_md_t *md_hs;
+    unsigned char   source[LEN];
+    unsigned char   target[LEN];
+    ptl_le_t        le;
+    ptl_handle_le_t le_h;
+    ptl_md_t        md;
+    ptl_ct_event_t  ctc;
+    ptl_process_t   myself;
+    int             round, i;
+
+    /* Pre-warm a few objects, and shrink the pools after 1ms. */
+    setenv("PTL_POOL_PREWARM", "16", 1);
+    setenv("PTL_POOL_IDLE_USEC", "1000", 1);
+
+    CHECK_RETURNVAL(PtlInit());
+
+    CHECK_RETURNVAL(libtest_init());
+
+    CHECK_RETURNVAL(PtlNIInit(PTL_IFACE_DEFAULT,
+                              PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+                              PTL_PID_ANY, NULL, NULL, &ni_h));
+
+    CHECK_RETURNVAL(PtlGetPhysId(ni_h, &myself));
+
+    CHECK_RETURNVAL(PtlPTAlloc(ni_h, 0, PTL_EQ_NONE, PTL_PT_ANY, &pt_index));
+
+    le.start = target;
+    le.length = LEN;
+    le.uid = PTL_UID_ANY;
+    le.options = PTL_LE_OP_PUT | PTL_LE_EVENT_CT_COMM;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &le.ct_handle));
+    CHECK_RETURNVAL(PtlLEAppend(ni_h, pt_index, &le, PTL_PRIORITY_LIST, NULL,
+                                &le_h));
+
+    md_hs = malloc(NUM_MDS * sizeof(*md_hs));
+    assert(md_hs);
+
+    md.start = source;
+    md.length = LEN;
+    md.options = PTL_MD_EVENT_CT_ACK;
+    md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &md.ct_handle));
+
+    /* Each round grows the MD pool, then leaves it idle long enough
+     * for it to shrink. The objects must still work afterwards. */
+    for (round = 0; round < NUM_ROUNDS; round++) {
+        for (i = 0; i < NUM_MDS; i++) {
+            CHECK_RETURNVAL(PtlMDBind(ni_h, &md, &md_hs[i]));
+        }
+
+        memset(source, round + 1, LEN);
+        memset(target, 0, LEN);
+        CHECK_RETURNVAL(PtlPut(md_hs[NUM_MDS - 1], 0, LEN, PTL_CT_ACK_REQ,
+                               myself, pt_index, 0, 0, NULL, 0));
+        CHECK_RETURNVAL(PtlCTWait(md.ct_handle, round + 1, &ctc));
+        assert(ctc.failure == 0);
+        CHECK_RETURNVAL(PtlCTWait(le.ct_handle, round + 1, &ctc));
+        assert(ctc.failure == 0);
+
+        for (i = 0; i < LEN; i++) {
+            assert(target[i] == round + 1);
+        }
+
+        for (i = 0; i < NUM_MDS; i++) {
+            CHECK_RETURNVAL(PtlMDRelease(md_hs[i]));
+        }
+
+        usleep(20000);
+    }
+
+    /* cleanup */
+    CHECK_RETURNVAL(PtlCTFree(md.ct_handle));
+    CHECK_RETURNVAL(PtlLEUnlink(le_h));
+    CHECK_RETURNVAL(PtlCTFree(le.ct_handle));
+    CHECK_RETURNVAL(PtlPTFree(ni_h, pt_index));
+    CHECK_RETURNVAL(PtlNIFini(ni_h));
+    CHECK_RETURNVAL(libtest_fini());
+    PtlFini();
+
+    free(md_hs);
+
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -0,0 +1,184 @@
+#include <portals4.h>
+#include <support.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "testing.h"
+
+#if INTERFACE == 1
+# define ENTRY_T  ptl_me_t
+# define HANDLE_T ptl_handle_me_t
+# define NI_TYPE  PTL_NI_MATCHING
+# define OPTIONS  (PTL_ME_OP_PUT | PTL_ME_EVENT_CT_COMM | PTL_ME_EVENT_LINK_DISABLE)
+# define APPEND   PtlMEAppend
+# define UNLINK   PtlMEUnlink
+#else
+# define ENTRY_T  ptl_le_t
+# define HANDLE_T ptl_handle_le_t
+# define NI_TYPE  PTL_NI_NO_MATCHING
+# define OPTIONS  (PTL_LE_OP_PUT | PTL_LE_EVENT_CT_COMM | PTL_LE_EVENT_LINK_DISABLE)
+# define APPEND   PtlLEAppend
+# define UNLINK   PtlLEUnlink
+#endif
+
+/* Number of times each prepared operation is issued. */
+#define NUM_ISSUES 16
+
+int main(int   argc,
+         char *argv[])
+{
+    ptl_handle_ni_t   ni_h;
+    ptl_pt_index_t    pt_index;
+    ptl_handle_eq_t   eq_h;
+    uint64_t          target[NUM_ISSUES + 1];
+    uint64_t          source[NUM_ISSUES];
+    uint64_t          one = 1;
+    ENTRY_T           value_e;
+    HANDLE_T          value_e_handle;
+    ptl_md_t          md;
+    ptl_handle_md_t   md_h;
+    ptl_md_t          one_md;
+    ptl_handle_md_t   one_md_h;
+    ptl_handle_prep_t put_prep;
+    ptl_handle_prep_t atomic_prep;
+    ptl_ct_event_t    ctc;
+    ptl_event_t       ev;
+    ptl_process_t     peer;
+    ptl_process_t    *procs;
+    int               rank, num_procs;
+    int               puts, atomics;
+    int               i;
+
+    CHECK_RETURNVAL(PtlInit());
+
+    CHECK_RETURNVAL(libtest_init());
+
+    rank = libtest_get_rank();
+    num_procs = libtest_get_size();
+
+    CHECK_RETURNVAL(PtlNIInit(PTL_IFACE_DEFAULT, NI_TYPE | PTL_NI_PHYSICAL,
+                              PTL_PID_ANY, NULL, NULL, &ni_h));
+
+    procs = libtest_get_mapping(ni_h);
+
+    /* Each rank sends to the next one. */
+    peer = procs[(rank + 1) % num_procs];
+
+    CHECK_RETURNVAL(PtlEQAlloc(ni_h, 2 * NUM_ISSUES, &eq_h));
+    CHECK_RETURNVAL(PtlPTAlloc(ni_h, 0, eq_h, PTL_PT_ANY, &pt_index));
+    assert(pt_index == 0);
+
+    memset(target, 0, sizeof(target));
+    value_e.start  = target;
+    value_e.length = sizeof(target);
+    value_e.uid    = PTL_UID_ANY;
+#if INTERFACE == 1
+    value_e.match_id.phys.nid = PTL_NID_ANY;
+    value_e.match_id.phys.pid = PTL_PID_ANY;
+    value_e.match_bits  = 7;
+    value_e.ignore_bits = 0;
+#endif
+    value_e.options = OPTIONS;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &value_e.ct_handle));
+    CHECK_RETURNVAL(APPEND(ni_h, pt_index, &value_e, PTL_PRIORITY_LIST, NULL,
+                           &value_e_handle));
+
+    for (i = 0; i < NUM_ISSUES; i++) {
+        source[i] = ((uint64_t)rank << 32) | i;
+    }
+
+    md.start     = source;
+    md.length    = sizeof(source);
+    md.options   = PTL_MD_EVENT_CT_ACK;
+    md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &md, &md_h));
+
+    one_md.start     = &one;
+    one_md.length    = sizeof(one);
+    one_md.options   = PTL_MD_EVENT_CT_ACK;
+    one_md.eq_handle = PTL_EQ_NONE;
+    one_md.ct_handle = md.ct_handle;
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &one_md, &one_md_h));
+
+    CHECK_RETURNVAL(PtlPutPrepare(md_h, PTL_CT_ACK_REQ, peer, pt_index, 7,
+                                  NULL, &put_prep));
+    CHECK_RETURNVAL(PtlAtomicPrepare(one_md_h, PTL_CT_ACK_REQ, peer, pt_index,
+                                     7, NULL, PTL_SUM, PTL_UINT64_T,
+                                     &atomic_prep));
+
+    /* The length is still checked against the md on every issue. */
+    assert(PtlPreparedIssue(put_prep, 0, sizeof(source) + 1, 0, 0) ==
+           PTL_ARG_INVALID);
+
+    libtest_barrier();
+
+    /* Write every element to its own slot, in reverse order, and
+     * bump the counter in the last slot as many times. Wait for the
+     * acknowledgments as we go, so the UDP transport is not flooded. */
+    for (i = 0; i < NUM_ISSUES; i++) {
+        ptl_size_t offset = (NUM_ISSUES - 1 - i) * sizeof(uint64_t);
+
+        CHECK_RETURNVAL(PtlPreparedIssue(put_prep, offset, sizeof(uint64_t),
+                                         offset, 1000 + i));
+        CHECK_RETURNVAL(PtlPreparedIssue(atomic_prep, 0, sizeof(uint64_t),
+                                         NUM_ISSUES * sizeof(uint64_t), 0));
+
+        CHECK_RETURNVAL(PtlCTWait(md.ct_handle, 2 * (i + 1), &ctc));
+        assert(ctc.failure == 0);
+    }
+
+    CHECK_RETURNVAL(PtlCTWait(value_e.ct_handle, 2 * NUM_ISSUES, &ctc));
+    assert(ctc.failure == 0);
+
+    /* Check the target side events. */
+    puts = atomics = 0;
+    for (i = 0; i < 2 * NUM_ISSUES; i++) {
+        CHECK_RETURNVAL(PtlEQWait(eq_h, &ev));
+        assert(ev.ni_fail_type == PTL_NI_OK);
+        assert(ev.mlength == sizeof(uint64_t));
+        if (ev.type == PTL_EVENT_PUT) {
+            assert(ev.hdr_data >= 1000 && ev.hdr_data < 1000 + NUM_ISSUES);
+            assert(ev.remote_offset ==
+                   (NUM_ISSUES - 1 - (ev.hdr_data - 1000)) * sizeof(uint64_t));
+            puts++;
+        } else {
+            assert(ev.type == PTL_EVENT_ATOMIC);
+            assert(ev.atomic_operation == PTL_SUM);
+            assert(ev.remote_offset == NUM_ISSUES * sizeof(uint64_t));
+            atomics++;
+        }
+    }
+    assert(puts == NUM_ISSUES && atomics == NUM_ISSUES);
+
+    /* The data came from the previous rank. */
+    rank = (rank + num_procs - 1) % num_procs;
+    for (i = 0; i < NUM_ISSUES; i++) {
+        assert(target[i] == (((uint64_t)rank << 32) | i));
+    }
+    assert(target[NUM_ISSUES] == NUM_ISSUES);
+
+    libtest_barrier();
+
+    /* cleanup */
+    CHECK_RETURNVAL(PtlPreparedRelease(put_prep));
+    CHECK_RETURNVAL(PtlPreparedRelease(atomic_prep));
+    CHECK_RETURNVAL(PtlMDRelease(md_h));
+    CHECK_RETURNVAL(PtlMDRelease(one_md_h));
+    CHECK_RETURNVAL(PtlCTFree(md.ct_handle));
+    CHECK_RETURNVAL(UNLINK(value_e_handle));
+    CHECK_RETURNVAL(PtlCTFree(value_e.ct_handle));
+    CHECK_RETURNVAL(PtlPTFree(ni_h, pt_index));
+    CHECK_RETURNVAL(PtlEQFree(eq_h));
+    CHECK_RETURNVAL(PtlNIFini(ni_h));
+    CHECK_RETURNVAL(libtest_fini());
+    PtlFini();
+
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -5,6 +5,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <sched.h>
 
 #include "testing.h"
@@ -14,6 +15,7 @@
 # define HANDLE_T ptl_handle_me_t
 # define NI_TYPE  PTL_NI_MATCHING
 # define OPTIONS  (PTL_ME_OP_PUT | PTL_ME_EVENT_CT_COMM)
+# define BIG_OPTIONS (PTL_ME_OP_PUT | PTL_ME_OP_GET | PTL_ME_EVENT_CT_COMM)
 # define APPEND   PtlMEAppend
 # define UNLINK   PtlMEUnlink
 #else
@@ -21,10 +23,14 @@
 # define HANDLE_T ptl_handle_le_t
 # define NI_TYPE  PTL_NI_NO_MATCHING
 # define OPTIONS  (PTL_LE_OP_PUT | PTL_LE_EVENT_CT_COMM)
+# define BIG_OPTIONS (PTL_LE_OP_PUT | PTL_LE_OP_GET | PTL_LE_EVENT_CT_COMM)
 # define APPEND   PtlLEAppend
 # define UNLINK   PtlLEUnlink
 #endif /* if INTERFACE == 1 */
 
+/* Larger than what is sent inline. */
+#define BIG_SIZE (64 * 1024)
+
 int main(int   argc,
          char *argv[])
 {
@@ -39,6 +45,12 @@ int main(int   argc,
     int             num_procs;
     ptl_ct_event_t ctc;
     ptl_process_t *procs;
+    unsigned char  *big_src, *big_dst, *big_back;
+    ENTRY_T         big_e;
+    HANDLE_T        big_e_handle;
+    ptl_md_t        big_md;
+    ptl_handle_md_t big_md_handle;
+    int             i;
 
     CHECK_RETURNVAL(PtlInit());
 
@@ -109,6 +121,63 @@ int main(int   argc,
     CHECK_RETURNVAL(UNLINK(value_e_handle));
     CHECK_RETURNVAL(PtlCTFree(value_e.ct_handle));
 
+    /* Same with a large message, there and back. */
+    big_src  = malloc(BIG_SIZE);
+    big_dst  = calloc(1, BIG_SIZE);
+    big_back = calloc(1, BIG_SIZE);
+    assert(big_src && big_dst && big_back);
+    for (i = 0; i < BIG_SIZE; i++) {
+        big_src[i] = i * 7;
+    }
+
+    big_e.start  = big_dst;
+    big_e.length = BIG_SIZE;
+    big_e.uid    = PTL_UID_ANY;
+#if MATCHING == 1
+    big_e.match_id    = myself;
+    big_e.match_bits  = 2;
+    big_e.ignore_bits = 0;
+#endif
+    big_e.options = BIG_OPTIONS;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &big_e.ct_handle));
+    CHECK_RETURNVAL(APPEND(ni_h, 0, &big_e, PTL_PRIORITY_LIST, NULL,
+                           &big_e_handle));
+
+    big_md.start     = big_src;
+    big_md.length    = BIG_SIZE;
+    big_md.options   = PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_REPLY;
+    big_md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &big_md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &big_md, &big_md_handle));
+
+    CHECK_RETURNVAL(PtlPut(big_md_handle, 0, BIG_SIZE, PTL_CT_ACK_REQ, myself,
+                           logical_pt_index, 2, 0, NULL, 0));
+    CHECK_RETURNVAL(PtlCTWait(big_md.ct_handle, 1, &ctc));
+    assert(ctc.failure == 0);
+    CHECK_RETURNVAL(PtlCTWait(big_e.ct_handle, 1, &ctc));
+    assert(ctc.failure == 0);
+    assert(memcmp(big_src, big_dst, BIG_SIZE) == 0);
+
+    CHECK_RETURNVAL(PtlMDRelease(big_md_handle));
+
+    /* Read it back into another buffer. */
+    big_md.start = big_back;
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &big_md, &big_md_handle));
+
+    CHECK_RETURNVAL(PtlGet(big_md_handle, 0, BIG_SIZE, myself,
+                           logical_pt_index, 2, 0, NULL));
+    CHECK_RETURNVAL(PtlCTWait(big_md.ct_handle, 2, &ctc));
+    assert(ctc.failure == 0);
+    assert(memcmp(big_src, big_back, BIG_SIZE) == 0);
+
+    CHECK_RETURNVAL(PtlMDRelease(big_md_handle));
+    CHECK_RETURNVAL(PtlCTFree(big_md.ct_handle));
+    CHECK_RETURNVAL(UNLINK(big_e_handle));
+    CHECK_RETURNVAL(PtlCTFree(big_e.ct_handle));
+    free(big_src);
+    free(big_dst);
+    free(big_back);
+
     /* cleanup */
     CHECK_RETURNVAL(PtlPTFree(ni_h, logical_pt_index));
     CHECK_RETURNVAL(PtlNIFini(ni_h));
@@ -0,0 +1,194 @@
+#include <portals4.h>
+#include <support.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "testing.h"
+
+/* Put lengths around the eager limit, which is set to EAGER_SIZE. */
+#define EAGER_SIZE  "16384"
+#define TOTAL_LEN   (100 + 2000 + 8192 + 16384 + 16385)
+#define UNEXP_LEN   8000
+#define UNEXP_DATA  99
+
+static const ptl_size_t lens[] = { 100, 2000, 8192, 16384, 16385 };
+#define NUM_LENS (sizeof(lens) / sizeof(lens[0]))
+
+static unsigned char value(int rank, ptl_size_t i)
+{
+    return (unsigned char)(rank * 7 + i * 13 + i / 251);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    ptl_handle_ni_t ni_h;
+    ptl_pt_index_t  pt_index;
+    ptl_handle_eq_t eq_h;
+    unsigned char  *target;
+    unsigned char  *overflow;
+    unsigned char  *unexp;
+    unsigned char  *source;
+    ptl_me_t        me;
+    ptl_handle_me_t me_h, ovf_h, unexp_h;
+    ptl_handle_ct_t me_ct_h;
+    ptl_md_t        md;
+    ptl_handle_md_t md_h;
+    ptl_ct_event_t  ctc;
+    ptl_event_t     ev;
+    ptl_process_t   peer;
+    int             rank, num_procs, prev;
+    ptl_size_t      i, offset;
+
+    /* Eager puts up to 16KiB. */
+    setenv("PTL_SHMEM_EAGER_SIZE", EAGER_SIZE, 1);
+
+    CHECK_RETURNVAL(PtlInit());
+
+    CHECK_RETURNVAL(libtest_init());
+
+    rank = libtest_get_rank();
+    num_procs = libtest_get_size();
+    prev = (rank + num_procs - 1) % num_procs;
+
+    /* Shared memory is only used between ranks. */
+    if (num_procs < 2) return 77;
+
+    /* Logical, so the peers on the node talk through shared memory. */
+    CHECK_RETURNVAL(PtlNIInit(PTL_IFACE_DEFAULT,
+                              PTL_NI_MATCHING | PTL_NI_LOGICAL, PTL_PID_ANY,
+                              NULL, NULL, &ni_h));
+
+    CHECK_RETURNVAL(PtlSetMap(ni_h, num_procs, libtest_get_mapping(ni_h)));
+
+    /* Each rank sends to the next one. */
+    peer.rank = (rank + 1) % num_procs;
+
+    CHECK_RETURNVAL(PtlEQAlloc(ni_h, 16, &eq_h));
+    CHECK_RETURNVAL(PtlPTAlloc(ni_h, 0, eq_h, PTL_PT_ANY, &pt_index));
+    assert(pt_index == 0);
+
+    target = calloc(1, TOTAL_LEN);
+    overflow = calloc(1, UNEXP_LEN);
+    unexp = calloc(1, UNEXP_LEN);
+    source = malloc(TOTAL_LEN);
+    assert(target && overflow && unexp && source);
+
+    /* Expected puts. */
+    me.start = target;
+    me.length = TOTAL_LEN;
+    me.uid = PTL_UID_ANY;
+    me.match_id.rank = PTL_RANK_ANY;
+    me.match_bits = 1;
+    me.ignore_bits = 0;
+    me.min_free = 0;
+    me.options = PTL_ME_OP_PUT | PTL_ME_EVENT_CT_COMM |
+        PTL_ME_EVENT_LINK_DISABLE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &me_ct_h));
+    me.ct_handle = me_ct_h;
+    CHECK_RETURNVAL(PtlMEAppend(ni_h, pt_index, &me, PTL_PRIORITY_LIST, NULL,
+                                &me_h));
+
+    /* Catches the unexpected put. */
+    me.start = overflow;
+    me.length = UNEXP_LEN;
+    me.match_bits = 2;
+    me.ct_handle = PTL_CT_NONE;
+    me.options = PTL_ME_OP_PUT | PTL_ME_USE_ONCE |
+        PTL_ME_EVENT_LINK_DISABLE | PTL_ME_EVENT_UNLINK_DISABLE;
+    CHECK_RETURNVAL(PtlMEAppend(ni_h, pt_index, &me, PTL_OVERFLOW_LIST, NULL,
+                                &ovf_h));
+
+    for (i = 0; i < TOTAL_LEN; i++) {
+        source[i] = value(rank, i);
+    }
+
+    md.start = source;
+    md.length = TOTAL_LEN;
+    md.options = PTL_MD_EVENT_CT_ACK;
+    md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &md, &md_h));
+
+    libtest_barrier();
+
+    /* Inline, eager, and past the eager limit. */
+    offset = 0;
+    for (i = 0; i < NUM_LENS; i++) {
+        CHECK_RETURNVAL(PtlPut(md_h, offset, lens[i], PTL_CT_ACK_REQ, peer,
+                               pt_index, 1, offset, NULL, lens[i]));
+        offset += lens[i];
+    }
+
+    /* An eager put landing in the overflow list. */
+    CHECK_RETURNVAL(PtlPut(md_h, 0, UNEXP_LEN, PTL_CT_ACK_REQ, peer,
+                           pt_index, 2, 0, NULL, UNEXP_DATA));
+
+    CHECK_RETURNVAL(PtlCTWait(md.ct_handle, NUM_LENS + 1, &ctc));
+    assert(ctc.success == NUM_LENS + 1 && ctc.failure == 0);
+
+    CHECK_RETURNVAL(PtlCTWait(me_ct_h, NUM_LENS, &ctc));
+    assert(ctc.failure == 0);
+
+    for (i = 0; i < NUM_LENS + 1; i++) {
+        CHECK_RETURNVAL(PtlEQWait(eq_h, &ev));
+        assert(ev.type == PTL_EVENT_PUT);
+        assert(ev.ni_fail_type == PTL_NI_OK);
+        if (ev.hdr_data == UNEXP_DATA) {
+            assert(ev.ptl_list == PTL_OVERFLOW_LIST);
+            assert(ev.mlength == UNEXP_LEN && ev.start == overflow);
+        } else {
+            assert(ev.ptl_list == PTL_PRIORITY_LIST);
+            assert(ev.mlength == ev.hdr_data && ev.rlength == ev.hdr_data);
+        }
+    }
+
+    /* The data came from the previous rank. */
+    for (i = 0; i < TOTAL_LEN; i++) {
+        assert(target[i] == value(prev, i));
+    }
+    for (i = 0; i < UNEXP_LEN; i++) {
+        assert(overflow[i] == value(prev, i));
+    }
+
+    /* The unexpected put is found again, with its header. */
+    me.start = unexp;
+    me.length = UNEXP_LEN;
+    me.match_bits = 2;
+    me.options = PTL_ME_OP_PUT | PTL_ME_EVENT_LINK_DISABLE;
+    CHECK_RETURNVAL(PtlMEAppend(ni_h, pt_index, &me, PTL_PRIORITY_LIST, NULL,
+                                &unexp_h));
+
+    CHECK_RETURNVAL(PtlEQWait(eq_h, &ev));
+    assert(ev.type == PTL_EVENT_PUT_OVERFLOW);
+    assert(ev.hdr_data == UNEXP_DATA && ev.match_bits == 2);
+    assert(ev.rlength == UNEXP_LEN && ev.mlength == UNEXP_LEN);
+    assert(ev.start == overflow);
+
+    libtest_barrier();
+
+    /* cleanup */
+    CHECK_RETURNVAL(PtlMDRelease(md_h));
+    CHECK_RETURNVAL(PtlCTFree(md.ct_handle));
+    CHECK_RETURNVAL(PtlMEUnlink(unexp_h));
+    CHECK_RETURNVAL(PtlMEUnlink(me_h));
+    CHECK_RETURNVAL(PtlCTFree(me_ct_h));
+    CHECK_RETURNVAL(PtlPTFree(ni_h, pt_index));
+    CHECK_RETURNVAL(PtlEQFree(eq_h));
+    CHECK_RETURNVAL(PtlNIFini(ni_h));
+    CHECK_RETURNVAL(libtest_fini());
+    PtlFini();
+
+    free(target);
+    free(overflow);
+    free(unexp);
+    free(source);
+
+    return 0;
+}
+
+/* vim:set expandtab: */
@@ -0,0 +1,154 @@
+#include <portals4.h>
+#include <support.h>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "testing.h"
+
+/* Larger than a datagram, so it takes several chunks. */
+#define LEN       200000
+#define ME_LEN    (LEN + LEN / 2)
+#define MD_OFFSET 1000
+
+static unsigned char value(int rank, ptl_size_t i)
+{
+    return (unsigned char)(rank * 7 + i * 13 + i / 251);
+}
+
+int main(int   argc,
+         char *argv[])
+{
+    ptl_handle_ni_t ni_h;
+    ptl_pt_index_t  pt_index;
+    ptl_handle_eq_t eq_h;
+    unsigned char  *target;
+    unsigned char  *source;
+    ptl_me_t        me;
+    ptl_handle_me_t me_h;
+    ptl_md_t        md;
+    ptl_handle_md_t md_h;
+    ptl_ct_event_t  ctc;
+    ptl_event_t     ev;
+    ptl_process_t   peer;
+    ptl_process_t  *procs;
+    int             rank, num_procs, prev;
+    ptl_size_t      i;
+
+    /* Small chunks, and ask again quickly, so duplicates are seen. */
+    setenv("PTL_UDP_RNDV", "1", 1);
+    setenv("PTL_UDP_RNDV_CHUNK", "8192", 1);
+    setenv("PTL_UDP_RNDV_USEC", "1000", 1);
+
+    CHECK_RETURNVAL(PtlInit());
+
+    CHECK_RETURNVAL(libtest_init());
+
+    rank = libtest_get_rank();
+    num_procs = libtest_get_size();
+    prev = (rank + num_procs - 1) % num_procs;
+
+    /* Physical, so the peers talk through UDP. */
+    CHECK_RETURNVAL(PtlNIInit(PTL_IFACE_DEFAULT,
+                              PTL_NI_MATCHING | PTL_NI_PHYSICAL, PTL_PID_ANY,
+                              NULL, NULL, &ni_h));
+
+    procs = libtest_get_mapping(ni_h);
+
+    /* Each rank sends to the next one. */
+    peer = procs[(rank + 1) % num_procs];
+
+    CHECK_RETURNVAL(PtlEQAlloc(ni_h, 8, &eq_h));
+    CHECK_RETURNVAL(PtlPTAlloc(ni_h, 0, eq_h, PTL_PT_ANY, &pt_index));
+    assert(pt_index == 0);
+
+    target = calloc(1, ME_LEN);
+    source = malloc(MD_OFFSET + LEN);
+    assert(target && source);
+
+    me.start = target;
+    me.length = ME_LEN;
+    me.uid = PTL_UID_ANY;
+    me.match_id.phys.nid = PTL_NID_ANY;
+    me.match_id.phys.pid = PTL_PID_ANY;
+    me.match_bits = 0;
+    me.ignore_bits = 0;
+    me.min_free = 0;
+    me.options = PTL_ME_OP_PUT | PTL_ME_EVENT_CT_COMM |
+        PTL_ME_EVENT_LINK_DISABLE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &me.ct_handle));
+    CHECK_RETURNVAL(PtlMEAppend(ni_h, pt_index, &me, PTL_PRIORITY_LIST, NULL,
+                                &me_h));
+
+    for (i = 0; i < MD_OFFSET + LEN; i++) {
+        source[i] = value(rank, i);
+    }
+
+    md.start = source;
+    md.length = MD_OFFSET + LEN;
+    md.options = PTL_MD_EVENT_CT_ACK;
+    md.eq_handle = PTL_EQ_NONE;
+    CHECK_RETURNVAL(PtlCTAlloc(ni_h, &md.ct_handle));
+    CHECK_RETURNVAL(PtlMDBind(ni_h, &md, &md_h));
+
+    libtest_barrier();
+
+    /* A whole put from an offset in the MD. */
+    CHECK_RETURNVAL(PtlPut(md_h, MD_OFFSET, LEN, PTL_CT_ACK_REQ, peer,
+                           pt_index, 0, 0, NULL, 1));
+    CHECK_RETURNVAL(PtlCTWait(md.ct_handle, 1, &ctc));
+    assert(ctc.failure == 0);
+
+    /* A put truncated by the end of the ME. Only what fits is
+     * pulled, at the right place. */
+    CHECK_RETURNVAL(PtlPut(md_h, 0, LEN, PTL_CT_ACK_REQ, peer, pt_index, 0,
+                           LEN, NULL, 2));
+    CHECK_RETURNVAL(PtlCTWait(md.ct_handle, 2, &ctc));
+    assert(ctc.failure == 0);
+
+    CHECK_RETURNVAL(PtlCTWait(me.ct_handle, 2, &ctc));
+    assert(ctc.failure == 0);
+
+    for (i = 0; i < 2; i++) {
+        CHECK_RETURNVAL(PtlEQWait(eq_h, &ev));
+        assert(ev.type == PTL_EVENT_PUT);
+        assert(ev.ni_fail_type == PTL_NI_OK);
+        if (ev.hdr_data == 1) {
+            assert(ev.mlength == LEN && ev.remote_offset == 0);
+        } else {
+            assert(ev.hdr_data == 2);
+            assert(ev.mlength == ME_LEN - LEN && ev.remote_offset == LEN);
+        }
+    }
+
+    /* The data came from the previous rank. */
+    for (i = 0; i < LEN; i++) {
+        assert(target[i] == value(prev, MD_OFFSET + i));
+    }
+    for (i = LEN; i < ME_LEN; i++) {
+        assert(target[i] == value(prev, i - LEN));
+    }
+
+    libtest_barrier();
+
+    /* cleanup */
+    CHECK_RETURNVAL(PtlMDRelease(md_h));
+    CHECK_RETURNVAL(PtlCTFree(md.ct_handle));
+    CHECK_RETURNVAL(PtlMEUnlink(me_h));
+    CHECK_RETURNVAL(PtlCTFree(me.ct_handle));
+    CHECK_RETURNVAL(PtlPTFree(ni_h, pt_index));
+    CHECK_RETURNVAL(PtlEQFree(eq_h));
+    CHECK_RETURNVAL(PtlNIFini(ni_h));
+    CHECK_RETURNVAL(libtest_fini());
+    PtlFini();
+
+    free(target);
+    free(source);
+
+    return 0;
+}
+
+/* vim:set expandtab: */
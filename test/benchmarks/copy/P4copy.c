@@ -0,0 +1,283 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Bandwidth of the library copy engine.
+**
+** A single process puts to itself, over a range of sizes, so that the
+** time is dominated by the copy of the data. The copy strategy is
+** chosen with -e before PtlInit. Run it once per strategy to see where
+** each one wins. With -r the data is also read back after each put,
+** as an application consuming it would, which is where streaming
+** stores lose for sizes that fit in the cache.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define BENCH_PT_INDEX	(7)
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+/*
+** Set the library parameters for a copy strategy.
+*/
+static int
+set_engine(const char *engine, const char *threads)
+{
+
+    if (strcmp(engine, "plain") == 0)   {
+        setenv("PTL_COPY_NT", "0", 1);
+        setenv("PTL_COPY_THREADS", "0", 1);
+    } else if (strcmp(engine, "nt") == 0)   {
+        setenv("PTL_COPY_NT", "1", 1);
+        setenv("PTL_COPY_NT_SIZE", "1", 1);
+        setenv("PTL_COPY_THREADS", "0", 1);
+    } else if (strcmp(engine, "mt") == 0)   {
+        setenv("PTL_COPY_NT", "1", 1);
+        setenv("PTL_COPY_NT_SIZE", "1", 1);
+        setenv("PTL_COPY_THREADS", threads, 1);
+        setenv("PTL_COPY_MT_SIZE", "0", 1);
+    } else if (strcmp(engine, "default") != 0)   {
+        return -1;
+    }
+
+    return 0;
+
+}  /* end of set_engine() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-e <engine>] [-t <threads>] [-l <bytes>] [-u <bytes>] [-i <iters>] [-r]\n", pname);
+    fprintf(stderr, "  -e <engine>   default, plain, nt or mt (default: default)\n");
+    fprintf(stderr, "                  default  the library settings\n");
+    fprintf(stderr, "                  plain    memcpy\n");
+    fprintf(stderr, "                  nt       streaming stores\n");
+    fprintf(stderr, "                  mt       streaming stores, split between threads\n");
+    fprintf(stderr, "  -t <threads>  Copy threads for mt (default 2)\n");
+    fprintf(stderr, "  -l <bytes>    Smallest put (default 4096)\n");
+    fprintf(stderr, "  -u <bytes>    Largest put (default 64MiB)\n");
+    fprintf(stderr, "  -i <iters>    Bytes copied per size, in multiples of the largest put (default 4)\n");
+    fprintf(stderr, "  -r            Read the data back after each put\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int readback= 0;
+long i;
+long niters;
+long multiple= 4;
+long lower= 4096;
+long upper= 64 * 1024 * 1024;
+long len;
+char *engine= "default";
+char *threads= "2";
+char *send_buf;
+volatile char *recv_buf;
+unsigned long sum;
+long j;
+double start;
+double elapsed;
+ptl_size_t count;
+ptl_process_t self;
+ptl_handle_ni_t ni;
+ptl_pt_index_t pt_index;
+ptl_md_t md;
+ptl_handle_md_t md_h;
+ptl_le_t le;
+ptl_handle_le_t le_h;
+ptl_handle_ct_t ct_h;
+ptl_ct_event_t ct;
+
+
+    while ((ch= getopt(argc, argv, "e:t:l:u:i:rh")) != -1)   {
+        switch (ch)   {
+            case 'e':
+                engine= optarg;
+                break;
+            case 't':
+                threads= optarg;
+                break;
+            case 'l':
+                lower= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'u':
+                upper= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'i':
+                multiple= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'r':
+                readback= 1;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (lower < 1 || upper < lower || multiple < 1 ||
+            set_engine(engine, threads) != 0)   {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    send_buf= malloc(upper);
+    recv_buf= malloc(upper);
+    if ((NULL == send_buf) || (NULL == recv_buf))   {
+        perror("malloc");
+        exit(1);
+    }
+    memset(send_buf, 1, upper);
+    memset((char *)recv_buf, 0, upper);
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    rc= PtlGetPhysId(ni, &self);
+    LIBTEST_CHECK(rc, "PtlGetPhysId");
+
+    rc= PtlPTAlloc(ni, 0, PTL_EQ_NONE, BENCH_PT_INDEX, &pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    le.start= (char *)recv_buf;
+    le.length= upper;
+    le.ct_handle= PTL_CT_NONE;
+    le.uid= PTL_UID_ANY;
+    le.options= PTL_LE_OP_PUT | PTL_LE_EVENT_LINK_DISABLE |
+        PTL_LE_EVENT_UNLINK_DISABLE | PTL_LE_EVENT_COMM_DISABLE;
+    rc= PtlLEAppend(ni, pt_index, &le, PTL_PRIORITY_LIST, NULL, &le_h);
+    LIBTEST_CHECK(rc, "PtlLEAppend");
+
+    rc= PtlCTAlloc(ni, &ct_h);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+
+    md.start= send_buf;
+    md.length= upper;
+    md.options= PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_SUCCESS_DISABLE;
+    md.eq_handle= PTL_EQ_NONE;
+    md.ct_handle= ct_h;
+    rc= PtlMDBind(ni, &md, &md_h);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    printf("# engine %s%s\n", engine, readback ? ", data read back" : "");
+    printf("# %-12s %14s %14s\n", "bytes", "MB/s", "latency (us)");
+
+    count= 0;
+    sum= 0;
+    for (len= lower; len <= upper; len*= 2)   {
+        niters= multiple * (upper / len);
+
+        start= timer();
+        for (i= 0; i < niters; i++)   {
+            rc= PtlPut(md_h, 0, len, PTL_CT_ACK_REQ, self, BENCH_PT_INDEX,
+                    0, 0, NULL, 0);
+            LIBTEST_CHECK(rc, "PtlPut");
+
+            count++;
+            rc= PtlCTWait(ct_h, count, &ct);
+            LIBTEST_CHECK(rc, "PtlCTWait");
+            if (ct.failure != 0)   {
+                fprintf(stderr, "put of %ld bytes failed\n", len);
+                exit(1);
+            }
+
+            if (readback)   {
+                for (j= 0; j < len; j+= 64)   {
+                    sum+= recv_buf[j];
+                }
+            }
+        }
+        elapsed= timer() - start;
+
+        printf("  %-12ld %14.2f %14.3f\n", len,
+            (double)len * niters / elapsed / 1000000.0,
+            elapsed * 1000000.0 / niters);
+    }
+
+    if (readback)   {
+        /* Also keeps the reads. */
+        printf("# read back %lu cache lines\n", sum);
+    }
+
+    rc= PtlMDRelease(md_h);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+    rc= PtlLEUnlink(le_h);
+    LIBTEST_CHECK(rc, "PtlLEUnlink");
+    rc= PtlCTFree(ct_h);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+    rc= PtlPTFree(ni, pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+
+    PtlNIFini(ni);
+    PtlFini();
+
+    free(send_buf);
+    free((char *)recv_buf);
+
+    return 0;
+
+}  /* end of main() */
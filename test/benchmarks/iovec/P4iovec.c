@@ -0,0 +1,277 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Bandwidth of puts and gets between an iovec MD and an iovec LE.
+**
+** A single process binds an MD and appends an LE, each made of many
+** small segments, and moves a fixed amount of data to and from
+** offsets spread over the whole iovec. This is what halo exchanges
+** do, and it shows the cost of finding the segment at an offset.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define BENCH_PT_INDEX	(7)
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+/*
+** Split a buffer in num_seg segments of seg_size bytes.
+*/
+static ptl_iovec_t *
+make_iovec(char *buf, int num_seg, ptl_size_t seg_size)
+{
+
+ptl_iovec_t *iov;
+int i;
+
+
+    iov= malloc(num_seg * sizeof(ptl_iovec_t));
+    if (NULL == iov)   {
+        perror("malloc");
+        exit(1);
+    }
+
+    for (i= 0; i < num_seg; i++)   {
+        iov[i].iov_base= buf + i * seg_size;
+        iov[i].iov_len= seg_size;
+    }
+
+    return iov;
+
+}  /* end of make_iovec() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-n <segments>] [-s <bytes>] [-m <bytes>] [-i <iters>]\n", pname);
+    fprintf(stderr, "  -n <segments> Segments in the MD and LE iovecs (default 4096)\n");
+    fprintf(stderr, "  -s <bytes>    Size of each segment (default 64)\n");
+    fprintf(stderr, "  -m <bytes>    Size of each put/get (default 1024)\n");
+    fprintf(stderr, "  -i <iters>    Operations timed (default 10000)\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int i;
+int op;
+int niters= 10000;
+int num_seg= 4096;
+long seg_size= 64;
+long len= 1024;
+ptl_size_t total;
+ptl_size_t offset;
+ptl_size_t count;
+char *send_buf;
+char *recv_buf;
+ptl_iovec_t *send_iov;
+ptl_iovec_t *recv_iov;
+double start;
+double elapsed;
+char limit[32];
+ptl_process_t self;
+ptl_handle_ni_t ni;
+ptl_pt_index_t pt_index;
+ptl_md_t md;
+ptl_handle_md_t md_h;
+ptl_le_t le;
+ptl_handle_le_t le_h;
+ptl_handle_ct_t ct_h;
+ptl_ct_event_t ct;
+
+
+    while ((ch= getopt(argc, argv, "n:s:m:i:h")) != -1)   {
+        switch (ch)   {
+            case 'n':
+                num_seg= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 's':
+                seg_size= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'm':
+                len= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'i':
+                niters= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    total= (ptl_size_t)num_seg * seg_size;
+    if (num_seg < 1 || seg_size < 1 || len < 1 || (ptl_size_t)len > total ||
+            niters < 1)   {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    send_buf= malloc(total);
+    recv_buf= malloc(total);
+    if ((NULL == send_buf) || (NULL == recv_buf))   {
+        perror("malloc");
+        exit(1);
+    }
+    memset(send_buf, 0, total);
+    memset(recv_buf, 0, total);
+
+    send_iov= make_iovec(send_buf, num_seg, seg_size);
+    recv_iov= make_iovec(recv_buf, num_seg, seg_size);
+
+    /* Allow iovecs of that many segments. */
+    snprintf(limit, sizeof(limit), "%d", num_seg);
+    setenv("PTL_LIM_MAX_IOVECS", limit, 0);
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    rc= PtlGetPhysId(ni, &self);
+    LIBTEST_CHECK(rc, "PtlGetPhysId");
+
+    rc= PtlPTAlloc(ni, 0, PTL_EQ_NONE, BENCH_PT_INDEX, &pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    le.start= recv_iov;
+    le.length= num_seg;
+    le.ct_handle= PTL_CT_NONE;
+    le.uid= PTL_UID_ANY;
+    le.options= PTL_IOVEC | PTL_LE_OP_PUT | PTL_LE_OP_GET |
+        PTL_LE_EVENT_LINK_DISABLE | PTL_LE_EVENT_UNLINK_DISABLE |
+        PTL_LE_EVENT_COMM_DISABLE;
+    rc= PtlLEAppend(ni, pt_index, &le, PTL_PRIORITY_LIST, NULL, &le_h);
+    LIBTEST_CHECK(rc, "PtlLEAppend");
+
+    rc= PtlCTAlloc(ni, &ct_h);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+
+    md.start= send_iov;
+    md.length= num_seg;
+    md.options= PTL_IOVEC | PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_REPLY |
+        PTL_MD_EVENT_SUCCESS_DISABLE;
+    md.eq_handle= PTL_EQ_NONE;
+    md.ct_handle= ct_h;
+    rc= PtlMDBind(ni, &md, &md_h);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    printf("# %d segments of %ld bytes, %ld bytes per operation\n", num_seg,
+        seg_size, len);
+    printf("# %-8s %14s %14s\n", "op", "MB/s", "latency (us)");
+
+    count= 0;
+    for (op= 0; op < 2; op++)   {
+        start= timer();
+        for (i= 0; i < niters; i++)   {
+            /* Spread the offsets over the whole iovec. */
+            offset= ((ptl_size_t)i * 7919 * seg_size) % (total - len + 1);
+
+            if (op == 0)   {
+                rc= PtlPut(md_h, offset, len, PTL_CT_ACK_REQ, self,
+                        BENCH_PT_INDEX, 0, offset, NULL, 0);
+                LIBTEST_CHECK(rc, "PtlPut");
+            } else   {
+                rc= PtlGet(md_h, offset, len, self, BENCH_PT_INDEX, 0,
+                        offset, NULL);
+                LIBTEST_CHECK(rc, "PtlGet");
+            }
+
+            count++;
+            rc= PtlCTWait(ct_h, count, &ct);
+            LIBTEST_CHECK(rc, "PtlCTWait");
+            if (ct.failure != 0)   {
+                fprintf(stderr, "%s at offset %ld failed\n",
+                    op ? "get" : "put", (long)offset);
+                exit(1);
+            }
+        }
+        elapsed= timer() - start;
+
+        printf("  %-8s %14.2f %14.3f\n", op ? "get" : "put",
+            (double)len * niters / elapsed / 1000000.0,
+            elapsed * 1000000.0 / niters);
+    }
+
+    rc= PtlMDRelease(md_h);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+    rc= PtlLEUnlink(le_h);
+    LIBTEST_CHECK(rc, "PtlLEUnlink");
+    rc= PtlCTFree(ct_h);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+    rc= PtlPTFree(ni, pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+
+    PtlNIFini(ni);
+    PtlFini();
+
+    free(send_iov);
+    free(recv_iov);
+    free(send_buf);
+    free(recv_buf);
+
+    return 0;
+
+}  /* end of main() */
@@ -0,0 +1,271 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Injection rate of small puts.
+**
+** Each process issues windows of small puts to itself and then
+** waits for their acks. The time spent in the PtlPut calls is
+** reported apart from the time to complete the window: it is what
+** the application can't overlap with its own work. With a PPE, -s
+** makes every put wait for the PPE, as the library did before
+** operations were submitted asynchronously.
+**
+** Run it with more processes to load the PPE with as many clients.
+** The rates printed are the sums over all the processes. With -u only
+** the even ranks put: with two PPE progress threads, which get the
+** clients in turn, all the load is on the first one.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define BENCH_PT_INDEX	(7)
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-w <window>] [-i <iters>] [-m <bytes>] [-s] [-u]\n", pname);
+    fprintf(stderr, "  -w <window>   Puts issued before waiting (default 64)\n");
+    fprintf(stderr, "  -i <iters>    Windows timed (default 10000)\n");
+    fprintf(stderr, "  -m <bytes>    Size of each put (default 8)\n");
+    fprintf(stderr, "  -s            Wait for the PPE in every put\n");
+    fprintf(stderr, "  -u            Only the even ranks put\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int i;
+int j;
+int rank;
+int world_size;
+int window= 64;
+int unbalanced= 0;
+int niters= 10000;
+long len= 8;
+double start;
+double issue;
+double elapsed;
+double issue_rate;
+double rate;
+char *send_buf;
+char *recv_buf;
+ptl_size_t count;
+ptl_process_t self;
+ptl_handle_ni_t ni;
+ptl_handle_ni_t ni_collectives;
+ptl_pt_index_t pt_index;
+ptl_md_t md;
+ptl_handle_md_t md_h;
+ptl_le_t le;
+ptl_handle_le_t le_h;
+ptl_handle_ct_t ct_h;
+ptl_ct_event_t ct;
+
+
+    while ((ch= getopt(argc, argv, "w:i:m:suh")) != -1)   {
+        switch (ch)   {
+            case 'w':
+                window= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'i':
+                niters= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'm':
+                len= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 's':
+                setenv("PTL_PPE_ASYNC", "0", 1);
+                break;
+            case 'u':
+                unbalanced= 1;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (window < 1 || niters < 1 || len < 0)   {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    send_buf= calloc(1, len + 1);
+    recv_buf= calloc(1, len + 1);
+    if ((NULL == send_buf) || (NULL == recv_buf))   {
+        perror("calloc");
+        exit(1);
+    }
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= libtest_init();
+    LIBTEST_CHECK(rc, "libtest_init");
+    rank= libtest_get_rank();
+    world_size= libtest_get_size();
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_LOGICAL,
+            PTL_PID_ANY, NULL, NULL, &ni_collectives);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    rc= PtlSetMap(ni_collectives, world_size,
+            libtest_get_mapping(ni_collectives));
+    LIBTEST_CHECK(rc, "PtlSetMap");
+
+    rc= PtlGetPhysId(ni, &self);
+    LIBTEST_CHECK(rc, "PtlGetPhysId");
+
+    rc= PtlPTAlloc(ni, 0, PTL_EQ_NONE, BENCH_PT_INDEX, &pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    le.start= recv_buf;
+    le.length= len;
+    le.ct_handle= PTL_CT_NONE;
+    le.uid= PTL_UID_ANY;
+    le.options= PTL_LE_OP_PUT | PTL_LE_EVENT_LINK_DISABLE |
+        PTL_LE_EVENT_UNLINK_DISABLE | PTL_LE_EVENT_COMM_DISABLE;
+    rc= PtlLEAppend(ni, pt_index, &le, PTL_PRIORITY_LIST, NULL, &le_h);
+    LIBTEST_CHECK(rc, "PtlLEAppend");
+
+    rc= PtlCTAlloc(ni, &ct_h);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+
+    md.start= send_buf;
+    md.length= len;
+    md.options= PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_SUCCESS_DISABLE;
+    md.eq_handle= PTL_EQ_NONE;
+    md.ct_handle= ct_h;
+    rc= PtlMDBind(ni, &md, &md_h);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    libtest_BarrierInit(ni_collectives, rank, world_size);
+    libtest_AllreduceDouble_init(ni_collectives);
+    libtest_barrier();
+
+    if (unbalanced && (rank % 2))   {
+        niters= 0;
+    }
+
+    count= 0;
+    issue= 0;
+    libtest_Barrier();
+    start= timer();
+    for (i= 0; i < niters; i++)   {
+        double t= timer();
+
+        for (j= 0; j < window; j++)   {
+            rc= PtlPut(md_h, 0, len, PTL_CT_ACK_REQ, self, BENCH_PT_INDEX,
+                    0, 0, NULL, 0);
+            LIBTEST_CHECK(rc, "PtlPut");
+        }
+        issue+= timer() - t;
+
+        count+= window;
+        rc= PtlCTWait(ct_h, count, &ct);
+        LIBTEST_CHECK(rc, "PtlCTWait");
+        if (ct.failure != 0)   {
+            fprintf(stderr, "%ld puts failed\n", (long)ct.failure);
+            exit(1);
+        }
+    }
+    elapsed= timer() - start;
+
+    issue_rate= libtest_AllreduceDouble(count ? count / issue : 0, PTL_SUM);
+    rate= libtest_AllreduceDouble(count ? count / elapsed : 0, PTL_SUM);
+
+    if (0 == rank)   {
+        printf("# %d clients%s, %d windows of %d puts of %ld bytes\n",
+            world_size, unbalanced ? " (odd ranks idle)" : "", niters,
+            window, len);
+        printf("# %-14s %14s\n", "", "Mputs/s");
+        printf("  %-14s %14.3f\n", "issue", issue_rate / 1000000.0);
+        printf("  %-14s %14.3f\n", "completion", rate / 1000000.0);
+    }
+
+    rc= PtlMDRelease(md_h);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+    rc= PtlLEUnlink(le_h);
+    LIBTEST_CHECK(rc, "PtlLEUnlink");
+    rc= PtlCTFree(ct_h);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+    rc= PtlPTFree(ni, pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+
+    libtest_barrier();
+
+    PtlNIFini(ni);
+    PtlNIFini(ni_collectives);
+    libtest_fini();
+    PtlFini();
+
+    free(send_buf);
+    free(recv_buf);
+
+    return 0;
+
+}  /* end of main() */
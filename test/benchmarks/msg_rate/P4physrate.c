@@ -0,0 +1,299 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Many-peer message rate on a physically addressed NI.
+**
+** Every rank sends small puts to every other rank in round-robin
+** order, so each initiator operation looks up a different peer in
+** the NI's connection table. The aggregate message rate of the job
+** is reported by rank 0. Run it with as many ranks as possible to
+** grow the number of peers per NI.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define BENCH_PT_INDEX	(7)
+
+
+/*
+** globals
+*/
+int rank;
+int world_size;
+
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-n <msgs>] [-s <bytes>] [-i <iters>] [-W <window>] [-m]\n", pname);
+    fprintf(stderr, "  -n <msgs>    Messages sent to each peer per iteration (default 100)\n");
+    fprintf(stderr, "  -s <bytes>   Message size (default 8)\n");
+    fprintf(stderr, "  -i <iters>   Number of iterations (default 10)\n");
+    fprintf(stderr, "  -W <window>  Maximum number of outstanding sends (default 256)\n");
+    fprintf(stderr, "  -m           Machine readable output\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int i, j, p;
+int nmsgs= 100;
+int nbytes= 8;
+int niters= 10;
+int window= 256;
+int machine_output= 0;
+int error= 0;
+int peer;
+char *send_buf;
+char *recv_buf;
+double start, total;
+ptl_size_t sent;
+ptl_size_t expected;
+ptl_process_t *mapping;
+ptl_handle_ni_t ni;
+ptl_pt_index_t pt_index;
+ptl_md_t md;
+ptl_handle_md_t md_h;
+ptl_le_t le;
+ptl_handle_le_t le_h;
+ptl_handle_ct_t send_ct;
+ptl_handle_ct_t recv_ct;
+ptl_ct_event_t ct;
+
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= libtest_init();
+    if (rc != 0)   {
+        fprintf(stderr, "libtest_init failed\n");
+        exit(1);
+    }
+
+    rank= libtest_get_rank();
+    world_size= libtest_get_size();
+
+    while ((ch= getopt(argc, argv, "n:s:i:W:mh")) != -1)   {
+        switch (ch)   {
+            case 'n':
+                nmsgs= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 's':
+                nbytes= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'i':
+                niters= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'W':
+                window= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'm':
+                machine_output= 1;
+                break;
+            case 'h':
+            default:
+                error= 1;
+                break;
+        }
+    }
+
+    if (world_size < 2)   {
+        if (rank == 0)   {
+            fprintf(stderr, "This benchmark needs at least 2 ranks\n");
+        }
+        error= 1;
+    }
+
+    if (nmsgs < 1 || nbytes < 0 || niters < 1 || window < 1)   {
+        error= 1;
+    }
+
+    if (error)   {
+        if (rank == 0)   {
+            usage(argv[0]);
+        }
+        libtest_fini();
+        PtlFini();
+        exit(1);
+    }
+
+    send_buf= malloc(nbytes ? nbytes : 1);
+    recv_buf= malloc(nbytes ? nbytes : 1);
+    if ((NULL == send_buf) || (NULL == recv_buf))   {
+        perror("malloc");
+        exit(1);
+    }
+    memset(send_buf, 0x5a, nbytes);
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    mapping= libtest_get_mapping(ni);
+    if (NULL == mapping)   {
+        fprintf(stderr, "libtest_get_mapping failed\n");
+        exit(1);
+    }
+
+    rc= PtlCTAlloc(ni, &send_ct);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+    rc= PtlCTAlloc(ni, &recv_ct);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+
+    rc= PtlPTAlloc(ni, 0, PTL_EQ_NONE, BENCH_PT_INDEX, &pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    /* All messages land on the same buffer; only the count matters. */
+    le.start= recv_buf;
+    le.length= nbytes;
+    le.ct_handle= recv_ct;
+    le.uid= PTL_UID_ANY;
+    le.options= PTL_LE_OP_PUT | PTL_LE_EVENT_LINK_DISABLE |
+        PTL_LE_EVENT_UNLINK_DISABLE | PTL_LE_EVENT_COMM_DISABLE |
+        PTL_LE_EVENT_CT_COMM;
+    rc= PtlLEAppend(ni, pt_index, &le, PTL_PRIORITY_LIST, NULL, &le_h);
+    LIBTEST_CHECK(rc, "PtlLEAppend");
+
+    md.start= send_buf;
+    md.length= nbytes;
+    md.options= PTL_MD_EVENT_CT_SEND;
+    md.eq_handle= PTL_EQ_NONE;
+    md.ct_handle= send_ct;
+    rc= PtlMDBind(ni, &md, &md_h);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    libtest_barrier();
+
+    if (rank == 0 && !machine_output)   {
+        printf("# %d ranks, %d peers per rank, %d msgs of %d bytes per peer, %d iterations\n",
+            world_size, world_size - 1, nmsgs, nbytes, niters);
+    }
+
+    total= 0.0;
+    sent= 0;
+    expected= 0;
+    for (i= 0; i < niters; i++)   {
+        libtest_barrier();
+        start= timer();
+
+        /* Walk the peers round-robin, starting after ourselves. */
+        for (j= 0; j < nmsgs; j++)   {
+            for (p= 1; p < world_size; p++)   {
+                peer= (rank + p) % world_size;
+
+                if (sent >= (ptl_size_t)window)   {
+                    rc= PtlCTWait(send_ct, sent - window + 1, &ct);
+                    LIBTEST_CHECK(rc, "PtlCTWait");
+                }
+
+                rc= PtlPut(md_h, 0, nbytes, PTL_NO_ACK_REQ, mapping[peer],
+                        pt_index, 0, 0, NULL, 0);
+                LIBTEST_CHECK(rc, "PtlPut");
+                sent++;
+            }
+        }
+
+        rc= PtlCTWait(send_ct, sent, &ct);
+        LIBTEST_CHECK(rc, "PtlCTWait");
+
+        expected += (ptl_size_t)nmsgs * (world_size - 1);
+        rc= PtlCTWait(recv_ct, expected, &ct);
+        LIBTEST_CHECK(rc, "PtlCTWait");
+
+        libtest_barrier();
+        total += timer() - start;
+    }
+
+    if (rank == 0)   {
+        double msgs= (double)niters * nmsgs * world_size * (world_size - 1);
+
+        if (machine_output)   {
+            printf("%.2f\n", msgs / total);
+        } else   {
+            printf("%20s: %.2f msgs/s\n", "aggregate rate", msgs / total);
+            printf("%20s: %.2f msgs/s\n", "per-rank rate", msgs / total / world_size);
+        }
+    }
+
+    rc= PtlMDRelease(md_h);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+    rc= PtlLEUnlink(le_h);
+    LIBTEST_CHECK(rc, "PtlLEUnlink");
+    rc= PtlPTFree(ni, pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+    rc= PtlCTFree(send_ct);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+    rc= PtlCTFree(recv_ct);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+
+    libtest_barrier();
+
+    PtlNIFini(ni);
+    libtest_fini();
+    PtlFini();
+
+    free(send_buf);
+    free(recv_buf);
+
+    return 0;
+
+}  /* end of main() */
@@ -0,0 +1,261 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Injection rate of prepared puts.
+**
+** A single process sends small puts to itself in windows, waiting for
+** the acknowledgments of a window before starting the next one. The
+** rate of PtlPut is compared with the rate of PtlPreparedIssue on a
+** template built once with PtlPutPrepare.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define BENCH_PT_INDEX	(7)
+
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+/*
+** Send one window of puts, the regular way or through the prepared
+** template, and wait for their acknowledgments. Returns the completion
+** count expected next.
+*/
+static ptl_size_t
+do_window(int prepared, ptl_handle_md_t md_h, ptl_handle_prep_t prep_h,
+    ptl_handle_ct_t ct_h, ptl_size_t len, int window, ptl_process_t self,
+    ptl_size_t count)
+{
+
+int rc;
+int i;
+ptl_ct_event_t ct;
+
+
+    for (i= 0; i < window; i++)   {
+        if (prepared)   {
+            rc= PtlPreparedIssue(prep_h, 0, len, 0, 0);
+            LIBTEST_CHECK(rc, "PtlPreparedIssue");
+        } else   {
+            rc= PtlPut(md_h, 0, len, PTL_CT_ACK_REQ, self, BENCH_PT_INDEX, 0,
+                    0, NULL, 0);
+            LIBTEST_CHECK(rc, "PtlPut");
+        }
+    }
+
+    count += window;
+    rc= PtlCTWait(ct_h, count, &ct);
+    LIBTEST_CHECK(rc, "PtlCTWait");
+    if (ct.failure != 0)   {
+        fprintf(stderr, "put of %ld bytes failed\n", (long)len);
+        exit(1);
+    }
+
+    return count;
+
+}  /* end of do_window() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-m <bytes>] [-i <iters>] [-w <window>]\n",
+        pname);
+    fprintf(stderr, "  -m <bytes>   Largest put size (default 256)\n");
+    fprintf(stderr, "  -i <iters>   Windows timed per size (default 1000)\n");
+    fprintf(stderr, "  -w <window>  Puts per window (default 16)\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int i;
+int prepared;
+int niters= 1000;
+int window= 16;
+long max_size= 256;
+ptl_size_t len;
+ptl_size_t count;
+char *send_buf;
+char *recv_buf;
+double start;
+double rate[2];
+ptl_process_t self;
+ptl_handle_ni_t ni;
+ptl_pt_index_t pt_index;
+ptl_md_t md;
+ptl_handle_md_t md_h;
+ptl_le_t le;
+ptl_handle_le_t le_h;
+ptl_handle_ct_t ct_h;
+ptl_handle_prep_t prep_h;
+
+
+    while ((ch= getopt(argc, argv, "m:i:w:h")) != -1)   {
+        switch (ch)   {
+            case 'm':
+                max_size= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'i':
+                niters= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'w':
+                window= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (max_size < 1 || niters < 1 || window < 1)   {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    send_buf= malloc(max_size);
+    recv_buf= malloc(max_size);
+    if ((NULL == send_buf) || (NULL == recv_buf))   {
+        perror("malloc");
+        exit(1);
+    }
+    memset(send_buf, 0, max_size);
+    memset(recv_buf, 0, max_size);
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    rc= PtlGetPhysId(ni, &self);
+    LIBTEST_CHECK(rc, "PtlGetPhysId");
+
+    rc= PtlPTAlloc(ni, 0, PTL_EQ_NONE, BENCH_PT_INDEX, &pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    le.start= recv_buf;
+    le.length= max_size;
+    le.ct_handle= PTL_CT_NONE;
+    le.uid= PTL_UID_ANY;
+    le.options= PTL_LE_OP_PUT | PTL_LE_EVENT_LINK_DISABLE |
+        PTL_LE_EVENT_UNLINK_DISABLE | PTL_LE_EVENT_COMM_DISABLE;
+    rc= PtlLEAppend(ni, pt_index, &le, PTL_PRIORITY_LIST, NULL, &le_h);
+    LIBTEST_CHECK(rc, "PtlLEAppend");
+
+    rc= PtlCTAlloc(ni, &ct_h);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+
+    md.start= send_buf;
+    md.length= max_size;
+    md.options= PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_SUCCESS_DISABLE;
+    md.eq_handle= PTL_EQ_NONE;
+    md.ct_handle= ct_h;
+    rc= PtlMDBind(ni, &md, &md_h);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    rc= PtlPutPrepare(md_h, PTL_CT_ACK_REQ, self, BENCH_PT_INDEX, 0, NULL,
+            &prep_h);
+    LIBTEST_CHECK(rc, "PtlPutPrepare");
+
+    printf("# %10s %16s %16s\n", "bytes", "put (msg/s)", "prepared (msg/s)");
+
+    count= 0;
+    for (len= 1; len <= (ptl_size_t)max_size; len *= 2)   {
+        for (prepared= 0; prepared < 2; prepared++)   {
+            /* Warm up, then time. */
+            for (i= 0; i < 10; i++)   {
+                count= do_window(prepared, md_h, prep_h, ct_h, len, window,
+                        self, count);
+            }
+
+            start= timer();
+            for (i= 0; i < niters; i++)   {
+                count= do_window(prepared, md_h, prep_h, ct_h, len, window,
+                        self, count);
+            }
+            rate[prepared]= (double)niters * window / (timer() - start);
+        }
+
+        printf("  %10ld %16.0f %16.0f\n", (long)len, rate[0], rate[1]);
+    }
+
+    rc= PtlPreparedRelease(prep_h);
+    LIBTEST_CHECK(rc, "PtlPreparedRelease");
+    rc= PtlMDRelease(md_h);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+    rc= PtlLEUnlink(le_h);
+    LIBTEST_CHECK(rc, "PtlLEUnlink");
+    rc= PtlCTFree(ct_h);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+    rc= PtlPTFree(ni, pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+
+    PtlNIFini(ni);
+    PtlFini();
+
+    free(send_buf);
+    free(recv_buf);
+
+    return 0;
+
+}  /* end of main() */
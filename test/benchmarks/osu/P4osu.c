@@ -0,0 +1,944 @@
+/* -*- C -*-
+ *
+ * Copyright 2013 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** OSU-style micro-benchmark driver for the Portals 4 API.
+**
+** Covers put/get/atomic/fetch-atomic/swap latency, put/get bandwidth,
+** bidirectional put bandwidth, message rate and triggered put
+** throughput between rank 0 and rank 1. Each test can be run on LEs
+** or MEs, with counting events or full events, and on a logical or a
+** physical NI; -a sweeps the entry and completion combinations on the
+** NI selected with -l. Logical and physical NIs are measured in
+** separate runs. With -p, the NIs have no progress thread and are
+** progressed by the benchmark itself while it waits. Results are
+** printed as text, JSON or CSV, so they can be collected by scripts.
+**
+** Example (single node, shmem or UDP loopback):
+**	yod.hydra -np 2 ./P4osu -a -f json
+**	yod.hydra -np 2 ./P4osu -a -l physical -f csv
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define BENCH_PT_INDEX	(5)
+#define EQ_SIZE		(4096)
+#define ATOMIC_SIZE	(sizeof(uint64_t))
+
+enum entry_type { ENTRY_LE, ENTRY_ME };
+enum comp_type { COMP_CT, COMP_EQ };
+enum ni_type { NI_LOGICAL, NI_PHYSICAL };
+enum out_format { OUT_TEXT, OUT_JSON, OUT_CSV };
+
+static const char *entry_name[] = { "le", "me" };
+static const char *comp_name[] = { "ct", "eq" };
+static const char *ni_name[] = { "logical", "physical" };
+
+
+/* configuration parameters - setable by command line arguments */
+static int min_size;
+static int max_size;
+static int niters;
+static int nwarmup;
+static int window;
+static int app_progress;
+static enum out_format format;
+
+
+/*
+** globals
+*/
+static int rank;
+static int world_size;
+static char *send_buf;
+static char *recv_buf;
+static int nrecords;
+
+/* The NIs are created on first use. Index is [ni_type][entry_type]. */
+static ptl_handle_ni_t nis[2][2];
+static ptl_process_t *mapping;
+
+/* Resources for the current configuration. */
+static struct {
+    enum entry_type entry;
+    enum comp_type comp;
+    enum ni_type ni_type;
+
+    ptl_handle_ni_t ni;
+    ptl_process_t peer;
+    ptl_pt_index_t pt_index;
+
+    ptl_handle_md_t md;
+    ptl_handle_ct_t md_ct;
+    ptl_handle_eq_t md_eq;
+    ptl_size_t md_expect;
+
+    ptl_handle_le_t entry_h;
+    ptl_handle_ct_t entry_ct;
+    ptl_handle_eq_t entry_eq;
+    ptl_size_t entry_expect;
+
+    ptl_handle_ct_t trig_ct;
+    ptl_size_t trig_count;
+} cfg;
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+static void
+check_event(const ptl_event_t *ev)
+{
+    if (ev->ni_fail_type != PTL_NI_OK)   {
+        fprintf(stderr, "%d: event %d failed with ni_fail_type %d\n",
+                rank, ev->type, ev->ni_fail_type);
+        exit(1);
+    }
+}  /* end of check_event() */
+
+
+/*
+** Wait for count more initiator side completions (send, ack or
+** reply, depending on how the MD was set up).
+*/
+static void
+wait_local(ptl_size_t count)
+{
+    int rc;
+    ptl_size_t i;
+    ptl_ct_event_t ct;
+    ptl_event_t ev;
+
+    if (cfg.comp == COMP_CT)   {
+        cfg.md_expect += count;
+        rc= PtlCTWait(cfg.md_ct, cfg.md_expect, &ct);
+        LIBTEST_CHECK(rc, "PtlCTWait");
+        if (ct.failure != 0)   {
+            fprintf(stderr, "%d: initiator counter failure\n", rank);
+            exit(1);
+        }
+    } else   {
+        for (i= 0; i < count; i++)   {
+            rc= PtlEQWait(cfg.md_eq, &ev);
+            LIBTEST_CHECK(rc, "PtlEQWait");
+            check_event(&ev);
+        }
+    }
+}  /* end of wait_local() */
+
+
+/*
+** Wait for count more messages to land in our LE/ME.
+*/
+static void
+wait_remote(ptl_size_t count)
+{
+    int rc;
+    ptl_size_t i;
+    ptl_ct_event_t ct;
+    ptl_event_t ev;
+
+    if (cfg.comp == COMP_CT)   {
+        cfg.entry_expect += count;
+        rc= PtlCTWait(cfg.entry_ct, cfg.entry_expect, &ct);
+        LIBTEST_CHECK(rc, "PtlCTWait");
+        if (ct.failure != 0)   {
+            fprintf(stderr, "%d: target counter failure\n", rank);
+            exit(1);
+        }
+    } else   {
+        for (i= 0; i < count; i++)   {
+            rc= PtlEQWait(cfg.entry_eq, &ev);
+            LIBTEST_CHECK(rc, "PtlEQWait");
+            check_event(&ev);
+        }
+    }
+}  /* end of wait_remote() */
+
+
+/*
+** With application progress, a passive target only answers while it
+** is inside the library, so it must wait for the operations it expects
+** instead of going straight to the next barrier.
+*/
+static void
+wait_passive(ptl_size_t count)
+{
+    if (app_progress)   {
+        wait_remote(count);
+    }
+}  /* end of wait_passive() */
+
+
+static ptl_handle_ni_t
+get_ni(enum ni_type ni_type, enum entry_type entry)
+{
+    int rc;
+    unsigned int options;
+    ptl_handle_ni_t *ni= &nis[ni_type][entry];
+
+    if (*ni != PTL_INVALID_HANDLE)   {
+        return *ni;
+    }
+
+    options= (entry == ENTRY_ME) ? PTL_NI_MATCHING : PTL_NI_NO_MATCHING;
+    options|= (ni_type == NI_LOGICAL) ? PTL_NI_LOGICAL : PTL_NI_PHYSICAL;
+    if (app_progress)   {
+        options|= PTL_NI_APP_PROGRESS;
+    }
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, options, PTL_PID_ANY, NULL, NULL, ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    /* All the NIs of a process share the same physical ID, so the
+    ** IDs are only exchanged once, like P4msgrate does. */
+    if (NULL == mapping)   {
+        mapping= libtest_get_mapping(*ni);
+        if (NULL == mapping)   {
+            fprintf(stderr, "%d: libtest_get_mapping failed\n", rank);
+            exit(1);
+        }
+    }
+
+    if (ni_type == NI_LOGICAL)   {
+        rc= PtlSetMap(*ni, world_size, mapping);
+        LIBTEST_CHECK(rc, "PtlSetMap");
+    }
+
+    return *ni;
+}  /* end of get_ni() */
+
+
+/*
+** Close the NIs opened by the tests.
+*/
+static void
+fini_nis(void)
+{
+    int l, e;
+
+    libtest_barrier();
+
+    for (l= 0; l < 2; l++)   {
+        for (e= 0; e < 2; e++)   {
+            if (nis[l][e] != PTL_INVALID_HANDLE)   {
+                PtlNIFini(nis[l][e]);
+                nis[l][e]= PTL_INVALID_HANDLE;
+            }
+        }
+    }
+
+}  /* end of fini_nis() */
+
+
+/*
+** Set up the MD, LE/ME and counters/event queues for one
+** configuration. notify selects whether the LE/ME generates
+** completion events; count_send whether the MD counts send events
+** instead of acks and replies.
+*/
+static void
+setup_config(int notify, int count_send)
+{
+    int rc;
+    ptl_md_t md;
+    ptl_me_t me;
+    ptl_le_t le;
+    unsigned int options;
+    int peer_rank= (rank == 0) ? 1 : 0;
+
+    cfg.ni= get_ni(cfg.ni_type, cfg.entry);
+
+    if (cfg.ni_type == NI_LOGICAL)   {
+        cfg.peer.rank= peer_rank;
+    } else   {
+        cfg.peer= mapping[peer_rank];
+    }
+
+    cfg.md_ct= PTL_CT_NONE;
+    cfg.md_eq= PTL_EQ_NONE;
+    cfg.entry_ct= PTL_CT_NONE;
+    cfg.entry_eq= PTL_EQ_NONE;
+    cfg.md_expect= 0;
+    cfg.entry_expect= 0;
+    cfg.trig_count= 0;
+
+    if (cfg.comp == COMP_CT)   {
+        rc= PtlCTAlloc(cfg.ni, &cfg.md_ct);
+        LIBTEST_CHECK(rc, "PtlCTAlloc");
+        rc= PtlCTAlloc(cfg.ni, &cfg.entry_ct);
+        LIBTEST_CHECK(rc, "PtlCTAlloc");
+    } else   {
+        rc= PtlEQAlloc(cfg.ni, EQ_SIZE, &cfg.md_eq);
+        LIBTEST_CHECK(rc, "PtlEQAlloc");
+        rc= PtlEQAlloc(cfg.ni, EQ_SIZE, &cfg.entry_eq);
+        LIBTEST_CHECK(rc, "PtlEQAlloc");
+    }
+
+    rc= PtlCTAlloc(cfg.ni, &cfg.trig_ct);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+
+    rc= PtlPTAlloc(cfg.ni, 0, cfg.entry_eq, BENCH_PT_INDEX, &cfg.pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    /* Initiator side. The same MD is used for the put and the get
+     * sides of fetch-atomic and swap. */
+    md.start= send_buf;
+    md.length= max_size;
+    md.ct_handle= cfg.md_ct;
+    md.eq_handle= cfg.md_eq;
+    if (cfg.comp == COMP_CT)   {
+        md.options= count_send ? PTL_MD_EVENT_CT_SEND :
+                    (PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_REPLY);
+    } else   {
+        md.options= count_send ? 0 : PTL_MD_EVENT_SEND_DISABLE;
+    }
+    rc= PtlMDBind(cfg.ni, &md, &cfg.md);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    /* Target side. */
+    options= PTL_LE_OP_PUT | PTL_LE_OP_GET | PTL_LE_EVENT_LINK_DISABLE |
+             PTL_LE_EVENT_UNLINK_DISABLE;
+    if (!notify)   {
+        options|= PTL_LE_EVENT_COMM_DISABLE;
+    } else if (cfg.comp == COMP_CT)   {
+        options|= PTL_LE_EVENT_CT_COMM | PTL_LE_EVENT_COMM_DISABLE;
+    }
+
+    if (cfg.entry == ENTRY_LE)   {
+        le.start= recv_buf;
+        le.length= max_size;
+        le.ct_handle= cfg.entry_ct;
+        le.uid= PTL_UID_ANY;
+        le.options= options;
+        rc= PtlLEAppend(cfg.ni, cfg.pt_index, &le, PTL_PRIORITY_LIST, NULL,
+                        &cfg.entry_h);
+        LIBTEST_CHECK(rc, "PtlLEAppend");
+    } else   {
+        me.start= recv_buf;
+        me.length= max_size;
+        me.ct_handle= cfg.entry_ct;
+        me.uid= PTL_UID_ANY;
+        me.options= options;
+        if (cfg.ni_type == NI_LOGICAL)   {
+            me.match_id.rank= PTL_RANK_ANY;
+        } else   {
+            me.match_id.phys.nid= PTL_NID_ANY;
+            me.match_id.phys.pid= PTL_PID_ANY;
+        }
+        me.match_bits= 0;
+        me.ignore_bits= 0;
+        me.min_free= 0;
+        rc= PtlMEAppend(cfg.ni, cfg.pt_index, &me, PTL_PRIORITY_LIST, NULL,
+                        &cfg.entry_h);
+        LIBTEST_CHECK(rc, "PtlMEAppend");
+    }
+
+    /* Everybody must have its entry in place before the first
+     * message is sent. */
+    libtest_barrier();
+
+}  /* end of setup_config() */
+
+
+static void
+teardown_config(void)
+{
+    int rc;
+
+    /* Wait for all in-flight traffic to settle. */
+    libtest_barrier();
+
+    if (cfg.entry == ENTRY_LE)   {
+        rc= PtlLEUnlink(cfg.entry_h);
+        LIBTEST_CHECK(rc, "PtlLEUnlink");
+    } else   {
+        rc= PtlMEUnlink(cfg.entry_h);
+        LIBTEST_CHECK(rc, "PtlMEUnlink");
+    }
+
+    rc= PtlMDRelease(cfg.md);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+
+    rc= PtlPTFree(cfg.ni, cfg.pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+
+    rc= PtlCTFree(cfg.trig_ct);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+
+    if (cfg.comp == COMP_CT)   {
+        PtlCTFree(cfg.md_ct);
+        PtlCTFree(cfg.entry_ct);
+    } else   {
+        PtlEQFree(cfg.md_eq);
+        PtlEQFree(cfg.entry_eq);
+    }
+
+}  /* end of teardown_config() */
+
+
+static void
+display_result(const char *test, int nbytes, double value, const char *unit)
+{
+    if (0 != rank)   {
+        return;
+    }
+
+    switch (format)   {
+        case OUT_JSON:
+            printf("%s  {\"test\": \"%s\", \"entry\": \"%s\", "
+                   "\"completion\": \"%s\", \"ni\": \"%s\", "
+                   "\"bytes\": %d, \"iterations\": %d, \"window\": %d, "
+                   "\"value\": %.3f, \"unit\": \"%s\"}",
+                   nrecords ? ",\n" : "", test, entry_name[cfg.entry],
+                   comp_name[cfg.comp], ni_name[cfg.ni_type], nbytes,
+                   niters, window, value, unit);
+            break;
+
+        case OUT_CSV:
+            printf("%s,%s,%s,%s,%d,%d,%d,%.3f,%s\n", test,
+                   entry_name[cfg.entry], comp_name[cfg.comp],
+                   ni_name[cfg.ni_type], nbytes, niters, window, value, unit);
+            break;
+
+        default:
+            printf("%-10s %-3s %-3s %-9s %10d %14.3f %s\n", test,
+                   entry_name[cfg.entry], comp_name[cfg.comp],
+                   ni_name[cfg.ni_type], nbytes, value, unit);
+            break;
+    }
+
+    fflush(stdout);
+    nrecords++;
+
+}  /* end of display_result() */
+
+
+/*
+** The tests. Each one runs iters iterations and returns the elapsed
+** time seen by rank 0.
+*/
+static double
+test_put_lat(int nbytes, int iters)
+{
+    int i, rc;
+    double start;
+
+    start= timer();
+    for (i= 0; i < iters; i++)   {
+        if (rank == 0)   {
+            rc= PtlPut(cfg.md, 0, nbytes, PTL_NO_ACK_REQ, cfg.peer,
+                       cfg.pt_index, 0, 0, NULL, 0);
+            LIBTEST_CHECK(rc, "PtlPut");
+            wait_remote(1);
+        } else   {
+            wait_remote(1);
+            rc= PtlPut(cfg.md, 0, nbytes, PTL_NO_ACK_REQ, cfg.peer,
+                       cfg.pt_index, 0, 0, NULL, 0);
+            LIBTEST_CHECK(rc, "PtlPut");
+        }
+
+        /* Nobody moves a large put along while we sit in the next
+         * barrier, unless we wait for it here. */
+        if (app_progress)   {
+            wait_local(1);
+        }
+    }
+
+    return timer() - start;
+}  /* end of test_put_lat() */
+
+
+/* Issue one passive target operation. */
+static void
+issue_op(const char *test, int nbytes, ptl_ack_req_t ack_req)
+{
+    int rc;
+
+    /* Full acks need an event queue on the MD; use counting acks
+     * otherwise. */
+    if (ack_req == PTL_ACK_REQ && cfg.comp == COMP_CT)   {
+        ack_req= PTL_CT_ACK_REQ;
+    }
+
+    if (0 == strncmp(test, "put", 3))   {
+        rc= PtlPut(cfg.md, 0, nbytes, ack_req, cfg.peer, cfg.pt_index,
+                   0, 0, NULL, 0);
+        LIBTEST_CHECK(rc, "PtlPut");
+    } else if (0 == strncmp(test, "get", 3))   {
+        rc= PtlGet(cfg.md, 0, nbytes, cfg.peer, cfg.pt_index, 0, 0, NULL);
+        LIBTEST_CHECK(rc, "PtlGet");
+    } else if (0 == strncmp(test, "atomic", 6))   {
+        rc= PtlAtomic(cfg.md, 0, nbytes, ack_req, cfg.peer, cfg.pt_index,
+                      0, 0, NULL, 0, PTL_SUM, PTL_UINT64_T);
+        LIBTEST_CHECK(rc, "PtlAtomic");
+    } else if (0 == strncmp(test, "fetch", 5))   {
+        rc= PtlFetchAtomic(cfg.md, ATOMIC_SIZE, cfg.md, 0, nbytes, cfg.peer,
+                           cfg.pt_index, 0, 0, NULL, 0, PTL_SUM,
+                           PTL_UINT64_T);
+        LIBTEST_CHECK(rc, "PtlFetchAtomic");
+    } else   {
+        rc= PtlSwap(cfg.md, ATOMIC_SIZE, cfg.md, 0, nbytes, cfg.peer,
+                    cfg.pt_index, 0, 0, NULL, 0, NULL, PTL_SWAP,
+                    PTL_UINT64_T);
+        LIBTEST_CHECK(rc, "PtlSwap");
+    }
+}  /* end of issue_op() */
+
+
+/*
+** Latency of get, atomic, fetch-atomic and swap: rank 0 waits for
+** the ack or reply of each operation before issuing the next one.
+*/
+static double
+test_op_lat(const char *test, int nbytes, int iters)
+{
+    int i;
+    double start;
+
+    start= timer();
+    if (rank == 0)   {
+        for (i= 0; i < iters; i++)   {
+            issue_op(test, nbytes, PTL_ACK_REQ);
+            wait_local(1);
+        }
+    } else   {
+        wait_passive(iters);
+    }
+
+    return timer() - start;
+}  /* end of test_op_lat() */
+
+
+/*
+** Bandwidth: keep a window of acknowledged puts (or gets) in flight.
+** With bidir set, both ranks send at the same time.
+*/
+static double
+test_bw(const char *test, int nbytes, int iters, int bidir)
+{
+    int i, j;
+    double start;
+
+    start= timer();
+    if (rank == 0 || bidir)   {
+        for (i= 0; i < iters; i++)   {
+            for (j= 0; j < window; j++)   {
+                issue_op(test, nbytes, PTL_ACK_REQ);
+            }
+            wait_local(window);
+        }
+    }
+    if (rank != 0 || bidir)   {
+        wait_passive((ptl_size_t)iters * window);
+    }
+
+    return timer() - start;
+}  /* end of test_bw() */
+
+
+/*
+** Message rate: rank 0 streams unacknowledged puts, throttled on the
+** local send completions, and rank 1 answers once everything landed.
+*/
+static double
+test_msgrate(int nbytes, int iters)
+{
+    int i, j, rc;
+    double start;
+
+    start= timer();
+    if (rank == 0)   {
+        for (i= 0; i < iters; i++)   {
+            for (j= 0; j < window; j++)   {
+                issue_op("put", nbytes, PTL_NO_ACK_REQ);
+            }
+            wait_local(window);
+        }
+        wait_remote(1);
+    } else   {
+        wait_remote((ptl_size_t)iters * window);
+        rc= PtlPut(cfg.md, 0, 0, PTL_NO_ACK_REQ, cfg.peer, cfg.pt_index,
+                   0, 0, NULL, 0);
+        LIBTEST_CHECK(rc, "PtlPut");
+    }
+
+    return timer() - start;
+}  /* end of test_msgrate() */
+
+
+/*
+** Triggered put throughput: arm a window of triggered puts on a
+** counter, fire them all with a single increment and wait for their
+** acks.
+*/
+static double
+test_triggered(int nbytes, int iters)
+{
+    int i, j, rc;
+    double start;
+    ptl_ct_event_t inc= { 1, 0 };
+
+    start= timer();
+    if (rank == 0)   {
+        for (i= 0; i < iters; i++)   {
+            cfg.trig_count++;
+            for (j= 0; j < window; j++)   {
+                rc= PtlTriggeredPut(cfg.md, 0, nbytes,
+                                    (cfg.comp == COMP_CT) ? PTL_CT_ACK_REQ :
+                                    PTL_ACK_REQ, cfg.peer, cfg.pt_index, 0, 0,
+                                    NULL, 0, cfg.trig_ct, cfg.trig_count);
+                LIBTEST_CHECK(rc, "PtlTriggeredPut");
+            }
+            rc= PtlCTInc(cfg.trig_ct, inc);
+            LIBTEST_CHECK(rc, "PtlCTInc");
+            wait_local(window);
+        }
+    } else   {
+        wait_passive((ptl_size_t)iters * window);
+    }
+
+    return timer() - start;
+}  /* end of test_triggered() */
+
+
+/* Run one test for every message size. */
+static void
+run_test(const char *test)
+{
+    int nbytes, first, last;
+    int atomic= 0;
+    double t, msgs;
+
+    atomic= (0 == strncmp(test, "atomic", 6) ||
+             0 == strncmp(test, "fetch", 5) ||
+             0 == strncmp(test, "swap", 4));
+
+    if (atomic)   {
+        first= last= ATOMIC_SIZE;
+    } else   {
+        first= min_size;
+        last= max_size;
+    }
+
+    /* With application progress, the passive side counts what it
+     * receives and put_lat waits for its own sends. */
+    setup_config(app_progress || 0 == strcmp(test, "put_lat") ||
+                 0 == strcmp(test, "msgrate"),
+                 0 == strcmp(test, "msgrate") ||
+                 (app_progress && 0 == strcmp(test, "put_lat")));
+
+    for (nbytes= first; nbytes <= last; nbytes= nbytes ? nbytes * 2 : 1)   {
+        if (0 == strcmp(test, "put_lat"))   {
+            test_put_lat(nbytes, nwarmup);
+            libtest_barrier();
+            t= test_put_lat(nbytes, niters);
+            display_result(test, nbytes, t * 1e6 / (2.0 * niters), "us");
+        } else if (0 == strcmp(test, "msgrate"))   {
+            test_msgrate(nbytes, nwarmup);
+            libtest_barrier();
+            t= test_msgrate(nbytes, niters);
+            display_result(test, nbytes, (double)niters * window / t, "msgs/s");
+        } else if (0 == strcmp(test, "trig"))   {
+            test_triggered(nbytes, nwarmup);
+            libtest_barrier();
+            t= test_triggered(nbytes, niters);
+            display_result(test, nbytes, (double)niters * window / t, "ops/s");
+        } else if (0 == strcmp(test + strlen(test) - 4, "bibw"))   {
+            test_bw(test, nbytes, nwarmup, 1);
+            libtest_barrier();
+            t= test_bw(test, nbytes, niters, 1);
+            msgs= 2.0 * niters * window;
+            display_result(test, nbytes, msgs * nbytes / t / 1e6, "MB/s");
+        } else if (0 == strcmp(test + strlen(test) - 2, "bw"))   {
+            test_bw(test, nbytes, nwarmup, 0);
+            libtest_barrier();
+            t= test_bw(test, nbytes, niters, 0);
+            msgs= (double)niters * window;
+            display_result(test, nbytes, msgs * nbytes / t / 1e6, "MB/s");
+        } else   {
+            test_op_lat(test, nbytes, nwarmup);
+            libtest_barrier();
+            t= test_op_lat(test, nbytes, niters);
+            display_result(test, nbytes, t * 1e6 / niters, "us");
+        }
+        libtest_barrier();
+    }
+
+    teardown_config();
+
+}  /* end of run_test() */
+
+
+static const char *all_tests[] = {
+    "put_lat", "get_lat", "atomic_lat", "fetch_lat", "swap_lat",
+    "put_bw", "get_bw", "put_bibw", "msgrate", "trig", NULL
+};
+
+
+static void
+usage(void)
+{
+    int i;
+
+    fprintf(stderr, "Usage: P4osu [OPTION]...\n\n");
+    fprintf(stderr, "  -h           Display this help message and exit\n");
+    fprintf(stderr, "  -t <test>    Test to run, or \"all\" (default)\n");
+    fprintf(stderr, "  -e <entry>   le or me (default le)\n");
+    fprintf(stderr, "  -c <comp>    ct or eq (default ct)\n");
+    fprintf(stderr, "  -l <ni>      logical or physical (default logical)\n");
+    fprintf(stderr, "  -a           Sweep all entry/completion combinations\n");
+    fprintf(stderr, "  -p           Progress the NIs from the benchmark, without a progress thread\n");
+    fprintf(stderr, "  -s <size>    Smallest message size (default 1)\n");
+    fprintf(stderr, "  -S <size>    Largest message size (default 1048576)\n");
+    fprintf(stderr, "  -i <num>     Number of iterations per size\n");
+    fprintf(stderr, "  -w <num>     Number of warmup iterations per size\n");
+    fprintf(stderr, "  -W <num>     Window of outstanding operations for bw, msgrate and trig\n");
+    fprintf(stderr, "  -f <format>  Output format: text, json or csv\n");
+    fprintf(stderr, "\nTests:");
+    for (i= 0; all_tests[i]; i++)   {
+        fprintf(stderr, " %s", all_tests[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int start_err= 0;
+int rc;
+int i, e, c, l;
+int sweep= 0;
+const char *test= "all";
+int entry= ENTRY_LE;
+int comp= COMP_CT;
+int ni_type= NI_LOGICAL;
+
+
+    /* Set some defaults */
+    min_size= 1;
+    max_size= 1024 * 1024;
+    niters= 1000;
+    nwarmup= 100;
+    window= 64;
+    format= OUT_TEXT;
+
+    for (l= 0; l < 2; l++)   {
+        for (e= 0; e < 2; e++)   {
+            nis[l][e]= PTL_INVALID_HANDLE;
+        }
+    }
+
+
+    /* Initialize Portals and get some runtime info */
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= libtest_init();
+    LIBTEST_CHECK(rc, "libtest_init");
+    rank= libtest_get_rank();
+    world_size= libtest_get_size();
+
+
+    /* Handle command line arguments */
+    while (start_err != 1 &&
+           (ch= getopt(argc, argv, "t:e:c:l:aps:S:i:w:W:f:h")) != -1)   {
+        switch (ch)   {
+            case 't':
+                test= optarg;
+                break;
+            case 'e':
+                entry= (0 == strcmp(optarg, "me")) ? ENTRY_ME : ENTRY_LE;
+                break;
+            case 'c':
+                comp= (0 == strcmp(optarg, "eq")) ? COMP_EQ : COMP_CT;
+                break;
+            case 'l':
+                ni_type= (0 == strcmp(optarg, "physical")) ? NI_PHYSICAL : NI_LOGICAL;
+                break;
+            case 'a':
+                sweep= 1;
+                break;
+            case 'p':
+                app_progress= 1;
+                break;
+            case 's':
+                min_size= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'S':
+                max_size= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'i':
+                niters= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'w':
+                nwarmup= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'W':
+                window= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'f':
+                if (0 == strcmp(optarg, "json"))   {
+                    format= OUT_JSON;
+                } else if (0 == strcmp(optarg, "csv"))   {
+                    format= OUT_CSV;
+                } else   {
+                    format= OUT_TEXT;
+                }
+                break;
+            case 'h':
+            case '?':
+            default:
+                start_err= 1;
+                if (rank == 0)   {
+                    usage();
+                }
+        }
+    }
+
+    /* sanity check */
+    if (start_err != 1)   {
+        if (world_size != 2)   {
+            if (rank == 0)   {
+                fprintf(stderr, "Must run on exactly two ranks.\n");
+            }
+            start_err= 1;
+        } else if (min_size < 0 || max_size < min_size ||
+                   max_size < (int)(2 * ATOMIC_SIZE))   {
+            if (rank == 0)   {
+                fprintf(stderr, "Invalid message size range.\n");
+            }
+            start_err= 1;
+        } else if (niters < 1 || nwarmup < 0 || window < 1 ||
+                   window > EQ_SIZE / 2)   {
+            if (rank == 0)   {
+                fprintf(stderr, "Invalid iteration or window count.\n");
+            }
+            start_err= 1;
+        }
+    }
+
+    if (0 != start_err)   {
+        libtest_fini();
+        PtlFini();
+        exit(1);
+    }
+
+    /* Keep the send and receive buffers on distinct pages. */
+    if (posix_memalign((void **)&send_buf, getpagesize(), max_size) ||
+        posix_memalign((void **)&recv_buf, getpagesize(), max_size))   {
+        perror("posix_memalign");
+        exit(1);
+    }
+    memset(send_buf, 0, max_size);
+    memset(recv_buf, 0, max_size);
+
+    if (0 == rank)   {
+        if (format == OUT_JSON)   {
+            printf("[\n");
+        } else if (format == OUT_CSV)   {
+            printf("test,entry,completion,ni,bytes,iterations,window,value,unit\n");
+        } else   {
+            printf("# %-8s %-3s %-3s %-9s %10s %14s\n", "test", "ent", "cmp",
+                   "ni", "bytes", "value");
+        }
+    }
+
+    for (l= 0; l < 2; l++)   {
+        for (e= 0; e < 2; e++)   {
+            for (c= 0; c < 2; c++)   {
+                if (l != ni_type || (!sweep && (e != entry || c != comp)))   {
+                    continue;
+                }
+
+                cfg.ni_type= l;
+                cfg.entry= e;
+                cfg.comp= c;
+
+                if (0 == strcmp(test, "all"))   {
+                    for (i= 0; all_tests[i]; i++)   {
+                        run_test(all_tests[i]);
+                    }
+                } else   {
+                    for (i= 0; all_tests[i]; i++)   {
+                        if (0 == strcmp(test, all_tests[i]))   {
+                            run_test(all_tests[i]);
+                            break;
+                        }
+                    }
+                    if (!all_tests[i] && rank == 0)   {
+                        fprintf(stderr, "Unknown test %s\n", test);
+                        usage();
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    fini_nis();
+
+    if (0 == rank && format == OUT_JSON)   {
+        printf("\n]\n");
+    }
+
+    free(send_buf);
+    free(recv_buf);
+
+    libtest_fini();
+    PtlFini();
+
+    return 0;
+
+}  /* end of main() */
@@ -0,0 +1,269 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Latency of operations a process sends to itself.
+**
+** A single process times put and get over a range of sizes, and
+** atomic, fetch-atomic and swap on one 64 bit integer, each one
+** waiting for its completion before the next is issued. Set
+** PTL_ENABLE_SELF=0 to compare against the regular transports.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define BENCH_PT_INDEX	(7)
+
+
+enum op { PUT, GET, ATOMIC, FETCH, SWAP };
+static const char *op_names[]= { "put", "get", "atomic", "fetch", "swap" };
+
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+/*
+** Issue one operation and wait for it to complete. Returns the
+** completion count expected next.
+*/
+static ptl_size_t
+do_op(enum op op, ptl_handle_md_t md_h, ptl_handle_ct_t ct_h, ptl_size_t len,
+    ptl_process_t self, ptl_size_t count)
+{
+
+int rc;
+ptl_ct_event_t ct;
+uint64_t operand= 1;
+
+
+    switch (op)   {
+        case PUT:
+            rc= PtlPut(md_h, 0, len, PTL_CT_ACK_REQ, self, BENCH_PT_INDEX, 0, 0,
+                    NULL, 0);
+            LIBTEST_CHECK(rc, "PtlPut");
+            break;
+        case GET:
+            rc= PtlGet(md_h, 0, len, self, BENCH_PT_INDEX, 0, 0, NULL);
+            LIBTEST_CHECK(rc, "PtlGet");
+            break;
+        case ATOMIC:
+            rc= PtlAtomic(md_h, 0, len, PTL_CT_ACK_REQ, self, BENCH_PT_INDEX, 0,
+                    0, NULL, 0, PTL_SUM, PTL_UINT64_T);
+            LIBTEST_CHECK(rc, "PtlAtomic");
+            break;
+        case FETCH:
+            rc= PtlFetchAtomic(md_h, 0, md_h, 0, len, self, BENCH_PT_INDEX, 0,
+                    0, NULL, 0, PTL_SUM, PTL_UINT64_T);
+            LIBTEST_CHECK(rc, "PtlFetchAtomic");
+            break;
+        case SWAP:
+            rc= PtlSwap(md_h, 0, md_h, 0, len, self, BENCH_PT_INDEX, 0, 0,
+                    NULL, 0, &operand, PTL_SWAP, PTL_UINT64_T);
+            LIBTEST_CHECK(rc, "PtlSwap");
+            break;
+    }
+
+    count++;
+    rc= PtlCTWait(ct_h, count, &ct);
+    LIBTEST_CHECK(rc, "PtlCTWait");
+    if (ct.failure != 0)   {
+        fprintf(stderr, "%s of %ld bytes failed\n", op_names[op], (long)len);
+        exit(1);
+    }
+
+    return count;
+
+}  /* end of do_op() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-m <bytes>] [-i <iters>]\n", pname);
+    fprintf(stderr, "  -m <bytes>   Largest put/get size (default 1048576)\n");
+    fprintf(stderr, "  -i <iters>   Operations timed per size (default 1000)\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int i;
+int op;
+int niters= 1000;
+long max_size= 1024 * 1024;
+ptl_size_t len;
+ptl_size_t count;
+char *send_buf;
+char *recv_buf;
+double start;
+ptl_process_t self;
+ptl_handle_ni_t ni;
+ptl_pt_index_t pt_index;
+ptl_md_t md;
+ptl_handle_md_t md_h;
+ptl_le_t le;
+ptl_handle_le_t le_h;
+ptl_handle_ct_t ct_h;
+
+
+    while ((ch= getopt(argc, argv, "m:i:h")) != -1)   {
+        switch (ch)   {
+            case 'm':
+                max_size= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'i':
+                niters= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (max_size < (long)sizeof(uint64_t) || niters < 1)   {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    send_buf= malloc(max_size);
+    recv_buf= malloc(max_size);
+    if ((NULL == send_buf) || (NULL == recv_buf))   {
+        perror("malloc");
+        exit(1);
+    }
+    memset(send_buf, 0, max_size);
+    memset(recv_buf, 0, max_size);
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    rc= PtlGetPhysId(ni, &self);
+    LIBTEST_CHECK(rc, "PtlGetPhysId");
+
+    rc= PtlPTAlloc(ni, 0, PTL_EQ_NONE, BENCH_PT_INDEX, &pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    le.start= recv_buf;
+    le.length= max_size;
+    le.ct_handle= PTL_CT_NONE;
+    le.uid= PTL_UID_ANY;
+    le.options= PTL_LE_OP_PUT | PTL_LE_OP_GET | PTL_LE_EVENT_LINK_DISABLE |
+        PTL_LE_EVENT_UNLINK_DISABLE | PTL_LE_EVENT_COMM_DISABLE;
+    rc= PtlLEAppend(ni, pt_index, &le, PTL_PRIORITY_LIST, NULL, &le_h);
+    LIBTEST_CHECK(rc, "PtlLEAppend");
+
+    rc= PtlCTAlloc(ni, &ct_h);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+
+    md.start= send_buf;
+    md.length= max_size;
+    md.options= PTL_MD_EVENT_CT_ACK | PTL_MD_EVENT_CT_REPLY |
+        PTL_MD_EVENT_SUCCESS_DISABLE;
+    md.eq_handle= PTL_EQ_NONE;
+    md.ct_handle= ct_h;
+    rc= PtlMDBind(ni, &md, &md_h);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    printf("# %-8s %10s %14s\n", "op", "bytes", "latency (us)");
+
+    count= 0;
+    for (op= PUT; op <= SWAP; op++)   {
+        for (len= sizeof(uint64_t); len <= (ptl_size_t)max_size; len *= 2)   {
+            /* Warm up, then time. */
+            for (i= 0; i < 10; i++)   {
+                count= do_op(op, md_h, ct_h, len, self, count);
+            }
+
+            start= timer();
+            for (i= 0; i < niters; i++)   {
+                count= do_op(op, md_h, ct_h, len, self, count);
+            }
+
+            printf("  %-8s %10ld %14.3f\n", op_names[op], (long)len,
+                (timer() - start) * 1000000.0 / niters);
+
+            /* Atomic operations are timed on a single element. */
+            if (op >= ATOMIC)   {
+                break;
+            }
+        }
+    }
+
+    rc= PtlMDRelease(md_h);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+    rc= PtlLEUnlink(le_h);
+    LIBTEST_CHECK(rc, "PtlLEUnlink");
+    rc= PtlCTFree(ct_h);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+    rc= PtlPTFree(ni, pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+
+    PtlNIFini(ni);
+    PtlFini();
+
+    free(send_buf);
+    free(recv_buf);
+
+    return 0;
+
+}  /* end of main() */
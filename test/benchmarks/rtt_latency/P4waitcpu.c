@@ -0,0 +1,269 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** CPU used by processes waiting for a message.
+**
+** Two processes pass a token back and forth, and wait for it with
+** PtlCTWait, or PtlEQWait with -e. Rank 0 works for -d microseconds
+** (sleeping, as if computing on another core) before each toss, so
+** rank 1 spends most of its time blocked in the wait: an idle client.
+** With -d 0 both are busy, and the round trip time is the latency.
+**
+**     yod.hydra -np 2 ./P4waitcpu -d 1000
+**
+** Rank 0 reports the round trip time, less the delay, and the CPU
+** time each rank used, in percent of the elapsed time. Run top, or
+** read /proc, to see what the PPE used meanwhile.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <portals4.h>
+#include <support.h>
+
+
+#define BENCH_PT_INDEX	(7)
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+static inline double
+cpu_time(void)
+{
+
+struct rusage ru;
+
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec * 1e-6 +
+        ru.ru_stime.tv_sec + ru.ru_stime.tv_usec * 1e-6;
+
+}  /* end of cpu_time() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-d <usec>] [-n <iters>] [-e]\n", pname);
+    fprintf(stderr, "  -d <usec>    Work of rank 0 before each toss (default 1000)\n");
+    fprintf(stderr, "  -n <iters>   Round trips (default 1000)\n");
+    fprintf(stderr, "  -e           Wait on an EQ instead of a CT\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int use_eq= 0;
+long delay= 1000;
+long niters= 1000;
+long i;
+int rank;
+int token= 0;
+double start, elapsed, cpu, cpu0, cpu1;
+ptl_process_t peer;
+ptl_handle_ni_t ni;
+ptl_pt_index_t pt_index;
+ptl_handle_eq_t eq_h= PTL_EQ_NONE;
+ptl_md_t md;
+ptl_handle_md_t md_h;
+ptl_le_t le;
+ptl_handle_le_t le_h;
+ptl_ct_event_t ct;
+ptl_event_t ev;
+
+
+    while ((ch= getopt(argc, argv, "d:n:eh")) != -1)   {
+        switch (ch)   {
+            case 'd':
+                delay= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'n':
+                niters= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'e':
+                use_eq= 1;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (delay < 0 || niters < 1)   {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= libtest_init();
+    LIBTEST_CHECK(rc, "libtest_init");
+
+    rank= libtest_get_rank();
+    if (libtest_get_size() != 2)   {
+        if (0 == rank)   {
+            fprintf(stderr, "%s needs two processes\n", argv[0]);
+        }
+        exit(1);
+    }
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_LOGICAL,
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    rc= PtlSetMap(ni, 2, libtest_get_mapping(ni));
+    LIBTEST_CHECK(rc, "PtlSetMap");
+
+    if (use_eq)   {
+        rc= PtlEQAlloc(ni, 16, &eq_h);
+        LIBTEST_CHECK(rc, "PtlEQAlloc");
+    }
+
+    rc= PtlPTAlloc(ni, 0, eq_h, BENCH_PT_INDEX, &pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    le.start= &token;
+    le.length= sizeof(token);
+    le.uid= PTL_UID_ANY;
+    le.options= PTL_LE_OP_PUT | PTL_LE_EVENT_LINK_DISABLE;
+    if (use_eq)   {
+        le.ct_handle= PTL_CT_NONE;
+    } else   {
+        le.options|= PTL_LE_EVENT_CT_COMM | PTL_LE_EVENT_COMM_DISABLE;
+        rc= PtlCTAlloc(ni, &le.ct_handle);
+        LIBTEST_CHECK(rc, "PtlCTAlloc");
+    }
+    rc= PtlLEAppend(ni, pt_index, &le, PTL_PRIORITY_LIST, NULL, &le_h);
+    LIBTEST_CHECK(rc, "PtlLEAppend");
+
+    md.start= &token;
+    md.length= sizeof(token);
+    md.options= PTL_MD_EVENT_SUCCESS_DISABLE;
+    md.eq_handle= PTL_EQ_NONE;
+    md.ct_handle= PTL_CT_NONE;
+    rc= PtlMDBind(ni, &md, &md_h);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    libtest_BarrierInit(ni, rank, 2);
+    libtest_AllreduceDouble_init(ni);
+    libtest_Barrier();
+
+    peer.rank= 1 - rank;
+    start= timer();
+    cpu= cpu_time();
+
+    for (i= 0; i < niters; i++)   {
+        if (0 == rank)   {
+            if (delay)   {
+                usleep(delay);
+            }
+            rc= PtlPut(md_h, 0, sizeof(token), PTL_NO_ACK_REQ, peer,
+                    pt_index, 0, 0, NULL, 0);
+            LIBTEST_CHECK(rc, "PtlPut");
+        }
+
+        if (use_eq)   {
+            rc= PtlEQWait(eq_h, &ev);
+            LIBTEST_CHECK(rc, "PtlEQWait");
+        } else   {
+            rc= PtlCTWait(le.ct_handle, i + 1, &ct);
+            LIBTEST_CHECK(rc, "PtlCTWait");
+        }
+
+        if (1 == rank)   {
+            rc= PtlPut(md_h, 0, sizeof(token), PTL_NO_ACK_REQ, peer,
+                    pt_index, 0, 0, NULL, 0);
+            LIBTEST_CHECK(rc, "PtlPut");
+        }
+    }
+
+    elapsed= timer() - start;
+    cpu= cpu_time() - cpu;
+
+    cpu0= libtest_AllreduceDouble(0 == rank ? cpu : 0.0, PTL_SUM);
+    cpu1= libtest_AllreduceDouble(1 == rank ? cpu : 0.0, PTL_SUM);
+
+    if (0 == rank)   {
+        printf("# %ld round trips, rank 0 works %ld usec before each, %s\n",
+            niters, delay, use_eq ? "PtlEQWait" : "PtlCTWait");
+        printf("# %-14s %12s\n", "", "value");
+        printf("  %-14s %12.3f\n", "rtt (usec)",
+            elapsed * 1000000.0 / niters - delay);
+        printf("  %-14s %12.1f\n", "rank 0 cpu %", cpu0 * 100.0 / elapsed);
+        printf("  %-14s %12.1f\n", "rank 1 cpu %", cpu1 * 100.0 / elapsed);
+    }
+
+    libtest_Barrier();
+
+    rc= PtlMDRelease(md_h);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+    rc= PtlLEUnlink(le_h);
+    LIBTEST_CHECK(rc, "PtlLEUnlink");
+    if (use_eq)   {
+        rc= PtlEQFree(eq_h);
+        LIBTEST_CHECK(rc, "PtlEQFree");
+    } else   {
+        rc= PtlCTFree(le.ct_handle);
+        LIBTEST_CHECK(rc, "PtlCTFree");
+    }
+    rc= PtlPTFree(ni, pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+    PtlNIFini(ni);
+    libtest_fini();
+    PtlFini();
+
+    return 0;
+
+}  /* end of main() */
@@ -0,0 +1,334 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Time until a process can talk to all of its peers.
+**
+** Every rank sends one small put to every other rank on a fresh NI,
+** first letting the connections be created on demand by the puts,
+** then after establishing them all at once with PtlNIConnect(). Each
+** phase ends with a barrier, so rank 0 reports the time taken by the
+** slowest rank. With -l physical, the
+** connections to peers on the same node go through the UDP handshake;
+** since a UDP physical NI can't be opened twice in the same process,
+** use -M to measure each method in its own run.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define BENCH_PT_INDEX	(9)
+
+enum method { LAZY, BULK };
+static const char *method_names[]= { "on demand", "PtlNIConnect" };
+
+
+/*
+** globals
+*/
+int rank;
+int world_size;
+int logical= 1;
+ptl_process_t *mapping= NULL;
+
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+static inline ptl_process_t
+peer_id(int peer)
+{
+
+ptl_process_t id;
+
+
+    if (logical)   {
+        id.rank= peer;
+    } else   {
+        id= mapping[peer];
+    }
+
+    return id;
+
+}  /* end of peer_id() */
+
+
+/*
+** Open a fresh NI, connect to every peer with the given method and
+** return the time it took, until every rank has completed and
+** received one put from each peer. *connect_time is the part spent in
+** PtlNIConnect().
+*/
+static double
+run(enum method method, double *connect_time)
+{
+
+int rc;
+int p;
+char buf[8];
+double start, elapsed;
+ptl_handle_ni_t ni;
+ptl_pt_index_t pt_index;
+ptl_md_t md;
+ptl_handle_md_t md_h;
+ptl_le_t le;
+ptl_handle_le_t le_h;
+ptl_handle_ct_t send_ct;
+ptl_handle_ct_t recv_ct;
+ptl_ct_event_t ct;
+
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING |
+            (logical ? PTL_NI_LOGICAL : PTL_NI_PHYSICAL),
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    /* All the NIs of a process share the same physical ID. */
+    if (NULL == mapping)   {
+        mapping= libtest_get_mapping(ni);
+        if (NULL == mapping)   {
+            fprintf(stderr, "%d: libtest_get_mapping failed\n", rank);
+            exit(1);
+        }
+    }
+
+    if (logical)   {
+        rc= PtlSetMap(ni, world_size, mapping);
+        LIBTEST_CHECK(rc, "PtlSetMap");
+    }
+
+    rc= PtlCTAlloc(ni, &send_ct);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+    rc= PtlCTAlloc(ni, &recv_ct);
+    LIBTEST_CHECK(rc, "PtlCTAlloc");
+
+    rc= PtlPTAlloc(ni, 0, PTL_EQ_NONE, BENCH_PT_INDEX, &pt_index);
+    LIBTEST_CHECK(rc, "PtlPTAlloc");
+
+    le.start= buf;
+    le.length= sizeof(buf);
+    le.ct_handle= recv_ct;
+    le.uid= PTL_UID_ANY;
+    le.options= PTL_LE_OP_PUT | PTL_LE_EVENT_LINK_DISABLE |
+        PTL_LE_EVENT_UNLINK_DISABLE | PTL_LE_EVENT_COMM_DISABLE |
+        PTL_LE_EVENT_CT_COMM;
+    rc= PtlLEAppend(ni, pt_index, &le, PTL_PRIORITY_LIST, NULL, &le_h);
+    LIBTEST_CHECK(rc, "PtlLEAppend");
+
+    md.start= buf;
+    md.length= sizeof(buf);
+    md.options= PTL_MD_EVENT_CT_SEND;
+    md.eq_handle= PTL_EQ_NONE;
+    md.ct_handle= send_ct;
+    rc= PtlMDBind(ni, &md, &md_h);
+    LIBTEST_CHECK(rc, "PtlMDBind");
+
+    libtest_barrier();
+    start= timer();
+
+    *connect_time= 0.0;
+    if (method == BULK)   {
+        if (logical)   {
+            rc= PtlNIConnect(ni, world_size, NULL);
+        } else   {
+            rc= PtlNIConnect(ni, world_size, mapping);
+        }
+        LIBTEST_CHECK(rc, "PtlNIConnect");
+        libtest_barrier();
+        *connect_time= timer() - start;
+    }
+
+    for (p= 1; p < world_size; p++)   {
+        rc= PtlPut(md_h, 0, sizeof(buf), PTL_NO_ACK_REQ,
+                peer_id((rank + p) % world_size), pt_index, 0, 0, NULL, 0);
+        LIBTEST_CHECK(rc, "PtlPut");
+    }
+
+    rc= PtlCTWait(send_ct, world_size - 1, &ct);
+    LIBTEST_CHECK(rc, "PtlCTWait");
+
+    /* Our peers' puts must land before the NI goes away. */
+    rc= PtlCTWait(recv_ct, world_size - 1, &ct);
+    LIBTEST_CHECK(rc, "PtlCTWait");
+    libtest_barrier();
+    elapsed= timer() - start;
+
+    rc= PtlMDRelease(md_h);
+    LIBTEST_CHECK(rc, "PtlMDRelease");
+    rc= PtlLEUnlink(le_h);
+    LIBTEST_CHECK(rc, "PtlLEUnlink");
+    rc= PtlPTFree(ni, pt_index);
+    LIBTEST_CHECK(rc, "PtlPTFree");
+    rc= PtlCTFree(send_ct);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+    rc= PtlCTFree(recv_ct);
+    LIBTEST_CHECK(rc, "PtlCTFree");
+
+    libtest_barrier();
+    PtlNIFini(ni);
+
+    return elapsed;
+
+}  /* end of run() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-l logical|physical] [-M demand|connect|all] [-m]\n", pname);
+    fprintf(stderr, "  -l <ni>      Addressing mode of the NI (default logical)\n");
+    fprintf(stderr, "  -M <method>  How connections are established (default all)\n");
+    fprintf(stderr, "  -m           Machine readable output\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int m;
+int only= -1;
+int error= 0;
+int machine_output= 0;
+double elapsed, connect_time;
+
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= libtest_init();
+    if (rc != 0)   {
+        fprintf(stderr, "libtest_init failed\n");
+        exit(1);
+    }
+
+    rank= libtest_get_rank();
+    world_size= libtest_get_size();
+
+    while ((ch= getopt(argc, argv, "l:M:mh")) != -1)   {
+        switch (ch)   {
+            case 'l':
+                if (0 == strcmp(optarg, "logical"))   {
+                    logical= 1;
+                } else if (0 == strcmp(optarg, "physical"))   {
+                    logical= 0;
+                } else   {
+                    error= 1;
+                }
+                break;
+            case 'M':
+                if (0 == strcmp(optarg, "demand"))   {
+                    only= LAZY;
+                } else if (0 == strcmp(optarg, "connect"))   {
+                    only= BULK;
+                } else if (0 != strcmp(optarg, "all"))   {
+                    error= 1;
+                }
+                break;
+            case 'm':
+                machine_output= 1;
+                break;
+            case 'h':
+            default:
+                error= 1;
+                break;
+        }
+    }
+
+    if (world_size < 2)   {
+        if (rank == 0)   {
+            fprintf(stderr, "This benchmark needs at least 2 ranks\n");
+        }
+        error= 1;
+    }
+
+    if (error)   {
+        if (rank == 0)   {
+            usage(argv[0]);
+        }
+        libtest_fini();
+        PtlFini();
+        exit(1);
+    }
+
+    if (rank == 0 && !machine_output)   {
+        printf("# %d ranks, %s NI\n", world_size, logical ? "logical" : "physical");
+        printf("# %-14s %14s %14s\n", "method", "connect (ms)", "total (ms)");
+    }
+
+    for (m= LAZY; m <= BULK; m++)   {
+        if (only >= 0 && m != only)   {
+            continue;
+        }
+
+        elapsed= run(m, &connect_time);
+
+        if (rank == 0)   {
+            if (machine_output)   {
+                printf("%s,%.3f,%.3f\n", method_names[m], connect_time * 1000.0,
+                    elapsed * 1000.0);
+            } else   {
+                printf("  %-14s %14.3f %14.3f\n", method_names[m],
+                    connect_time * 1000.0, elapsed * 1000.0);
+            }
+        }
+    }
+
+    libtest_fini();
+    PtlFini();
+
+    return 0;
+
+}  /* end of main() */
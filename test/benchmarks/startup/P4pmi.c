@@ -0,0 +1,241 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Cost of a PMI wire-up.
+**
+** Every process puts a business card in the KVS, and then reads the
+** cards of all the others, either with one get per card or by walking
+** the whole KVS with the iterator (-i). Portals is not used, so it
+** can run with thousands of local processes to load the PMI server:
+**
+**     yod.hydra -np 2000 ./P4pmi
+**
+** Rank 0 reports how long the puts and the gets took, and the wire-up
+** time from its first put to the end of the last process' gets.
+*/
+
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#if PMI_SLURM
+#include <slurm/pmi.h>
+#else
+#include <pmi.h>
+#endif
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+#define CHECK(rc, name)							\
+    if (PMI_SUCCESS != (rc))   {					\
+        fprintf(stderr, "%s failed: %d\n", (name), (rc));		\
+        exit(1);							\
+    }
+
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-k <keys>] [-v <bytes>] [-i]\n", pname);
+    fprintf(stderr, "  -k <keys>    Cards each process puts (default 1)\n");
+    fprintf(stderr, "  -v <bytes>   Size of a card (default 64)\n");
+    fprintf(stderr, "  -i           Read the cards with the KVS iterator\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int r;
+int k;
+int rank;
+int size;
+int spawned;
+int nkeys= 1;
+int vlen= 64;
+int iter= 0;
+int found;
+int name_max, key_max, val_max;
+char *kvsname;
+char *key;
+char *val;
+char *got;
+double start, put, get, wireup;
+
+
+    while ((ch= getopt(argc, argv, "k:v:ih")) != -1)   {
+        switch (ch)   {
+            case 'k':
+                nkeys= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'v':
+                vlen= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'i':
+                iter= 1;
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (nkeys < 1 || vlen < 1)   {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    rc= PMI_Init(&spawned);
+    CHECK(rc, "PMI_Init");
+    rc= PMI_Get_rank(&rank);
+    CHECK(rc, "PMI_Get_rank");
+    rc= PMI_Get_size(&size);
+    CHECK(rc, "PMI_Get_size");
+
+    rc= PMI_KVS_Get_name_length_max(&name_max);
+    CHECK(rc, "PMI_KVS_Get_name_length_max");
+    rc= PMI_KVS_Get_key_length_max(&key_max);
+    CHECK(rc, "PMI_KVS_Get_key_length_max");
+    rc= PMI_KVS_Get_value_length_max(&val_max);
+    CHECK(rc, "PMI_KVS_Get_value_length_max");
+
+    if (vlen >= val_max)   {
+        vlen= val_max - 1;
+    }
+
+    kvsname= malloc(name_max);
+    key= malloc(key_max);
+    val= malloc(val_max);
+    got= malloc(val_max);
+    if ((NULL == kvsname) || (NULL == key) || (NULL == val) || (NULL == got))   {
+        perror("malloc");
+        exit(1);
+    }
+
+    rc= PMI_KVS_Get_my_name(kvsname, name_max);
+    CHECK(rc, "PMI_KVS_Get_my_name");
+
+    memset(val, 'a' + rank % 26, vlen);
+    val[vlen]= '\0';
+
+    rc= PMI_Barrier();
+    CHECK(rc, "PMI_Barrier");
+
+    start= timer();
+    for (k= 0; k < nkeys; k++)   {
+        snprintf(key, key_max, "card-%d-%d", rank, k);
+        rc= PMI_KVS_Put(kvsname, key, val);
+        CHECK(rc, "PMI_KVS_Put");
+    }
+    rc= PMI_KVS_Commit(kvsname);
+    CHECK(rc, "PMI_KVS_Commit");
+    rc= PMI_Barrier();
+    CHECK(rc, "PMI_Barrier");
+    put= timer() - start;
+
+    found= 0;
+    if (iter)   {
+        rc= PMI_KVS_Iter_first(kvsname, key, key_max, got, val_max);
+        while (PMI_SUCCESS == rc && key[0] != '\0')   {
+            if (0 == strncmp(key, "card-", 5))   {
+                found++;
+            }
+            rc= PMI_KVS_Iter_next(kvsname, key, key_max, got, val_max);
+        }
+        CHECK(rc, "PMI_KVS_Iter_next");
+    } else   {
+        for (r= 0; r < size; r++)   {
+            for (k= 0; k < nkeys; k++)   {
+                snprintf(key, key_max, "card-%d-%d", r, k);
+                rc= PMI_KVS_Get(kvsname, key, got, val_max);
+                CHECK(rc, "PMI_KVS_Get");
+                if (got[0] == 'a' + r % 26)   {
+                    found++;
+                }
+            }
+        }
+    }
+    get= timer() - start - put;
+
+    rc= PMI_Barrier();
+    CHECK(rc, "PMI_Barrier");
+    wireup= timer() - start;
+
+    if (found != size * nkeys)   {
+        fprintf(stderr, "rank %d found %d cards out of %d\n", rank, found,
+            size * nkeys);
+        exit(1);
+    }
+
+    if (0 == rank)   {
+        printf("# %d processes, %d cards of %d bytes each, %s\n", size,
+            nkeys, vlen, iter ? "iterator" : "gets");
+        printf("# %-14s %12s\n", "", "time (ms)");
+        printf("  %-14s %12.3f\n", "put", put * 1000.0);
+        printf("  %-14s %12.3f\n", "get", get * 1000.0);
+        printf("  %-14s %12.3f\n", "wire-up", wireup * 1000.0);
+    }
+
+    free(kvsname);
+    free(key);
+    free(val);
+    free(got);
+    PMI_Finalize();
+
+    return 0;
+
+}  /* end of main() */
@@ -0,0 +1,253 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+/*
+** Startup cost of a logical NI.
+**
+** Builds a synthetic mapping of increasing size, in which this process
+** is rank 0 and every other rank lives on another node, and reports
+** how long PtlSetMap() takes and how much the resident set grows. No
+** message is sent, so the peers never need to exist. Set
+** PTL_COMPRESS_MAP=0 to compare against the uncompressed mapping.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+enum layout { BLOCK, CYCLIC, RANDOM };
+static const char *layout_names[]= { "block", "cyclic", "random" };
+
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+/*
+** Resident set size in KiB, or 0 if it can't be read.
+*/
+static long
+rss_kb(void)
+{
+
+FILE *fp;
+long size, resident;
+
+
+    fp= fopen("/proc/self/statm", "r");
+    if (fp == NULL)   {
+        return 0;
+    }
+
+    if (fscanf(fp, "%ld %ld", &size, &resident) != 2)   {
+        resident= 0;
+    }
+    fclose(fp);
+
+    return resident * (getpagesize() / 1024);
+
+}  /* end of rss_kb() */
+
+
+static void
+fill_mapping(ptl_process_t *mapping, long map_size, enum layout layout,
+    ptl_process_t self, int ppn)
+{
+
+long r;
+long nnodes;
+
+
+    nnodes= (map_size - 1 + ppn - 1) / ppn;
+    if (nnodes < 1)   {
+        nnodes= 1;
+    }
+
+    mapping[0]= self;
+    for (r= 1; r < map_size; r++)   {
+        switch (layout)   {
+            case BLOCK:
+                mapping[r].phys.nid= self.phys.nid + 1 + (r - 1) / ppn;
+                mapping[r].phys.pid= self.phys.pid + (r - 1) % ppn;
+                break;
+            case CYCLIC:
+                mapping[r].phys.nid= self.phys.nid + 1 + (r - 1) % nnodes;
+                mapping[r].phys.pid= self.phys.pid + (r - 1) / nnodes;
+                break;
+            case RANDOM:
+                mapping[r].phys.nid= self.phys.nid + 1 + random() % nnodes;
+                mapping[r].phys.pid= self.phys.pid + random() % ppn;
+                break;
+        }
+    }
+
+}  /* end of fill_mapping() */
+
+
+static void
+usage(char *pname)
+{
+
+    fprintf(stderr, "Usage: %s [-n <ranks>] [-p <ppn>] [-l block|cyclic|random|all]\n", pname);
+    fprintf(stderr, "  -n <ranks>   Largest map size; sizes grow by 10x from 1000 (default 1000000)\n");
+    fprintf(stderr, "  -p <ppn>     Processes per node in the synthetic layout (default 32)\n");
+    fprintf(stderr, "  -l <layout>  Layout of the synthetic map (default all)\n");
+
+}  /* end of usage() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int ch;
+int rc;
+int l;
+int ppn= 32;
+int only= -1;
+long max_size= 1000000;
+long map_size;
+long rss_before;
+double start, elapsed;
+ptl_process_t self;
+ptl_process_t *mapping;
+ptl_handle_ni_t ni_physical;
+ptl_handle_ni_t ni_logical;
+
+
+    while ((ch= getopt(argc, argv, "n:p:l:h")) != -1)   {
+        switch (ch)   {
+            case 'n':
+                max_size= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'p':
+                ppn= strtol(optarg, (char **)NULL, 0);
+                break;
+            case 'l':
+                for (l= 0; l < 3; l++)   {
+                    if (0 == strcmp(optarg, layout_names[l]))   {
+                        only= l;
+                    }
+                }
+                if (only < 0 && 0 != strcmp(optarg, "all"))   {
+                    usage(argv[0]);
+                    exit(1);
+                }
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+                exit(1);
+        }
+    }
+
+    if (max_size < 1 || ppn < 1)   {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    /* A physical NI establishes our PID. */
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_PHYSICAL,
+            PTL_PID_ANY, NULL, NULL, &ni_physical);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    rc= PtlGetPhysId(ni_physical, &self);
+    LIBTEST_CHECK(rc, "PtlGetPhysId");
+
+    mapping= malloc(max_size * sizeof(ptl_process_t));
+    if (mapping == NULL)   {
+        perror("malloc");
+        exit(1);
+    }
+
+    printf("# %-7s %10s %12s %12s\n", "layout", "ranks", "setmap (ms)", "rss (KiB)");
+
+    for (l= 0; l < 3; l++)   {
+        if (only >= 0 && l != only)   {
+            continue;
+        }
+
+        for (map_size= 1000; ; map_size *= 10)   {
+            if (map_size > max_size)   {
+                map_size= max_size;
+            }
+
+            fill_mapping(mapping, map_size, l, self, ppn);
+
+            rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_LOGICAL,
+                    PTL_PID_ANY, NULL, NULL, &ni_logical);
+            LIBTEST_CHECK(rc, "PtlNIInit");
+
+            rss_before= rss_kb();
+            start= timer();
+            rc= PtlSetMap(ni_logical, map_size, mapping);
+            elapsed= timer() - start;
+            LIBTEST_CHECK(rc, "PtlSetMap");
+
+            printf("  %-7s %10ld %12.3f %12ld\n", layout_names[l], map_size,
+                elapsed * 1000.0, rss_kb() - rss_before);
+
+            PtlNIFini(ni_logical);
+
+            if (map_size >= max_size)   {
+                break;
+            }
+        }
+    }
+
+    free(mapping);
+    PtlNIFini(ni_physical);
+    PtlFini();
+
+    return 0;
+
+}  /* end of main() */
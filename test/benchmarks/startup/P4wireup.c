@@ -0,0 +1,125 @@
+/* -*- C -*-
+ *
+ * Copyright 2006 Sandia Corporation. Under the terms of Contract
+ * DE-AC04-94AL85000 with Sandia Corporation, the U.S. Government
+ * retains certain rights in this software.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301, USA.
+ */
+
+
+/*
+** Time until a process can address its peers by rank.
+**
+** Every rank opens a logical NI, exchanges its physical ID with all
+** the others through libtest_get_mapping() and calls PtlSetMap(). A
+** barrier ends the run, so rank 0 reports the time taken by the
+** slowest rank. Run it with many local ranks to load the PMI server:
+**
+**     yod.hydra -np 400 ./P4wireup
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <portals4.h>
+#include <support.h>
+
+#ifdef __APPLE__
+# include <sys/time.h>
+#endif
+
+
+/*
+** Local functions
+*/
+static inline double
+timer(void)
+{
+#ifdef __APPLE__
+    struct timeval tm;
+    gettimeofday(&tm, NULL);
+    return tm.tv_sec + tm.tv_usec * 1e-6;
+#else
+    struct timespec tm;
+
+    clock_gettime(CLOCK_REALTIME, &tm);
+    return tm.tv_sec + tm.tv_nsec / 1000000000.0;
+#endif
+}  /* end of timer() */
+
+
+
+int
+main(int argc, char *argv[])
+{
+
+int rc;
+int rank;
+int world_size;
+double start, mapped, elapsed;
+ptl_handle_ni_t ni;
+ptl_process_t *mapping;
+
+
+    rc= PtlInit();
+    LIBTEST_CHECK(rc, "PtlInit");
+
+    rc= libtest_init();
+    if (rc != 0)   {
+        fprintf(stderr, "libtest_init failed\n");
+        exit(1);
+    }
+
+    rank= libtest_get_rank();
+    world_size= libtest_get_size();
+
+    rc= PtlNIInit(PTL_IFACE_DEFAULT, PTL_NI_NO_MATCHING | PTL_NI_LOGICAL,
+            PTL_PID_ANY, NULL, NULL, &ni);
+    LIBTEST_CHECK(rc, "PtlNIInit");
+
+    libtest_barrier();
+    start= timer();
+
+    mapping= libtest_get_mapping(ni);
+    if (NULL == mapping)   {
+        fprintf(stderr, "%d: libtest_get_mapping failed\n", rank);
+        exit(1);
+    }
+    mapped= timer() - start;
+
+    rc= PtlSetMap(ni, world_size, mapping);
+    LIBTEST_CHECK(rc, "PtlSetMap");
+
+    libtest_barrier();
+    elapsed= timer() - start;
+
+    if (rank == 0)   {
+        printf("# %d ranks\n", world_size);
+        printf("# %-14s %12s\n", "", "time (ms)");
+        printf("  %-14s %12.3f\n", "exchange", mapped * 1000.0);
+        printf("  %-14s %12.3f\n", "wire-up", elapsed * 1000.0);
+    }
+
+    PtlNIFini(ni);
+    libtest_fini();
+    PtlFini();
+
+    return 0;
+
+}  /* end of main() */
@@ -131,12 +131,76 @@ libtest_fini(void)
     return 0;
 }
 
+/* Longest value put in the KVS, leaving room for the rest of the PMI
+ * command on the same line. */
+#define MAX_PUT_LEN 768
+
+/*
+ * Node of each rank, from the PMI_process_mapping that MPICH and Hydra
+ * give: a vector of (first node, number of nodes, ranks per node)
+ * blocks, repeated until every rank has a node. Returns 1 if there is
+ * no such mapping.
+ */
+static int
+get_node_map(const char *name, char *val, int max_val_len, int *node)
+{
+    const char *p;
+    int start[64], count[64], ppn[64];
+    int nblocks, per_cycle, b, n, j, r, len;
+
+    if (PMI_SUCCESS != PMI_KVS_Get(name, "PMI_process_mapping", val,
+                                   max_val_len)) {
+        return 1;
+    }
+
+    p = strstr(val, "(vector,");
+    if (NULL == p) return 1;
+    p += strlen("(vector,");
+
+    per_cycle = 0;
+    for (nblocks = 0 ; nblocks < 64 ; ++nblocks) {
+        if (3 != sscanf(p, "(%d,%d,%d)%n", &start[nblocks], &count[nblocks],
+                        &ppn[nblocks], &len)) {
+            break;
+        }
+        per_cycle += count[nblocks] * ppn[nblocks];
+        p += len;
+        if (',' == *p) p++;
+    }
+    if (0 == nblocks || per_cycle <= 0 || ')' != *p) return 1;
+
+    r = 0;
+    while (r < size) {
+        for (b = 0 ; b < nblocks && r < size ; ++b) {
+            for (n = 0 ; n < count[b] && r < size ; ++n) {
+                for (j = 0 ; j < ppn[b] && r < size ; ++j) {
+                    node[r++] = start[b] + n;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Exchange the physical IDs of all ranks. Each rank puts its ID, the
+ * first rank of each node reads the IDs of the other local ranks and
+ * puts them all in the values of the node, and every rank then reads
+ * the values of each node. That is a few gets per node rather than
+ * one per rank. Without a process mapping, every rank is its own
+ * node.
+ */
 ptl_process_t*
 libtest_get_mapping(ptl_handle_ni_t ni_h)
 {
-    int i, ret, max_name_len, max_key_len, max_val_len;
-    char *name, *key, *val;
+    int i, j, n, ret, max_name_len, max_key_len, max_val_len;
+    int per_val, count;
+    int *node = NULL, *first = NULL, *order = NULL;
+    char *name = NULL, *key = NULL, *val = NULL;
     ptl_process_t my_id;
+    ptl_process_t *ids = NULL;
     struct map_t *map = NULL;
     
     for (i = 0 ; i < 4 ; ++i) {
@@ -157,86 +221,169 @@ libtest_get_mapping(ptl_handle_ni_t ni_h)
     map->handle = ni_h;
 
     if (PMI_SUCCESS != PMI_KVS_Get_name_length_max(&max_name_len)) {
-        return NULL;
+        goto err;
     }
     name = (char*) malloc(max_name_len);
-    if (NULL == name) return NULL;
+    if (NULL == name) goto err;
 
     if (PMI_SUCCESS != PMI_KVS_Get_key_length_max(&max_key_len)) {
-        return NULL;
+        goto err;
     }
     key = (char*) malloc(max_key_len);
-    if (NULL == key) return NULL;
+    if (NULL == key) goto err;
 
     if (PMI_SUCCESS != PMI_KVS_Get_value_length_max(&max_val_len)) {
-        return NULL;
+        goto err;
     }
     val = (char*) malloc(max_val_len);
-    if (NULL == val) return NULL;
+    if (NULL == val) goto err;
+
+    per_val = ((max_val_len < MAX_PUT_LEN ? max_val_len : MAX_PUT_LEN) - 1) /
+        (2 * sizeof(ptl_process_t));
 
     ret = PtlGetPhysId(ni_h, &my_id);
-    if (PTL_OK != ret) return NULL;
+    if (PTL_OK != ret) goto err;
 
     if (PMI_SUCCESS != PMI_KVS_Get_my_name(name, max_name_len)) {
-        return NULL;
+        goto err;
     }
 
-    /* put my information */
-    snprintf(key, max_key_len, "libsupport-%lu-%lu-nid", 
-             (long unsigned) ni_h, (long unsigned) rank);
-    if (0 != encode(&my_id.phys.nid, sizeof(my_id.phys.nid), val, 
-                    max_val_len)) {
-        return NULL;
+    map->mapping = malloc(sizeof(ptl_process_t) * size);
+    node = malloc(sizeof(int) * size);
+    first = calloc(size + 1, sizeof(int));
+    order = malloc(sizeof(int) * size);
+    ids = malloc(sizeof(ptl_process_t) * per_val);
+    if (NULL == map->mapping || NULL == node || NULL == first ||
+        NULL == order || NULL == ids) {
+        goto err;
     }
-    if (PMI_SUCCESS != PMI_KVS_Put(name, key, val)) {
-        return NULL;
+
+    ret = get_node_map(name, val, max_val_len, node);
+    for (i = 0 ; 0 == ret && i < size ; ++i) {
+        if (node[i] < 0 || node[i] >= size) ret = 1;
+    }
+    if (0 != ret) {
+        for (i = 0 ; i < size ; ++i) {
+            node[i] = i;
+        }
     }
 
-    snprintf(key, max_key_len, "libsupport-%lu-%lu-pid",
-             (long unsigned) ni_h, (long unsigned) rank);
-    if (0 != encode(&my_id.phys.pid, sizeof(my_id.phys.pid), val, 
-                    max_val_len)) {
-        return NULL;
+    /* the ranks of node n are order[first[n]] to order[first[n + 1] - 1] */
+    for (i = 0 ; i < size ; ++i) {
+        first[node[i]]++;
+    }
+    for (n = 1 ; n <= size ; ++n) {
+        first[n] += first[n - 1];
     }
-    if (PMI_SUCCESS != PMI_KVS_Put(name, key, val)) {
-        return NULL;
+    for (i = size - 1 ; i >= 0 ; --i) {
+        order[--first[node[i]]] = i;
     }
 
-    if (PMI_SUCCESS != PMI_KVS_Commit(name)) {
-        return NULL;
+    /* put my information, for the first rank of my node */
+    n = node[rank];
+    if (order[first[n]] != rank) {
+        snprintf(key, max_key_len, "libsupport-%lu-%lu",
+                 (long unsigned) ni_h, (long unsigned) rank);
+        if (0 != encode(&my_id, sizeof(my_id), val, max_val_len)) {
+            goto err;
+        }
+        if (PMI_SUCCESS != PMI_KVS_Put(name, key, val)) {
+            goto err;
+        }
+
+        if (PMI_SUCCESS != PMI_KVS_Commit(name)) {
+            goto err;
+        }
     }
 
     if (PMI_SUCCESS != PMI_Barrier()) {
-        return NULL;
+        goto err;
     }
 
-    /* get everyone's information */
-    map->mapping = malloc(sizeof(ptl_process_t) * size);
-    if (NULL == map->mapping) return NULL;
-
-    for (i = 0 ; i < size ; ++i) {
-        snprintf(key, max_key_len, "libsupport-%lu-%lu-nid",
-                 (long unsigned) ni_h, (long unsigned) i);
-        if (PMI_SUCCESS != PMI_KVS_Get(name, key, val, max_val_len)) {
-            return NULL;
-        }
-        if (0 != decode(val, &(map->mapping)[i].phys.nid, 
-                        sizeof((map->mapping)[i].phys.nid))) {
-            return NULL;
+    /* put the information of my node, a few ranks per value */
+    if (order[first[n]] == rank) {
+        for (j = first[n] ; j < first[n + 1] ; ++j) {
+            count = (j - first[n]) % per_val;
+
+            if (order[j] == rank) {
+                ids[count] = my_id;
+            } else {
+                snprintf(key, max_key_len, "libsupport-%lu-%lu",
+                         (long unsigned) ni_h, (long unsigned) order[j]);
+                if (PMI_SUCCESS != PMI_KVS_Get(name, key, val, max_val_len)) {
+                    goto err;
+                }
+                if (0 != decode(val, &ids[count], sizeof(ids[count]))) {
+                    goto err;
+                }
+            }
+
+            if (count + 1 == per_val || j + 1 == first[n + 1]) {
+                snprintf(key, max_key_len, "libsupport-%lu-node-%d-%d",
+                         (long unsigned) ni_h, n, (j - first[n]) / per_val);
+                if (0 != encode(ids, (count + 1) * sizeof(ptl_process_t),
+                                val, max_val_len)) {
+                    goto err;
+                }
+                if (PMI_SUCCESS != PMI_KVS_Put(name, key, val)) {
+                    goto err;
+                }
+            }
         }
 
-        snprintf(key, max_key_len, "libsupport-%lu-%lu-pid",
-                 (long unsigned) ni_h, (long unsigned) i);
-        if (PMI_SUCCESS != PMI_KVS_Get(name, key, val, max_val_len)) {
-            return NULL;
+        if (PMI_SUCCESS != PMI_KVS_Commit(name)) {
+            goto err;
         }
-        if (0 != decode(val, &(map->mapping)[i].phys.pid,
-                        sizeof((map->mapping)[i].phys.pid))) {
-            return NULL;
+    }
+
+    if (PMI_SUCCESS != PMI_Barrier()) {
+        goto err;
+    }
+
+    /* get everyone's information, node by node */
+    for (n = 0 ; n < size ; ++n) {
+        for (j = first[n] ; j < first[n + 1] ; j += count) {
+            count = first[n + 1] - j;
+            if (count > per_val) count = per_val;
+
+            snprintf(key, max_key_len, "libsupport-%lu-node-%d-%d",
+                     (long unsigned) ni_h, n, (j - first[n]) / per_val);
+            if (PMI_SUCCESS != PMI_KVS_Get(name, key, val, max_val_len)) {
+                goto err;
+            }
+            if (0 != decode(val, ids, count * sizeof(ptl_process_t))) {
+                goto err;
+            }
+
+            for (i = 0 ; i < count ; ++i) {
+                map->mapping[order[j + i]] = ids[i];
+            }
         }
     }
 
+    free(ids);
+    free(order);
+    free(first);
+    free(node);
+    free(val);
+    free(key);
+    free(name);
+
     return map->mapping;
+
+ err:
+    free(ids);
+    free(order);
+    free(first);
+    free(node);
+    free(val);
+    free(key);
+    free(name);
+    free(map->mapping);
+    map->mapping = NULL;
+    map->handle = PTL_INVALID_HANDLE;
+
+    return NULL;
 }
 
 
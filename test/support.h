@@ -61,7 +61,8 @@ int libtest_fini(void);
  *  the caller.
  *
  *  This call is collective and must be called in the same order on
- *  all processes.
+ *  all processes. The IDs are gathered per node, so the number of
+ *  PMI gets grows with the number of nodes, not ranks.
  */
 ptl_process_t* libtest_get_mapping(ptl_handle_ni_t ni_h);
 